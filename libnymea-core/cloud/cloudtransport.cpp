@@ -62,6 +62,18 @@ void CloudTransport::sendData(const QList<QUuid> &clientIds, const QByteArray &d
     }
 }
 
+void CloudTransport::sendRawData(const QUuid &clientId, const QByteArray &data)
+{
+    qCDebug(dcCloudTraffic()) << "Sending raw data" << clientId << data.size() << "bytes";
+    foreach (const ConnectionContext &ctx, m_connections) {
+        if (ctx.clientId == clientId) {
+            ctx.proxyConnection->sendData(data);
+            return;
+        }
+    }
+    qCWarning(dcCloud()) << "Error sending data. No such clientId";
+}
+
 void CloudTransport::terminateClientConnection(const QUuid &clientId)
 {
     foreach (const ConnectionContext &ctx, m_connections) {
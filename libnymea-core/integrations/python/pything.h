@@ -76,9 +76,10 @@ static void PyThing_setThing(PyThing *self, Thing *thing, PyThreadState *threadS
     self->pyParams = PyParams_FromParamList(self->thing->params());
     self->pySettings = PyParams_FromParamList(self->thing->settings());
 
-    self->pyStates = PyList_New(thing->states().count());
-    for (int i = 0; i < thing->states().count(); i++) {
-        State state = thing->states().at(i);
+    States states = thing->states();
+    self->pyStates = PyList_New(states.count());
+    for (int i = 0; i < states.count(); i++) {
+        State state = states.at(i);
         PyObject *pyState = Py_BuildValue("{s:s, s:O}",
                                           "stateTypeId", state.stateTypeId().toString().toUtf8().data(),
                                           "value", QVariantToPyObject(state.value()));
@@ -59,6 +59,7 @@
 //#include "unistd.h"
 
 #include "plugintimer.h"
+#include "thingstatecache.h"
 
 #include <QPluginLoader>
 #include <QStaticPlugin>
@@ -69,6 +70,10 @@
 #include <QStandardPaths>
 #include <QDir>
 #include <QJsonDocument>
+#include <QSet>
+
+// Cached states are written behind, at most once per minute and on shutdown
+static const int stateCacheFlushInterval = 60000;
 
 ThingManagerImplementation::ThingManagerImplementation(HardwareManager *hardwareManager, const QLocale &locale, QObject *parent) :
     ThingManager(parent),
@@ -92,6 +97,8 @@ ThingManagerImplementation::ThingManagerImplementation(HardwareManager *hardware
 
     m_apiKeysProvidersLoader = new ApiKeysProvidersLoader(this);
 
+    m_stateCache = new nymeaserver::ThingStateCache(NymeaSettings::cachePath() + "/thingstates.cache", stateCacheFlushInterval, this);
+
     // Give hardware a chance to start up before loading plugins etc.
     QMetaObject::invokeMethod(this, "loadPlugins", Qt::QueuedConnection);
     QMetaObject::invokeMethod(this, "loadConfiguredThings", Qt::QueuedConnection);
@@ -114,6 +121,7 @@ ThingManagerImplementation::~ThingManagerImplementation()
         storeThingStates(thing);
         delete thing;
     }
+    m_stateCache->flush();
 
     foreach (IntegrationPlugin *plugin, m_integrationPlugins) {
         if (plugin->parent() == this) {
@@ -516,7 +524,7 @@ Thing::ThingError ThingManagerImplementation::setStateLogging(const ThingId &thi
         qCWarning(dcThingManager()) << "Cannot configure event logging. Thing" << thingId.toString() << "not found";
         return Thing::ThingErrorThingNotFound;
     }
-    if (!thing->thingClass().stateTypes().findById(stateTypeId).isValid()) {
+    if (!thing->thingClass().hasStateType(stateTypeId)) {
         qCWarning(dcThingManager()) << "Cannot configure state logging. Thing" << thingId.toString() << "has no state type with id" << stateTypeId;
         return Thing::ThingErrorStateTypeNotFound;
     }
@@ -540,7 +548,7 @@ Thing::ThingError ThingManagerImplementation::setEventLogging(const ThingId &thi
         qCWarning(dcThingManager()) << "Cannot configure event logging. Thing" << thingId.toString() << "not found";
         return Thing::ThingErrorThingNotFound;
     }
-    if (!thing->thingClass().eventTypes().findById(eventTypeId).isValid()) {
+    if (!thing->thingClass().hasEventType(eventTypeId)) {
         qCWarning(dcThingManager()) << "Cannot configure event logging. Thing" << thingId.toString() << "has no event type with id" << eventTypeId;
         return Thing::ThingErrorEventTypeNotFound;
     }
@@ -564,7 +572,7 @@ Thing::ThingError ThingManagerImplementation::setStateFilter(const ThingId &thin
         qCWarning(dcThingManager()) << "Cannot configure state filter. Thing" << thingId.toString() << "not found";
         return Thing::ThingErrorThingNotFound;
     }
-    if (!thing->thingClass().stateTypes().findById(stateTypeId).isValid()) {
+    if (!thing->thingClass().hasStateType(stateTypeId)) {
         qCWarning(dcThingManager()) << "Cannot configure state filter. Thing" << thingId.toString() << "has no state type with id" << stateTypeId;
         return Thing::ThingErrorEventTypeNotFound;
     }
@@ -846,10 +854,11 @@ Thing::ThingError ThingManagerImplementation::removeConfiguredThing(const ThingI
     // don't end up aborting an already finished setup instead of calling thingRemoved() on it.
     qApp->processEvents();
 
-    Thing *thing = m_configuredThings.take(thingId);
+    Thing *thing = m_configuredThings.value(thingId);
     if (!thing) {
         return Thing::ThingErrorThingNotFound;
     }
+    unregisterThing(thing);
     IntegrationPlugin *plugin = m_integrationPlugins.value(thing->pluginId());
     if (!plugin) {
         qCWarning(dcThingManager()).nospace() << "Plugin not loaded for thing " << thing->name() << ". Not calling thingRemoved on plugin.";
@@ -869,13 +878,11 @@ Thing::ThingError ThingManagerImplementation::removeConfiguredThing(const ThingI
     settings.remove("");
     settings.endGroup();
 
+    m_stateCache->removeThing(thingId);
     QFile::remove(statesCacheFile(thingId));
 
-    foreach (const IOConnectionId &ioConnectionId, m_ioConnections.keys()) {
-        IOConnection ioConnection = m_ioConnections.value(ioConnectionId);
-        if (ioConnection.inputThingId() == thing->id() || ioConnection.outputThingId() == thing->id()) {
-            disconnectIO(ioConnectionId);
-        }
+    foreach (const IOConnection &ioConnection, ioConnections(thingId)) {
+        disconnectIO(ioConnection.id());
     }
 
     emit thingRemoved(thingId);
@@ -1055,7 +1062,7 @@ IOConnectionResult ThingManagerImplementation::connectIO(const IOConnection &con
         result.error = Thing::ThingErrorStateTypeNotFound;
         return result;
     }
-    StateType inputStateType = inputThing->thingClass().stateTypes().findById(connection.inputStateTypeId());
+    const StateType &inputStateType = inputThing->thingClass().stateType(connection.inputStateTypeId());
 
     // Check if this is actually an input
     if (inputStateType.ioType() != Types::IOTypeDigitalInput && inputStateType.ioType() != Types::IOTypeAnalogInput) {
@@ -1075,7 +1082,7 @@ IOConnectionResult ThingManagerImplementation::connectIO(const IOConnection &con
         result.error = Thing::ThingErrorStateTypeNotFound;
         return result;
     }
-    StateType outputStateType = outputThing->thingClass().stateTypes().findById(connection.outputStateTypeId());
+    const StateType &outputStateType = outputThing->thingClass().stateType(connection.outputStateTypeId());
 
     // Check if this is actually an output
     if (outputStateType.ioType() != Types::IOTypeDigitalOutput && outputStateType.ioType() != Types::IOTypeAnalogOutput) {
@@ -1096,21 +1103,21 @@ IOConnectionResult ThingManagerImplementation::connectIO(const IOConnection &con
         return result;
     }
 
-    // Check if either input or output is already connected
-    foreach (const IOConnectionId &id, m_ioConnections.keys()) {
-        if (m_ioConnections.value(id).inputThingId() == connection.inputThingId() && m_ioConnections.value(id).inputStateTypeId() == connection.inputStateTypeId()) {
-            qCDebug(dcThingManager()).nospace() << "Thing " << inputThing->name() << " already has an IO connection on " << inputStateType.displayName() << ". Replacing old connection.";
-            disconnectIO(id);
-            continue;
-        }
-        if (m_ioConnections.value(id).outputThingId() == connection.outputThingId() && m_ioConnections.value(id).outputStateTypeId() == connection.outputStateTypeId()) {
-            qCDebug(dcThingManager()).nospace() << "Thing " << inputThing->name() << " already has an IO connection on " << inputStateType.displayName() << ". Replacing old connection.";
-            disconnectIO(id);
-        }
+    // Check if either input or output is already connected. A connection might match on both ends.
+    QSet<IOConnectionId> connectedIds;
+    foreach (const IOConnectionId &id, m_ioConnectionsByInput.values(qMakePair(connection.inputThingId(), connection.inputStateTypeId()))) {
+        connectedIds.insert(id);
+    }
+    foreach (const IOConnectionId &id, m_ioConnectionsByOutput.values(qMakePair(connection.outputThingId(), connection.outputStateTypeId()))) {
+        connectedIds.insert(id);
+    }
+    foreach (const IOConnectionId &id, connectedIds) {
+        qCDebug(dcThingManager()).nospace() << "Thing " << inputThing->name() << " already has an IO connection on " << inputStateType.displayName() << ". Replacing old connection.";
+        disconnectIO(id);
     }
 
     // Finally add the connection
-    m_ioConnections.insert(connection.id(), connection);
+    addIOConnection(connection);
 
     storeIOConnections();
 
@@ -1132,7 +1139,9 @@ Thing::ThingError ThingManagerImplementation::disconnectIO(const IOConnectionId
         qCWarning(dcThingManager()) << "IO connection" << ioConnectionId << "not found. Cannot disconnect.";
         return Thing::ThingErrorItemNotFound;
     }
-    m_ioConnections.remove(ioConnectionId);
+    IOConnection ioConnection = m_ioConnections.take(ioConnectionId);
+    m_ioConnectionsByInput.remove(qMakePair(ioConnection.inputThingId(), ioConnection.inputStateTypeId()), ioConnectionId);
+    m_ioConnectionsByOutput.remove(qMakePair(ioConnection.outputThingId(), ioConnection.outputStateTypeId()), ioConnectionId);
 
     NymeaSettings settings(NymeaSettings::SettingsRoleIOConnections);
     settings.beginGroup("IOConnections");
@@ -1235,12 +1244,7 @@ Vendor ThingManagerImplementation::translateVendor(const Vendor &vendor, const Q
 
 Thing *ThingManagerImplementation::findConfiguredThing(const ThingId &id) const
 {
-    foreach (Thing *thing, m_configuredThings) {
-        if (thing->id() == id) {
-            return thing;
-        }
-    }
-    return nullptr;
+    return m_configuredThings.value(id);
 }
 
 Things ThingManagerImplementation::configuredThings() const
@@ -1250,46 +1254,22 @@ Things ThingManagerImplementation::configuredThings() const
 
 Things ThingManagerImplementation::findConfiguredThings(const ThingClassId &thingClassId) const
 {
-    QList<Thing*> ret;
-    foreach (Thing *thing, m_configuredThings) {
-        if (thing->thingClassId() == thingClassId) {
-            ret << thing;
-        }
-    }
-    return ret;
+    return m_configuredThingsByClass.value(thingClassId);
 }
 
 Things ThingManagerImplementation::findConfiguredThings(const QString &interface) const
 {
-    QList<Thing*> ret;
-    foreach (Thing *thing, m_configuredThings) {
-        ThingClass thingClass = m_supportedThings.value(thing->thingClassId());
-        if (thingClass.interfaces().contains(interface)) {
-            ret.append(thing);
-        }
-    }
-    return ret;
+    return m_configuredThingsByInterface.value(interface);
 }
 
 Things ThingManagerImplementation::findChilds(const ThingId &id) const
 {
-    QList<Thing *> ret;
-    foreach (Thing *d, m_configuredThings) {
-        if (d->parentId() == id) {
-            ret.append(d);
-        }
-    }
-    return ret;
+    return m_configuredThingsByParent.value(id);
 }
 
 ThingClass ThingManagerImplementation::findThingClass(const ThingClassId &thingClassId) const
 {
-    foreach (const ThingClass &thingClass, m_supportedThings) {
-        if (thingClass.id() == thingClassId) {
-            return thingClass;
-        }
-    }
-    return ThingClass();
+    return m_supportedThings.value(thingClassId);
 }
 
 ThingActionInfo *ThingManagerImplementation::executeAction(const Action &action)
@@ -1311,8 +1291,8 @@ ThingActionInfo *ThingManagerImplementation::executeAction(const Action &action)
     }
 
     // Make sure this thing has an action type with this id
-    ThingClass thingClass = findThingClass(thing->thingClassId());
-    ActionType actionType = thingClass.actionTypes().findById(action.actionTypeId());
+    const ThingClass &thingClass = thing->thingClass();
+    const ActionType &actionType = thingClass.actionType(action.actionTypeId());
     if (actionType.id().isNull()) {
         qCWarning(dcThingManager()) << "Cannot execute action. No such action type" << action.actionTypeId();
         ThingActionInfo *info = new ThingActionInfo(thing, action, this);
@@ -1323,7 +1303,7 @@ ThingActionInfo *ThingManagerImplementation::executeAction(const Action &action)
     // If there's a stateType with the same id, we'll need to take min/max values from the state as
     // they might change at runtime
     ParamTypes paramTypes = actionType.paramTypes();
-    StateType stateType = thingClass.stateTypes().findById(action.actionTypeId());
+    const StateType &stateType = thingClass.stateType(StateTypeId(action.actionTypeId()));
     if (!stateType.id().isNull()) {
         ParamType pt = actionType.paramTypes().at(0);
         pt.setMinValue(thing->state(stateType.id()).minValue());
@@ -1815,11 +1795,24 @@ void ThingManagerImplementation::onLoaded()
 
 void ThingManagerImplementation::cleanupThingStateCache()
 {
-    QDir dir(NymeaSettings::cachePath() + "/thingstates/");
-    foreach (const QFileInfo &entry, dir.entryList()) {
-        ThingId thingId(entry.baseName());
+    foreach (const ThingId &thingId, m_stateCache->thingIds()) {
         if (!m_configuredThings.contains(thingId)) {
             qCDebug(dcThingManager()) << "Thing ID" << thingId << "not found in configured things. Cleaning up stale thing state cache.";
+            m_stateCache->removeThing(thingId);
+        }
+    }
+
+    // Legacy per thing cache files. Once migrated, the states live in the state cache. Migrated
+    // states are only in memory until the next flush, so the old files are kept unless it succeeds.
+    bool migrated = m_stateCache->flush();
+    if (!migrated) {
+        qCWarning(dcThingManager()) << "Error writing the thing state cache. Keeping the legacy thing state cache files.";
+    }
+    QDir dir(NymeaSettings::cachePath() + "/thingstates/");
+    foreach (const QFileInfo &entry, dir.entryInfoList(QDir::Files)) {
+        ThingId thingId(entry.baseName());
+        if (!m_configuredThings.contains(thingId) || (migrated && m_stateCache->contains(thingId))) {
+            qCDebug(dcThingManager()) << "Cleaning up legacy thing state cache file" << entry.fileName();
             QFile::remove(entry.absoluteFilePath());
         }
     }
@@ -1833,8 +1826,7 @@ void ThingManagerImplementation::onEventTriggered(Event event)
         qCWarning(dcThingManager()) << "Invalid thing id in emitted event. Not forwarding event. Thing setup not complete yet?";
         return;
     }
-    EventType eventType = thing->thingClass().eventTypes().findById(event.eventTypeId());
-    if (!eventType.isValid()) {
+    if (!thing->thingClass().hasEventType(event.eventTypeId())) {
         qCWarning(dcThingManager()) << "The given thing does not have an event type of id " + event.eventTypeId().toString() + ". Not forwarding event.";
         return;
     }
@@ -1854,7 +1846,7 @@ void ThingManagerImplementation::slotThingStateValueChanged(const StateTypeId &s
         qCWarning(dcThingManager()) << "Invalid thing id in state change. Not forwarding event. Thing setup not complete yet?";
         return;
     }
-    if (thing->thingClass().getStateType(stateTypeId).cached()) {
+    if (thing->thingClass().stateType(stateTypeId).cached()) {
         storeThingState(thing, stateTypeId);
     }
 
@@ -1865,120 +1857,119 @@ void ThingManagerImplementation::slotThingStateValueChanged(const StateTypeId &s
 
 void ThingManagerImplementation::syncIOConnection(Thing *thing, const StateTypeId &stateTypeId)
 {
+    // Check if this state is an input to an IO connection.
+    foreach (const IOConnectionId &ioConnectionId, m_ioConnectionsByInput.values(qMakePair(thing->id(), stateTypeId))) {
+        const IOConnection ioConnection = m_ioConnections.value(ioConnectionId);
+        Thing *inputThing = thing;
+        QVariant inputValue = inputThing->stateValue(stateTypeId);
 
-    foreach (const IOConnection &ioConnection, m_ioConnections) {
-        // Check if this state is an input to an IO connection.
-        if (ioConnection.inputThingId() == thing->id() && ioConnection.inputStateTypeId() == stateTypeId) {
-            Thing *inputThing = thing;
-            QVariant inputValue = inputThing->stateValue(stateTypeId);
-
-            Thing *outputThing = m_configuredThings.value(ioConnection.outputThingId());
-            if (!outputThing) {
-                qCWarning(dcThingManager()) << "IO connection contains invalid output thing!";
-                continue;
-            }
-            IntegrationPlugin *plugin = m_integrationPlugins.value(outputThing->pluginId());
-            if (!plugin) {
-                qCWarning(dcThingManager()) << "Plugin not found for IO connection's output action.";
+        Thing *outputThing = m_configuredThings.value(ioConnection.outputThingId());
+        if (!outputThing) {
+            qCWarning(dcThingManager()) << "IO connection contains invalid output thing!";
+            continue;
+        }
+        IntegrationPlugin *plugin = m_integrationPlugins.value(outputThing->pluginId());
+        if (!plugin) {
+            qCWarning(dcThingManager()) << "Plugin not found for IO connection's output action.";
+            continue;
+        }
+        const StateType &inputStateType = inputThing->thingClass().stateType(stateTypeId);
+
+        const StateType &outputStateType = outputThing->thingClass().stateType(ioConnection.outputStateTypeId());
+        if (outputStateType.id().isNull()) {
+            qCWarning(dcThingManager()) << "Could not find output state type for IO connection.";
+            continue;
+        }
+        QVariant outputValue;
+        if (outputStateType.ioType() == Types::IOTypeDigitalOutput) {
+            // Digital IOs are mapped as-is
+            outputValue = ioConnection.inverted() xor inputValue.toBool();
+
+            // We're already in sync! Skipping action.
+            if (outputThing->stateValue(outputStateType.id()) == outputValue) {
                 continue;
             }
-            StateType inputStateType = inputThing->thingClass().getStateType(stateTypeId);
+        } else {
+            // Analog IOs are mapped within the according min/max ranges
+            outputValue = mapValue(inputValue, inputStateType, outputStateType, ioConnection.inverted());
 
-            StateType outputStateType = outputThing->thingClass().getStateType(ioConnection.outputStateTypeId());
-            if (outputStateType.id().isNull()) {
-                qCWarning(dcThingManager()) << "Could not find output state type for IO connection.";
+            // We're already in sync (fuzzy, good enough)! Skipping action.
+            if (qFuzzyCompare(1.0 + outputThing->stateValue(outputStateType.id()).toDouble(), 1.0 + outputValue.toDouble())) {
                 continue;
             }
-            QVariant outputValue;
-            if (outputStateType.ioType() == Types::IOTypeDigitalOutput) {
-                // Digital IOs are mapped as-is
-                outputValue = ioConnection.inverted() xor inputValue.toBool();
-
-                // We're already in sync! Skipping action.
-                if (outputThing->stateValue(outputStateType.id()) == outputValue) {
-                    continue;
-                }
-            } else {
-                // Analog IOs are mapped within the according min/max ranges
-                outputValue = mapValue(inputValue, inputStateType, outputStateType, ioConnection.inverted());
+        }
+        Action outputAction(ActionTypeId(ioConnection.outputStateTypeId()), ioConnection.outputThingId());
 
-                // We're already in sync (fuzzy, good enough)! Skipping action.
-                if (qFuzzyCompare(1.0 + outputThing->stateValue(outputStateType.id()).toDouble(), 1.0 + outputValue.toDouble())) {
-                    continue;
+        Param outputParam(ioConnection.outputStateTypeId(), outputValue);
+        outputAction.setParams(ParamList() << outputParam);
+        qCDebug(dcThingManager()) << "Executing IO connection action on" << outputThing->name() << outputParam;
+        ThingActionInfo* info = executeAction(outputAction);
+        connect(info, &ThingActionInfo::finished, this, [=](){
+            if (info->status() != Thing::ThingErrorNoError) {
+                // An error happened... let's switch the input back to be in sync with the output
+                qCWarning(dcThingManager()) << "Error syncing IO connection state. Reverting input back to old value.";
+                if (inputStateType.ioType() == Types::IOTypeDigitalInput) {
+                    inputThing->setStateValue(inputStateType.id(), outputThing->stateValue(outputStateType.id()));
+                } else {
+                    inputThing->setStateValue(inputStateType.id(), mapValue(outputThing->stateValue(outputStateType.id()), outputStateType, inputStateType, ioConnection.inverted()));
                 }
             }
-            Action outputAction(ActionTypeId(ioConnection.outputStateTypeId()), ioConnection.outputThingId());
-
-            Param outputParam(ioConnection.outputStateTypeId(), outputValue);
-            outputAction.setParams(ParamList() << outputParam);
-            qCDebug(dcThingManager()) << "Executing IO connection action on" << outputThing->name() << outputParam;
-            ThingActionInfo* info = executeAction(outputAction);
-            connect(info, &ThingActionInfo::finished, this, [=](){
-                if (info->status() != Thing::ThingErrorNoError) {
-                    // An error happened... let's switch the input back to be in sync with the output
-                    qCWarning(dcThingManager()) << "Error syncing IO connection state. Reverting input back to old value.";
-                    if (inputStateType.ioType() == Types::IOTypeDigitalInput) {
-                        inputThing->setStateValue(inputStateType.id(), outputThing->stateValue(outputStateType.id()));
-                    } else {
-                        inputThing->setStateValue(inputStateType.id(), mapValue(outputThing->stateValue(outputStateType.id()), outputStateType, inputStateType, ioConnection.inverted()));
-                    }
-                }
-            });
+        });
+    }
+
+    // Now check if this is an output state type and - if possible - update the inputs for bidirectional connections
+    foreach (const IOConnectionId &ioConnectionId, m_ioConnectionsByOutput.values(qMakePair(thing->id(), stateTypeId))) {
+        const IOConnection ioConnection = m_ioConnections.value(ioConnectionId);
+        Thing *outputThing = thing;
+        QVariant outputValue = outputThing->stateValue(stateTypeId);
+
+        Thing *inputThing = m_configuredThings.value(ioConnection.inputThingId());
+        if (!inputThing) {
+            qCWarning(dcThingManager()) << "IO connection contains invalid input thing!";
+            continue;
         }
+        IntegrationPlugin *plugin = m_integrationPlugins.value(inputThing->pluginId());
+        if (!plugin) {
+            qCWarning(dcThingManager()) << "Plugin not found for IO connection's input action.";
+            continue;
+        }
+        const StateType &outputStateType = outputThing->thingClass().stateType(stateTypeId);
 
-        // Now check if this is an output state type and - if possible - update the inputs for bidirectional connections
-        if (ioConnection.outputThingId() == thing->id() && ioConnection.outputStateTypeId() == stateTypeId) {
-            Thing *outputThing = thing;
-            QVariant outputValue = outputThing->stateValue(stateTypeId);
+        const StateType &inputStateType = inputThing->thingClass().stateType(ioConnection.inputStateTypeId());
+        if (inputStateType.id().isNull()) {
+            qCWarning(dcThingManager()) << "Could not find input state type for IO connection.";
+            continue;
+        }
 
-            Thing *inputThing = m_configuredThings.value(ioConnection.inputThingId());
-            if (!inputThing) {
-                qCWarning(dcThingManager()) << "IO connection contains invalid input thing!";
-                continue;
-            }
-            IntegrationPlugin *plugin = m_integrationPlugins.value(inputThing->pluginId());
-            if (!plugin) {
-                qCWarning(dcThingManager()) << "Plugin not found for IO connection's input action.";
-                continue;
-            }
-            StateType outputStateType = outputThing->thingClass().getStateType(stateTypeId);
+        if (!inputStateType.writable()) {
+            qCDebug(dcThingManager()) << "Input state is not writable. This connection is unidirectional.";
+            continue;
+        }
 
-            StateType inputStateType = inputThing->thingClass().getStateType(ioConnection.inputStateTypeId());
-            if (inputStateType.id().isNull()) {
-                qCWarning(dcThingManager()) << "Could not find input state type for IO connection.";
-                continue;
-            }
+        QVariant inputValue;
+        if (inputStateType.ioType() == Types::IOTypeDigitalInput) {
+            // Digital IOs are mapped as-is
+            inputValue = ioConnection.inverted() xor outputValue.toBool();
 
-            if (!inputStateType.writable()) {
-                qCDebug(dcThingManager()) << "Input state is not writable. This connection is unidirectional.";
+            // Prevent looping
+            if (inputThing->stateValue(inputStateType.id()) == inputValue) {
                 continue;
             }
+        } else {
+            // Analog IOs are mapped within the according min/max ranges
+            inputValue = mapValue(outputValue, outputStateType, inputStateType, ioConnection.inverted());
 
-            QVariant inputValue;
-            if (inputStateType.ioType() == Types::IOTypeDigitalInput) {
-                // Digital IOs are mapped as-is
-                inputValue = ioConnection.inverted() xor outputValue.toBool();
-
-                // Prevent looping
-                if (inputThing->stateValue(inputStateType.id()) == inputValue) {
-                    continue;
-                }
-            } else {
-                // Analog IOs are mapped within the according min/max ranges
-                inputValue = mapValue(outputValue, outputStateType, inputStateType, ioConnection.inverted());
-
-                // Prevent looping even if the above calculation has rounding errors... Just skip this action if we're close enough already
-                if (qFuzzyCompare(1.0 + inputThing->stateValue(inputStateType.id()).toDouble(), 1.0 + inputValue.toDouble())) {
-                    continue;
-                }
+            // Prevent looping even if the above calculation has rounding errors... Just skip this action if we're close enough already
+            if (qFuzzyCompare(1.0 + inputThing->stateValue(inputStateType.id()).toDouble(), 1.0 + inputValue.toDouble())) {
+                continue;
             }
-            Action inputAction(ActionTypeId(ioConnection.inputStateTypeId()), ioConnection.inputThingId());
-
-            Param inputParam(ioConnection.inputStateTypeId(), inputValue);
-            inputAction.setParams(ParamList() << inputParam);
-            qCDebug(dcThingManager()) << "Executing reverse IO connection action on" << inputThing->name() << inputParam;
-            executeAction(inputAction);
         }
+        Action inputAction(ActionTypeId(ioConnection.inputStateTypeId()), ioConnection.inputThingId());
+
+        Param inputParam(ioConnection.inputStateTypeId(), inputValue);
+        inputAction.setParams(ParamList() << inputParam);
+        qCDebug(dcThingManager()) << "Executing reverse IO connection action on" << inputThing->name() << inputParam;
+        executeAction(inputAction);
     }
 }
 
@@ -2135,31 +2126,34 @@ QString ThingManagerImplementation::statesCacheFile(const ThingId &thingId)
 
 void ThingManagerImplementation::loadThingStates(Thing *thing)
 {
-    QSettings *settings = nullptr;
-    if (QFile::exists(statesCacheFile(thing->id()))) {
-        settings = new QSettings(statesCacheFile(thing->id()), QSettings::IniFormat);
+    bool migrate = false;
+    QHash<StateTypeId, nymeaserver::ThingStateCache::CachedState> cachedStates;
+    if (m_stateCache->contains(thing->id())) {
+        cachedStates = m_stateCache->states(thing->id());
     } else {
-        // try legacy (<= 0.30 cache)
-        settings = new QSettings(NymeaSettings::settingsPath() + "/thingstates.conf", QSettings::IniFormat);
-        settings->beginGroup(thing->id().toString());
+        QHash<StateTypeId, QVariantList> legacyStates = loadLegacyThingStates(thing);
+        foreach (const StateTypeId &stateTypeId, legacyStates.keys()) {
+            const QVariantList &values = legacyStates[stateTypeId];
+            nymeaserver::ThingStateCache::CachedState cachedState;
+            cachedState.value = values.value(0);
+            cachedState.minValue = values.value(1);
+            cachedState.maxValue = values.value(2);
+            cachedStates.insert(stateTypeId, cachedState);
+        }
+        migrate = !cachedStates.isEmpty();
     }
-    ThingClass thingClass = m_supportedThings.value(thing->thingClassId());
+
+    const ThingClass &thingClass = thing->thingClass();
     foreach (const StateType &stateType, thingClass.stateTypes()) {
         QVariant value = stateType.defaultValue();
         QVariant minValue = stateType.minValue();
         QVariant maxValue = stateType.maxValue();
 
-        if (stateType.cached()) {
-            if (settings->childGroups().contains(stateType.id().toString())) {
-                settings->beginGroup(stateType.id().toString());
-                value = settings->value("value");
-                minValue = settings->value("minValue");
-                maxValue = settings->value("maxValue");
-                settings->endGroup();
-            } else if (settings->contains(stateType.id().toString())) {
-                // Migration from < 0.30
-                value = settings->value(stateType.id().toString());
-            }
+        if (stateType.cached() && cachedStates.contains(stateType.id())) {
+            const nymeaserver::ThingStateCache::CachedState &cachedState = cachedStates[stateType.id()];
+            value = cachedState.value;
+            minValue = cachedState.minValue;
+            maxValue = cachedState.maxValue;
             value.convert(stateType.type());
             minValue.convert(stateType.type());
             maxValue.convert(stateType.type());
@@ -2169,7 +2163,50 @@ void ThingManagerImplementation::loadThingStates(Thing *thing)
         thing->setStateMinMaxValues(stateType.id(), minValue, maxValue);
         thing->setStateValueFilter(stateType.id(), stateType.filter());
     }
+
+    if (migrate) {
+        qCDebug(dcThingManager()) << "Migrating legacy state cache of" << thing->name() << "to the thing state cache";
+        storeThingStates(thing);
+    }
+}
+
+// Reads the states of the given thing from the per thing QSettings cache file, or from
+// thingstates.conf (<= 0.30). Returns value, minValue and maxValue of each cached state type.
+QHash<StateTypeId, QVariantList> ThingManagerImplementation::loadLegacyThingStates(Thing *thing)
+{
+    QHash<StateTypeId, QVariantList> states;
+    QSettings *settings = nullptr;
+    if (QFile::exists(statesCacheFile(thing->id()))) {
+        settings = new QSettings(statesCacheFile(thing->id()), QSettings::IniFormat);
+    } else if (QFile::exists(NymeaSettings::settingsPath() + "/thingstates.conf")) {
+        settings = new QSettings(NymeaSettings::settingsPath() + "/thingstates.conf", QSettings::IniFormat);
+        settings->beginGroup(thing->id().toString());
+    } else {
+        return states;
+    }
+
+    foreach (const StateType &stateType, thing->thingClass().stateTypes()) {
+        if (!stateType.cached()) {
+            continue;
+        }
+        if (settings->childGroups().contains(stateType.id().toString())) {
+            settings->beginGroup(stateType.id().toString());
+            states.insert(stateType.id(), {settings->value("value"), settings->value("minValue"), settings->value("maxValue")});
+            settings->endGroup();
+        } else if (settings->contains(stateType.id().toString())) {
+            // Migration from < 0.30
+            states.insert(stateType.id(), {settings->value(stateType.id().toString()), stateType.minValue(), stateType.maxValue()});
+        }
+    }
     delete settings;
+    return states;
+}
+
+void ThingManagerImplementation::addIOConnection(const IOConnection &ioConnection)
+{
+    m_ioConnections.insert(ioConnection.id(), ioConnection);
+    m_ioConnectionsByInput.insert(qMakePair(ioConnection.inputThingId(), ioConnection.inputStateTypeId()), ioConnection.id());
+    m_ioConnectionsByOutput.insert(qMakePair(ioConnection.outputThingId(), ioConnection.outputStateTypeId()), ioConnection.id());
 }
 
 void ThingManagerImplementation::storeIOConnections()
@@ -2203,7 +2240,7 @@ void ThingManagerImplementation::loadIOConnections()
         StateTypeId outputStateTypeId = connectionSettings.value("outputStateTypeId").toUuid();
         bool inverted = connectionSettings.value("inverted").toBool();
         IOConnection ioConnection(id, inputThingId, inputStateTypeId, outputThingId, outputStateTypeId, inverted);
-        m_ioConnections.insert(id, ioConnection);
+        addIOConnection(ioConnection);
         connectionSettings.endGroup();
 
         Thing *inputThing = m_configuredThings.value(inputThingId);
@@ -2262,12 +2299,37 @@ void ThingManagerImplementation::trySetupThing(Thing *thing)
 void ThingManagerImplementation::registerThing(Thing *thing)
 {
     m_configuredThings.insert(thing->id(), thing);
+    m_configuredThingsByClass[thing->thingClassId()].append(thing);
+    foreach (const QString &interface, thing->thingClass().interfaces()) {
+        m_configuredThingsByInterface[interface].append(thing);
+    }
+    m_configuredThingsByParent[thing->parentId()].append(thing);
     connect(thing, &Thing::eventTriggered, this, &ThingManagerImplementation::onEventTriggered);
     connect(thing, &Thing::stateValueChanged, this, &ThingManagerImplementation::slotThingStateValueChanged);
     connect(thing, &Thing::settingChanged, this, &ThingManagerImplementation::slotThingSettingChanged);
     connect(thing, &Thing::nameChanged, this, &ThingManagerImplementation::slotThingNameChanged);
 }
 
+void ThingManagerImplementation::unregisterThing(Thing *thing)
+{
+    m_configuredThings.remove(thing->id());
+
+    m_configuredThingsByClass[thing->thingClassId()].removeAll(thing);
+    if (m_configuredThingsByClass.value(thing->thingClassId()).isEmpty()) {
+        m_configuredThingsByClass.remove(thing->thingClassId());
+    }
+    foreach (const QString &interface, thing->thingClass().interfaces()) {
+        m_configuredThingsByInterface[interface].removeAll(thing);
+        if (m_configuredThingsByInterface.value(interface).isEmpty()) {
+            m_configuredThingsByInterface.remove(interface);
+        }
+    }
+    m_configuredThingsByParent[thing->parentId()].removeAll(thing);
+    if (m_configuredThingsByParent.value(thing->parentId()).isEmpty()) {
+        m_configuredThingsByParent.remove(thing->parentId());
+    }
+}
+
 IntegrationPlugin *ThingManagerImplementation::createCppIntegrationPlugin(const QString &absoluteFilePath)
 {
     // Check plugin API version compatibility
@@ -2342,12 +2404,7 @@ void ThingManagerImplementation::storeThingStates(Thing *thing)
 
 void ThingManagerImplementation::storeThingState(Thing *thing, const StateTypeId &stateTypeId)
 {
-    QSettings settings(statesCacheFile(thing->id()), QSettings::IniFormat);
-    qCDebug(dcThingManager()) << "Caching state:" << thing->name() << thing->thingClass().stateTypes().findById(stateTypeId).name();
-    settings.beginGroup(stateTypeId.toString());
-    settings.setValue("value", thing->stateValue(stateTypeId));
-    settings.setValue("minValue", thing->state(stateTypeId).minValue());
-    settings.setValue("maxValue", thing->state(stateTypeId).maxValue());
-    settings.endGroup();
+    State state = thing->state(stateTypeId);
+    m_stateCache->storeState(thing->id(), stateTypeId, state.value(), state.minValue(), state.maxValue());
 }
 
@@ -61,6 +61,10 @@ class HardwareManager;
 class Translator;
 class ApiKeysProvidersLoader;
 
+namespace nymeaserver {
+class ThingStateCache;
+}
+
 class ThingManagerImplementation: public ThingManager
 {
     Q_OBJECT
@@ -162,11 +166,14 @@ private:
     void initThing(Thing *thing);
     void trySetupThing(Thing *thing);
     void registerThing(Thing *thing);
+    void unregisterThing(Thing *thing);
     void postSetupThing(Thing *thing);
     QString statesCacheFile(const ThingId &thingId);
+    QHash<StateTypeId, QVariantList> loadLegacyThingStates(Thing *thing);
     void storeThingStates(Thing *thing);
     void storeThingState(Thing *thing, const StateTypeId &stateTypeId);
     void loadThingStates(Thing *thing);
+    void addIOConnection(const IOConnection &ioConnection);
     void storeIOConnections();
     void loadIOConnections();
     void syncIOConnection(Thing *inputThing, const StateTypeId &stateTypeId);
@@ -184,7 +191,12 @@ private:
     QHash<VendorId, QList<ThingClassId> > m_vendorThingMap;
     QHash<ThingClassId, ThingClass> m_supportedThings;
     QHash<ThingId, Thing*> m_configuredThings;
+    // Secondary indexes of m_configuredThings
+    QHash<ThingClassId, QList<Thing*>> m_configuredThingsByClass;
+    QHash<QString, QList<Thing*>> m_configuredThingsByInterface;
+    QHash<ThingId, QList<Thing*>> m_configuredThingsByParent;
     QHash<ThingDescriptorId, ThingDescriptor> m_discoveredThings;
+    nymeaserver::ThingStateCache *m_stateCache = nullptr;
 
     QHash<PluginId, IntegrationPlugin*> m_integrationPlugins;
 
@@ -200,6 +212,9 @@ private:
     QHash<ThingId, ThingSetupInfo*> m_pendingSetups;
 
     QHash<IOConnectionId, IOConnection> m_ioConnections;
+    // (thingId, stateTypeId) -> IO connections using that state as input or output
+    QMultiHash<QPair<ThingId, StateTypeId>, IOConnectionId> m_ioConnectionsByInput;
+    QMultiHash<QPair<ThingId, StateTypeId>, IOConnectionId> m_ioConnectionsByOutput;
 
     ApiKeysProvidersLoader *m_apiKeysProvidersLoader = nullptr;
 };
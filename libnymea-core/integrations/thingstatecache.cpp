@@ -0,0 +1,212 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2022, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+/*!
+    \class nymeaserver::ThingStateCache
+    \brief Keeps the values of cached thing states in memory and writes them to disk behind the scenes.
+
+    \ingroup things
+    \inmodule core
+
+    All cached states of all things are held in memory. Changes only mark the cache dirty, the file is
+    written at most once per flush interval and when the cache is destroyed. The whole cache is stored in a
+    single binary file which is written to a temporary file first and then renamed over the old one, so a
+    crash or power loss while flushing leaves the previous version intact.
+*/
+
+#include "thingstatecache.h"
+#include "loggingcategories.h"
+
+#include <QDataStream>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QFile>
+#include <QDir>
+
+namespace nymeaserver {
+
+static const quint32 cacheMagic = 0x6e534331; // "nSC1"
+static const quint32 cacheVersion = 1;
+
+/*! Constructs a ThingStateCache backed by the file \a fileName and loads its content. Changes are written
+    to disk at most every \a flushInterval milliseconds. */
+ThingStateCache::ThingStateCache(const QString &fileName, int flushInterval, QObject *parent):
+    QObject(parent),
+    m_fileName(fileName)
+{
+    m_flushTimer.setSingleShot(true);
+    m_flushTimer.setInterval(flushInterval);
+    connect(&m_flushTimer, &QTimer::timeout, this, &ThingStateCache::flush);
+
+    load();
+}
+
+/*! Writes pending changes to disk. */
+ThingStateCache::~ThingStateCache()
+{
+    flush();
+}
+
+/*! Returns true if there are cached states for the thing with the given \a thingId. */
+bool ThingStateCache::contains(const ThingId &thingId) const
+{
+    return m_states.contains(thingId);
+}
+
+/*! Returns the ids of all things with cached states. */
+QList<ThingId> ThingStateCache::thingIds() const
+{
+    return m_states.keys();
+}
+
+/*! Returns the cached states of the thing with the given \a thingId. */
+QHash<StateTypeId, ThingStateCache::CachedState> ThingStateCache::states(const ThingId &thingId) const
+{
+    return m_states.value(thingId);
+}
+
+/*! Updates the cached state with the given \a stateTypeId of the thing with the given \a thingId. The
+    change will be written to disk with the next flush. */
+void ThingStateCache::storeState(const ThingId &thingId, const StateTypeId &stateTypeId, const QVariant &value, const QVariant &minValue, const QVariant &maxValue)
+{
+    QHash<StateTypeId, CachedState> &states = m_states[thingId];
+    QHash<StateTypeId, CachedState>::const_iterator it = states.constFind(stateTypeId);
+    if (it != states.constEnd() && it->value == value && it->minValue == minValue && it->maxValue == maxValue) {
+        return;
+    }
+    CachedState &state = states[stateTypeId];
+    state.value = value;
+    state.minValue = minValue;
+    state.maxValue = maxValue;
+    markDirty();
+}
+
+/*! Removes all cached states of the thing with the given \a thingId. */
+void ThingStateCache::removeThing(const ThingId &thingId)
+{
+    if (m_states.remove(thingId) > 0) {
+        markDirty();
+    }
+}
+
+/*! Writes the cache to disk if it has been changed since the last flush. Returns false if writing failed. */
+bool ThingStateCache::flush()
+{
+    m_flushTimer.stop();
+    if (!m_dirty) {
+        return true;
+    }
+
+    QDir dir = QFileInfo(m_fileName).absoluteDir();
+    if (!dir.exists() && !dir.mkpath(dir.absolutePath())) {
+        qCWarning(dcThingManager()) << "Error creating thing state cache dir at" << dir.absolutePath();
+        return false;
+    }
+
+    QSaveFile file(m_fileName);
+    if (!file.open(QFile::WriteOnly)) {
+        qCWarning(dcThingManager()) << "Error opening thing state cache for writing at" << m_fileName << file.errorString();
+        return false;
+    }
+
+    QDataStream stream(&file);
+    stream.setVersion(QDataStream::Qt_5_0);
+    stream << cacheMagic << cacheVersion;
+    stream << static_cast<quint32>(m_states.count());
+    for (auto thingIt = m_states.constBegin(); thingIt != m_states.constEnd(); ++thingIt) {
+        stream << thingIt.key() << static_cast<quint32>(thingIt->count());
+        for (auto stateIt = thingIt->constBegin(); stateIt != thingIt->constEnd(); ++stateIt) {
+            stream << stateIt.key() << stateIt->value << stateIt->minValue << stateIt->maxValue;
+        }
+    }
+
+    if (stream.status() != QDataStream::Ok || !file.commit()) {
+        qCWarning(dcThingManager()) << "Error writing thing state cache at" << m_fileName << file.errorString();
+        return false;
+    }
+
+    qCDebug(dcThingManager()) << "Thing state cache written for" << m_states.count() << "things";
+    m_dirty = false;
+    return true;
+}
+
+void ThingStateCache::load()
+{
+    QFile file(m_fileName);
+    if (!file.exists()) {
+        return;
+    }
+    if (!file.open(QFile::ReadOnly)) {
+        qCWarning(dcThingManager()) << "Error opening thing state cache at" << m_fileName << file.errorString();
+        return;
+    }
+
+    QDataStream stream(&file);
+    stream.setVersion(QDataStream::Qt_5_0);
+    quint32 magic = 0, version = 0, thingCount = 0;
+    stream >> magic >> version;
+    if (magic != cacheMagic || version != cacheVersion) {
+        qCWarning(dcThingManager()) << "Thing state cache at" << m_fileName << "has an unknown format. Ignoring it.";
+        return;
+    }
+
+    QHash<ThingId, QHash<StateTypeId, CachedState>> things;
+    stream >> thingCount;
+    for (quint32 i = 0; i < thingCount && stream.status() == QDataStream::Ok; i++) {
+        QUuid thingId;
+        quint32 stateCount = 0;
+        stream >> thingId >> stateCount;
+        QHash<StateTypeId, CachedState> &states = things[ThingId(thingId)];
+        for (quint32 j = 0; j < stateCount && stream.status() == QDataStream::Ok; j++) {
+            QUuid stateTypeId;
+            CachedState state;
+            stream >> stateTypeId >> state.value >> state.minValue >> state.maxValue;
+            states.insert(StateTypeId(stateTypeId), state);
+        }
+    }
+
+    if (stream.status() != QDataStream::Ok) {
+        qCWarning(dcThingManager()) << "Thing state cache at" << m_fileName << "is corrupt. Ignoring it.";
+        return;
+    }
+
+    m_states = things;
+    qCDebug(dcThingManager()) << "Loaded thing state cache for" << m_states.count() << "things";
+}
+
+void ThingStateCache::markDirty()
+{
+    m_dirty = true;
+    if (!m_flushTimer.isActive()) {
+        m_flushTimer.start();
+    }
+}
+
+}
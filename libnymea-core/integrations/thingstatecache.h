@@ -0,0 +1,78 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2022, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef THINGSTATECACHE_H
+#define THINGSTATECACHE_H
+
+#include "typeutils.h"
+
+#include <QObject>
+#include <QHash>
+#include <QTimer>
+#include <QVariant>
+
+namespace nymeaserver {
+
+class ThingStateCache : public QObject
+{
+    Q_OBJECT
+public:
+    struct CachedState {
+        QVariant value;
+        QVariant minValue;
+        QVariant maxValue;
+    };
+
+    explicit ThingStateCache(const QString &fileName, int flushInterval, QObject *parent = nullptr);
+    ~ThingStateCache() override;
+
+    bool contains(const ThingId &thingId) const;
+    QList<ThingId> thingIds() const;
+    QHash<StateTypeId, CachedState> states(const ThingId &thingId) const;
+
+    void storeState(const ThingId &thingId, const StateTypeId &stateTypeId, const QVariant &value, const QVariant &minValue, const QVariant &maxValue);
+    void removeThing(const ThingId &thingId);
+
+public slots:
+    bool flush();
+
+private:
+    void load();
+    void markDirty();
+
+    QString m_fileName;
+    QHash<ThingId, QHash<StateTypeId, CachedState>> m_states;
+    QTimer m_flushTimer;
+    bool m_dirty = false;
+};
+
+}
+
+#endif // THINGSTATECACHE_H
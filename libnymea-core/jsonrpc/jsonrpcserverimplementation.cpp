@@ -74,11 +74,17 @@
 #include "modbusrtuhandler.h"
 
 #include <QJsonDocument>
+#if QT_VERSION >= QT_VERSION_CHECK(5,12,0)
+#include <QCborValue>
+#endif
 #include <QStringList>
 #include <QSslConfiguration>
 
 namespace nymeaserver {
 
+// Throttled notifications are held back while more than this is waiting to be written to the client
+static const qint64 maxThrottledBytesToWrite = 64 * 1024;
+
 /*! Constructs a \l{JsonRPCServer} with the given \a sslConfiguration and \a parent. */
 JsonRPCServerImplementation::JsonRPCServerImplementation(const QSslConfiguration &sslConfiguration, QObject *parent):
     JsonHandler(parent),
@@ -91,6 +97,9 @@ JsonRPCServerImplementation::JsonRPCServerImplementation(const QSslConfiguration
     registerEnum<BasicType>();
     registerEnum<UserManager::UserError>();
     registerEnum<CloudManager::CloudConnectionState>();
+    registerEnum<MessageEncoding>();
+    registerEnum<MessageCompression>();
+    registerEnum<MessageFraming>();
     registerFlag<Types::PermissionScope, Types::PermissionScopes>();
 
     // Objects
@@ -106,6 +115,13 @@ JsonRPCServerImplementation::JsonRPCServerImplementation(const QSslConfiguration
     cacheHash.insert("hash", enumValueName(String));
     registerObject("CacheHash", cacheHash);
 
+    QVariantMap notificationFilter;
+    notificationFilter.insert("o:notifications", enumValueName(StringList));
+    notificationFilter.insert("o:thingIds", QVariantList() << enumValueName(Uuid));
+    notificationFilter.insert("o:stateTypeIds", QVariantList() << enumValueName(Uuid));
+    notificationFilter.insert("o:interfaces", enumValueName(StringList));
+    registerObject("NotificationFilter", notificationFilter);
+
     // Methods
     QString description; QVariantMap returns; QVariantMap params;
     description = "Initiates a connection. Use this method to perform an initial handshake of the "
@@ -121,8 +137,32 @@ JsonRPCServerImplementation::JsonRPCServerImplementation(const QSslConfiguration
                             "a method does not change, a client may use a previously cached copy of the call instead of "
                             "fetching the content again. While the Hello call doesn't necessarily require a token, this "
                             "can be called with a token. If a token is provided, it will be verified and the reply contains "
-                            "information about the tokens validity and the user and permissions for the given token.";
+                            "information about the tokens validity and the user and permissions for the given token.\n "
+                            "The optional parameter encoding selects the encoding of all following messages in both "
+                            "directions. With MessageEncodingCbor, messages are sent as CBOR maps instead of JSON objects. "
+                            "On the WebSocket transport they are sent as binary frames, on the other transports they are "
+                            "followed by a newline like JSON messages. The reply to this call still uses the previous encoding, "
+                            "that is JSON for the initial handshake, and "
+                            "contains the encoding actually used, which falls back to MessageEncodingJson if CBOR is not "
+                            "supported by this server. Clients must not send CBOR data before having received it.\n "
+                            "The optional parameter compression enables compression for all following messages in both "
+                            "directions. With MessageCompressionDeflate, each direction of the connection is a single raw "
+                            "deflate stream (RFC 1951, without zlib header) which is flushed after each message. "
+                            "Decompressing it yields the messages each followed by a newline, on all transports. On the "
+                            "WebSocket transport, every binary frame contains the compressed data of one message. Like the "
+                            "encoding, the compression takes effect after the reply to this call, which contains the "
+                            "compression actually used.\n "
+                            "The optional parameter framing selects how messages are delimited in both directions. With "
+                            "MessageFramingDelimited, JSON messages end with the closing bracket of the top level object "
+                            "and are followed by a newline, CBOR messages are self-delimiting. With "
+                            "MessageFramingLengthPrefixed, each message is preceded by its size in bytes as 32 bit unsigned "
+                            "big endian integer and no newline is added. When compression is used, the framing applies to "
+                            "the decompressed stream. The framing takes effect after the reply to this call, which contains "
+                            "the framing used.";
     params.insert("o:locale", enumValueName(String));
+    params.insert("o:encoding", enumRef<MessageEncoding>());
+    params.insert("o:compression", enumRef<MessageCompression>());
+    params.insert("o:framing", enumRef<MessageFraming>());
     returns.insert("server", enumValueName(String));
     returns.insert("name", enumValueName(String));
     returns.insert("version", enumValueName(String));
@@ -138,6 +178,9 @@ JsonRPCServerImplementation::JsonRPCServerImplementation(const QSslConfiguration
     returns.insert("o:authenticated", enumValueName(Bool));
     returns.insert("o:permissionScopes", flagRef<Types::PermissionScopes>());
     returns.insert("o:username", enumValueName(String));
+    returns.insert("o:encoding", enumRef<MessageEncoding>());
+    returns.insert("o:compression", enumRef<MessageCompression>());
+    returns.insert("o:framing", enumRef<MessageFraming>());
     registerMethod("Hello", description, params, returns, Types::PermissionScopeNone);
 
     params.clear(); returns.clear();
@@ -163,9 +206,22 @@ JsonRPCServerImplementation::JsonRPCServerImplementation(const QSslConfiguration
                                             "will be enabled, the others will be disabled. The return value of \"success\" will "
                                             "indicate success of the operation. The \"enabled\" property in the return value is "
                                             "deprecated and used for legacy compatibilty only. It will be set to true if at least "
-                                            "one namespace has been enabled.";
+                                            "one namespace has been enabled. "
+                                            "Optionally, \"filters\" can be given to receive only a subset of the notifications "
+                                            "of the enabled namespaces. If filters are given, a notification is only sent if at least "
+                                            "one of the filters matches it. A filter matches if all of its given criteria match: The "
+                                            "notification name is in \"notifications\", the thing the notification refers to is in "
+                                            "\"thingIds\" or implements one of the \"interfaces\" and its \"stateTypeId\" is "
+                                            "in \"stateTypeIds\". Notifications not referring to a thing or state type do not "
+                                            "match filters using the according criteria. Filters replace the previously set ones. "
+                                            "If \"throttle\" is given and not 0, state change notifications are held back for the given "
+                                            "amount of milliseconds and only the latest value of each state is sent afterwards. Throttled "
+                                            "notifications are also held back while the connection has not sent out previous data yet. Any "
+                                            "other notification sends out the held back ones first, so the order of notifications is kept.";
     params.insert("o:namespaces", enumValueName(StringList));
     params.insert("d:o:enabled", enumValueName(Bool));
+    params.insert("o:filters", QVariantList() << objectRef("NotificationFilter"));
+    params.insert("o:throttle", enumValueName(Uint));
     returns.insert("namespaces", enumValueName(StringList));
     returns.insert("d:enabled", enumValueName(Bool));
     registerMethod("SetNotificationStatus", description, params, returns, Types::PermissionScopeNone);
@@ -267,6 +323,12 @@ JsonRPCServerImplementation::JsonRPCServerImplementation(const QSslConfiguration
     m_connectionLockdownTimer.setInterval(3000);
 }
 
+JsonRPCServerImplementation::~JsonRPCServerImplementation()
+{
+    qDeleteAll(m_clientCompressors);
+    qDeleteAll(m_pendingClientCompressors);
+}
+
 /*! Returns the \e namespace of \l{JsonHandler}. */
 QString JsonRPCServerImplementation::name() const
 {
@@ -285,6 +347,42 @@ JsonReply *JsonRPCServerImplementation::Hello(const QVariantMap &params, const J
 
     qCDebug(dcJsonRpc()) << "Client" << clientId << "initiated handshake." << m_clientLocales.value(clientId);
 
+    MessageEncoding encoding = m_clientEncodings.value(clientId, MessageEncodingJson);
+    if (params.contains("encoding")) {
+        encoding = enumNameToValue<MessageEncoding>(params.value("encoding").toString());
+#if QT_VERSION < QT_VERSION_CHECK(5,12,0)
+        if (encoding == MessageEncodingCbor) {
+            qCInfo(dcJsonRpc()) << "CBOR encoding requires Qt 5.12. Continuing with JSON for client" << clientId;
+            encoding = MessageEncodingJson;
+        }
+#endif
+        m_pendingClientEncodings.insert(clientId, encoding);
+    }
+
+    MessageFraming framing = m_clientFramings.value(clientId, MessageFramingDelimited);
+    if (params.contains("framing")) {
+        framing = enumNameToValue<MessageFraming>(params.value("framing").toString());
+        m_pendingClientFramings.insert(clientId, framing);
+    }
+
+    MessageCompression compression = m_clientCompressors.contains(clientId) ? MessageCompressionDeflate : MessageCompressionNone;
+    if (params.contains("compression")) {
+        MessageCompression requestedCompression = enumNameToValue<MessageCompression>(params.value("compression").toString());
+        if (requestedCompression == MessageCompressionDeflate && compression == MessageCompressionNone) {
+            MessageCompressor *compressor = new MessageCompressor();
+            if (compressor->isValid()) {
+                m_pendingClientCompressors.insert(clientId, compressor);
+                compression = MessageCompressionDeflate;
+            } else {
+                qCWarning(dcJsonRpc()) << "Failed to set up compression for client" << clientId;
+                delete compressor;
+            }
+        } else if (requestedCompression == MessageCompressionNone && compression == MessageCompressionDeflate) {
+            m_pendingClientCompressors.insert(clientId, nullptr);
+            compression = MessageCompressionNone;
+        }
+    }
+
     // If we waited for the handshake, here it is. Remove the timer...
     if (m_newConnectionWaitTimers.contains(clientId)) {
         delete m_newConnectionWaitTimers.take(clientId);
@@ -350,6 +448,10 @@ JsonReply *JsonRPCServerImplementation::Hello(const QVariantMap &params, const J
         m_connectionLockdownTimer.start();
     }
 
+    handshake.insert("encoding", enumValueName(encoding));
+    handshake.insert("compression", enumValueName(compression));
+    handshake.insert("framing", enumValueName(framing));
+
     return createReply(handshake);;
 }
 
@@ -388,8 +490,26 @@ JsonReply* JsonRPCServerImplementation::SetNotificationStatus(const QVariantMap
             }
         }
     }
-    qCDebug(dcJsonRpc()) << "Notification settings for client" << clientId << ":" << enabledNamespaces;
+    QList<NotificationFilter> filters;
+    foreach (const QVariant &filterVariant, params.value("filters").toList()) {
+        QVariantMap filterMap = filterVariant.toMap();
+        NotificationFilter filter;
+        filter.notifications = filterMap.value("notifications").toStringList();
+        foreach (const QVariant &thingId, filterMap.value("thingIds").toList()) {
+            filter.thingIds.insert(thingId.toUuid());
+        }
+        foreach (const QVariant &stateTypeId, filterMap.value("stateTypeIds").toList()) {
+            filter.stateTypeIds.insert(stateTypeId.toUuid());
+        }
+        filter.interfaces = filterMap.value("interfaces").toStringList();
+        filters.append(filter);
+    }
+
+    qCDebug(dcJsonRpc()) << "Notification settings for client" << clientId << ":" << enabledNamespaces << filters.count() << "filters";
     m_clientNotifications[clientId] = enabledNamespaces;
+    m_clientNotificationFilters[clientId] = filters;
+    updateNotificationSubscribers(clientId);
+    setNotificationThrottle(clientId, params.value("throttle").toUInt());
 
     QVariantMap returns;
     returns.insert("namespaces", m_clientNotifications[clientId]);
@@ -568,9 +688,67 @@ void JsonRPCServerImplementation::sendResponse(TransportInterface *interface, co
         response.insert("deprecationWarning", deprecationWarning);
     }
 
-    QByteArray data = QJsonDocument::fromVariant(response).toJson(QJsonDocument::Compact);
+    QByteArray data = encodeMessage(response, m_clientEncodings.value(clientId, MessageEncodingJson));
     qCDebug(dcJsonRpcTraffic()) << "Sending data:" << data;
-    interface->sendData(clientId, data);
+    sendMessage(interface, clientId, data);
+}
+
+/*! Send the response with the given \a params for a call to \a method to a client using compression. The params
+    are compressed only once for each locale and encoding, as long as the handler reports the same cache hash for
+    the \a method. The small envelope around them is compressed with the stream of the client.
+*/
+void JsonRPCServerImplementation::sendPrecompressedResponse(TransportInterface *interface, const QUuid &clientId, int commandId, const QString &method, const QVariantMap &params)
+{
+    MessageEncoding encoding = m_clientEncodings.value(clientId, MessageEncodingJson);
+    MethodInfo methodInfo = m_methods.value(method);
+    // Our own API only changes when registering handlers, which drops the cache. Others need to provide a hash.
+    QString hash = methodInfo.handler->cacheHashes().value(methodInfo.methodName);
+    if (hash.isEmpty() && methodInfo.handler != this) {
+        sendResponse(interface, clientId, commandId, params);
+        return;
+    }
+
+    QString cacheKey = method + '|' + m_clientLocales.value(clientId).name() + '|' + enumValueName(encoding);
+    QHash<QString, PrecompressedReply>::iterator cached = m_precompressedReplies.find(cacheKey);
+    if (cached == m_precompressedReplies.end() || cached->hash != hash) {
+        qCDebug(dcJsonRpc()) << "Compressing reply for" << cacheKey;
+        QByteArray encodedParams = encodeMessage(params, encoding);
+        PrecompressedReply reply;
+        reply.hash = hash;
+        reply.segment = MessageCompressor::compressSegment(encodedParams);
+        cached = m_precompressedReplies.insert(cacheKey, reply);
+    }
+
+    // Encode the response with a placeholder for the params and split it there
+    static const QString placeholder = QStringLiteral("nymea:precompressed:params");
+    QVariantMap response;
+    response.insert("id", commandId);
+    response.insert("status", "success");
+    response.insert("params", placeholder);
+    QByteArray data = encodeMessage(response, encoding);
+    QByteArray encodedPlaceholder = '"' + placeholder.toUtf8() + '"';
+#if QT_VERSION >= QT_VERSION_CHECK(5,12,0)
+    if (encoding == MessageEncodingCbor) {
+        encodedPlaceholder = QCborValue(placeholder).toCbor();
+    }
+#endif
+    int index = data.indexOf(encodedPlaceholder);
+    if (index < 0) {
+        qCWarning(dcJsonRpc()) << "Params placeholder not found in encoded response. Compressing the whole reply.";
+        sendResponse(interface, clientId, commandId, params);
+        return;
+    }
+
+    QByteArray prefix = data.left(index);
+    QByteArray suffix = data.mid(index + encodedPlaceholder.size());
+    if (m_clientFramings.value(clientId, MessageFramingDelimited) == MessageFramingLengthPrefixed) {
+        prefix.prepend(MessageFramer::lengthPrefix(prefix.size() + cached->segment.dataSize + suffix.size()));
+    } else {
+        suffix.append('\n');
+    }
+
+    qCDebug(dcJsonRpcTraffic()) << "Sending precompressed reply for" << method << "to client" << clientId;
+    interface->sendRawData(clientId, m_clientCompressors.value(clientId)->compress(prefix, cached->segment, suffix));
 }
 
 /*! Send a JSON error response to the client with the given \a clientId,
@@ -583,9 +761,9 @@ void JsonRPCServerImplementation::sendErrorResponse(TransportInterface *interfac
     errorResponse.insert("status", "error");
     errorResponse.insert("error", error);
 
-    QByteArray data = QJsonDocument::fromVariant(errorResponse).toJson(QJsonDocument::Compact);
+    QByteArray data = encodeMessage(errorResponse, m_clientEncodings.value(clientId, MessageEncodingJson));
     qCDebug(dcJsonRpcTraffic()) << "Sending data:" << data;
-    interface->sendData(clientId, data);
+    sendMessage(interface, clientId, data);
 }
 
 void JsonRPCServerImplementation::sendUnauthorizedResponse(TransportInterface *interface, const QUuid &clientId, int commandId, const QString &error)
@@ -595,9 +773,9 @@ void JsonRPCServerImplementation::sendUnauthorizedResponse(TransportInterface *i
     errorResponse.insert("status", "unauthorized");
     errorResponse.insert("error", error);
 
-    QByteArray data = QJsonDocument::fromVariant(errorResponse).toJson(QJsonDocument::Compact);
+    QByteArray data = encodeMessage(errorResponse, m_clientEncodings.value(clientId, MessageEncodingJson));
     qCDebug(dcJsonRpcTraffic()) << "Sending data:" << data;
-    interface->sendData(clientId, data);
+    sendMessage(interface, clientId, data);
 }
 
 void JsonRPCServerImplementation::setup()
@@ -605,7 +783,9 @@ void JsonRPCServerImplementation::setup()
     registerHandler(this);
     registerHandler(new IntegrationsHandler(NymeaCore::instance()->thingManager(), this));
     registerHandler(new RulesHandler(this));
-    registerHandler(new LoggingHandler(this));
+    LoggingHandler *loggingHandler = new LoggingHandler(this);
+    connect(this, &JsonRPCServerImplementation::clientRemoved, loggingHandler, &LoggingHandler::stopLogStreams);
+    registerHandler(loggingHandler);
     registerHandler(new ConfigurationHandler(this));
     registerHandler(new NetworkManagerHandler(NymeaCore::instance()->networkManager(), this));
     registerHandler(new TagsHandler(this));
@@ -625,25 +805,44 @@ void JsonRPCServerImplementation::processData(const QUuid &clientId, const QByte
 
     TransportInterface *interface = qobject_cast<TransportInterface *>(sender());
 
-    // Handle packet fragmentation
-    QByteArray buffer = m_clientBuffers[clientId];
-    buffer.append(data);
-    int splitIndex = buffer.indexOf("}\n{");
-    while (splitIndex > -1) {
-        processJsonPacket(interface, clientId, buffer.left(splitIndex + 1));
-        buffer = buffer.right(buffer.length() - splitIndex - 2);
-        splitIndex = buffer.indexOf("}\n{");
+    // Handle packet fragmentation. The framer is taken out while processing, as a call may disconnect the client.
+    MessageFramer framer = m_clientFramers.take(clientId);
+    MessageCompressor *compressor = m_clientCompressors.value(clientId);
+    if (compressor) {
+        if (!compressor->decompress(data, framer.buffer(), framer.maxMessageSize())) {
+            qCWarning(dcJsonRpc()) << "Invalid compressed data from client" << clientId << ". Dropping client connection.";
+            interface->terminateClientConnection(clientId);
+            return;
+        }
+    } else {
+        framer.buffer()->append(data);
     }
-    if (buffer.trimmed().endsWith("}")) {
-        processJsonPacket(interface, clientId, buffer);
-        buffer.clear();
+
+    framer.setFraming(clientFraming(clientId));
+    QByteArray message;
+    MessageFramer::Result result;
+    while ((result = framer.nextMessage(&message)) == MessageFramer::ResultMessage) {
+        if (m_clientEncodings.value(clientId, MessageEncodingJson) == MessageEncodingCbor) {
+            processCborPacket(interface, clientId, message);
+        } else {
+            processJsonPacket(interface, clientId, message);
+        }
+        if (!m_clientTransports.contains(clientId)) {
+            return;
+        }
+        // Hello may have changed the framing for the following messages
+        framer.setFraming(clientFraming(clientId));
     }
-    m_clientBuffers[clientId] = buffer;
 
-    if (buffer.size() > 1024 * 1024) {
-        qCWarning(dcJsonRpc()) << "Client buffer larger than 1MB and no valid data. Dropping client connection.";
+    if (result == MessageFramer::ResultError) {
+        qCWarning(dcJsonRpc()) << "Invalid data from client" << clientId << ":" << framer.errorString() << ". Dropping client connection.";
+        sendErrorResponse(interface, clientId, -1, framer.errorString());
         interface->terminateClientConnection(clientId);
+        return;
     }
+
+    framer.compact();
+    m_clientFramers.insert(clientId, framer);
 }
 
 void JsonRPCServerImplementation::processJsonPacket(TransportInterface *interface, const QUuid &clientId, const QByteArray &data)
@@ -657,8 +856,41 @@ void JsonRPCServerImplementation::processJsonPacket(TransportInterface *interfac
         return;
     }
 
-    QVariantMap message = jsonDoc.toVariant().toMap();
+    processMessage(interface, clientId, jsonDoc.toVariant().toMap());
+}
+
+void JsonRPCServerImplementation::processCborPacket(TransportInterface *interface, const QUuid &clientId, const QByteArray &data)
+{
+#if QT_VERSION >= QT_VERSION_CHECK(5,12,0)
+    QCborParserError error;
+    QCborValue value = QCborValue::fromCbor(data, &error);
+    if (error.error != QCborError::NoError || !value.isMap()) {
+        QString errorString = error.error != QCborError::NoError ? error.errorString() : "Message is not a map";
+        qCWarning(dcJsonRpc()) << "Failed to parse CBOR data from client" << clientId << ":" << errorString;
+        sendErrorResponse(interface, clientId, -1, QString("Failed to parse CBOR data: %1").arg(errorString));
+        return;
+    }
+    processMessage(interface, clientId, value.toMap().toVariantMap());
+#else
+    Q_UNUSED(interface)
+    Q_UNUSED(clientId)
+    Q_UNUSED(data)
+#endif
+}
+
+MessageFramer::Framing JsonRPCServerImplementation::clientFraming(const QUuid &clientId) const
+{
+    if (m_clientFramings.value(clientId, MessageFramingDelimited) == MessageFramingLengthPrefixed) {
+        return MessageFramer::FramingLengthPrefixed;
+    }
+    if (m_clientEncodings.value(clientId, MessageEncodingJson) == MessageEncodingCbor) {
+        return MessageFramer::FramingCbor;
+    }
+    return MessageFramer::FramingJson;
+}
 
+void JsonRPCServerImplementation::processMessage(TransportInterface *interface, const QUuid &clientId, const QVariantMap &message)
+{
     bool success;
     int commandId = message.value("id").toInt(&success);
     if (!success) {
@@ -668,20 +900,18 @@ void JsonRPCServerImplementation::processJsonPacket(TransportInterface *interfac
     }
 
     QString methodString = message.value("method").toString();
-    QStringList commandList = methodString.split('.');
-    if (commandList.count() != 2) {
+    QHash<QString, MethodInfo>::const_iterator methodInfo = m_methods.constFind(methodString);
+    if (methodInfo == m_methods.constEnd() && methodString.count('.') != 1) {
         qCWarning(dcJsonRpc) << "Error parsing method.\nGot:" << message.value("method").toString() << "\nExpected: \"Namespace.method\"";
         sendErrorResponse(interface, clientId, commandId, QString("Error parsing method. Got: '%1'', Expected: 'Namespace.method'").arg(message.value("method").toString()));
         return;
     }
-    QString targetNamespace = commandList.first();
-    QString method = commandList.last();
 
     // check if authentication is required for this transport
     if (m_interfaces.value(interface)) {
         QByteArray token = message.value("token").toByteArray();
-        QStringList authExemptMethodsNoUser = {"JSONRPC.Introspect", "JSONRPC.Hello", "JSONRPC.RequestPushButtonAuth", "JSONRPC.CreateUser"};
-        QStringList authExemptMethodsWithUser = {"JSONRPC.Introspect", "JSONRPC.Hello", "JSONRPC.Authenticate", "JSONRPC.RequestPushButtonAuth"};
+        static const QStringList authExemptMethodsNoUser = {"JSONRPC.Introspect", "JSONRPC.Hello", "JSONRPC.RequestPushButtonAuth", "JSONRPC.CreateUser"};
+        static const QStringList authExemptMethodsWithUser = {"JSONRPC.Introspect", "JSONRPC.Hello", "JSONRPC.Authenticate", "JSONRPC.RequestPushButtonAuth"};
         // if there is no user in the system yet, let's fail unless this is a special method for authentication itself
         if (NymeaCore::instance()->userManager()->initRequired()) {
             if (!authExemptMethodsNoUser.contains(methodString) && (token.isEmpty() || !NymeaCore::instance()->userManager()->verifyToken(token))) {
@@ -695,7 +925,8 @@ void JsonRPCServerImplementation::processJsonPacket(TransportInterface *interfac
         } else {
             // ok, we have a user. if there isn't a valid token, let's fail unless this is a Authenticate, Introspect  Hello call
             if (!authExemptMethodsWithUser.contains(methodString)) {
-                if (token.isEmpty() || !NymeaCore::instance()->userManager()->verifyToken(token)) {
+                Types::PermissionScopes scopes;
+                if (token.isEmpty() || !NymeaCore::instance()->userManager()->verifyToken(token, &scopes)) {
                     sendUnauthorizedResponse(interface, clientId, commandId, "Forbidden: Invalid token.");
                     qCWarning(dcJsonRpc()) << "Client did not not present a valid token. Dropping connection.";
                     interface->terminateClientConnection(clientId);
@@ -704,11 +935,9 @@ void JsonRPCServerImplementation::processJsonPacket(TransportInterface *interfac
                     return;
                 }
                 // Check if the user has the required permissions
-                TokenInfo tokenInfo = NymeaCore::instance()->userManager()->tokenInfo(token);
-                UserInfo userInfo = NymeaCore::instance()->userManager()->userInfo(tokenInfo.username());
-                Types::PermissionScope methodScope = Types::scopeFromString(m_api.value("methods").toMap().value(methodString).toMap().value("permissionScope").toString());
-                if (methodScope != Types::PermissionScopeNone && !userInfo.scopes().testFlag(Types::PermissionScopeAdmin) && !userInfo.scopes().testFlag(methodScope)) {
-                    qCWarning(dcJsonRpc()) << "Method" << methodString << "requires" << Types::scopeToString(methodScope) << "but client token has:" << Types::scopesToStringList(userInfo.scopes());
+                Types::PermissionScope methodScope = methodInfo != m_methods.constEnd() ? methodInfo->permissionScope : Types::PermissionScopeNone;
+                if (methodScope != Types::PermissionScopeNone && !scopes.testFlag(Types::PermissionScopeAdmin) && !scopes.testFlag(methodScope)) {
+                    qCWarning(dcJsonRpc()) << "Method" << methodString << "requires" << Types::scopeToString(methodScope) << "but client token has:" << Types::scopesToStringList(scopes);
                     sendErrorResponse(interface, clientId, commandId, "Permission denied.");
                     return;
                 }
@@ -717,32 +946,31 @@ void JsonRPCServerImplementation::processJsonPacket(TransportInterface *interfac
     }
     // At this point we can assume all the calls are authorized
 
-    JsonHandler *handler = m_handlers.value(targetNamespace);
-    if (!handler) {
-        qCWarning(dcJsonRpc()) << "JSON RPC method called for invalid namespace:" << targetNamespace;
-        sendErrorResponse(interface, clientId, commandId, "No such namespace");
-        return;
-    }
-    if (!handler->jsonMethods().contains(method)) {
-        qCWarning(dcJsonRpc()) << QString("JSON RPC method called for invalid method: %1.%2").arg(targetNamespace).arg(method);
+    if (methodInfo == m_methods.constEnd()) {
+        QString targetNamespace = methodString.section('.', 0, 0);
+        if (!m_handlers.contains(targetNamespace)) {
+            qCWarning(dcJsonRpc()) << "JSON RPC method called for invalid namespace:" << targetNamespace;
+            sendErrorResponse(interface, clientId, commandId, "No such namespace");
+            return;
+        }
+        qCWarning(dcJsonRpc()) << QString("JSON RPC method called for invalid method: %1").arg(methodString);
         sendErrorResponse(interface, clientId, commandId, "No such method");
         return;
     }
+    JsonHandler *handler = methodInfo->handler;
 
     QVariantMap params = message.value("params").toMap();
 
-    QVariantMap definition = handler->jsonMethods().value(method).toMap().value("params").toMap();
-    JsonValidator validator;
-    JsonValidator::Result validationResult = validator.validateParams(params, targetNamespace + '.' + method, m_api);
+    JsonValidator::Result validationResult = m_validator.validateParams(params, methodInfo->params, methodString);
     if (!validationResult.success()) {
-        qCWarning(dcJsonRpc()) << "JSON RPC parameter verification failed for method" << targetNamespace + '.' + method;
+        qCWarning(dcJsonRpc()) << "JSON RPC parameter verification failed for method" << methodString;
         qCWarning(dcJsonRpc()) << validationResult.errorString() << "in" << validationResult.where();
         qCWarning(dcJsonRpc()) << "Call params:" << qUtf8Printable(QJsonDocument::fromVariant(params).toJson());
         sendErrorResponse(interface, clientId, commandId, "Invalid params: " + validationResult.errorString() + " in " + validationResult.where());
         return;
     }
 
-    if (!(targetNamespace == "JSONRPC" && method == "Hello")) {
+    if (!(handler == this && methodInfo->methodName == "Hello")) {
         // This is not the handshake message. If we've waited for it, consider this a protocol violation and drop connection
         if (m_newConnectionWaitTimers.contains(clientId)) {
             sendErrorResponse(interface, clientId, commandId, "Handshake required. Call JSONRPC.Hello first.");
@@ -760,13 +988,13 @@ void JsonRPCServerImplementation::processJsonPacket(TransportInterface *interfac
     JsonContext callContext(clientId, m_clientLocales.value(clientId));
     callContext.setToken(message.value("token").toByteArray());
 
-    qCDebug(dcJsonRpc()) << "Invoking method" << targetNamespace + '.' +  method << "from client" << clientId;
+    qCDebug(dcJsonRpc()) << "Invoking method" << methodString << "from client" << clientId;
 
-    JsonReply *reply;
-    if (handler->metaObject()->indexOfMethod(method.toUtf8() + "(QVariantMap,JsonContext)") >= 0) {
-        QMetaObject::invokeMethod(handler, method.toUtf8().data(), Q_RETURN_ARG(JsonReply*, reply), Q_ARG(QVariantMap, params), Q_ARG(JsonContext, callContext));
+    JsonReply *reply = nullptr;
+    if (methodInfo->withContext) {
+        methodInfo->metaMethod.invoke(handler, Qt::DirectConnection, Q_RETURN_ARG(JsonReply*, reply), Q_ARG(QVariantMap, params), Q_ARG(JsonContext, callContext));
     } else {
-        QMetaObject::invokeMethod(handler, method.toUtf8().data(), Q_RETURN_ARG(JsonReply*, reply), Q_ARG(QVariantMap, params));
+        methodInfo->metaMethod.invoke(handler, Qt::DirectConnection, Q_RETURN_ARG(JsonReply*, reply), Q_ARG(QVariantMap, params));
     }
 
     if (reply->type() == JsonReply::TypeAsync) {
@@ -776,63 +1004,161 @@ void JsonRPCServerImplementation::processJsonPacket(TransportInterface *interfac
         connect(reply, &JsonReply::finished, this, &JsonRPCServerImplementation::asyncReplyFinished);
         reply->startWait();
     } else {
-        JsonValidator validator;
-        Q_ASSERT_X((targetNamespace == "JSONRPC" && method == "Introspect") || validator.validateReturns(reply->data(), targetNamespace + '.' + method, m_api).success(),
-                   validator.result().where().toUtf8(),
-                   validator.result().errorString().toUtf8() + "\nReturn value:\n" + QJsonDocument::fromVariant(reply->data()).toJson());
-
-        QString deprecationWarning;
-        if (m_api.value("methods").toMap().value(targetNamespace + '.' + method).toMap().contains("deprecated")) {
-            deprecationWarning = m_api.value("methods").toMap().value(targetNamespace + '.' + method).toMap().value("deprecated").toString();
+        Q_ASSERT_X((handler == this && methodInfo->methodName == "Introspect") || m_validator.validateReturns(reply->data(), methodString).success(),
+                   m_validator.result().where().toUtf8(),
+                   m_validator.result().errorString().toUtf8() + "\nReturn value:\n" + QJsonDocument::fromVariant(reply->data()).toJson());
+
+        QString deprecationWarning = methodInfo->deprecationInfo;
+        if (!deprecationWarning.isEmpty()) {
             qCWarning(dcJsonRpc()) << "Client uses deprecated API. Please update client implementation!";
-            qCWarning(dcJsonRpc()) << targetNamespace + '.' + method + ':' << deprecationWarning;
+            qCWarning(dcJsonRpc()) << methodString + ':' << deprecationWarning;
         }
 
-        sendResponse(interface, clientId, commandId, reply->data(), deprecationWarning);
+        // Large static replies are compressed once and reused for all compressed connections
+        static const QStringList precompressedMethods = {"JSONRPC.Introspect", "Integrations.GetThingClasses"};
+        if (m_clientCompressors.contains(clientId) && params.isEmpty() && deprecationWarning.isEmpty() && precompressedMethods.contains(methodString)) {
+            sendPrecompressedResponse(interface, clientId, commandId, methodString, reply->data());
+        } else {
+            sendResponse(interface, clientId, commandId, reply->data(), deprecationWarning);
+        }
         reply->deleteLater();
     }
+
+    // A new encoding, compression or framing requested in Hello applies once the reply has been sent
+    if (m_pendingClientEncodings.contains(clientId)) {
+        MessageEncoding encoding = m_pendingClientEncodings.take(clientId);
+        qCDebug(dcJsonRpc()) << "Client" << clientId << "switched to" << encoding;
+        if (encoding == MessageEncodingJson) {
+            m_clientEncodings.remove(clientId);
+        } else {
+            m_clientEncodings.insert(clientId, encoding);
+        }
+    }
+    if (m_pendingClientFramings.contains(clientId)) {
+        MessageFraming framing = m_pendingClientFramings.take(clientId);
+        qCDebug(dcJsonRpc()) << "Client" << clientId << "switched to" << framing;
+        if (framing == MessageFramingDelimited) {
+            m_clientFramings.remove(clientId);
+        } else {
+            m_clientFramings.insert(clientId, framing);
+        }
+    }
+    if (m_pendingClientCompressors.contains(clientId)) {
+        MessageCompressor *compressor = m_pendingClientCompressors.take(clientId);
+        qCDebug(dcJsonRpc()) << "Client" << clientId << (compressor ? "enabled" : "disabled") << "compression";
+        delete m_clientCompressors.take(clientId);
+        if (compressor) {
+            m_clientCompressors.insert(clientId, compressor);
+        }
+    }
+}
+
+QByteArray JsonRPCServerImplementation::encodeMessage(const QVariantMap &message, MessageEncoding encoding)
+{
+#if QT_VERSION >= QT_VERSION_CHECK(5,12,0)
+    if (encoding == MessageEncodingCbor) {
+        return QCborValue::fromVariant(message).toCbor();
+    }
+#else
+    Q_UNUSED(encoding)
+#endif
+    return QJsonDocument::fromVariant(message).toJson(QJsonDocument::Compact);
+}
+
+void JsonRPCServerImplementation::sendMessage(TransportInterface *interface, const QUuid &clientId, const QByteArray &data)
+{
+    MessageCompressor *compressor = m_clientCompressors.value(clientId);
+    if (m_clientFramings.value(clientId, MessageFramingDelimited) == MessageFramingLengthPrefixed) {
+        QByteArray frame = MessageFramer::lengthPrefix(data.size());
+        frame.append(data);
+        interface->sendRawData(clientId, compressor ? compressor->compress(frame) : frame);
+        return;
+    }
+    if (compressor) {
+        // The separator is part of the compressed stream, regardless of the transport
+        interface->sendRawData(clientId, compressor->compress(data + '\n'));
+        return;
+    }
+    if (m_clientEncodings.value(clientId, MessageEncodingJson) == MessageEncodingCbor) {
+        interface->sendBinaryData(clientId, data);
+    } else {
+        interface->sendData(clientId, data);
+    }
 }
 
 void JsonRPCServerImplementation::sendNotification(const QVariantMap &params)
 {
     JsonHandler *handler = qobject_cast<JsonHandler *>(sender());
     QMetaMethod method = handler->metaObject()->method(senderSignalIndex());
-
-    QVariantMap notification;
-    notification.insert("id", m_notificationId++);
-    notification.insert("notification", handler->name() + "." + method.name());
-
-    foreach (const QUuid &clientId, m_clientNotifications.keys()) {
-
-        // Check if this client wants to be notified
-        if (!m_clientNotifications.value(clientId).contains(handler->name())) {
-            continue;
+    QString notificationName = handler->name() + '.' + method.name();
+
+    // Group the interested clients by locale so the notification only needs to be translated and serialized once per locale
+    QHash<QLocale, QList<QUuid>> clientsByLocale;
+    const QHash<QUuid, QList<NotificationFilter>> subscribers = m_notificationSubscribers.value(notificationName);
+    for (QHash<QUuid, QList<NotificationFilter>>::const_iterator it = subscribers.constBegin(); it != subscribers.constEnd(); ++it) {
+        bool matches = it.value().isEmpty();
+        for (int i = 0; i < it.value().count() && !matches; i++) {
+            matches = it.value().at(i).matches(params);
         }
-
-        // Add deprecation warning if necessary
-        if (m_api.value("notifications").toMap().value(handler->name() + '.' + method.name()).toMap().contains("deprecated")) {
-            QString deprecationMessage = m_api.value("notifications").toMap().value(handler->name() + '.' + method.name()).toMap().value("deprecated").toString();
-            qCWarning(dcJsonRpc()) << "Client" << clientId << "uses deprecated API. Please update client implementation!";
-            qCWarning(dcJsonRpc()) << handler->name() + '.' + method.name() + ':' << deprecationMessage;
-            notification.insert("deprecationWarning", deprecationMessage);
+        if (matches) {
+            clientsByLocale[m_clientLocales.value(it.key())].append(it.key());
         }
+    }
+    if (clientsByLocale.isEmpty()) {
+        return;
+    }
+
+    int notificationId = m_notificationId++;
+    QVariantMap notification;
+    notification.insert("id", notificationId);
+    notification.insert("notification", notificationName);
+
+    // State changes can be coalesced for clients throttling notifications
+    bool coalescable = !m_notificationThrottles.isEmpty() && params.contains("thingId") && params.contains("stateTypeId");
+    QPair<QUuid, QUuid> stateKey(params.value("thingId").toUuid(), params.value("stateTypeId").toUuid());
+
+    // Add deprecation warning if necessary
+    if (m_notificationDeprecations.contains(notificationName)) {
+        QString deprecationMessage = m_notificationDeprecations.value(notificationName);
+        qCWarning(dcJsonRpc()) << "Clients use deprecated API. Please update client implementation!";
+        qCWarning(dcJsonRpc()) << notificationName + ':' << deprecationMessage;
+        notification.insert("deprecationWarning", deprecationMessage);
+    }
 
-        QLocale locale = m_clientLocales.value(clientId);
-        QVariantMap translatedParams = handler->translateNotification(method.name(), params, locale);
+    for (QHash<QLocale, QList<QUuid>>::const_iterator it = clientsByLocale.constBegin(); it != clientsByLocale.constEnd(); ++it) {
+        QVariantMap translatedParams = handler->translateNotification(method.name(), params, it.key());
 
-        JsonValidator validator;
-        Q_ASSERT_X(validator.validateNotificationParams(translatedParams, handler->name() + '.' + method.name(), m_api).success(),
-                   validator.result().where().toUtf8(),
-                   validator.result().errorString().toUtf8() + "\nGot:" + QJsonDocument::fromVariant(translatedParams).toJson(QJsonDocument::Indented));
+        Q_ASSERT_X(m_validator.validateNotificationParams(translatedParams, notificationName).success(),
+                   m_validator.result().where().toUtf8(),
+                   m_validator.result().errorString().toUtf8() + "\nGot:" + QJsonDocument::fromVariant(translatedParams).toJson(QJsonDocument::Indented));
 
         notification.insert("params", translatedParams);
 
-        QByteArray data = QJsonDocument::fromVariant(notification).toJson(QJsonDocument::Compact);
-
-        qCDebug(dcJsonRpc()) << "Sending notification" << handler->name() + "." + method.name() << "to client" << clientId;
-        qCDebug(dcJsonRpcTraffic()) << "Notification content:" << data;
+        // Implicitly shared between all the clients using this locale and encoding
+        QHash<int, QByteArray> encodedData;
 
-        m_clientTransports.value(clientId)->sendData(clientId, data);
+        foreach (const QUuid &clientId, it.value()) {
+            MessageEncoding encoding = m_clientEncodings.value(clientId, MessageEncodingJson);
+            if (!encodedData.contains(encoding)) {
+                encodedData.insert(encoding, encodeMessage(notification, encoding));
+                qCDebug(dcJsonRpcTraffic()) << "Notification content:" << encodedData.value(encoding);
+            }
+            const QByteArray data = encodedData.value(encoding);
+            if (coalescable && m_notificationThrottles.contains(clientId)) {
+                NotificationThrottle &throttle = m_notificationThrottles[clientId];
+                throttle.pending.remove(throttle.pendingIds.value(stateKey, -1));
+                throttle.pendingIds.insert(stateKey, notificationId);
+                throttle.pending.insert(notificationId, data);
+                if (!throttle.timer->isActive()) {
+                    throttle.timer->start();
+                }
+                continue;
+            }
+            // Don't overtake state changes still held back for this client
+            flushThrottledNotifications(clientId, true);
+            qCDebug(dcJsonRpc()) << "Sending notification" << notificationName << "to client" << clientId;
+            sendMessage(m_clientTransports.value(clientId), clientId, data);
+        }
     }
 }
 
@@ -851,22 +1177,167 @@ void JsonRPCServerImplementation::sendClientNotification(const QUuid &clientId,
     notification.insert("notification", handler->name() + "." + method.name());
     notification.insert("params", params);
 
-    JsonValidator validator;
-    Q_ASSERT_X(validator.validateNotificationParams(params, handler->name() + '.' + method.name(), m_api).success(),
-               validator.result().where().toUtf8(),
-               validator.result().errorString().toUtf8() + "\nGot:" + QJsonDocument::fromVariant(params).toJson(QJsonDocument::Indented));
+    Q_ASSERT_X(m_validator.validateNotificationParams(params, handler->name() + '.' + method.name()).success(),
+               m_validator.result().where().toUtf8(),
+               m_validator.result().errorString().toUtf8() + "\nGot:" + QJsonDocument::fromVariant(params).toJson(QJsonDocument::Indented));
 
-    if (m_api.value("notifications").toMap().value(handler->name() + '.' + method.name()).toMap().contains("deprecated")) {
-        QString deprecationMessage = m_api.value("notifications").toMap().value(handler->name() + '.' + method.name()).toMap().value("deprecated").toString();
+    if (m_notificationDeprecations.contains(handler->name() + '.' + method.name())) {
+        QString deprecationMessage = m_notificationDeprecations.value(handler->name() + '.' + method.name());
         qCWarning(dcJsonRpc()) << "Client uses deprecated API. Please update client implementation!";
         qCWarning(dcJsonRpc()) << handler->name() + '.' + method.name() + ':' << deprecationMessage;
         notification.insert("deprecationWarning", deprecationMessage);
     }
 
-    QByteArray data = QJsonDocument::fromVariant(notification).toJson(QJsonDocument::Compact);
+    QByteArray data = encodeMessage(notification, m_clientEncodings.value(clientId, MessageEncodingJson));
     qCDebug(dcJsonRpcTraffic()) << "Notification content:" << data;
     qCDebug(dcJsonRpc()) << "Sending notification:" << handler->name() + "." + method.name();
-    m_clientTransports.value(clientId)->sendData(clientId, data);
+    flushThrottledNotifications(clientId, true);
+    sendMessage(m_clientTransports.value(clientId), clientId, data);
+}
+
+// Resolves the namespaces and filters of the given client into the per notification subscriber lists
+void JsonRPCServerImplementation::updateNotificationSubscribers(const QUuid &clientId)
+{
+    const QStringList namespaces = m_clientNotifications.value(clientId);
+    const QList<NotificationFilter> filters = m_clientNotificationFilters.value(clientId);
+
+    foreach (const QString &notificationName, m_api.value("notifications").toMap().keys()) {
+        QHash<QUuid, QList<NotificationFilter>> &subscribers = m_notificationSubscribers[notificationName];
+        subscribers.remove(clientId);
+        if (!namespaces.contains(notificationName.left(notificationName.indexOf('.')))) {
+            continue;
+        }
+        if (filters.isEmpty()) {
+            subscribers.insert(clientId, QList<NotificationFilter>());
+            continue;
+        }
+
+        QList<NotificationFilter> notificationFilters;
+        bool unfiltered = false;
+        foreach (const NotificationFilter &filter, filters) {
+            if (!filter.notifications.isEmpty() && !filter.notifications.contains(notificationName)) {
+                continue;
+            }
+            if (filter.thingIds.isEmpty() && filter.stateTypeIds.isEmpty() && filter.interfaces.isEmpty()) {
+                unfiltered = true;
+                break;
+            }
+            notificationFilters.append(filter);
+        }
+        if (unfiltered) {
+            subscribers.insert(clientId, QList<NotificationFilter>());
+        } else if (!notificationFilters.isEmpty()) {
+            subscribers.insert(clientId, notificationFilters);
+        }
+    }
+}
+
+void JsonRPCServerImplementation::setNotificationThrottle(const QUuid &clientId, uint interval)
+{
+    if (interval == 0) {
+        if (!m_notificationThrottles.contains(clientId)) {
+            return;
+        }
+        // Send out whatever is still held back
+        flushThrottledNotifications(clientId, true);
+        delete m_notificationThrottles.take(clientId).timer;
+        return;
+    }
+
+    NotificationThrottle &throttle = m_notificationThrottles[clientId];
+    if (!throttle.timer) {
+        throttle.timer = new QTimer(this);
+        throttle.timer->setSingleShot(true);
+        connect(throttle.timer, &QTimer::timeout, this, [this, clientId](){
+            flushThrottledNotifications(clientId);
+        });
+    }
+    throttle.timer->setInterval(interval);
+}
+
+void JsonRPCServerImplementation::flushThrottledNotifications(const QUuid &clientId, bool force)
+{
+    TransportInterface *transport = m_clientTransports.value(clientId);
+    if (!transport || !m_notificationThrottles.contains(clientId)) {
+        return;
+    }
+    NotificationThrottle &throttle = m_notificationThrottles[clientId];
+    if (throttle.pending.isEmpty()) {
+        return;
+    }
+
+    // Don't pile up data in the transport for slow connections. The pending notifications are bounded
+    // by the number of states, so keep coalescing until the connection has caught up. Transports which
+    // can't tell how much is waiting get at most maxThrottledBytesToWrite per interval.
+    qint64 budget = maxThrottledBytesToWrite;
+    if (!force) {
+        qint64 bytesToWrite = transport->bytesToWrite(clientId);
+        if (bytesToWrite > maxThrottledBytesToWrite) {
+            qCDebug(dcJsonRpc()) << "Client" << clientId << "is not keeping up. Holding back" << throttle.pending.count() << "state notifications.";
+            throttle.timer->start();
+            return;
+        }
+        budget -= qMax<qint64>(bytesToWrite, 0);
+    }
+
+    QList<QByteArray> messages;
+    QMap<int, QByteArray>::iterator it = throttle.pending.begin();
+    while (it != throttle.pending.end() && (force || budget > 0)) {
+        budget -= it.value().size();
+        messages.append(it.value());
+        it = throttle.pending.erase(it);
+    }
+
+    if (throttle.pending.isEmpty()) {
+        throttle.pendingIds.clear();
+    } else {
+        QHash<QPair<QUuid, QUuid>, int>::iterator idIt = throttle.pendingIds.begin();
+        while (idIt != throttle.pendingIds.end()) {
+            if (throttle.pending.contains(idIt.value())) {
+                ++idIt;
+            } else {
+                idIt = throttle.pendingIds.erase(idIt);
+            }
+        }
+        qCDebug(dcJsonRpc()) << "Holding back" << throttle.pending.count() << "state notifications for client" << clientId << "until the next interval.";
+        throttle.timer->start();
+    }
+
+    qCDebug(dcJsonRpc()) << "Sending" << messages.count() << "throttled notifications to client" << clientId;
+    foreach (const QByteArray &data, messages) {
+        sendMessage(transport, clientId, data);
+    }
+}
+
+bool JsonRPCServerImplementation::NotificationFilter::matches(const QVariantMap &params) const
+{
+    QUuid thingId = params.value("thingId").toUuid();
+    if (thingId.isNull()) {
+        thingId = params.value("thing").toMap().value("id").toUuid();
+    }
+    if (thingId.isNull()) {
+        thingId = params.value("event").toMap().value("thingId").toUuid();
+    }
+
+    if (!thingIds.isEmpty() && !thingIds.contains(thingId)) {
+        return false;
+    }
+    if (!stateTypeIds.isEmpty() && !stateTypeIds.contains(params.value("stateTypeId").toUuid())) {
+        return false;
+    }
+    if (!interfaces.isEmpty()) {
+        Thing *thing = NymeaCore::instance()->thingManager()->findConfiguredThing(thingId);
+        if (!thing) {
+            return false;
+        }
+        foreach (const QString &interface, thing->thingClass().interfaces()) {
+            if (interfaces.contains(interface)) {
+                return true;
+            }
+        }
+        return false;
+    }
+    return true;
 }
 
 void JsonRPCServerImplementation::asyncReplyFinished()
@@ -879,15 +1350,13 @@ void JsonRPCServerImplementation::asyncReplyFinished()
         return;
     }
     if (!reply->timedOut()) {
-        JsonValidator validator;
         QString method = reply->handler()->name() + '.' + reply->method();
-        Q_ASSERT_X(validator.validateReturns(reply->data(), method, m_api).success()
-                   ,validator.result().where().toUtf8()
-                   ,validator.result().errorString().toUtf8() + "\nReturn value:\n" + QJsonDocument::fromVariant(reply->data()).toJson());
+        Q_ASSERT_X(m_validator.validateReturns(reply->data(), method).success()
+                   ,m_validator.result().where().toUtf8()
+                   ,m_validator.result().errorString().toUtf8() + "\nReturn value:\n" + QJsonDocument::fromVariant(reply->data()).toJson());
 
-        QString deprecationWarning;
-        if (m_api.value("methods").toMap().value(method).toMap().contains("deprecated")) {
-            deprecationWarning = m_api.value("methods").toMap().value(method).toMap().value("deprecated").toString();
+        QString deprecationWarning = m_methods.value(method).deprecationInfo;
+        if (!deprecationWarning.isEmpty()) {
             qCWarning(dcJsonRpc()) << "Client uses deprecated API. Please update client implementation!";
             qCWarning(dcJsonRpc()) << method + ':' << deprecationWarning;
         }
@@ -1034,8 +1503,41 @@ bool JsonRPCServerImplementation::registerHandler(JsonHandler *handler)
     // Checks completed. Store new API
     qCDebug(dcJsonRpc()) << "Registering JSON RPC handler:" << handler->name();
     m_api = apiIncludingThis;
+    m_validator.setApi(m_api);
+    m_precompressedReplies.clear();
 
     m_handlers.insert(handler->name(), handler);
+
+    // Resolve everything needed to dispatch calls upfront
+    QVariantMap handlerMethods = handler->jsonMethods();
+    for (QVariantMap::const_iterator it = handlerMethods.constBegin(); it != handlerMethods.constEnd(); ++it) {
+        QVariantMap methodDescription = it.value().toMap();
+        MethodInfo methodInfo;
+        methodInfo.handler = handler;
+        methodInfo.methodName = it.key();
+        int index = handler->metaObject()->indexOfMethod(it.key().toUtf8() + "(QVariantMap,JsonContext)");
+        methodInfo.withContext = index >= 0;
+        if (!methodInfo.withContext) {
+            index = handler->metaObject()->indexOfMethod(it.key().toUtf8() + "(QVariantMap)");
+        }
+        methodInfo.metaMethod = handler->metaObject()->method(index);
+        methodInfo.permissionScope = Types::scopeFromString(methodDescription.value("permissionScope").toString());
+        methodInfo.deprecationInfo = methodDescription.value("deprecated").toString();
+        m_methods.insert(handler->name() + '.' + it.key(), methodInfo);
+    }
+    for (QVariantMap::const_iterator it = newNotifications.constBegin(); it != newNotifications.constEnd(); ++it) {
+        if (it.value().toMap().contains("deprecated")) {
+            m_notificationDeprecations.insert(it.key(), it.value().toMap().value("deprecated").toString());
+        }
+    }
+    // Clients which enabled notifications already subscribe to the ones of this handler too
+    foreach (const QUuid &clientId, m_clientNotifications.keys()) {
+        updateNotificationSubscribers(clientId);
+    }
+    // The validator has been recompiled, update the references to it for all methods
+    for (QHash<QString, MethodInfo>::iterator it = m_methods.begin(); it != m_methods.end(); ++it) {
+        it->params = m_validator.methodParams(it.key());
+    }
     for (int i = 0; i < handler->metaObject()->methodCount(); ++i) {
         QMetaMethod method = handler->metaObject()->method(i);
         if (method.methodType() == QMetaMethod::Signal && QString(method.name()).contains(QRegExp("^[A-Z]"))) {
@@ -1081,14 +1583,28 @@ void JsonRPCServerImplementation::clientDisconnected(const QUuid &clientId)
     qCDebug(dcJsonRpc()) << "Client disconnected:" << clientId;
     m_clientTransports.remove(clientId);
     m_clientNotifications.remove(clientId);
-    m_clientBuffers.remove(clientId);
+    m_clientNotificationFilters.remove(clientId);
+    if (m_notificationThrottles.contains(clientId)) {
+        delete m_notificationThrottles.take(clientId).timer;
+    }
+    for (QHash<QString, QHash<QUuid, QList<NotificationFilter>>>::iterator it = m_notificationSubscribers.begin(); it != m_notificationSubscribers.end(); ++it) {
+        it->remove(clientId);
+    }
+    m_clientFramers.remove(clientId);
     m_clientLocales.remove(clientId);
+    m_clientEncodings.remove(clientId);
+    m_pendingClientEncodings.remove(clientId);
+    delete m_clientCompressors.take(clientId);
+    delete m_pendingClientCompressors.take(clientId);
+    m_clientFramings.remove(clientId);
+    m_pendingClientFramings.remove(clientId);
     if (m_pushButtonTransactions.values().contains(clientId)) {
         NymeaCore::instance()->userManager()->cancelPushButtonAuth(m_pushButtonTransactions.key(clientId));
     }
     if (m_newConnectionWaitTimers.contains(clientId)) {
         delete m_newConnectionWaitTimers.take(clientId);
     }
+    emit clientRemoved(clientId);
 }
 
 }
@@ -33,6 +33,9 @@
 
 #include "jsonrpc/jsonrpcserver.h"
 #include "jsonrpc/jsonhandler.h"
+#include "jsonrpc/jsonvalidator.h"
+#include "jsonrpc/messagecompressor.h"
+#include "jsonrpc/messageframer.h"
 #include "transportinterface.h"
 #include "usermanager/usermanager.h"
 
@@ -44,6 +47,8 @@
 #include <QVariantMap>
 #include <QString>
 #include <QSslConfiguration>
+#include <QMetaMethod>
+#include <QSet>
 
 class Thing;
 
@@ -53,7 +58,26 @@ class JsonRPCServerImplementation: public JsonHandler, public JsonRPCServer
 {
     Q_OBJECT
 public:
+    enum MessageEncoding {
+        MessageEncodingJson,
+        MessageEncodingCbor
+    };
+    Q_ENUM(MessageEncoding)
+
+    enum MessageCompression {
+        MessageCompressionNone,
+        MessageCompressionDeflate
+    };
+    Q_ENUM(MessageCompression)
+
+    enum MessageFraming {
+        MessageFramingDelimited,
+        MessageFramingLengthPrefixed
+    };
+    Q_ENUM(MessageFraming)
+
     JsonRPCServerImplementation(const QSslConfiguration &sslConfiguration = QSslConfiguration(), QObject *parent = nullptr);
+    ~JsonRPCServerImplementation() override;
 
     // JsonHandler API implementation
     QString name() const override;
@@ -74,6 +98,8 @@ signals:
     void CloudConnectedChanged(const QVariantMap &map);
     void PushButtonAuthFinished(const QUuid &clientId, const QVariantMap &params);
 
+    void clientRemoved(const QUuid &clientId);
+
     // Server API
 public:
     void registerTransportInterface(TransportInterface *interface, bool authenticationRequired);
@@ -86,10 +112,21 @@ private:
     QHash<QString, JsonHandler *> handlers() const;
 
     void sendResponse(TransportInterface *interface, const QUuid &clientId, int commandId, const QVariantMap &params = QVariantMap(), const QString &deprecationWarning = QString());
+    void sendPrecompressedResponse(TransportInterface *interface, const QUuid &clientId, int commandId, const QString &method, const QVariantMap &params);
     void sendErrorResponse(TransportInterface *interface, const QUuid &clientId, int commandId, const QString &error);
     void sendUnauthorizedResponse(TransportInterface *interface, const QUuid &clientId, int commandId, const QString &error);
 
     void processJsonPacket(TransportInterface *interface, const QUuid &clientId, const QByteArray &data);
+    void processCborPacket(TransportInterface *interface, const QUuid &clientId, const QByteArray &data);
+    MessageFramer::Framing clientFraming(const QUuid &clientId) const;
+    void processMessage(TransportInterface *interface, const QUuid &clientId, const QVariantMap &message);
+
+    static QByteArray encodeMessage(const QVariantMap &message, MessageEncoding encoding);
+    void sendMessage(TransportInterface *interface, const QUuid &clientId, const QByteArray &data);
+
+    void updateNotificationSubscribers(const QUuid &clientId);
+    void setNotificationThrottle(const QUuid &clientId, uint interval);
+    void flushThrottledNotifications(const QUuid &clientId, bool force = false);
 
 private slots:
     void setup();
@@ -109,16 +146,71 @@ private slots:
     void onPushButtonAuthFinished(int transactionId, bool success, const QByteArray &token);
 
 private:
+    // Everything needed to dispatch a call, resolved in registerHandler() for each "Namespace.Method"
+    struct MethodInfo {
+        JsonHandler *handler = nullptr;
+        QString methodName;
+        QMetaMethod metaMethod;
+        bool withContext = false;
+        Types::PermissionScope permissionScope = Types::PermissionScopeNone;
+        QString deprecationInfo;
+        const JsonValidator::Node *params = nullptr;
+    };
+
     QVariantMap m_api;
+    // The API compiled for validation, updated whenever a handler is registered
+    JsonValidator m_validator;
     QHash<JsonHandler*, QString> m_experiences;
     QMap<TransportInterface*, bool> m_interfaces; // Interface, authenticationRequired
     QHash<QString, JsonHandler *> m_handlers;
+    QHash<QString, MethodInfo> m_methods;
+    // Notification name -> deprecation info, for deprecated notifications only
+    QHash<QString, QString> m_notificationDeprecations;
     QHash<JsonReply *, TransportInterface *> m_asyncReplies;
 
     QHash<QUuid, TransportInterface*> m_clientTransports;
-    QHash<QUuid, QByteArray> m_clientBuffers;
+    QHash<QUuid, MessageFramer> m_clientFramers;
     QHash<QUuid, QStringList> m_clientNotifications;
+
+    // A filter set up with JSONRPC.SetNotificationStatus. Criteria left empty match any notification.
+    struct NotificationFilter {
+        QStringList notifications;
+        QSet<QUuid> thingIds;
+        QSet<QUuid> stateTypeIds;
+        QStringList interfaces;
+        bool matches(const QVariantMap &params) const;
+    };
+    QHash<QUuid, QList<NotificationFilter>> m_clientNotificationFilters;
+    // Notification name -> subscribed clients and the filters to check for them. An empty list means unfiltered.
+    QHash<QString, QHash<QUuid, QList<NotificationFilter>>> m_notificationSubscribers;
+
+    // State notifications held back for a client which asked for them to be throttled
+    struct NotificationThrottle {
+        QTimer *timer = nullptr;
+        // (thingId, stateTypeId) -> id of the pending notification for that state
+        QHash<QPair<QUuid, QUuid>, int> pendingIds;
+        // Notification id -> serialized notification, sent in order on flush
+        QMap<int, QByteArray> pending;
+    };
+    QHash<QUuid, NotificationThrottle> m_notificationThrottles;
+
     QHash<QUuid, QLocale> m_clientLocales;
+    // Clients using another encoding than JSON. Changes requested in Hello apply after the Hello reply has been sent.
+    QHash<QUuid, MessageEncoding> m_clientEncodings;
+    QHash<QUuid, MessageEncoding> m_pendingClientEncodings;
+    // Clients using compression. Like encodings, changes apply after the Hello reply. A null compressor disables it.
+    QHash<QUuid, MessageCompressor*> m_clientCompressors;
+    QHash<QUuid, MessageCompressor*> m_pendingClientCompressors;
+    // Clients using length prefixed framing, applied like encodings
+    QHash<QUuid, MessageFraming> m_clientFramings;
+    QHash<QUuid, MessageFraming> m_pendingClientFramings;
+
+    // Compressed params of large static replies, per method, locale and encoding
+    struct PrecompressedReply {
+        QString hash;
+        MessageCompressor::Segment segment;
+    };
+    QHash<QString, PrecompressedReply> m_precompressedReplies;
     QHash<int, QUuid> m_pushButtonTransactions;
     QHash<QUuid, QTimer*> m_newConnectionWaitTimers;
 
@@ -80,27 +80,145 @@ bool JsonValidator::checkRefs(const QVariantMap &map, const QVariantMap &api)
 
 }
 
-JsonValidator::Result JsonValidator::validateParams(const QVariantMap &params, const QString &method, const QVariantMap &api)
+class JsonValidator::Node
 {
-    QVariantMap paramDefinition = api.value("methods").toMap().value(method).toMap().value("params").toMap();
-    m_result = validateMap(params, paramDefinition, api, QIODevice::WriteOnly);
-    m_result.setWhere(method + ", param " + m_result.where());
+public:
+    enum Kind {
+        KindBasicType,
+        KindEnum,
+        KindFlags,
+        KindObject,
+        KindList
+    };
+
+    struct Field {
+        QString key; // The key as in the definition, including the o:, r: and d: prefixes
+        Node *node = nullptr;
+        bool optional = false;
+        bool readOnly = false;
+    };
+
+    Kind kind = KindObject;
+    QString typeName;
+
+    // KindBasicType
+    JsonHandler::BasicType basicType = JsonHandler::Variant;
+    QVariant::Type variantType = QVariant::Invalid;
+
+    // KindEnum
+    QSet<QString> enumValues;
+
+    // KindObject, by key without prefixes
+    QHash<QString, Field> fields;
+    QStringList requiredKeys; // Required in returns and notifications
+    QStringList requiredWritableKeys; // Required in params, read-only keys are not
+
+    // KindList entries and KindFlags enum
+    Node *entry = nullptr;
+};
+
+JsonValidator::JsonValidator()
+{
+    m_emptyObject = createNode();
+}
+
+JsonValidator::~JsonValidator()
+{
+    qDeleteAll(m_nodes);
+}
+
+void JsonValidator::setApi(const QVariantMap &api)
+{
+    clear();
+
+    // Named nodes are created upfront so references, also recursive ones, can point to them directly
+    QVariantMap enums = api.value("enums").toMap();
+    for (QVariantMap::const_iterator it = enums.constBegin(); it != enums.constEnd(); ++it) {
+        Node *node = createNode();
+        node->kind = Node::KindEnum;
+        node->typeName = it.key();
+        foreach (const QVariant &value, it.value().toList()) {
+            node->enumValues.insert(value.toString());
+        }
+        m_types.insert(it.key(), node);
+    }
+    QVariantMap flags = api.value("flags").toMap();
+    for (QVariantMap::const_iterator it = flags.constBegin(); it != flags.constEnd(); ++it) {
+        Node *node = createNode();
+        node->kind = Node::KindFlags;
+        node->typeName = it.key();
+        m_types.insert(it.key(), node);
+    }
+    QVariantMap types = api.value("types").toMap();
+    for (QVariantMap::const_iterator it = types.constBegin(); it != types.constEnd(); ++it) {
+        Node *node = createNode();
+        node->typeName = it.key();
+        m_types.insert(it.key(), node);
+    }
+
+    for (QVariantMap::const_iterator it = flags.constBegin(); it != flags.constEnd(); ++it) {
+        m_types.value(it.key())->entry = compile(it.value().toList().value(0));
+    }
+    for (QVariantMap::const_iterator it = types.constBegin(); it != types.constEnd(); ++it) {
+        compileNode(m_types.value(it.key()), it.value());
+    }
+
+    QVariantMap methods = api.value("methods").toMap();
+    for (QVariantMap::const_iterator it = methods.constBegin(); it != methods.constEnd(); ++it) {
+        QVariantMap method = it.value().toMap();
+        m_methodParams.insert(it.key(), compile(method.value("params").toMap()));
+        m_methodReturns.insert(it.key(), compile(method.value("returns").toMap()));
+    }
+    QVariantMap notifications = api.value("notifications").toMap();
+    for (QVariantMap::const_iterator it = notifications.constBegin(); it != notifications.constEnd(); ++it) {
+        m_notificationParams.insert(it.key(), compile(it.value().toMap().value("params").toMap()));
+    }
+}
+
+const JsonValidator::Node *JsonValidator::methodParams(const QString &method) const
+{
+    return m_methodParams.value(method, m_emptyObject);
+}
+
+const JsonValidator::Node *JsonValidator::methodReturns(const QString &method) const
+{
+    return m_methodReturns.value(method, m_emptyObject);
+}
+
+const JsonValidator::Node *JsonValidator::notificationParams(const QString &notification) const
+{
+    return m_notificationParams.value(notification, m_emptyObject);
+}
+
+JsonValidator::Result JsonValidator::validateParams(const QVariantMap &params, const QString &method)
+{
+    return validateParams(params, methodParams(method), method);
+}
+
+JsonValidator::Result JsonValidator::validateParams(const QVariantMap &params, const Node *definition, const QString &method)
+{
+    m_result = validateMap(params, definition, QIODevice::WriteOnly);
+    if (!m_result.success()) {
+        m_result.setWhere(method + ", param " + m_result.where());
+    }
     return m_result;
 }
 
-JsonValidator::Result JsonValidator::validateReturns(const QVariantMap &returns, const QString &method, const QVariantMap &api)
+JsonValidator::Result JsonValidator::validateReturns(const QVariantMap &returns, const QString &method)
 {
-    QVariantMap returnsDefinition = api.value("methods").toMap().value(method).toMap().value("returns").toMap();
-    m_result = validateMap(returns, returnsDefinition, api, QIODevice::ReadOnly);
-    m_result.setWhere(method + ", returns " + m_result.where());
+    m_result = validateMap(returns, methodReturns(method), QIODevice::ReadOnly);
+    if (!m_result.success()) {
+        m_result.setWhere(method + ", returns " + m_result.where());
+    }
     return m_result;
 }
 
-JsonValidator::Result JsonValidator::validateNotificationParams(const QVariantMap &params, const QString &notification, const QVariantMap &api)
+JsonValidator::Result JsonValidator::validateNotificationParams(const QVariantMap &params, const QString &notification)
 {
-    QVariantMap paramDefinition = api.value("notifications").toMap().value(notification).toMap().value("params").toMap();
-    m_result = validateMap(params, paramDefinition, api, QIODevice::ReadOnly);
-    m_result.setWhere(notification + ", param " + m_result.where());
+    m_result = validateMap(params, notificationParams(notification), QIODevice::ReadOnly);
+    if (!m_result.success()) {
+        m_result.setWhere(notification + ", param " + m_result.where());
+    }
     return m_result;
 }
 
@@ -109,180 +227,212 @@ JsonValidator::Result JsonValidator::result() const
     return m_result;
 }
 
-JsonValidator::Result JsonValidator::validateMap(const QVariantMap &map, const QVariantMap &definition, const QVariantMap &api, QIODevice::OpenMode openMode)
+void JsonValidator::clear()
 {
-    // Make sure all required values are available
-    foreach (const QString &key, definition.keys()) {
-        QRegExp isOptional = QRegExp("^([a-z]:)*o:.*");
-        if (isOptional.exactMatch(key)) {
-            continue;
+    qDeleteAll(m_nodes);
+    m_nodes.clear();
+    m_types.clear();
+    m_methodParams.clear();
+    m_methodReturns.clear();
+    m_notificationParams.clear();
+    m_emptyObject = createNode();
+}
+
+JsonValidator::Node *JsonValidator::createNode()
+{
+    Node *node = new Node();
+    m_nodes.append(node);
+    return node;
+}
+
+JsonValidator::Node *JsonValidator::compile(const QVariant &definition)
+{
+    if (definition.type() == QVariant::String && definition.toString().startsWith("$ref:")) {
+        QString refName = definition.toString().remove(0, 5);
+        Node *node = m_types.value(refName);
+        if (node) {
+            return node;
         }
-        QRegExp isReadOnly = QRegExp("^([a-z]:)*r:.*");
-        if (isReadOnly.exactMatch(key) && openMode.testFlag(QIODevice::WriteOnly)) {
-            continue;
+        qCWarning(dcJsonRpc()) << "Invalid reference to" << refName << "in API description";
+        node = createNode();
+        node->kind = Node::KindBasicType;
+        node->typeName = refName;
+        return node;
+    }
+    Node *node = createNode();
+    compileNode(node, definition);
+    return node;
+}
+
+void JsonValidator::compileNode(Node *node, const QVariant &definition)
+{
+    if (definition.type() == QVariant::Map) {
+        node->kind = Node::KindObject;
+        QVariantMap map = definition.toMap();
+        for (QVariantMap::const_iterator it = map.constBegin(); it != map.constEnd(); ++it) {
+            Node::Field field;
+            field.key = it.key();
+            field.node = compile(it.value());
+
+            // Strip the o:, r: and d: prefixes (e.g. "r:o:value")
+            QString name = it.key();
+            while (name.length() > 2 && name.at(1) == ':' && (name.at(0) == 'o' || name.at(0) == 'r' || name.at(0) == 'd')) {
+                field.optional |= name.at(0) == 'o';
+                field.readOnly |= name.at(0) == 'r';
+                name.remove(0, 2);
+            }
+
+            if (!field.optional) {
+                node->requiredKeys.append(name);
+                if (!field.readOnly) {
+                    node->requiredWritableKeys.append(name);
+                }
+            }
+            node->fields.insert(name, field);
         }
-        QString trimmedKey = key;
-        trimmedKey.remove(QRegExp("^(o:|r:|d:)*"));
-        if (!map.contains(trimmedKey)) {
-            return Result(false, "Missing required key: " + key, key);
+        return;
+    }
+
+    if (definition.type() == QVariant::List) {
+        node->kind = Node::KindList;
+        node->entry = compile(definition.toList().value(0));
+        node->typeName = definition.toList().value(0).toString();
+        return;
+    }
+
+    node->kind = Node::KindBasicType;
+    node->typeName = definition.toString();
+    node->basicType = JsonHandler::enumNameToValue<JsonHandler::BasicType>(node->typeName);
+    node->variantType = JsonHandler::basicTypeToVariantType(node->basicType);
+}
+
+JsonValidator::Result JsonValidator::validateMap(const QVariantMap &map, const Node *node, QIODevice::OpenMode openMode) const
+{
+    // Make sure all required values are available
+    const QStringList &requiredKeys = openMode.testFlag(QIODevice::WriteOnly) ? node->requiredWritableKeys : node->requiredKeys;
+    foreach (const QString &key, requiredKeys) {
+        if (!map.contains(key)) {
+            QString definitionKey = node->fields.value(key).key;
+            return Result(false, "Missing required key: " + definitionKey, definitionKey);
         }
     }
 
     // Make sure given values are valid
-    foreach (const QString &key, map.keys()) {
+    for (QVariantMap::const_iterator it = map.constBegin(); it != map.constEnd(); ++it) {
         // Is the key allowed in here?
-        QVariant expectedValue = definition.value(key);
-        foreach (const QString &definitionKey, definition.keys()) {
-            QRegExp regExp = QRegExp("(o:|r:|d:)*" + key);
-            if (regExp.exactMatch(definitionKey)) {
-                expectedValue = definition.value(definitionKey);
-            }
-        }
-        if (!expectedValue.isValid()) {
-            expectedValue = definition.value("o:" + key);
-        }
-        if (!expectedValue.isValid()) {
-            expectedValue = definition.value("d:" + key);
-        }
-        if (!expectedValue.isValid()) {
-            return Result(false, "Invalid key: " + key);
+        QHash<QString, Node::Field>::const_iterator field = node->fields.constFind(it.key());
+        if (field == node->fields.constEnd()) {
+            return Result(false, "Invalid key: " + it.key());
         }
 
         // Validate content
-        QVariant value = map.value(key);
-
-        Result result = validateEntry(value, expectedValue, api, openMode);
+        Result result = validateEntry(it.value(), field.value().node, openMode);
         if (!result.success()) {
-            result.setWhere(key + '.' + result.where());
-            result.setErrorString(result.errorString());
+            result.setWhere(it.key() + '.' + result.where());
             return result;
         }
-
-   }
+    }
 
     return Result(true);
 }
 
-JsonValidator::Result JsonValidator::validateEntry(const QVariant &value, const QVariant &definition, const QVariantMap &api, QIODevice::OpenMode openMode)
+JsonValidator::Result JsonValidator::validateEntry(const QVariant &value, const Node *node, QIODevice::OpenMode openMode) const
 {
-    if (definition.type() == QVariant::String) {
-        QString expectedTypeName = definition.toString();
-
-        if (expectedTypeName.startsWith("$ref:")) {
-            QString refName = expectedTypeName;
-            refName.remove("$ref:");
-
-            // Refs might be enums
-            QVariantMap enums = api.value("enums").toMap();
-            if (enums.contains(refName)) {
-                QVariant refDefinition = enums.value(refName);
-
-                QVariantList enumList = refDefinition.toList();
-                if (!enumList.contains(value.toString())) {
-                    return Result(false, "Expected enum value for" + refName + " but got " + value.toString());
-                }
-                return Result(true);
-            }
-            // Or flags
-            QVariantMap flags = api.value("flags").toMap();
-            if (flags.contains(refName)) {
-                QVariant refDefinition = flags.value(refName);
-                if (value.type() != QVariant::List && value.type() != QVariant::StringList) {
-                    return Result(false, "Expected flags " + refName + " but got " + value.toString());
-                }
-                QString flagEnum = refDefinition.toList().first().toString();
-                foreach (const QVariant &flagsEntry, value.toList()) {
-                    Result result = validateEntry(flagsEntry, flagEnum, api, openMode);
-                    if (!result.success()) {
-                        return result;
-                    }
-                }
-                return Result(true);
-            }
-
-            QVariantMap types = api.value("types").toMap();
-            QVariant refDefinition = types.value(refName);
-            return validateEntry(value, refDefinition, api, openMode);
-        }
-
-        JsonHandler::BasicType expectedBasicType = JsonHandler::enumNameToValue<JsonHandler::BasicType>(expectedTypeName);
-        QVariant::Type expectedVariantType = JsonHandler::basicTypeToVariantType(expectedBasicType);
-
-        // Verify basic compatiblity
-        if (expectedBasicType != JsonHandler::Variant && !value.canConvert(expectedVariantType)) {
-            return Result(false, "Invalid value. Expected: " + definition.toString() + ", Got: " + value.toString());
+    switch (node->kind) {
+    case Node::KindEnum:
+        if (!node->enumValues.contains(value.toString())) {
+            return Result(false, "Expected enum value for" + node->typeName + " but got " + value.toString());
         }
+        return Result(true);
 
-        // Any string converts fine to Uuid, but the resulting uuid might be null
-        if (expectedBasicType == JsonHandler::Uuid && value.toUuid().isNull()) {
-            return Result(false, "Invalid Uuid: " + value.toString());
-        }
-        // Make sure ints are valid
-        if (expectedBasicType == JsonHandler::Int) {
-            bool ok;
-            value.toLongLong(&ok);
-            if (!ok) {
-                return Result(false, "Invalid Int: " + value.toString());
-            }
-        }
-        // UInts
-        if (expectedBasicType == JsonHandler::Uint) {
-            bool ok;
-            value.toULongLong(&ok);
-            if (!ok) {
-                return Result(false, "Invalid UInt: " + value.toString());
-            }
-        }
-        // Double
-        if (expectedBasicType == JsonHandler::Double) {
-            bool ok;
-            value.toDouble(&ok);
-            if (!ok) {
-                return Result(false, "Invalid Double: " + value.toString());
-            }
-        }
-        // Color
-        if (expectedBasicType == JsonHandler::Color) {
-            QColor color = value.value<QColor>();
-            if (!color.isValid()) {
-                return Result(false, "Invalid Color: " + value.toString());
-            }
+    case Node::KindFlags:
+        if (value.type() != QVariant::List && value.type() != QVariant::StringList) {
+            return Result(false, "Expected flags " + node->typeName + " but got " + value.toString());
         }
-        // Time
-        if (expectedBasicType == JsonHandler::Time) {
-            QTime time = QTime::fromString(value.toString(), "hh:mm");
-            if (!time.isValid()) {
-                return Result(false, "Invalid Time: " + value.toString());
+        foreach (const QVariant &flagsEntry, value.toList()) {
+            Result result = validateEntry(flagsEntry, node->entry, openMode);
+            if (!result.success()) {
+                return result;
             }
         }
-
-
         return Result(true);
-    }
 
-    if (definition.type() == QVariant::Map) {
+    case Node::KindObject:
         if (value.type() != QVariant::Map) {
             return Result(false, "Invalid value. Expected a map bug received: " + value.toString());
         }
-        return validateMap(value.toMap(), definition.toMap(), api, openMode);
-    }
+        return validateMap(value.toMap(), node, openMode);
 
-    if (definition.type() == QVariant::List) {
-        QVariantList list = definition.toList();
-        QVariant entryDefinition = list.first();
+    case Node::KindList:
         if (value.type() != QVariant::List && value.type() != QVariant::StringList) {
-            return Result(false, "Expected list of " + entryDefinition.toString() + " but got value of type " + value.typeName() + "\n" + QJsonDocument::fromVariant(value).toJson());
+            return Result(false, "Expected list of " + node->typeName + " but got value of type " + value.typeName() + "\n" + QJsonDocument::fromVariant(value).toJson());
         }
         foreach (const QVariant &entry, value.toList()) {
-            Result result = validateEntry(entry, entryDefinition, api, openMode);
+            Result result = validateEntry(entry, node->entry, openMode);
             if (!result.success()) {
                 return result;
             }
         }
         return Result(true);
+
+    case Node::KindBasicType:
+        break;
+    }
+
+    JsonHandler::BasicType expectedBasicType = node->basicType;
+
+    // Verify basic compatiblity
+    if (expectedBasicType != JsonHandler::Variant && !value.canConvert(node->variantType)) {
+        return Result(false, "Invalid value. Expected: " + node->typeName + ", Got: " + value.toString());
     }
-    Q_ASSERT_X(false, "JsonValildator", "Incomplete validation. Unexpected type in template");
-    return Result(false);
+
+    switch (expectedBasicType) {
+    case JsonHandler::Uuid:
+        // Any string converts fine to Uuid, but the resulting uuid might be null
+        if (value.toUuid().isNull()) {
+            return Result(false, "Invalid Uuid: " + value.toString());
+        }
+        break;
+    case JsonHandler::Int: {
+        // Make sure ints are valid
+        bool ok;
+        value.toLongLong(&ok);
+        if (!ok) {
+            return Result(false, "Invalid Int: " + value.toString());
+        }
+        break;
+    }
+    case JsonHandler::Uint: {
+        bool ok;
+        value.toULongLong(&ok);
+        if (!ok) {
+            return Result(false, "Invalid UInt: " + value.toString());
+        }
+        break;
+    }
+    case JsonHandler::Double: {
+        bool ok;
+        value.toDouble(&ok);
+        if (!ok) {
+            return Result(false, "Invalid Double: " + value.toString());
+        }
+        break;
+    }
+    case JsonHandler::Color:
+        if (!value.value<QColor>().isValid()) {
+            return Result(false, "Invalid Color: " + value.toString());
+        }
+        break;
+    case JsonHandler::Time:
+        if (!QTime::fromString(value.toString(), "hh:mm").isValid()) {
+            return Result(false, "Invalid Time: " + value.toString());
+        }
+        break;
+    default:
+        break;
+    }
+
+    return Result(true);
 }
 
 }
@@ -34,6 +34,7 @@
 #include <QPair>
 #include <QVariant>
 #include <QIODevice>
+#include <QHash>
 
 namespace nymeaserver {
 
@@ -59,18 +60,46 @@ public:
         bool m_deprecated = false;
     };
 
-    JsonValidator() {}
+    // A node of the compiled API description
+    class Node;
+
+    JsonValidator();
+    ~JsonValidator();
 
     static bool checkRefs(const QVariantMap &map, const QVariantMap &api);
 
-    Result validateParams(const QVariantMap &params, const QString &method, const QVariantMap &api);
-    Result validateReturns(const QVariantMap &returns, const QString &method, const QVariantMap &api);
-    Result validateNotificationParams(const QVariantMap &params, const QString &notification, const QVariantMap &api);
+    // Compiles the given API description. Must be called again whenever the API changes.
+    void setApi(const QVariantMap &api);
+
+    const Node *methodParams(const QString &method) const;
+    const Node *methodReturns(const QString &method) const;
+    const Node *notificationParams(const QString &notification) const;
+
+    Result validateParams(const QVariantMap &params, const QString &method);
+    Result validateParams(const QVariantMap &params, const Node *definition, const QString &method);
+    Result validateReturns(const QVariantMap &returns, const QString &method);
+    Result validateNotificationParams(const QVariantMap &params, const QString &notification);
 
     Result result() const;
+
 private:
-    Result validateMap(const QVariantMap &map, const QVariantMap &definition, const QVariantMap &api, QIODevice::OpenMode openMode);
-    Result validateEntry(const QVariant &value, const QVariant &definition, const QVariantMap &api, QIODevice::OpenMode openMode);
+    Q_DISABLE_COPY(JsonValidator)
+
+    void clear();
+    Node *createNode();
+    void compileNode(Node *node, const QVariant &definition);
+    Node *compile(const QVariant &definition);
+
+    Result validateMap(const QVariantMap &map, const Node *node, QIODevice::OpenMode openMode) const;
+    Result validateEntry(const QVariant &value, const Node *node, QIODevice::OpenMode openMode) const;
+
+    QList<Node*> m_nodes;
+    Node *m_emptyObject = nullptr;
+    // Enums, flags and types by name
+    QHash<QString, Node*> m_types;
+    QHash<QString, Node*> m_methodParams;
+    QHash<QString, Node*> m_methodReturns;
+    QHash<QString, Node*> m_notificationParams;
 
     Result m_result;
 };
@@ -46,9 +46,11 @@ LoggingHandler::LoggingHandler(QObject *parent) :
     registerEnum<Logging::LoggingLevel>();
     registerEnum<Logging::LoggingEventType>();
     registerEnum<Logging::LoggingError>();
+    registerEnum<Logging::StateHistoryResolution>();
 
     // Objects
     registerObject<LogEntry, LogEntries>();
+    registerObject<StateHistoryPoint, StateHistoryPoints>();
 
     // Methods
     QString description; QVariantMap params; QVariantMap returns;
@@ -66,7 +68,13 @@ LoggingHandler::LoggingHandler(QObject *parent) :
                    "1) offset 0, maxCount 1000: Entries 0 to 9999\n"
                    "2) offset 10000, maxCount 1000: Entries 10000 - 19999\n"
                    "3) offset 20000, maxCount 1000: Entries 20000 - 29999\n"
-                   "...";
+                   "...\n\n"
+                   "Deep pages are faster to fetch using the nextCursor returned along with a full page. "
+                   "Passing it as cursor continues the result set right after the last entry of the previous "
+                   "page. The offset is ignored if a cursor is given.\n\n"
+                   "If stream is set to true, the reply only contains the streamId and the entries are sent "
+                   "in chunks with LogEntriesStreamed notifications to the calling client. The last chunk has "
+                   "the final flag set.";
     QVariantMap timeFilter;
     timeFilter.insert("o:startDate", enumValueName(Int));
     timeFilter.insert("o:endDate", enumValueName(Int));
@@ -79,12 +87,32 @@ LoggingHandler::LoggingHandler(QObject *parent) :
     params.insert("o:values", QVariantList() << enumValueName(Variant));
     params.insert("o:limit", enumValueName(Int));
     params.insert("o:offset", enumValueName(Int));
+    params.insert("o:cursor", enumValueName(String));
+    params.insert("o:stream", enumValueName(Bool));
     returns.insert("loggingError", enumRef<Logging::LoggingError>());
     returns.insert("o:logEntries", objectRef<LogEntries>());
     returns.insert("count", enumValueName(Int));
     returns.insert("offset", enumValueName(Int));
+    returns.insert("o:nextCursor", enumValueName(String));
+    returns.insert("o:streamId", enumValueName(Uuid));
     registerMethod("GetLogEntries", description, params, returns);
 
+    params.clear(); returns.clear();
+    description = "Get the history of a numeric state in the given resolution. The history is aggregated "
+                  "while the state values are logged, each point holds the minimum, maximum, average and "
+                  "last value of the state within the interval starting at its timestamp. Intervals without "
+                  "values are omitted. The optional from and to parameters limit the time range and are given "
+                  "in milliseconds since epoch, as are the timestamps of the returned points. Minute points are "
+                  "kept for 2 days, quarter hour points for 31 days, hour points for a year and day points forever.";
+    params.insert("thingId", enumValueName(Uuid));
+    params.insert("stateTypeId", enumValueName(Uuid));
+    params.insert("resolution", enumRef<Logging::StateHistoryResolution>());
+    params.insert("o:from", enumValueName(Uint));
+    params.insert("o:to", enumValueName(Uint));
+    returns.insert("loggingError", enumRef<Logging::LoggingError>());
+    returns.insert("o:stateHistoryPoints", objectRef<StateHistoryPoints>());
+    registerMethod("GetStateHistory", description, params, returns);
+
     // Notifications
     params.clear();
     description = "Emitted whenever an entry is appended to the logging system. ";
@@ -99,6 +127,14 @@ LoggingHandler::LoggingHandler(QObject *parent) :
                    "keep to database in the size limits.";
     registerNotification("LogDatabaseUpdated", description, params);
 
+    params.clear();
+    description = "Emitted to the client which called GetLogEntries with stream set to true. Contains the next "
+                  "chunk of the result set. The last chunk of a stream has the final flag set.";
+    params.insert("streamId", enumValueName(Uuid));
+    params.insert("logEntries", objectRef<LogEntries>());
+    params.insert("final", enumValueName(Bool));
+    registerNotification("LogEntriesStreamed", description, params);
+
     connect(NymeaCore::instance()->logEngine(), &LogEngine::logEntryAdded, this, &LoggingHandler::logEntryAdded);
     connect(NymeaCore::instance()->logEngine(), &LogEngine::logDatabaseUpdated, this, &LoggingHandler::logDatabaseUpdated);
 }
@@ -120,10 +156,31 @@ void LoggingHandler::logDatabaseUpdated()
     emit LogDatabaseUpdated(QVariantMap());
 }
 
-JsonReply* LoggingHandler::GetLogEntries(const QVariantMap &params) const
+JsonReply* LoggingHandler::GetLogEntries(const QVariantMap &params, const JsonContext &context)
 {
     LogFilter filter = unpackLogFilter(params);
 
+    if (params.contains("cursor") && !filter.setCursor(params.value("cursor").toString())) {
+        QVariantMap returns;
+        returns.insert("loggingError", enumValueName<Logging::LoggingError>(Logging::LoggingErrorInvalidFilterParameter));
+        returns.insert("offset", filter.offset());
+        returns.insert("count", 0);
+        return createReply(returns);
+    }
+
+    if (params.value("stream").toBool()) {
+        QUuid streamId = QUuid::createUuid();
+        m_streams.insert(streamId, context.clientId());
+        streamLogEntries(context.clientId(), streamId, filter, filter.limit());
+
+        QVariantMap returns;
+        returns.insert("loggingError", enumValueName<Logging::LoggingError>(Logging::LoggingErrorNoError));
+        returns.insert("offset", filter.offset());
+        returns.insert("count", 0);
+        returns.insert("streamId", streamId);
+        return createReply(returns);
+    }
+
     LogEntriesFetchJob *job = NymeaCore::instance()->logEngine()->fetchLogEntries(filter);
 
     JsonReply *reply = createAsyncReply("GetLogEntries");
@@ -139,6 +196,100 @@ JsonReply* LoggingHandler::GetLogEntries(const QVariantMap &params) const
         returns.insert("logEntries", entries);
         returns.insert("offset", filter.offset());
         returns.insert("count", entries.count());
+        if (!job->nextCursor().isEmpty()) {
+            returns.insert("nextCursor", job->nextCursor());
+        }
+
+        reply->setData(returns);
+        reply->finished();
+    });
+
+    return reply;
+}
+
+void LoggingHandler::streamLogEntries(const QUuid &clientId, const QUuid &streamId, const LogFilter &filter, int remaining)
+{
+    // Only one chunk is held in memory at a time. Chunks after the first one continue
+    // at the cursor of the previous one.
+    LogFilter chunkFilter = filter;
+    chunkFilter.setLimit(remaining < 0 ? m_streamChunkSize : qMin(remaining, m_streamChunkSize));
+
+    LogEntriesFetchJob *job = NymeaCore::instance()->logEngine()->fetchLogEntries(chunkFilter);
+    connect(job, &LogEntriesFetchJob::finished, this, [this, job, clientId, streamId, chunkFilter, remaining](){
+        if (!m_streams.contains(streamId)) {
+            qCDebug(dcJsonRpc()) << "Client" << clientId << "has gone away. Stopping log stream" << streamId;
+            return;
+        }
+
+        QVariantList entries;
+        foreach (const LogEntry &entry, job->results()) {
+            entries.append(packLogEntry(entry));
+        }
+
+        int left = remaining < 0 ? -1 : remaining - entries.count();
+        bool finished = job->nextCursor().isEmpty() || left == 0;
+
+        QVariantMap params;
+        params.insert("streamId", streamId);
+        params.insert("logEntries", entries);
+        params.insert("final", finished);
+        emit LogEntriesStreamed(clientId, params);
+
+        if (finished) {
+            m_streams.remove(streamId);
+        } else {
+            LogFilter nextFilter = chunkFilter;
+            nextFilter.setCursor(job->nextCursor());
+            streamLogEntries(clientId, streamId, nextFilter, left);
+        }
+    });
+}
+
+// Chunks which are already being fetched for the streams are dropped when they arrive
+void LoggingHandler::stopLogStreams(const QUuid &clientId)
+{
+    QHash<QUuid, QUuid>::iterator it = m_streams.begin();
+    while (it != m_streams.end()) {
+        if (it.value() == clientId) {
+            it = m_streams.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+JsonReply *LoggingHandler::GetStateHistory(const QVariantMap &params) const
+{
+    ThingId thingId = params.value("thingId").toUuid();
+    StateTypeId stateTypeId = params.value("stateTypeId").toUuid();
+    Logging::StateHistoryResolution resolution = enumNameToValue<Logging::StateHistoryResolution>(params.value("resolution").toString());
+    QDateTime from;
+    if (params.contains("from")) {
+        from = QDateTime::fromMSecsSinceEpoch(params.value("from").toLongLong());
+    }
+    QDateTime to;
+    if (params.contains("to")) {
+        to = QDateTime::fromMSecsSinceEpoch(params.value("to").toLongLong());
+    }
+
+    if (from.isValid() && to.isValid() && from > to) {
+        QVariantMap returns;
+        returns.insert("loggingError", enumValueName<Logging::LoggingError>(Logging::LoggingErrorInvalidFilterParameter));
+        return createReply(returns);
+    }
+
+    StateHistoryFetchJob *job = NymeaCore::instance()->logEngine()->fetchStateHistory(thingId, stateTypeId, resolution, from, to);
+
+    JsonReply *reply = createAsyncReply("GetStateHistory");
+
+    connect(job, &StateHistoryFetchJob::finished, reply, [reply, job](){
+        QVariantList points;
+        foreach (const StateHistoryPoint &point, job->results()) {
+            points.append(packStateHistoryPoint(point));
+        }
+        QVariantMap returns;
+        returns.insert("loggingError", enumValueName<Logging::LoggingError>(Logging::LoggingErrorNoError));
+        returns.insert("stateHistoryPoints", points);
 
         reply->setData(returns);
         reply->finished();
@@ -147,6 +298,18 @@ JsonReply* LoggingHandler::GetLogEntries(const QVariantMap &params) const
     return reply;
 }
 
+QVariantMap LoggingHandler::packStateHistoryPoint(const StateHistoryPoint &point)
+{
+    QVariantMap pointMap;
+    pointMap.insert("timestamp", point.timestamp().toMSecsSinceEpoch());
+    pointMap.insert("minimum", point.minimum());
+    pointMap.insert("maximum", point.maximum());
+    pointMap.insert("average", point.average());
+    pointMap.insert("last", point.last());
+    pointMap.insert("count", point.count());
+    return pointMap;
+}
+
 QVariantMap LoggingHandler::packLogEntry(const LogEntry &logEntry)
 {
     QVariantMap logEntryMap;
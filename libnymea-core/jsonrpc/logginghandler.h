@@ -34,6 +34,7 @@
 #include "jsonrpc/jsonhandler.h"
 #include "logging/logentry.h"
 #include "logging/logfilter.h"
+#include "logging/statehistorypoint.h"
 
 namespace nymeaserver {
 
@@ -44,17 +45,28 @@ public:
     explicit LoggingHandler(QObject *parent = nullptr);
     QString name() const override;
 
-    Q_INVOKABLE JsonReply *GetLogEntries(const QVariantMap &params) const;
+    Q_INVOKABLE JsonReply *GetLogEntries(const QVariantMap &params, const JsonContext &context);
+    Q_INVOKABLE JsonReply *GetStateHistory(const QVariantMap &params) const;
+
+    void stopLogStreams(const QUuid &clientId);
 
 signals:
     void LogEntryAdded(const QVariantMap &params);
     void LogDatabaseUpdated(const QVariantMap &params);
+    void LogEntriesStreamed(const QUuid &clientId, const QVariantMap &params);
 
 private:
     static QVariantMap packLogEntry(const LogEntry &logEntry);
+    static QVariantMap packStateHistoryPoint(const StateHistoryPoint &point);
 
     static LogFilter unpackLogFilter(const QVariantMap &logFilterMap);
 
+    void streamLogEntries(const QUuid &clientId, const QUuid &streamId, const LogFilter &filter, int remaining);
+
+    int m_streamChunkSize = 500;
+    // Stream id -> client id of the streams in progress
+    QHash<QUuid, QUuid> m_streams;
+
 private slots:
     void logEntryAdded(const LogEntry &entry);
     void logDatabaseUpdated();
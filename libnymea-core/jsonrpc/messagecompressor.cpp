@@ -0,0 +1,197 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2022, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+/*!
+    \class nymeaserver::MessageCompressor
+    \brief Compresses and decompresses the messages of a JSON RPC connection.
+
+    \ingroup json
+    \inmodule core
+
+    Each direction of a connection is a single raw deflate stream, without zlib header. Every message is
+    flushed with Z_SYNC_FLUSH, so the peer can decompress it as soon as it arrived and the compression
+    context is kept across messages, like permessage-deflate with context takeover does.
+
+    Large static replies can be compressed once with compressSegment() and spliced into the stream of any
+    connection. A segment only references data within itself, and after splicing it the compressor uses the
+    segment content as its history, so the following data may still refer back to it.
+*/
+
+#include "messagecompressor.h"
+#include "loggingcategories.h"
+
+namespace nymeaserver {
+
+// Raw deflate with the maximum window size
+static const int windowBits = -MAX_WBITS;
+static const int memLevel = 8;
+static const int windowSize = 1 << MAX_WBITS;
+
+MessageCompressor::MessageCompressor()
+{
+    m_deflateStream.zalloc = Z_NULL;
+    m_deflateStream.zfree = Z_NULL;
+    m_deflateStream.opaque = Z_NULL;
+    m_inflateStream.zalloc = Z_NULL;
+    m_inflateStream.zfree = Z_NULL;
+    m_inflateStream.opaque = Z_NULL;
+    m_inflateStream.next_in = Z_NULL;
+    m_inflateStream.avail_in = 0;
+
+    if (deflateInit2(&m_deflateStream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, windowBits, memLevel, Z_DEFAULT_STRATEGY) != Z_OK) {
+        qCWarning(dcJsonRpc()) << "Failed to initialize deflate stream:" << m_deflateStream.msg;
+        return;
+    }
+    if (inflateInit2(&m_inflateStream, windowBits) != Z_OK) {
+        qCWarning(dcJsonRpc()) << "Failed to initialize inflate stream:" << m_inflateStream.msg;
+        deflateEnd(&m_deflateStream);
+        return;
+    }
+    m_valid = true;
+}
+
+MessageCompressor::~MessageCompressor()
+{
+    if (m_valid) {
+        deflateEnd(&m_deflateStream);
+        inflateEnd(&m_inflateStream);
+    }
+}
+
+bool MessageCompressor::isValid() const
+{
+    return m_valid;
+}
+
+/*! Compresses \a data and flushes the stream so the peer can decompress all of it. */
+QByteArray MessageCompressor::compress(const QByteArray &data)
+{
+    Q_ASSERT(m_valid);
+    return deflateData(&m_deflateStream, data);
+}
+
+/*! Compresses \a prefix, followed by the precompressed \a segment and \a suffix. */
+QByteArray MessageCompressor::compress(const QByteArray &prefix, const Segment &segment, const QByteArray &suffix)
+{
+    Q_ASSERT(m_valid);
+    QByteArray output = deflateData(&m_deflateStream, prefix);
+    output.append(segment.compressedData);
+
+    // The peer has the segment content in its history now, make the compressor use the same history.
+    // If that isn't possible, starting over without history keeps the stream valid too.
+    int status = deflateSetDictionary(&m_deflateStream, reinterpret_cast<const Bytef *>(segment.dictionary.constData()), static_cast<uInt>(segment.dictionary.size()));
+    if (status != Z_OK) {
+        deflateReset(&m_deflateStream);
+    }
+
+    output.append(deflateData(&m_deflateStream, suffix));
+    return output;
+}
+
+/*! Decompresses \a data and appends the result to \a output. Returns false if \a data isn't valid or if more than
+    \a maxSize bytes would be appended.
+*/
+bool MessageCompressor::decompress(const QByteArray &data, QByteArray *output, int maxSize)
+{
+    Q_ASSERT(m_valid);
+    int start = output->size();
+    m_inflateStream.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(data.constData()));
+    m_inflateStream.avail_in = static_cast<uInt>(data.size());
+
+    do {
+        int chunkSize = qMax(data.size() * 4, 4096);
+        if (output->size() - start + chunkSize > maxSize) {
+            chunkSize = maxSize - (output->size() - start);
+            if (chunkSize <= 0) {
+                qCWarning(dcJsonRpc()) << "Decompressed data exceeds" << maxSize << "bytes";
+                return false;
+            }
+        }
+        int offset = output->size();
+        output->resize(offset + chunkSize);
+        m_inflateStream.next_out = reinterpret_cast<Bytef *>(output->data() + offset);
+        m_inflateStream.avail_out = static_cast<uInt>(chunkSize);
+
+        int status = inflate(&m_inflateStream, Z_SYNC_FLUSH);
+        output->resize(output->size() - static_cast<int>(m_inflateStream.avail_out));
+        if (status == Z_STREAM_END) {
+            // The peer finished its stream. Anything after that starts a new one.
+            inflateReset(&m_inflateStream);
+        } else if (status != Z_OK && status != Z_BUF_ERROR) {
+            qCWarning(dcJsonRpc()) << "Failed to decompress data:" << (m_inflateStream.msg ? m_inflateStream.msg : "unknown error");
+            return false;
+        }
+    } while (m_inflateStream.avail_in > 0 || m_inflateStream.avail_out == 0);
+    return true;
+}
+
+/*! Compresses \a data with the best compression, independent of any stream, so it can be passed to compress()
+    for many connections.
+*/
+MessageCompressor::Segment MessageCompressor::compressSegment(const QByteArray &data)
+{
+    Segment segment;
+
+    z_stream stream;
+    stream.zalloc = Z_NULL;
+    stream.zfree = Z_NULL;
+    stream.opaque = Z_NULL;
+    if (deflateInit2(&stream, Z_BEST_COMPRESSION, Z_DEFLATED, windowBits, memLevel, Z_DEFAULT_STRATEGY) != Z_OK) {
+        qCWarning(dcJsonRpc()) << "Failed to initialize deflate stream:" << stream.msg;
+        return segment;
+    }
+    segment.compressedData = deflateData(&stream, data);
+    segment.dictionary = data.right(windowSize);
+    segment.dataSize = data.size();
+    deflateEnd(&stream);
+    return segment;
+}
+
+QByteArray MessageCompressor::deflateData(z_stream *stream, const QByteArray &data)
+{
+    QByteArray output;
+    stream->next_in = reinterpret_cast<Bytef *>(const_cast<char *>(data.constData()));
+    stream->avail_in = static_cast<uInt>(data.size());
+
+    // Leave room for the sync flush marker. If that's not enough, the loop grows the buffer.
+    int chunkSize = static_cast<int>(deflateBound(stream, static_cast<uLong>(data.size()))) + 16;
+    do {
+        int offset = output.size();
+        output.resize(offset + chunkSize);
+        stream->next_out = reinterpret_cast<Bytef *>(output.data() + offset);
+        stream->avail_out = static_cast<uInt>(chunkSize);
+        deflate(stream, Z_SYNC_FLUSH);
+        output.resize(output.size() - static_cast<int>(stream->avail_out));
+    } while (stream->avail_out == 0);
+
+    return output;
+}
+
+}
@@ -0,0 +1,73 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2022, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef MESSAGECOMPRESSOR_H
+#define MESSAGECOMPRESSOR_H
+
+#include <QByteArray>
+
+#include <zlib.h>
+
+namespace nymeaserver {
+
+class MessageCompressor
+{
+public:
+    // A piece of a message compressed independently, which can be spliced into any compressed stream
+    struct Segment {
+        QByteArray compressedData;
+        QByteArray dictionary;
+        int dataSize = 0;
+    };
+
+    MessageCompressor();
+    ~MessageCompressor();
+
+    bool isValid() const;
+
+    QByteArray compress(const QByteArray &data);
+    QByteArray compress(const QByteArray &prefix, const Segment &segment, const QByteArray &suffix);
+    bool decompress(const QByteArray &data, QByteArray *output, int maxSize);
+
+    static Segment compressSegment(const QByteArray &data);
+
+private:
+    Q_DISABLE_COPY(MessageCompressor)
+
+    static QByteArray deflateData(z_stream *stream, const QByteArray &data);
+
+    z_stream m_deflateStream;
+    z_stream m_inflateStream;
+    bool m_valid = false;
+};
+
+}
+
+#endif // MESSAGECOMPRESSOR_H
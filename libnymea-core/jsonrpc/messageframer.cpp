@@ -0,0 +1,271 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2022, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+/*!
+    \class nymeaserver::MessageFramer
+    \brief Splits the data received from a JSON RPC client into messages.
+
+    \ingroup json
+    \inmodule core
+
+    Incoming data is appended to buffer() and complete messages are taken with nextMessage() until it returns
+    ResultIncomplete. The returned messages point into the buffer without copying it and are only valid until
+    the buffer is modified. Consumed data is dropped by compact(), which moves the remaining data only when at
+    least half of the buffer has been consumed, so processing a stream of pipelined messages stays linear.
+
+    Without length prefixes, JSON messages end with the closing bracket of the top level object. The scanner
+    keeps track of strings and nesting, so brackets within strings don't matter, and its state is kept when
+    waiting for more data. As JSON strings can't contain raw newlines, a newline within a string or after
+    anything which isn't a JSON object ends a broken message, which then fails to parse. CBOR messages are
+    self-delimiting. With FramingLengthPrefixed, each message is preceded by its size as 32 bit unsigned big
+    endian integer, for both JSON and CBOR.
+*/
+
+#include "messageframer.h"
+
+#include <QtEndian>
+#if QT_VERSION >= QT_VERSION_CHECK(5,12,0)
+#include <QCborStreamReader>
+#endif
+
+namespace nymeaserver {
+
+MessageFramer::MessageFramer(int maxMessageSize):
+    m_maxMessageSize(maxMessageSize)
+{
+
+}
+
+/*! Returns the maximum size of a message. Clients sending larger messages can't be framed. */
+int MessageFramer::maxMessageSize() const
+{
+    return m_maxMessageSize;
+}
+
+MessageFramer::Framing MessageFramer::framing() const
+{
+    return m_framing;
+}
+
+/*! Sets the \a framing for the data following the messages taken so far. */
+void MessageFramer::setFraming(Framing framing)
+{
+    if (m_framing == framing) {
+        return;
+    }
+    m_framing = framing;
+    m_scanPosition = m_offset;
+    m_depth = 0;
+    m_inString = false;
+    m_escaped = false;
+}
+
+/*! Returns the buffer to append incoming data to. */
+QByteArray *MessageFramer::buffer()
+{
+    return &m_buffer;
+}
+
+/*! Takes the next complete message from the buffer and stores it in \a message. Returns ResultIncomplete if
+    more data is needed, and ResultError if the data can't be framed. The connection can't be recovered then.
+*/
+MessageFramer::Result MessageFramer::nextMessage(QByteArray *message)
+{
+    switch (m_framing) {
+    case FramingJson:
+        return nextJsonMessage(message);
+    case FramingCbor:
+        return nextCborMessage(message);
+    case FramingLengthPrefixed:
+        return nextLengthPrefixedMessage(message);
+    }
+    return ResultIncomplete;
+}
+
+QString MessageFramer::errorString() const
+{
+    return m_errorString;
+}
+
+/*! Drops the data of the messages taken from the buffer. */
+void MessageFramer::compact()
+{
+    if (m_offset == 0) {
+        return;
+    }
+    if (m_offset >= m_buffer.size()) {
+        m_buffer.clear();
+        m_scanPosition = 0;
+        m_offset = 0;
+        return;
+    }
+    if (m_offset >= m_buffer.size() / 2) {
+        m_buffer.remove(0, m_offset);
+        m_scanPosition -= m_offset;
+        m_offset = 0;
+    }
+}
+
+/*! Returns the prefix to send before a message of the given \a length with FramingLengthPrefixed. */
+QByteArray MessageFramer::lengthPrefix(int length)
+{
+    QByteArray prefix(4, 0);
+    qToBigEndian<quint32>(static_cast<quint32>(length), reinterpret_cast<uchar *>(prefix.data()));
+    return prefix;
+}
+
+MessageFramer::Result MessageFramer::nextJsonMessage(QByteArray *message)
+{
+    const char *data = m_buffer.constData();
+    const int size = m_buffer.size();
+
+    while (m_scanPosition < size) {
+        const char c = data[m_scanPosition++];
+        if (m_inString) {
+            if (m_escaped) {
+                m_escaped = false;
+            } else if (c == '\\') {
+                m_escaped = true;
+            } else if (c == '"') {
+                m_inString = false;
+            } else if (c == '\n') {
+                return takeMessage(message, m_offset, m_scanPosition - 1, m_scanPosition);
+            }
+            continue;
+        }
+
+        switch (c) {
+        case '{':
+        case '[':
+            m_depth++;
+            break;
+        case '}':
+        case ']':
+            if (m_depth > 0 && --m_depth == 0) {
+                return takeMessage(message, m_offset, m_scanPosition, m_scanPosition);
+            }
+            break;
+        case '"':
+            m_inString = true;
+            break;
+        case '\n':
+        case '\r':
+        case ' ':
+        case '\t':
+            if (m_depth == 0) {
+                if (m_offset == m_scanPosition - 1) {
+                    // Whitespace between messages
+                    m_offset = m_scanPosition;
+                } else if (c == '\n') {
+                    return takeMessage(message, m_offset, m_scanPosition - 1, m_scanPosition);
+                }
+            }
+            break;
+        default:
+            break;
+        }
+    }
+
+    if (size - m_offset > m_maxMessageSize) {
+        return fail(QString("Message exceeds %1 bytes").arg(m_maxMessageSize));
+    }
+    return ResultIncomplete;
+}
+
+MessageFramer::Result MessageFramer::nextCborMessage(QByteArray *message)
+{
+#if QT_VERSION >= QT_VERSION_CHECK(5,12,0)
+    // Messages may be separated by newlines, just like JSON messages
+    while (m_offset < m_buffer.size() && (m_buffer.at(m_offset) == '\n' || m_buffer.at(m_offset) == '\r')) {
+        m_offset++;
+    }
+    if (m_offset == m_buffer.size()) {
+        return ResultIncomplete;
+    }
+
+    QCborStreamReader reader(m_buffer.constData() + m_offset, m_buffer.size() - m_offset);
+    reader.next();
+    if (reader.lastError() == QCborError::EndOfFile) {
+        if (m_buffer.size() - m_offset > m_maxMessageSize) {
+            return fail(QString("Message exceeds %1 bytes").arg(m_maxMessageSize));
+        }
+        return ResultIncomplete;
+    }
+    if (reader.lastError() != QCborError::NoError) {
+        return fail(QString("Failed to parse CBOR data: %1").arg(reader.lastError().toString()));
+    }
+    int end = m_offset + static_cast<int>(reader.currentOffset());
+    return takeMessage(message, m_offset, end, end);
+#else
+    Q_UNUSED(message)
+    return fail("CBOR is not supported");
+#endif
+}
+
+MessageFramer::Result MessageFramer::nextLengthPrefixedMessage(QByteArray *message)
+{
+    // Skip the separator after the message which switched to this framing. As messages are limited to
+    // m_maxMessageSize, a valid length prefix never starts with one of these.
+    while (m_offset < m_buffer.size() && (m_buffer.at(m_offset) == '\n' || m_buffer.at(m_offset) == '\r')) {
+        m_offset++;
+    }
+    if (m_buffer.size() - m_offset < 4) {
+        return ResultIncomplete;
+    }
+    quint32 length = qFromBigEndian<quint32>(reinterpret_cast<const uchar *>(m_buffer.constData() + m_offset));
+    if (length > static_cast<quint32>(m_maxMessageSize)) {
+        return fail(QString("Message length %1 exceeds %2 bytes").arg(length).arg(m_maxMessageSize));
+    }
+    int start = m_offset + 4;
+    if (m_buffer.size() - start < static_cast<int>(length)) {
+        return ResultIncomplete;
+    }
+    int end = start + static_cast<int>(length);
+    return takeMessage(message, start, end, end);
+}
+
+MessageFramer::Result MessageFramer::takeMessage(QByteArray *message, int start, int end, int next)
+{
+    *message = QByteArray::fromRawData(m_buffer.constData() + start, end - start);
+    m_offset = next;
+    m_scanPosition = next;
+    m_depth = 0;
+    m_inString = false;
+    m_escaped = false;
+    return ResultMessage;
+}
+
+MessageFramer::Result MessageFramer::fail(const QString &errorString)
+{
+    m_errorString = errorString;
+    return ResultError;
+}
+
+}
@@ -0,0 +1,91 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2022, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef MESSAGEFRAMER_H
+#define MESSAGEFRAMER_H
+
+#include <QByteArray>
+#include <QString>
+
+namespace nymeaserver {
+
+class MessageFramer
+{
+public:
+    enum Framing {
+        FramingJson,
+        FramingCbor,
+        FramingLengthPrefixed
+    };
+
+    enum Result {
+        ResultIncomplete,
+        ResultMessage,
+        ResultError
+    };
+
+    explicit MessageFramer(int maxMessageSize = 1024 * 1024);
+
+    int maxMessageSize() const;
+
+    Framing framing() const;
+    void setFraming(Framing framing);
+
+    QByteArray *buffer();
+    Result nextMessage(QByteArray *message);
+    QString errorString() const;
+
+    void compact();
+
+    static QByteArray lengthPrefix(int length);
+
+private:
+    Result nextJsonMessage(QByteArray *message);
+    Result nextCborMessage(QByteArray *message);
+    Result nextLengthPrefixedMessage(QByteArray *message);
+    Result takeMessage(QByteArray *message, int start, int end, int next);
+    Result fail(const QString &errorString);
+
+    Framing m_framing = FramingJson;
+    int m_maxMessageSize;
+    QByteArray m_buffer;
+    int m_offset = 0;
+    QString m_errorString;
+
+    // JSON scanner state, kept across calls so every byte is only looked at once
+    int m_scanPosition = 0;
+    int m_depth = 0;
+    bool m_inString = false;
+    bool m_escaped = false;
+};
+
+}
+
+#endif // MESSAGEFRAMER_H
@@ -5,7 +5,7 @@ include(../nymea.pri)
 
 QT += bluetooth dbus qml sql websockets serialport
 INCLUDEPATH += $$top_srcdir/libnymea $$top_builddir
-LIBS += -L$$top_builddir/libnymea/ -lnymea -lssl -lcrypto
+LIBS += -L$$top_builddir/libnymea/ -lnymea -lssl -lcrypto -lz
 
 CONFIG += link_pkgconfig
 PKGCONFIG += nymea-mqtt nymea-networkmanager nymea-zigbee nymea-remoteproxyclient nymea-gpio
@@ -64,6 +64,7 @@ HEADERS += nymeacore.h \
     hardware/serialport/serialportmonitor.h \
     integrations/apikeysprovidersloader.h \
     integrations/plugininfocache.h \
+    integrations/thingstatecache.h \
     integrations/python/pyapikeystorage.h \
     integrations/python/pybrowseractioninfo.h \
     integrations/python/pybrowseresult.h \
@@ -81,6 +82,7 @@ HEADERS += nymeacore.h \
     ruleengine/stateevaluator.h \
     ruleengine/ruleaction.h \
     ruleengine/ruleactionparam.h \
+    ruleengine/thingstatesnapshot.h \
     scriptengine/script.h \
     scriptengine/scriptaction.h \
     scriptengine/scriptalarm.h \
@@ -104,6 +106,8 @@ HEADERS += nymeacore.h \
     servers/tunnelproxyserver.h \
     jsonrpc/jsonrpcserverimplementation.h \
     jsonrpc/jsonvalidator.h \
+    jsonrpc/messagecompressor.h \
+    jsonrpc/messageframer.h \
     jsonrpc/integrationshandler.h \
     jsonrpc/ruleshandler.h \
     jsonrpc/logginghandler.h \
@@ -116,8 +120,11 @@ HEADERS += nymeacore.h \
     jsonrpc/usershandler.h \
     logging/logging.h \
     logging/logengine.h \
+    logging/logdatabaseworker.h \
     logging/logfilter.h \
     logging/logentry.h \
+    logging/stateaggregator.h \
+    logging/statehistorypoint.h \
     logging/logvaluetool.h \
     time/timemanager.h \
     usermanager/userautorizer.h \
@@ -164,6 +171,7 @@ SOURCES += nymeacore.cpp \
     hardware/serialport/serialportmonitor.cpp \
     integrations/apikeysprovidersloader.cpp \
     integrations/plugininfocache.cpp \
+    integrations/thingstatecache.cpp \
     integrations/thingmanagerimplementation.cpp \
     integrations/translator.cpp \
     experiences/experiencemanager.cpp \
@@ -174,6 +182,7 @@ SOURCES += nymeacore.cpp \
     ruleengine/stateevaluator.cpp \
     ruleengine/ruleaction.cpp \
     ruleengine/ruleactionparam.cpp \
+    ruleengine/thingstatesnapshot.cpp \
     scriptengine/script.cpp \
     scriptengine/scriptaction.cpp \
     scriptengine/scriptalarm.cpp \
@@ -197,6 +206,8 @@ SOURCES += nymeacore.cpp \
     servers/tunnelproxyserver.cpp \
     jsonrpc/jsonrpcserverimplementation.cpp \
     jsonrpc/jsonvalidator.cpp \
+    jsonrpc/messagecompressor.cpp \
+    jsonrpc/messageframer.cpp \
     jsonrpc/integrationshandler.cpp \
     jsonrpc/ruleshandler.cpp \
     jsonrpc/logginghandler.cpp \
@@ -208,8 +219,11 @@ SOURCES += nymeacore.cpp \
     jsonrpc/scriptshandler.cpp \
     jsonrpc/usershandler.cpp \
     logging/logengine.cpp \
+    logging/logdatabaseworker.cpp \
     logging/logfilter.cpp \
     logging/logentry.cpp \
+    logging/stateaggregator.cpp \
+    logging/statehistorypoint.cpp \
     logging/logvaluetool.cpp \
     time/timemanager.cpp \
     usermanager/userautorizer.cpp \
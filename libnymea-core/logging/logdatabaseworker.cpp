@@ -0,0 +1,151 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include "logdatabaseworker.h"
+#include "loggingcategories.h"
+
+#include <QSqlQuery>
+#include <QSqlError>
+#include <QSqlRecord>
+#include <QMutexLocker>
+
+namespace nymeaserver {
+
+LogDatabaseWorker::LogDatabaseWorker(const QString &connectionName, const QString &driver, const QString &dbName, const QString &hostname, const QString &username, const QString &password, bool readOnly, QObject *parent):
+    QThread(parent),
+    m_connectionName(connectionName),
+    m_driver(driver),
+    m_dbName(dbName),
+    m_hostname(hostname),
+    m_username(username),
+    m_password(password),
+    m_readOnly(readOnly)
+{
+    qRegisterMetaType<QList<DatabaseJob*>>();
+}
+
+LogDatabaseWorker::~LogDatabaseWorker()
+{
+    stop();
+}
+
+void LogDatabaseWorker::enqueue(const QList<DatabaseJob *> &jobs)
+{
+    QMutexLocker locker(&m_queueMutex);
+    m_queue.enqueue(jobs);
+    m_queueCondition.wakeOne();
+}
+
+void LogDatabaseWorker::stop()
+{
+    m_queueMutex.lock();
+    m_stopRequested = true;
+    m_queueCondition.wakeOne();
+    m_queueMutex.unlock();
+
+    wait();
+
+    m_queueMutex.lock();
+    m_stopRequested = false;
+    m_queueMutex.unlock();
+}
+
+void LogDatabaseWorker::run()
+{
+    // The connection is created and used exclusively in this thread as QSql connections can't be shared across threads
+    {
+        QSqlDatabase db = QSqlDatabase::addDatabase(m_driver, m_connectionName);
+        db.setDatabaseName(m_dbName);
+        db.setHostName(m_hostname);
+        if (m_readOnly && m_driver == "QSQLITE") {
+            db.setConnectOptions("QSQLITE_OPEN_READONLY");
+        }
+        if (!db.open(m_username, m_password)) {
+            qCWarning(dcLogEngine()) << "Error opening database connection" << m_connectionName << db.lastError().driverText() << db.lastError().databaseText();
+        }
+
+        forever {
+            QList<DatabaseJob*> jobs;
+            m_queueMutex.lock();
+            while (m_queue.isEmpty() && !m_stopRequested) {
+                m_queueCondition.wait(&m_queueMutex);
+            }
+            if (m_queue.isEmpty()) {
+                m_queueMutex.unlock();
+                break;
+            }
+            jobs = m_queue.dequeue();
+            m_queueMutex.unlock();
+
+            execute(db, jobs);
+            emit jobsFinished(jobs);
+        }
+
+        db.close();
+    }
+    QSqlDatabase::removeDatabase(m_connectionName);
+}
+
+void LogDatabaseWorker::execute(QSqlDatabase &db, const QList<DatabaseJob *> &jobs)
+{
+    // Multiple jobs are always batches sharing the same query, executed in a single transaction
+    bool transaction = jobs.count() > 1 && db.transaction();
+
+    QSqlQuery query(db);
+    query.prepare(jobs.first()->m_queryString);
+
+    foreach (DatabaseJob *job, jobs) {
+        for (int i = 0; i < job->m_bindValues.count(); i++) {
+            query.bindValue(i, job->m_bindValues.at(i));
+        }
+
+        query.exec();
+
+        job->m_error = query.lastError();
+        job->m_executedQuery = query.executedQuery();
+        job->m_rowsAffected = query.numRowsAffected();
+
+        if (!query.lastError().isValid()) {
+            while (query.next()) {
+                job->m_results.append(query.record());
+            }
+        }
+    }
+
+    if (transaction && !db.commit()) {
+        QSqlError error = db.lastError();
+        db.rollback();
+        foreach (DatabaseJob *job, jobs) {
+            job->m_error = error;
+        }
+    }
+}
+
+}
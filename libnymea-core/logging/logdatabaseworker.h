@@ -0,0 +1,79 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef LOGDATABASEWORKER_H
+#define LOGDATABASEWORKER_H
+
+#include "logengine.h"
+
+#include <QThread>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QQueue>
+#include <QSqlDatabase>
+
+namespace nymeaserver {
+
+class LogDatabaseWorker : public QThread
+{
+    Q_OBJECT
+public:
+    explicit LogDatabaseWorker(const QString &connectionName, const QString &driver, const QString &dbName, const QString &hostname, const QString &username, const QString &password, bool readOnly, QObject *parent = nullptr);
+    ~LogDatabaseWorker() override;
+
+    void enqueue(const QList<DatabaseJob*> &jobs);
+    void stop();
+
+signals:
+    void jobsFinished(const QList<DatabaseJob*> &jobs);
+
+protected:
+    void run() override;
+
+private:
+    void execute(QSqlDatabase &db, const QList<DatabaseJob*> &jobs);
+
+    QString m_connectionName;
+    QString m_driver;
+    QString m_dbName;
+    QString m_hostname;
+    QString m_username;
+    QString m_password;
+    bool m_readOnly = false;
+
+    QMutex m_queueMutex;
+    QWaitCondition m_queueCondition;
+    QQueue<QList<DatabaseJob*>> m_queue;
+    bool m_stopRequested = false;
+};
+
+}
+
+#endif // LOGDATABASEWORKER_H
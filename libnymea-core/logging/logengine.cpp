@@ -30,6 +30,7 @@
 
 #include "nymeasettings.h"
 #include "logengine.h"
+#include "logdatabaseworker.h"
 #include "loggingcategories.h"
 #include "logging.h"
 #include "logvaluetool.h"
@@ -46,20 +47,25 @@
 #include <QDateTime>
 #include <QFileInfo>
 #include <QTime>
-#include <QtConcurrent/QtConcurrent>
+#include <QEventLoop>
 
-#define DB_SCHEMA_VERSION 4
+#include <limits>
+
+#define DB_SCHEMA_VERSION 6
 
 namespace nymeaserver {
 
 // IMPORTANT:
-// DatabaseJobs run threaded, however, QSql is *not* threadsafe.
-// It is crucial to *not* access m_db while the job queue is being processed.
-// That is, entire setup of the DB must happen before processQueue() is called
-// and teardown must happen only after the job queue is empty.
+// DatabaseJobs are executed by the writer and reader worker threads, each using its own
+// connection, as QSql connections can't be shared across threads.
+// m_db is only used in the main thread for setup, migration and recovery. It is crucial
+// to *not* access m_db while the workers are running. That is, entire setup of the DB must
+// happen before the workers are started and teardown must happen only after they're stopped.
 
 LogEngine::LogEngine(const QString &driver, const QString &dbName, const QString &hostname, const QString &username, const QString &password, int maxDBSize, QObject *parent):
     QObject(parent),
+    m_driver(driver),
+    m_hostname(hostname),
     m_username(username),
     m_password(password),
     m_dbMaxSize(maxDBSize)
@@ -88,20 +94,39 @@ LogEngine::LogEngine(const QString &driver, const QString &dbName, const QString
         }
     }
 
-    connect(&m_jobWatcher, SIGNAL(finished()), this, SLOT(handleJobFinished()));
+    m_flushTimer.setSingleShot(true);
+    connect(&m_flushTimer, &QTimer::timeout, this, &LogEngine::flushBatch);
+
+    // Time based retention is applied on new entries, this catches idle periods
+    m_retentionTimer.setInterval(60 * 60 * 1000);
+    connect(&m_retentionTimer, &QTimer::timeout, this, &LogEngine::trim);
+
+    m_stateHistoryTimer.setInterval(60 * 1000);
+    connect(&m_stateHistoryTimer, &QTimer::timeout, this, &LogEngine::flushStateHistory);
+    m_stateHistoryTimer.start();
+
+    startWorkers();
     checkDBSize();
 }
 
 LogEngine::~LogEngine()
 {
+    // Don't hold back any pending batch while shutting down
+    m_flushInterval = 0;
+    m_flushTimer.stop();
+    flushStateHistory();
+    processQueue();
+
     // Process the job queue before allowing to shut down
-    while (m_currentJob) {
-        qCDebug(dcLogEngine()) << "Waiting for job to finish... (" << m_jobQueue.count() << "jobs left in queue)";
-        m_jobWatcher.waitForFinished();
-        // Make sure that the job queue is processes
-        // We can't call processQueue ourselves because thread synchronisation is done via queued connections
-        qApp->processEvents();
+    while (m_initialized && jobsRunning()) {
+        qCDebug(dcLogEngine()) << "Waiting for jobs to finish... (" << m_jobQueue.count() << "jobs left in queue)";
+        // Results are delivered via queued connections from the worker threads
+        qApp->processEvents(QEventLoop::WaitForMoreEvents);
     }
+    stopWorkers();
+    qDeleteAll(m_jobQueue);
+    qDeleteAll(m_readQueue);
+
     qCDebug(dcLogEngine()) << "Closing Database";
     m_db.close();
 }
@@ -116,27 +141,16 @@ void LogEngine::setThingManager(ThingManager *thingManager)
 
 LogEntriesFetchJob *LogEngine::fetchLogEntries(const LogFilter &filter)
 {
-    QList<LogEntry> results;
-
-    QString limitString;
-    if (filter.limit() >= 0) {
-        limitString.append(QString("LIMIT %1 ").arg(filter.limit()));
-    }
-    if (filter.offset() > 0) {
-        limitString.append(QString("OFFSET %1").arg(QString::number(filter.offset())));
-    }
-
-    QString queryString;
-    if (filter.isEmpty()) {
-        queryString = QString("SELECT * FROM entries ORDER BY timestamp DESC %1;").arg(limitString);
-    } else {
-        queryString = QString("SELECT * FROM entries WHERE %1 ORDER BY timestamp DESC %2;").arg(filter.queryString()).arg(limitString);
+    // The filter is applied to each partition, so its values need to be bound for each of them
+    QVariantList bindValues;
+    for (int i = 0; i < m_partitions.count(); i++) {
+        bindValues.append(filter.values());
     }
 
-    DatabaseJob *job = new DatabaseJob(m_db, queryString, filter.values());
+    DatabaseJob *job = new DatabaseJob(selectEntriesQuery(filter), bindValues);
     LogEntriesFetchJob *fetchJob = new LogEntriesFetchJob(this);
 
-    connect(job, &DatabaseJob::finished, this, [job, fetchJob](){
+    connect(job, &DatabaseJob::finished, this, [job, fetchJob, filter](){
         fetchJob->deleteLater();
         if (job->error().isValid()) {
             qCWarning(dcLogEngine) << "Error fetching log entries. Driver error:" << job->error().driverText() << "Database error:" << job->error().databaseText();
@@ -158,20 +172,30 @@ LogEntriesFetchJob *LogEngine::fetchLogEntries(const LogFilter &filter)
 
             fetchJob->m_results.append(entry);
         }
+
+        // A full page means there might be more entries
+        if (filter.limit() > 0 && job->results().count() == filter.limit()) {
+            const QSqlRecord &last = job->results().last();
+            fetchJob->m_nextCursor = LogFilter::createCursor(last.value("timestamp").toLongLong(), last.value("partitionId").toInt(), last.value("entryRowId").toLongLong());
+        }
         qCDebug(dcLogEngine) << "Fetched" << fetchJob->results().count() << "entries for db query:" << job->executedQuery();
         fetchJob->finished();
     });
 
-    enqueJob(job, true);
+    enqueReadJob(job);
 
     return fetchJob;
 }
 
 ThingsFetchJob *LogEngine::fetchThings()
 {
-    QString queryString = QString("SELECT thingId FROM entries WHERE thingId != \"%1\" GROUP BY thingId;").arg(QUuid().toString());
+    QStringList existsQueries;
+    foreach (const Partition &partition, m_partitions) {
+        existsQueries.append(QString("EXISTS (SELECT 1 FROM %1 WHERE %1.thingId = uuids.id)").arg(partition.table()));
+    }
+    QString queryString = QString("SELECT uuid AS thingId FROM uuids WHERE uuid != '%1' AND (%2);").arg(QUuid().toString()).arg(existsQueries.join(" OR "));
 
-    DatabaseJob *job = new DatabaseJob(m_db, queryString);
+    DatabaseJob *job = new DatabaseJob(queryString);
     ThingsFetchJob *fetchJob = new ThingsFetchJob(this);
     connect(job, &DatabaseJob::finished, this, [job, fetchJob](){
         fetchJob->deleteLater();
@@ -186,13 +210,59 @@ ThingsFetchJob *LogEngine::fetchThings()
         }
         fetchJob->finished();
     });
-    enqueJob(job, true);
+    enqueReadJob(job);
+    return fetchJob;
+}
+
+StateHistoryFetchJob *LogEngine::fetchStateHistory(const ThingId &thingId, const StateTypeId &stateTypeId, Logging::StateHistoryResolution resolution, const QDateTime &from, const QDateTime &to)
+{
+    // Pending values are written first and the query is run by the writer after them,
+    // so the result includes everything aggregated up to now without merging in memory.
+    flushStateHistory();
+
+    QString queryString = "SELECT startTime, minimum, maximum, sum, count, last FROM stateHistory "
+                          "WHERE thingId = (SELECT id FROM uuids WHERE uuid = ?) AND stateTypeId = (SELECT id FROM uuids WHERE uuid = ?) "
+                          "AND resolution = ? AND startTime >= ? AND startTime <= ? ORDER BY startTime;";
+    QVariantList bindValues;
+    bindValues.append(thingId.toString());
+    bindValues.append(stateTypeId.toString());
+    bindValues.append(resolution);
+    bindValues.append(from.isValid() ? StateAggregator::bucketStart(resolution, from.toMSecsSinceEpoch()) : 0);
+    bindValues.append(to.isValid() ? to.toMSecsSinceEpoch() : std::numeric_limits<qint64>::max());
+
+    DatabaseJob *job = new DatabaseJob(queryString, bindValues);
+    StateHistoryFetchJob *fetchJob = new StateHistoryFetchJob(this);
+    connect(job, &DatabaseJob::finished, this, [job, fetchJob](){
+        fetchJob->deleteLater();
+        if (job->error().type() != QSqlError::NoError) {
+            qCWarning(dcLogEngine()) << "Error fetching state history from log database:" << job->error().driverText() << job->error().databaseText();
+            fetchJob->finished();
+            return;
+        }
+
+        foreach (const QSqlRecord &result, job->results()) {
+            int count = result.value("count").toInt();
+            if (count == 0) {
+                continue;
+            }
+            fetchJob->m_results.append(StateHistoryPoint(
+                                           QDateTime::fromMSecsSinceEpoch(result.value("startTime").toLongLong()),
+                                           result.value("minimum").toDouble(),
+                                           result.value("maximum").toDouble(),
+                                           result.value("sum").toDouble() / count,
+                                           result.value("last").toDouble(),
+                                           count));
+        }
+        qCDebug(dcLogEngine) << "Fetched" << fetchJob->m_results.count() << "state history points for db query:" << job->executedQuery();
+        fetchJob->finished();
+    });
+    enqueJob(job);
     return fetchJob;
 }
 
 bool LogEngine::jobsRunning() const
 {
-    return !m_jobQueue.isEmpty() || m_currentJob;
+    return !m_jobQueue.isEmpty() || !m_readQueue.isEmpty() || !m_pendingDrops.isEmpty() || m_runningWriteBatches > 0 || m_runningReadJobs > 0;
 }
 
 void LogEngine::setMaxLogEntries(int maxLogEntries, int trimSize)
@@ -202,24 +272,67 @@ void LogEngine::setMaxLogEntries(int maxLogEntries, int trimSize)
     trim();
 }
 
-void LogEngine::clearDatabase()
+void LogEngine::setWriteBatching(int maxBatchSize, int flushInterval)
 {
-    qCWarning(dcLogEngine) << "Clearing logging database.";
+    // A batch size of 1 disables group commits, a flush interval of 0 only groups
+    // entries which have queued up while the previous job was running.
+    m_maxBatchSize = qMax(1, maxBatchSize);
+    m_flushInterval = qMax(0, flushInterval);
+    qCDebug(dcLogEngine()) << "Write batching: max batch size" << m_maxBatchSize << "flush interval" << m_flushInterval << "ms";
+    flushBatch();
+}
 
-    QString queryDeleteString = QString("DELETE FROM entries;");
+void LogEngine::setRetentionPolicy(int maxDays, bool partitionByDay)
+{
+    // With partitionByDay, a new partition is started every day in addition to when the current one is full.
+    // Retention by days drops whole partitions, so it implies daily partitions too.
+    m_maxDays = qMax(0, maxDays);
+    m_partitionByDay = partitionByDay;
+    qCDebug(dcLogEngine()) << "Log retention: max days" << m_maxDays << "partition by day" << m_partitionByDay;
+    if (m_maxDays > 0) {
+        m_retentionTimer.start();
+    } else {
+        m_retentionTimer.stop();
+    }
+    trim();
+}
 
-    DatabaseJob *job = new DatabaseJob(m_db, queryDeleteString);
+void LogEngine::clearDatabase()
+{
+    qCWarning(dcLogEngine) << "Clearing logging database.";
 
-    connect(job, &DatabaseJob::finished, this, [this, job](){
-        if (job->error().type() != QSqlError::NoError) {
-            qCWarning(dcLogEngine) << "Error clearing log database. Driver error:" << job->error().driverText() << "Database error:" << job->error().databaseText();
-            return;
+    m_stateAggregator.clear();
+    DatabaseJob *stateHistoryJob = new DatabaseJob("DELETE FROM stateHistory;");
+    connect(stateHistoryJob, &DatabaseJob::finished, this, [stateHistoryJob](){
+        if (stateHistoryJob->error().type() != QSqlError::NoError) {
+            qCWarning(dcLogEngine) << "Error clearing state history. Driver error:" << stateHistoryJob->error().driverText() << "Database error:" << stateHistoryJob->error().databaseText();
         }
-        m_entryCount = 0;
-        emit logDatabaseUpdated();
     });
+    enqueJob(stateHistoryJob);
 
-    enqueJob(job);
+    for (int i = 0; i < m_partitions.count(); i++) {
+        int partitionId = m_partitions.at(i).id;
+        bool last = i == m_partitions.count() - 1;
+        DatabaseJob *job = new DatabaseJob(QString("DELETE FROM %1;").arg(m_partitions.at(i).table()));
+
+        connect(job, &DatabaseJob::finished, this, [this, job, partitionId, last](){
+            if (job->error().type() != QSqlError::NoError) {
+                qCWarning(dcLogEngine) << "Error clearing log database. Driver error:" << job->error().driverText() << "Database error:" << job->error().databaseText();
+                return;
+            }
+            Partition *partition = findPartition(partitionId);
+            if (partition) {
+                partition->size -= partition->entryCount;
+                partition->entryCount = 0;
+            }
+            updateEntryCount();
+            if (last) {
+                emit logDatabaseUpdated();
+            }
+        });
+
+        enqueJob(job);
+    }
 }
 
 void LogEngine::logSystemEvent(const QDateTime &dateTime, bool active, Logging::LoggingLevel level)
@@ -264,6 +377,10 @@ void LogEngine::logStateChange(Thing *thing, const StateTypeId &stateTypeId, con
     entry.setThingId(thing->id());
     entry.setValue(value);
     appendLogEntry(entry);
+
+    if (m_initialized && StateAggregator::isNumeric(value)) {
+        m_stateAggregator.addValue(thing->id(), stateTypeId, entry.timestamp().toMSecsSinceEpoch(), value.toDouble());
+    }
 }
 
 void LogEngine::logAction(const Action &action, Thing::ThingError status)
@@ -350,48 +467,158 @@ void LogEngine::removeThingLogs(const ThingId &thingId)
 {
     qCDebug(dcLogEngine) << "Deleting log entries from device" << thingId.toString();
 
-    QString queryDeleteString = QString("DELETE FROM entries WHERE thingId = '%1';").arg(thingId.toString());
-
-    DatabaseJob *job = new DatabaseJob(m_db, queryDeleteString);
-    connect(job, &DatabaseJob::finished, this, [this, job, thingId](){
-        if (job->error().type() != QSqlError::NoError) {
-            qCWarning(dcLogEngine) << "Error deleting log entries from device" << thingId.toString() << ". Driver error:" << job->error().driverText() << "Database error:" << job->error().databaseText();
-            return;
+    m_stateAggregator.removeThing(thingId);
+    DatabaseJob *stateHistoryJob = new DatabaseJob("DELETE FROM stateHistory WHERE thingId = (SELECT id FROM uuids WHERE uuid = ?);", {thingId.toString()});
+    connect(stateHistoryJob, &DatabaseJob::finished, this, [stateHistoryJob, thingId](){
+        if (stateHistoryJob->error().type() != QSqlError::NoError) {
+            qCWarning(dcLogEngine) << "Error deleting state history from device" << thingId.toString() << ". Driver error:" << stateHistoryJob->error().driverText() << "Database error:" << stateHistoryJob->error().databaseText();
         }
-
-        emit logDatabaseUpdated();
-        checkDBSize();
     });
+    enqueJob(stateHistoryJob);
 
-    enqueJob(job);
+    for (int i = 0; i < m_partitions.count(); i++) {
+        int partitionId = m_partitions.at(i).id;
+        bool last = i == m_partitions.count() - 1;
+        QString queryDeleteString = QString("DELETE FROM %1 WHERE thingId = (SELECT id FROM uuids WHERE uuid = '%2');").arg(m_partitions.at(i).table()).arg(thingId.toString());
+
+        DatabaseJob *job = new DatabaseJob(queryDeleteString);
+        connect(job, &DatabaseJob::finished, this, [this, job, thingId, partitionId, last](){
+            if (job->error().type() != QSqlError::NoError) {
+                qCWarning(dcLogEngine) << "Error deleting log entries from device" << thingId.toString() << ". Driver error:" << job->error().driverText() << "Database error:" << job->error().databaseText();
+                return;
+            }
+
+            removedFromPartition(partitionId, job->rowsAffected());
+            if (last) {
+                emit logDatabaseUpdated();
+            }
+        });
+
+        enqueJob(job);
+    }
 }
 
 void LogEngine::removeRuleLogs(const RuleId &ruleId)
 {
     qCDebug(dcLogEngine) << "Deleting log entries from rule" << ruleId.toString();
 
-    QString queryDeleteString = QString("DELETE FROM entries WHERE typeId = '%1';").arg(ruleId.toString());
+    for (int i = 0; i < m_partitions.count(); i++) {
+        int partitionId = m_partitions.at(i).id;
+        bool last = i == m_partitions.count() - 1;
+        QString queryDeleteString = QString("DELETE FROM %1 WHERE typeId = (SELECT id FROM uuids WHERE uuid = '%2');").arg(m_partitions.at(i).table()).arg(ruleId.toString());
 
-    DatabaseJob *job = new DatabaseJob(m_db, queryDeleteString);
+        DatabaseJob *job = new DatabaseJob(queryDeleteString);
 
-    connect(job, &DatabaseJob::finished, this, [this, job, ruleId](){
+        connect(job, &DatabaseJob::finished, this, [this, job, ruleId, partitionId, last](){
 
-        if (job->error().type() != QSqlError::NoError) {
-            qCWarning(dcLogEngine) << "Error deleting log entries from rule" << ruleId.toString() << ". Driver error:" << job->error().driverText() << "Database error:" << job->error().databaseText();
-            return;
+            if (job->error().type() != QSqlError::NoError) {
+                qCWarning(dcLogEngine) << "Error deleting log entries from rule" << ruleId.toString() << ". Driver error:" << job->error().driverText() << "Database error:" << job->error().databaseText();
+                return;
+            }
+
+            removedFromPartition(partitionId, job->rowsAffected());
+            if (last) {
+                emit logDatabaseUpdated();
+            }
+        });
+
+        enqueJob(job);
+    }
+}
+
+QString LogEngine::selectEntriesQuery(const LogFilter &filter) const
+{
+    // Each partition is queried on its own so its indexes and the limit can be used there,
+    // the outer query merges the partitions and resolves the interned ids.
+    // Entries are ordered by (timestamp, partition, rowid), which is unique, so a cursor can
+    // continue right after the last entry of the previous page without skipping over the
+    // previous entries as the offset does.
+    int offset = filter.hasCursor() ? 0 : filter.offset();
+
+    QString partitionLimitString;
+    QString limitString;
+    if (filter.limit() >= 0) {
+        partitionLimitString = QString("LIMIT %1").arg(filter.limit() + offset);
+        limitString.append(QString("LIMIT %1 ").arg(filter.limit()));
+    }
+    if (offset > 0) {
+        if (filter.limit() < 0) {
+            limitString.append("LIMIT -1 ");
         }
+        limitString.append(QString("OFFSET %1").arg(QString::number(offset)));
+    }
 
-        emit logDatabaseUpdated();
-        checkDBSize();
-    });
+    QStringList partitionQueries;
+    for (int i = m_partitions.count() - 1; i >= 0; i--) {
+        const Partition &partition = m_partitions.at(i);
+        QStringList conditions;
+        if (!filter.isEmpty()) {
+            conditions.append(QString("(%1)").arg(filter.queryString()));
+        }
+        if (filter.hasCursor()) {
+            if (partition.id == filter.cursorPartitionId()) {
+                conditions.append(QString("(timestamp < %1 OR (timestamp = %1 AND rowid < %2))").arg(filter.cursorTimestamp()).arg(filter.cursorRowId()));
+            } else if (partition.id > filter.cursorPartitionId()) {
+                conditions.append(QString("timestamp < %1").arg(filter.cursorTimestamp()));
+            } else {
+                conditions.append(QString("timestamp <= %1").arg(filter.cursorTimestamp()));
+            }
+        }
+        QString whereString;
+        if (!conditions.isEmpty()) {
+            whereString = QString("WHERE %1").arg(conditions.join(" AND "));
+        }
+        partitionQueries.append(QString("SELECT * FROM (SELECT *, rowid AS entryRowId, %1 AS partitionId FROM %2 %3 ORDER BY timestamp DESC, rowid DESC %4)")
+                                .arg(QString::number(partition.id), partition.table(), whereString, partitionLimitString));
+    }
 
+    return QString("SELECT entries.timestamp AS timestamp, loggingLevel, sourceType, types.uuid AS typeId, things.uuid AS thingId, value, loggingEventType, active, errorCode, partitionId, entryRowId "
+                   "FROM (%1) AS entries "
+                   "LEFT JOIN uuids AS types ON entries.typeId = types.id "
+                   "LEFT JOIN uuids AS things ON entries.thingId = things.id "
+                   "ORDER BY timestamp DESC, partitionId DESC, entryRowId DESC %2;").arg(partitionQueries.join(" UNION ALL "), limitString);
+}
+
+void LogEngine::internUuid(const QUuid &uuid)
+{
+    // Thing and type ids are stored as integer keys into the uuids lookup table.
+    // New ones are added to the lookup table right before the entry referencing them.
+    if (m_internedUuids.contains(uuid)) {
+        return;
+    }
+    m_internedUuids.insert(uuid);
+    DatabaseJob *job = new DatabaseJob("INSERT OR IGNORE INTO uuids (uuid) VALUES (?);", {uuid.toString()});
+    connect(job, &DatabaseJob::finished, this, [this, job, uuid](){
+        if (job->error().type() != QSqlError::NoError) {
+            qCWarning(dcLogEngine) << "Error adding" << uuid.toString() << "to the uuid lookup table. Driver error:" << job->error().driverText() << "Database error:" << job->error().databaseText();
+            m_internedUuids.remove(uuid);
+        }
+    });
     enqueJob(job);
 }
 
 void LogEngine::appendLogEntry(const LogEntry &entry)
 {
     qCDebug(dcLogEngine()) << "Adding log entry:" << entry;
-    QString queryString = QString("INSERT INTO entries (timestamp, loggingEventType, loggingLevel, sourceType, typeId, thingId, value, active, errorCode) values (?, ?, ?, ?, ?, ?, ?, ?, ?);");
+    if (m_partitions.isEmpty()) {
+        qCDebug(dcLogEngine()) << "Log DB not initialized. Discarding log entry.";
+        return;
+    }
+
+    // Start a new partition if the current one is full or, if partitioned by day, a new day has begun
+    const Partition &current = m_partitions.last();
+    if (current.size >= partitionSize()
+            || (partitionByDay() && current.size > 0 && QDateTime::fromMSecsSinceEpoch(current.startTime).date() != entry.timestamp().date())) {
+        createPartition(entry.timestamp());
+    }
+    int partitionId = m_partitions.last().id;
+    m_partitions.last().size++;
+
+    internUuid(entry.typeId());
+    internUuid(entry.thingId());
+
+    QString queryString = QString("INSERT INTO %1 (timestamp, loggingEventType, loggingLevel, sourceType, typeId, thingId, value, active, errorCode) "
+                                  "values (?, ?, ?, ?, (SELECT id FROM uuids WHERE uuid = ?), (SELECT id FROM uuids WHERE uuid = ?), ?, ?, ?);").arg(m_partitions.last().table());
     QVariantList bindValues;
     bindValues.append(entry.timestamp().toMSecsSinceEpoch());
     bindValues.append(entry.eventType());
@@ -403,7 +630,7 @@ void LogEngine::appendLogEntry(const LogEntry &entry)
     bindValues.append(entry.active());
     bindValues.append(entry.errorCode());
 
-    DatabaseJob *job = new DatabaseJob(m_db, queryString, bindValues);
+    DatabaseJob *job = new DatabaseJob(queryString, bindValues, true);
 
     // Check for log flooding. If we are exceeding the queue we'll start flagging log events of a certain type.
     // If we'll get more log events of the same type while the queue is still exceededd, we'll discard the old
@@ -419,21 +646,33 @@ void LogEngine::appendLogEntry(const LogEntry &entry)
         if (m_flaggedJobs.contains(entry.typeId().toString() + entry.thingId().toString())) {
             if (m_flaggedJobs.value(entry.typeId().toString() + entry.thingId().toString()).count() > 10) {
                 qCWarning(dcLogEngine()) << "Discarding log entry because of excessive log flooding.";
-                DatabaseJob *job = m_flaggedJobs[entry.typeId().toString() + entry.thingId().toString()].takeFirst();
-                int jobIdx = m_jobQueue.indexOf(job);
-                m_jobQueue.takeAt(jobIdx)->deleteLater();
+                QPair<DatabaseJob*, int> flaggedJob = m_flaggedJobs[entry.typeId().toString() + entry.thingId().toString()].takeFirst();
+                int jobIdx = m_jobQueue.indexOf(flaggedJob.first);
+                // The job might be part of the batch which is currently being written
+                if (jobIdx >= 0) {
+                    m_jobQueue.takeAt(jobIdx)->deleteLater();
+                    // The discarded entry has been counted in its partition already
+                    Partition *partition = findPartition(flaggedJob.second);
+                    if (partition) {
+                        partition->size--;
+                    }
+                }
             }
         }
-        m_flaggedJobs[entry.typeId().toString() + entry.thingId().toString()].append(job);
+        m_flaggedJobs[entry.typeId().toString() + entry.thingId().toString()].append(qMakePair(job, partitionId));
     }
 
-    connect(job, &DatabaseJob::finished, this, [this, job, entry](){
+    connect(job, &DatabaseJob::finished, this, [this, job, entry, partitionId](){
 
-        m_flaggedJobs[entry.typeId().toString() + entry.thingId().toString()].removeAll(job);
+        m_flaggedJobs[entry.typeId().toString() + entry.thingId().toString()].removeAll(qMakePair(job, partitionId));
 
+        Partition *partition = findPartition(partitionId);
         if (job->error().type() != QSqlError::NoError) {
             qCWarning(dcLogEngine) << "Error writing log entry. Driver error:" << job->error().driverText() << "Database error:" << job->error().databaseText();
             qCWarning(dcLogEngine) << entry;
+            if (partition) {
+                partition->size--;
+            }
             m_dbMalformed = true;
             return;
         }
@@ -441,7 +680,11 @@ void LogEngine::appendLogEntry(const LogEntry &entry)
 
         emit logEntryAdded(entry);
 
-        m_entryCount++;
+        // The partition might have been dropped by the retention in the meantime
+        if (partition) {
+            partition->entryCount++;
+            m_entryCount++;
+        }
         trim();
     });
 
@@ -450,42 +693,220 @@ void LogEngine::appendLogEntry(const LogEntry &entry)
 
 void LogEngine::checkDBSize()
 {
-    DatabaseJob *job = new DatabaseJob(m_db, "SELECT COUNT(*) FROM entries;");
-    connect(job, &DatabaseJob::finished, this, [this, job](){
-        if (job->error().type() != QSqlError::NoError || job->results().count() == 0) {
-            qCWarning(dcLogEngine()) << "Error fetching log DB size. Driver error:" << job->error().driverText() << "Database error:" << job->error().databaseText();
-            m_entryCount = 0;
-            return;
-        }
-        m_entryCount = job->results().first().value(0).toInt();
-    });
-    enqueJob(job, true);
+    // Only needed at startup, afterwards the partition sizes are tracked. The count jobs are run by the
+    // writer in front of any queued inserts, so entries finishing afterwards can be counted on top.
+    foreach (const Partition &partition, m_partitions) {
+        int partitionId = partition.id;
+        DatabaseJob *job = new DatabaseJob(QString("SELECT COUNT(*) FROM %1;").arg(partition.table()));
+        connect(job, &DatabaseJob::finished, this, [this, job, partitionId](){
+            Partition *partition = findPartition(partitionId);
+            if (!partition) {
+                return;
+            }
+            if (job->error().type() != QSqlError::NoError || job->results().count() == 0) {
+                qCWarning(dcLogEngine()) << "Error fetching log DB size. Driver error:" << job->error().driverText() << "Database error:" << job->error().databaseText();
+                return;
+            }
+            int count = job->results().first().value(0).toInt();
+            partition->size += count - partition->entryCount;
+            partition->entryCount = count;
+            updateEntryCount();
+            trim();
+        });
+        enqueJob(job, true);
+    }
 }
 
 void LogEngine::trim()
 {
-    if (m_dbMaxSize == -1 || m_entryCount < m_dbMaxSize) {
-        // No trimming required
+    if (m_partitions.isEmpty()) {
+        return;
+    }
+
+    // When idle, the current partition isn't rolled over by new entries. Start a new one so the
+    // old entries can expire. createPartition() trims again.
+    const Partition &current = m_partitions.last();
+    if (m_maxDays > 0 && current.size > 0 && QDateTime::fromMSecsSinceEpoch(current.startTime).date() != QDate::currentDate()) {
+        createPartition(QDateTime::currentDateTime());
+        return;
+    }
+
+    // Retention drops whole partitions, oldest first. The current partition is never dropped.
+    qint64 minTime = m_maxDays > 0 ? QDateTime::currentDateTime().addDays(-m_maxDays).toMSecsSinceEpoch() : 0;
+    while (m_partitions.count() > 1) {
+        bool tooManyEntries = m_dbMaxSize >= 0 && m_entryCount > m_dbMaxSize;
+        // A partition holds entries until the next one is started
+        bool tooOld = m_partitions.at(1).startTime < minTime;
+        if (!tooManyEntries && !tooOld) {
+            break;
+        }
+        dropPartition(m_partitions.takeFirst());
+        updateEntryCount();
+    }
+}
+
+void LogEngine::flushStateHistory()
+{
+    if (!m_initialized || !m_stateAggregator.hasPending()) {
         return;
     }
-    QDateTime startTime = QDateTime::currentDateTime();
 
-    QString queryDeleteString = QString("DELETE FROM entries WHERE ROWID IN (SELECT ROWID FROM entries ORDER BY timestamp DESC LIMIT -1 OFFSET %1);").arg(QString::number(m_dbMaxSize - m_trimSize));
+    // Each pending bucket is merged into its stored counterpart. The inserts and the updates
+    // are queued in two runs of the same statement so they're written in batches.
+    QList<StateAggregator::Bucket> buckets = m_stateAggregator.takePending();
+    qCDebug(dcLogEngine()) << "Writing" << buckets.count() << "state history buckets";
+
+    QList<DatabaseJob*> insertJobs;
+    QList<DatabaseJob*> updateJobs;
+    foreach (const StateAggregator::Bucket &bucket, buckets) {
+        internUuid(bucket.thingId);
+        internUuid(bucket.stateTypeId);
+
+        QVariantList bindValues;
+        bindValues.append(bucket.thingId.toString());
+        bindValues.append(bucket.stateTypeId.toString());
+        bindValues.append(bucket.resolution);
+        bindValues.append(bucket.startTime);
+        bindValues.append(bucket.minimum);
+        bindValues.append(bucket.maximum);
+        bindValues.append(bucket.last);
+        insertJobs.append(new DatabaseJob("INSERT OR IGNORE INTO stateHistory (thingId, stateTypeId, resolution, startTime, minimum, maximum, sum, count, last) "
+                                 "VALUES ((SELECT id FROM uuids WHERE uuid = ?), (SELECT id FROM uuids WHERE uuid = ?), ?, ?, ?, ?, 0, 0, ?);", bindValues, true));
+
+        bindValues.clear();
+        bindValues.append(bucket.minimum);
+        bindValues.append(bucket.maximum);
+        bindValues.append(bucket.sum);
+        bindValues.append(bucket.count);
+        bindValues.append(bucket.last);
+        bindValues.append(bucket.thingId.toString());
+        bindValues.append(bucket.stateTypeId.toString());
+        bindValues.append(bucket.resolution);
+        bindValues.append(bucket.startTime);
+        DatabaseJob *job = new DatabaseJob("UPDATE stateHistory SET minimum = MIN(minimum, ?), maximum = MAX(maximum, ?), sum = sum + ?, count = count + ?, last = ? "
+                                           "WHERE thingId = (SELECT id FROM uuids WHERE uuid = ?) AND stateTypeId = (SELECT id FROM uuids WHERE uuid = ?) AND resolution = ? AND startTime = ?;", bindValues, true);
+        connect(job, &DatabaseJob::finished, this, [job](){
+            if (job->error().type() != QSqlError::NoError) {
+                qCWarning(dcLogEngine) << "Error writing state history. Driver error:" << job->error().driverText() << "Database error:" << job->error().databaseText();
+            }
+        });
+        updateJobs.append(job);
+    }
+    m_jobQueue.append(insertJobs);
+    m_jobQueue.append(updateJobs);
+
+    // Fine grained buckets are only kept for a limited time
+    qint64 now = QDateTime::currentMSecsSinceEpoch();
+    foreach (Logging::StateHistoryResolution resolution, StateAggregator::resolutions()) {
+        qint64 retention = StateAggregator::retention(resolution);
+        if (retention > 0) {
+            m_jobQueue.append(new DatabaseJob("DELETE FROM stateHistory WHERE resolution = ? AND startTime < ?;", {resolution, now - retention}));
+        }
+    }
+    processQueue();
+}
 
-    DatabaseJob *deleteJob = new DatabaseJob(m_db, queryDeleteString);
+bool LogEngine::partitionByDay() const
+{
+    return m_partitionByDay || m_maxDays > 0;
+}
+
+int LogEngine::partitionSize() const
+{
+    // Partitions are sized by the trim size, but hold at least 1/10th of the maximum entries
+    // to not spread queries over too many tables.
+    if (m_dbMaxSize < 0) {
+        return qMax(m_trimSize, 10000);
+    }
+    return qMax(1, qMax(m_trimSize, m_dbMaxSize / 10));
+}
 
-    connect(deleteJob, &DatabaseJob::finished, this, [this, deleteJob, startTime](){
-        if (deleteJob->error().type() != QSqlError::NoError) {
-            qCWarning(dcLogEngine) << "Error deleting oldest log entries to keep size. Driver error:" << deleteJob->error().driverText() << "Database error:" << deleteJob->error().databaseText();
+LogEngine::Partition *LogEngine::findPartition(int partitionId)
+{
+    for (int i = 0; i < m_partitions.count(); i++) {
+        if (m_partitions.at(i).id == partitionId) {
+            return &m_partitions[i];
         }
-        qCDebug(dcLogEngine()) << "Ran housekeeping on log database in" << startTime.msecsTo(QDateTime::currentDateTime()) << "ms. (Deleted" << m_entryCount - (m_dbMaxSize - m_trimSize) << "entries)";
-        m_entryCount = m_dbMaxSize - m_trimSize;
+    }
+    return nullptr;
+}
 
-        emit logDatabaseUpdated();
-    });
+void LogEngine::removedFromPartition(int partitionId, int count)
+{
+    Partition *partition = findPartition(partitionId);
+    if (!partition || count <= 0) {
+        return;
+    }
+    partition->entryCount = qMax(0, partition->entryCount - count);
+    partition->size = qMax(0, partition->size - count);
+    updateEntryCount();
+}
+
+void LogEngine::updateEntryCount()
+{
+    m_entryCount = 0;
+    foreach (const Partition &partition, m_partitions) {
+        m_entryCount += partition.entryCount;
+    }
+}
 
-    qCDebug(dcLogEngine()) << "Scheduling housekeeping job.";
-    enqueJob(deleteJob, true);
+QStringList LogEngine::partitionSchema(int partitionId) const
+{
+    QString table = QString("entries_%1").arg(partitionId);
+    QStringList statements;
+    statements.append(QString("CREATE TABLE %1 "
+                              "("
+                              "timestamp BIGINT,"
+                              "loggingLevel INT,"
+                              "sourceType INT,"
+                              "typeId INTEGER,"
+                              "thingId INTEGER,"
+                              "value VARCHAR(100),"
+                              "loggingEventType INT,"
+                              "active BOOL,"
+                              "errorCode INT,"
+                              "FOREIGN KEY(sourceType) REFERENCES sourceTypes(id),"
+                              "FOREIGN KEY(loggingEventType) REFERENCES loggingEventTypes(id),"
+                              "FOREIGN KEY(typeId) REFERENCES uuids(id),"
+                              "FOREIGN KEY(thingId) REFERENCES uuids(id)"
+                              ");").arg(table));
+    // Covering the common filters (thing, type, thing + type) ordered by time, and plain time ordering
+    statements.append(QString("CREATE INDEX %1_thing_type_timestamp ON %1 (thingId, typeId, timestamp);").arg(table));
+    statements.append(QString("CREATE INDEX %1_timestamp ON %1 (timestamp);").arg(table));
+    return statements;
+}
+
+void LogEngine::createPartition(const QDateTime &startTime)
+{
+    Partition partition;
+    partition.id = m_partitions.isEmpty() ? 1 : m_partitions.last().id + 1;
+    partition.startTime = startTime.toMSecsSinceEpoch();
+    qCDebug(dcLogEngine()) << "Starting new log partition" << partition.table();
+
+    QStringList statements = partitionSchema(partition.id);
+    statements.append(QString("INSERT INTO partitions (id, startTime) VALUES (%1, %2);").arg(partition.id).arg(partition.startTime));
+    foreach (const QString &statement, statements) {
+        DatabaseJob *job = new DatabaseJob(statement);
+        connect(job, &DatabaseJob::finished, this, [this, job](){
+            if (job->error().type() != QSqlError::NoError) {
+                qCWarning(dcLogEngine) << "Error creating log partition. Driver error:" << job->error().driverText() << "Database error:" << job->error().databaseText();
+                m_dbMalformed = true;
+            }
+        });
+        enqueJob(job);
+    }
+
+    m_partitions.append(partition);
+    trim();
+}
+
+void LogEngine::dropPartition(const Partition &partition)
+{
+    qCDebug(dcLogEngine()) << "Dropping log partition" << partition.table() << "(" << partition.entryCount << "entries)";
+    // Queries using this partition might still be running on the reader, the drop is
+    // queued by processQueue() once they're done.
+    m_pendingDrops.append(partition.id);
+    processQueue();
 }
 
 void LogEngine::enqueJob(DatabaseJob *job, bool priority)
@@ -499,72 +920,163 @@ void LogEngine::enqueJob(DatabaseJob *job, bool priority)
     processQueue();
 }
 
+void LogEngine::enqueReadJob(DatabaseJob *job)
+{
+    m_readQueue.append(job);
+    processQueue();
+}
+
 void LogEngine::processQueue()
 {
     if (!m_initialized) {
         return;
     }
 
-    if (m_jobQueue.isEmpty()) {
-        emit jobsRunningChanged();
-        return;
-    }
-
-    if (m_currentJob) {
-        return;
-    }
-
-    emit jobsRunningChanged();
-
     if (m_dbMalformed) {
+        if (m_runningWriteBatches > 0 || m_runningReadJobs > 0) {
+            // The workers need to be idle before the database file can be replaced
+            return;
+        }
         qCWarning(dcLogEngine()) << "Database is malformed. Trying to recover...";
+        stopWorkers();
         m_db.close();
         rotate(m_db.databaseName());
-        initDB(m_username, m_password);
+        discardQueuedJobs();
         m_dbMalformed = false;
+        if (!initDB(m_username, m_password)) {
+            qCWarning(dcLogEngine()) << "Error recovering log database. Logs can't be stored.";
+            return;
+        }
+        startWorkers();
     }
 
+    // Reads don't depend on each other and run in parallel to the writes on the read-only connection
+    while (!m_readQueue.isEmpty()) {
+        m_runningReadJobs++;
+        m_reader->enqueue({m_readQueue.takeFirst()});
+    }
 
-    DatabaseJob *job = m_jobQueue.takeFirst();
-    qCDebug(dcLogEngine()) << "Processing DB queue. (" << m_jobQueue.count() << "jobs left in queue," << m_entryCount << "entries in DB)";
-    m_currentJob = job;
-
-    QFuture<DatabaseJob*> future = QtConcurrent::run([job](){
-        QSqlQuery query(job->m_db);
-        query.prepare(job->m_queryString);
-
-        foreach (const QVariant &value, job->m_bindValues) {
-            query.addBindValue(value);
+    // Partitions are dropped once no read is running anymore which might still use them.
+    // Appending keeps them behind any inserts still queued for those partitions.
+    if (!m_pendingDrops.isEmpty() && m_runningReadJobs == 0) {
+        foreach (int partitionId, m_pendingDrops) {
+            DatabaseJob *dropJob = new DatabaseJob(QString("DROP TABLE entries_%1;").arg(partitionId));
+            connect(dropJob, &DatabaseJob::finished, this, [this, dropJob](){
+                if (dropJob->error().type() != QSqlError::NoError) {
+                    qCWarning(dcLogEngine) << "Error dropping log partition. Driver error:" << dropJob->error().driverText() << "Database error:" << dropJob->error().databaseText();
+                }
+                emit logDatabaseUpdated();
+            });
+            m_jobQueue.append(dropJob);
+            m_jobQueue.append(new DatabaseJob(QString("DELETE FROM partitions WHERE id = %1;").arg(partitionId)));
         }
+        m_pendingDrops.clear();
+    }
 
-        query.exec();
-
-        job->m_error = query.lastError();
-        job->m_executedQuery = query.executedQuery();
+    // Keep up to 2 batches queued in the writer so it can start with the next one right away
+    while (!m_jobQueue.isEmpty() && m_runningWriteBatches < 2) {
+
+        // Collect consecutive batchable jobs at the head of the queue. They share the same query
+        // and are written in one go using a single prepared statement and a single transaction.
+        int batchSize = 1;
+        if (m_jobQueue.first()->m_batchable) {
+            while (batchSize < m_jobQueue.count() && batchSize < m_maxBatchSize
+                   && m_jobQueue.at(batchSize)->m_batchable
+                   && m_jobQueue.at(batchSize)->m_queryString == m_jobQueue.first()->m_queryString) {
+                batchSize++;
+            }
 
-        if (!query.lastError().isValid()) {
-            while (query.next()) {
-                job->m_results.append(query.record());
+            // Wait for more entries to queue up unless the batch is full already or the flush interval has passed
+            if (batchSize < m_maxBatchSize && m_flushInterval > 0 && !m_flushDue) {
+                if (!m_flushTimer.isActive()) {
+                    m_flushTimer.start(m_flushInterval);
+                }
+                break;
             }
         }
+        m_flushTimer.stop();
+        m_flushDue = false;
+
+        QList<DatabaseJob*> jobs = m_jobQueue.mid(0, batchSize);
+        m_jobQueue.erase(m_jobQueue.begin(), m_jobQueue.begin() + batchSize);
+        qCDebug(dcLogEngine()) << "Processing DB queue. (" << jobs.count() << "jobs in this batch," << m_jobQueue.count() << "jobs left in queue," << m_entryCount << "entries in DB)";
+        m_runningWriteBatches++;
+        m_writer->enqueue(jobs);
+    }
 
-       return job;
-    });
+    if (m_jobQueue.isEmpty()) {
+        m_flushDue = false;
+    }
 
-    m_jobWatcher.setFuture(future);
+    emit jobsRunningChanged();
 }
 
-void LogEngine::handleJobFinished()
+void LogEngine::discardQueuedJobs()
 {
-    DatabaseJob *job = m_jobWatcher.result();
-    job->finished();
-    job->deleteLater();
-    m_currentJob = nullptr;
+    // Queued writes refer to partitions of the replaced database which don't exist anymore in the new one
+    if (!m_jobQueue.isEmpty()) {
+        qCWarning(dcLogEngine()) << "Discarding" << m_jobQueue.count() << "queued jobs for the replaced log database.";
+    }
+    qDeleteAll(m_jobQueue);
+    m_jobQueue.clear();
+    m_flaggedJobs.clear();
+    m_pendingDrops.clear();
+    m_flushTimer.stop();
+    m_flushDue = false;
+}
 
-    qCDebug(dcLogEngine()) << "DB job finished. (" << m_entryCount << "entries in DB)";
+void LogEngine::flushBatch()
+{
+    m_flushDue = true;
     processQueue();
 }
 
+void LogEngine::handleJobsFinished(const QList<DatabaseJob *> &jobs)
+{
+    if (sender() == m_reader) {
+        m_runningReadJobs -= jobs.count();
+    } else {
+        m_runningWriteBatches--;
+    }
+
+    foreach (DatabaseJob *job, jobs) {
+        job->finished();
+        job->deleteLater();
+    }
+
+    qCDebug(dcLogEngine()) << "DB batch of" << jobs.count() << "jobs finished. (" << m_entryCount << "entries in DB)";
+    processQueue();
+}
+
+void LogEngine::startWorkers()
+{
+    if (!m_initialized) {
+        return;
+    }
+
+    m_writer = new LogDatabaseWorker("logs-writer", m_driver, m_db.databaseName(), m_hostname, m_username, m_password, false, this);
+    connect(m_writer, &LogDatabaseWorker::jobsFinished, this, &LogEngine::handleJobsFinished, Qt::QueuedConnection);
+    m_writer->start();
+
+    m_reader = new LogDatabaseWorker("logs-reader", m_driver, m_db.databaseName(), m_hostname, m_username, m_password, true, this);
+    connect(m_reader, &LogDatabaseWorker::jobsFinished, this, &LogEngine::handleJobsFinished, Qt::QueuedConnection);
+    m_reader->start();
+}
+
+void LogEngine::stopWorkers()
+{
+    if (m_writer) {
+        m_writer->stop();
+        delete m_writer;
+        m_writer = nullptr;
+    }
+    if (m_reader) {
+        m_reader->stop();
+        delete m_reader;
+        m_reader = nullptr;
+    }
+}
+
 void LogEngine::rotate(const QString &dbName)
 {
     int index = 1;
@@ -611,8 +1123,8 @@ bool LogEngine::migrateDatabaseVersion3to4()
     }
     qCDebug(dcLogEngine()) << "Created new entries table:" << m_db.lastError().text();
 
-    qCDebug(dcLogEngine()) << "Updating database version to" << DB_SCHEMA_VERSION;
-    m_db.exec(QString("UPDATE metadata SET data = %1 WHERE `key` = 'version';").arg(DB_SCHEMA_VERSION));
+    qCDebug(dcLogEngine()) << "Updating database version to 4";
+    m_db.exec("UPDATE metadata SET data = 4 WHERE `key` = 'version';");
     if (m_db.lastError().isValid()) {
         qCWarning(dcLogEngine) << "Error updating database verion 3 -> 4. Driver error:" << m_db.lastError().driverText() << "Database error:" << m_db.lastError().databaseText();
         return false;
@@ -628,7 +1140,7 @@ void LogEngine::migrateEntries3to4()
 {
     QString selectQuery = QString("SELECT * FROM _entries_v3;");
 
-    DatabaseJob *job = new DatabaseJob(m_db, selectQuery);
+    DatabaseJob *job = new DatabaseJob(selectQuery);
 
     connect(job, &DatabaseJob::finished, this, [this, job](){
 
@@ -650,7 +1162,13 @@ void LogEngine::migrateEntries3to4()
         QString encodedValue = result.value("value").toByteArray();
         QString decodedValue = LogValueTool::convertVariantToString(LogValueTool::deserializeValue(encodedValue));
 
-        QString insertCall = QString("INSERT INTO entries (timestamp, loggingEventType, loggingLevel, sourceType, typeId, thingId, value, active, errorCode) values ('%1', '%2', '%3', '%4', '%5', '%6', '%7', '%8', '%9');")
+        // The entries are inserted into the current partition, so thing and type ids need to be interned
+        internUuid(result.value("typeId").toUuid());
+        internUuid(result.value("deviceId").toUuid());
+        int partitionId = m_partitions.last().id;
+        m_partitions.last().size++;
+
+        QString insertCall = QString("INSERT INTO " + m_partitions.last().table() + " (timestamp, loggingEventType, loggingLevel, sourceType, typeId, thingId, value, active, errorCode) values ('%1', '%2', '%3', '%4', (SELECT id FROM uuids WHERE uuid = '%5'), (SELECT id FROM uuids WHERE uuid = '%6'), '%7', '%8', '%9');")
                 .arg(result.value("timestamp").toLongLong() * 1000)
                 .arg(result.value("loggingEventType").toInt())
                 .arg(result.value("loggingLevel").toInt())
@@ -661,13 +1179,18 @@ void LogEngine::migrateEntries3to4()
                 .arg(result.value("active").toBool())
                 .arg(result.value("errorCode").toInt());
 
-        DatabaseJob *insertJob = new DatabaseJob(m_db, insertCall);
-        connect(insertJob, &DatabaseJob::finished, this, [this, insertJob, count, result](){
+        DatabaseJob *insertJob = new DatabaseJob(insertCall);
+        connect(insertJob, &DatabaseJob::finished, this, [this, insertJob, count, result, partitionId](){
             if (insertJob->error().type() != QSqlError::NoError) {
                 qCWarning(dcLogEngine) << "Error fetching entries to migrate. Driver error:" << insertJob->error().driverText() << "Database error:" << insertJob->error().databaseText();
                 m_dbMalformed = true;
                 return;
             }
+            Partition *partition = findPartition(partitionId);
+            if (partition) {
+                partition->entryCount++;
+                updateEntryCount();
+            }
 
             QString deleteCall = QString("DELETE FROM _entries_v3 WHERE timestamp = '%1' AND loggingEventType = '%2' AND loggingLevel = '%3' AND sourceType = '%4' AND typeId = '%5' AND deviceId = '%6' AND value = '%7' AND active = '%8' AND errorCode = '%9';")
                     .arg(result.value("timestamp").toLongLong())
@@ -680,7 +1203,7 @@ void LogEngine::migrateEntries3to4()
                     .arg(result.value("active").toBool())
                     .arg(result.value("errorCode").toInt());
 
-            DatabaseJob *deleteJob = new DatabaseJob(m_db, deleteCall);
+            DatabaseJob *deleteJob = new DatabaseJob(deleteCall);
             connect(deleteJob, &DatabaseJob::finished, this, [this, deleteJob, count, result](){
                 if (deleteJob->error().type() != QSqlError::NoError) {
                     qCWarning(dcLogEngine) << "Error deleting old entry during migration. Driver error:" << deleteJob->error().driverText() << "Database error:" << deleteJob->error().databaseText();
@@ -706,7 +1229,7 @@ void LogEngine::finalizeMigration3To4()
 {
     qCDebug(dcLogEngine()) << "Finalizing migration of database version 3 to 4.";
     QString selectQuery = QString("DROP TABLE _entries_v3;");
-    DatabaseJob *job = new DatabaseJob(m_db, selectQuery);
+    DatabaseJob *job = new DatabaseJob(selectQuery);
     enqueJob(job);
     connect(job, &DatabaseJob::finished, this, [job](){
 
@@ -717,6 +1240,169 @@ void LogEngine::finalizeMigration3To4()
     });
 }
 
+bool LogEngine::migrateDatabaseVersion4to5()
+{
+    // The new tables are created by initDB, entries are moved over in the background by migrateEntries4to5()
+    m_db.exec("ALTER TABLE entries RENAME TO _entries_v4;");
+    if (m_db.lastError().isValid()) {
+        qCWarning(dcLogEngine) << "Error migrating database verion 4 -> 5 (renaming table). Driver error:" << m_db.lastError().driverText() << "Database error:" << m_db.lastError().databaseText();
+        return false;
+    }
+    qCDebug(dcLogEngine()) << "Renamed entries table to _entries_v4";
+
+    qCDebug(dcLogEngine()) << "Updating database version to 5";
+    m_db.exec("UPDATE metadata SET data = 5 WHERE `key` = 'version';");
+    if (m_db.lastError().isValid()) {
+        qCWarning(dcLogEngine) << "Error updating database verion 4 -> 5. Driver error:" << m_db.lastError().driverText() << "Database error:" << m_db.lastError().databaseText();
+        return false;
+    }
+
+    qCDebug(dcLogEngine()) << "Migrated database schema from version 4 to 5.";
+    return true;
+}
+
+void LogEngine::migrateEntries4to5()
+{
+    // Entries are moved in chunks of consecutive rows to not block the queue for too long
+    DatabaseJob *job = new DatabaseJob("SELECT MIN(ROWID) FROM _entries_v4;");
+
+    connect(job, &DatabaseJob::finished, this, [this, job](){
+        if (job->error().type() != QSqlError::NoError) {
+            qCWarning(dcLogEngine) << "Error fetching entries to migrate. Driver error:" << job->error().driverText() << "Database error:" << job->error().databaseText();
+            m_dbMalformed = true;
+            return;
+        }
+
+        if (job->results().isEmpty() || job->results().first().value(0).isNull()) {
+            qCDebug(dcLogEngine()) << "No items to migrate from schema 4 to 5 remaining.";
+            finalizeMigration4To5();
+            return;
+        }
+
+        qlonglong first = job->results().first().value(0).toLongLong();
+        QString range = QString("ROWID BETWEEN %1 AND %2").arg(first).arg(first + 999);
+
+        DatabaseJob *internJob = new DatabaseJob(QString("INSERT OR IGNORE INTO uuids (uuid) SELECT typeId FROM _entries_v4 WHERE %1 UNION SELECT thingId FROM _entries_v4 WHERE %1;").arg(range));
+        connect(internJob, &DatabaseJob::finished, this, [this, internJob, range](){
+            if (internJob->error().type() != QSqlError::NoError) {
+                qCWarning(dcLogEngine) << "Error interning ids during migration. Driver error:" << internJob->error().driverText() << "Database error:" << internJob->error().databaseText();
+                m_dbMalformed = true;
+                return;
+            }
+
+            Partition *migrationPartition = findPartition(m_migrationPartitionId);
+            if (!migrationPartition || migrationPartition->id == m_partitions.last().id) {
+                // The remaining entries are older than the ones already dropped by the retention
+                qCDebug(dcLogEngine()) << "The partition for migrated entries has been dropped. Discarding the remaining entries of schema 4.";
+                finalizeMigration4To5();
+                return;
+            }
+            int partitionId = migrationPartition->id;
+            DatabaseJob *copyJob = new DatabaseJob(QString("INSERT INTO %1 (timestamp, loggingEventType, loggingLevel, sourceType, typeId, thingId, value, active, errorCode) "
+                                                           "SELECT timestamp, loggingEventType, loggingLevel, sourceType, "
+                                                           "(SELECT id FROM uuids WHERE uuid = _entries_v4.typeId), (SELECT id FROM uuids WHERE uuid = _entries_v4.thingId), "
+                                                           "value, active, errorCode FROM _entries_v4 WHERE %2;").arg(migrationPartition->table(), range));
+            connect(copyJob, &DatabaseJob::finished, this, [this, copyJob, range, partitionId](){
+                if (copyJob->error().type() != QSqlError::NoError) {
+                    qCWarning(dcLogEngine) << "Error copying entries during migration. Driver error:" << copyJob->error().driverText() << "Database error:" << copyJob->error().databaseText();
+                    m_dbMalformed = true;
+                    return;
+                }
+                Partition *partition = findPartition(partitionId);
+                if (partition) {
+                    partition->entryCount += copyJob->rowsAffected();
+                    partition->size += copyJob->rowsAffected();
+                    updateEntryCount();
+                }
+
+                DatabaseJob *deleteJob = new DatabaseJob(QString("DELETE FROM _entries_v4 WHERE %1;").arg(range));
+                connect(deleteJob, &DatabaseJob::finished, this, [this, deleteJob, range](){
+                    if (deleteJob->error().type() != QSqlError::NoError) {
+                        qCWarning(dcLogEngine) << "Error deleting old entries during migration. Driver error:" << deleteJob->error().driverText() << "Database error:" << deleteJob->error().databaseText();
+                        finalizeMigration4To5();
+                        return;
+                    }
+                    qCDebug(dcLogEngine()) << "Migrated log entries" << range << "from version 4 to 5.";
+                    trim();
+                    migrateEntries4to5();
+                });
+                enqueJob(deleteJob);
+            });
+            enqueJob(copyJob);
+        });
+        enqueJob(internJob);
+    });
+    enqueJob(job);
+}
+
+void LogEngine::finalizeMigration4To5()
+{
+    qCDebug(dcLogEngine()) << "Finalizing migration of database version 4 to 5.";
+    DatabaseJob *job = new DatabaseJob("DROP TABLE _entries_v4;");
+    connect(job, &DatabaseJob::finished, this, [this, job](){
+        if (job->error().type() != QSqlError::NoError) {
+            qCWarning(dcLogEngine) << "Error finalizing migration from 4 to 5 (drop _entries_v4). Driver error:" << job->error().driverText() << "Database error:" << job->error().databaseText();
+            return;
+        }
+        emit logDatabaseUpdated();
+    });
+    enqueJob(job);
+}
+
+bool LogEngine::migrateDatabaseVersion5to6()
+{
+    // The existing entries table becomes the first partition
+    m_db.exec("CREATE TABLE partitions (id INTEGER PRIMARY KEY, startTime BIGINT);");
+    if (m_db.lastError().isValid()) {
+        qCWarning(dcLogEngine) << "Error migrating database verion 5 -> 6 (creating partitions table). Driver error:" << m_db.lastError().driverText() << "Database error:" << m_db.lastError().databaseText();
+        return false;
+    }
+
+    if (m_db.tables().contains("entries")) {
+        m_db.exec("ALTER TABLE entries RENAME TO entries_1;");
+        if (m_db.lastError().isValid()) {
+            qCWarning(dcLogEngine) << "Error migrating database verion 5 -> 6 (renaming table). Driver error:" << m_db.lastError().driverText() << "Database error:" << m_db.lastError().databaseText();
+            return false;
+        }
+        m_db.exec(QString("INSERT INTO partitions (id, startTime) VALUES (1, %1);").arg(QDateTime::currentDateTime().toMSecsSinceEpoch()));
+        if (m_db.lastError().isValid()) {
+            qCWarning(dcLogEngine) << "Error migrating database verion 5 -> 6 (adding partition). Driver error:" << m_db.lastError().driverText() << "Database error:" << m_db.lastError().databaseText();
+            return false;
+        }
+    }
+
+    qCDebug(dcLogEngine()) << "Updating database version to 6";
+    m_db.exec("UPDATE metadata SET data = 6 WHERE `key` = 'version';");
+    if (m_db.lastError().isValid()) {
+        qCWarning(dcLogEngine) << "Error updating database verion 5 -> 6. Driver error:" << m_db.lastError().driverText() << "Database error:" << m_db.lastError().databaseText();
+        return false;
+    }
+
+    qCDebug(dcLogEngine()) << "Migrated database schema from version 5 to 6.";
+    return true;
+}
+
+bool LogEngine::loadPartitions()
+{
+    m_partitions.clear();
+    m_pendingDrops.clear();
+    m_entryCount = 0;
+
+    QSqlQuery query = m_db.exec("SELECT id, startTime FROM partitions ORDER BY id ASC;");
+    if (m_db.lastError().isValid()) {
+        qCWarning(dcLogEngine) << "Error loading log partitions. Driver error:" << m_db.lastError().driverText() << "Database error:" << m_db.lastError().databaseText();
+        return false;
+    }
+    while (query.next()) {
+        Partition partition;
+        partition.id = query.value("id").toInt();
+        partition.startTime = query.value("startTime").toLongLong();
+        m_partitions.append(partition);
+    }
+    qCDebug(dcLogEngine()) << "Loaded" << m_partitions.count() << "log partitions";
+    return true;
+}
+
 bool LogEngine::initDB(const QString &username, const QString &password)
 {
     m_db.close();
@@ -727,6 +1413,14 @@ bool LogEngine::initDB(const QString &username, const QString &password)
         return false;
     }
 
+    if (m_db.driverName() == "QSQLITE") {
+        // Allows the reader connection to fetch entries while the writer is inserting new ones
+        m_db.exec("PRAGMA journal_mode=WAL;");
+        if (m_db.lastError().isValid()) {
+            qCWarning(dcLogEngine()) << "Error enabling write-ahead logging. Driver error:" << m_db.lastError().driverText() << "Database error:" << m_db.lastError().databaseText();
+        }
+    }
+
     if (!m_db.tables().contains("metadata")) {
         qCDebug(dcLogEngine()) << "Empty Database. Setting up metadata...";
         m_db.exec("CREATE TABLE metadata (`key` VARCHAR(10), data VARCHAR(40));");
@@ -754,6 +1448,28 @@ bool LogEngine::initDB(const QString &username, const QString &password)
             }
         }
 
+        // Migration from 4 -> 5
+        if (version == 4) {
+            if (!migrateDatabaseVersion4to5()) {
+                qCWarning(dcLogEngine()) << "Migration process failed.";
+                m_db.close();
+                return false;
+            } else {
+                version = 5;
+            }
+        }
+
+        // Migration from 5 -> 6
+        if (version == 5) {
+            if (!migrateDatabaseVersion5to6()) {
+                qCWarning(dcLogEngine()) << "Migration process failed.";
+                m_db.close();
+                return false;
+            } else {
+                version = 6;
+            }
+        }
+
         if (version != DB_SCHEMA_VERSION) {
             qCWarning(dcLogEngine) << "Log schema version not matching! Schema upgrade not implemented for this version change.";
             m_db.close();
@@ -765,6 +1481,9 @@ bool LogEngine::initDB(const QString &username, const QString &password)
             if (m_db.tables().contains("_entries_v3")) {
                 migrateEntries3to4();
             }
+            if (m_db.tables().contains("_entries_v4")) {
+                migrateEntries4to5();
+            }
         }
     } else {
         qCWarning(dcLogEngine) << "Broken log database. Version not found in metadata table.";
@@ -795,30 +1514,92 @@ bool LogEngine::initDB(const QString &username, const QString &password)
         }
     }
 
-    if (!m_db.tables().contains("entries")) {
-        qCDebug(dcLogEngine()) << "No \"entries\" table in database. Creating it.";
-        m_db.exec("CREATE TABLE entries "
+    if (!m_db.tables().contains("uuids")) {
+        qCDebug(dcLogEngine()) << "No \"uuids\" table in database. Creating it.";
+        m_db.exec("CREATE TABLE uuids (id INTEGER PRIMARY KEY, uuid VARCHAR(38) UNIQUE);");
+        if (m_db.lastError().isValid()) {
+            qCWarning(dcLogEngine) << "Error creating uuids table in database. Driver error:" << m_db.lastError().driverText() << "Database error:" << m_db.lastError().databaseText();
+            m_db.close();
+            return false;
+        }
+    }
+
+    if (!m_db.tables().contains("partitions")) {
+        qCDebug(dcLogEngine()) << "No \"partitions\" table in database. Creating it.";
+        m_db.exec("CREATE TABLE partitions (id INTEGER PRIMARY KEY, startTime BIGINT);");
+        if (m_db.lastError().isValid()) {
+            qCWarning(dcLogEngine) << "Error creating partitions table in database. Driver error:" << m_db.lastError().driverText() << "Database error:" << m_db.lastError().databaseText();
+            m_db.close();
+            return false;
+        }
+    }
+
+    if (!m_db.tables().contains("stateHistory")) {
+        qCDebug(dcLogEngine()) << "No \"stateHistory\" table in database. Creating it.";
+        m_db.exec("CREATE TABLE stateHistory "
                   "("
-                  "timestamp BIGINT,"
-                  "loggingLevel INT,"
-                  "sourceType INT,"
-                  "typeId VARCHAR(38),"
-                  "thingId VARCHAR(38),"
-                  "value VARCHAR(100),"
-                  "loggingEventType INT,"
-                  "active BOOL,"
-                  "errorCode INT,"
-                  "FOREIGN KEY(sourceType) REFERENCES sourceTypes(id),"
-                  "FOREIGN KEY(loggingEventType) REFERENCES loggingEventTypes(id)"
+                  "thingId INTEGER,"
+                  "stateTypeId INTEGER,"
+                  "resolution INT,"
+                  "startTime BIGINT,"
+                  "minimum REAL,"
+                  "maximum REAL,"
+                  "sum REAL,"
+                  "count INT,"
+                  "last REAL,"
+                  "PRIMARY KEY(thingId, stateTypeId, resolution, startTime),"
+                  "FOREIGN KEY(thingId) REFERENCES uuids(id),"
+                  "FOREIGN KEY(stateTypeId) REFERENCES uuids(id)"
                   ");");
-
         if (m_db.lastError().isValid()) {
-            qCWarning(dcLogEngine) << "Error creating log table in database. Driver error:" << m_db.lastError().driverText() << "Database error:" << m_db.lastError().databaseText();
+            qCWarning(dcLogEngine) << "Error creating stateHistory table in database. Driver error:" << m_db.lastError().driverText() << "Database error:" << m_db.lastError().databaseText();
             m_db.close();
             return false;
         }
+        m_db.exec("CREATE INDEX stateHistory_resolution_startTime ON stateHistory (resolution, startTime);");
+    }
+
+    if (!loadPartitions()) {
+        m_db.close();
+        return false;
+    }
+
+    if (m_partitions.isEmpty()) {
+        qCDebug(dcLogEngine()) << "No log partitions in database. Creating the first one.";
+        QStringList statements;
+        int partitionId = 1;
+        // Entries migrated from schema 4 go to a partition of their own in front of the current one,
+        // so the retention can drop them like any other partition
+        if (m_db.tables().contains("_entries_v4")) {
+            QSqlQuery startTimeQuery = m_db.exec("SELECT MIN(timestamp) FROM _entries_v4;");
+            qint64 startTime = startTimeQuery.next() ? startTimeQuery.value(0).toLongLong() : 0;
+            statements.append(partitionSchema(partitionId));
+            statements.append(QString("INSERT INTO partitions (id, startTime) VALUES (%1, %2);").arg(partitionId).arg(startTime));
+            partitionId++;
+        }
+        statements.append(partitionSchema(partitionId));
+        statements.append(QString("INSERT INTO partitions (id, startTime) VALUES (%1, %2);").arg(partitionId).arg(QDateTime::currentDateTime().toMSecsSinceEpoch()));
+        foreach (const QString &statement, statements) {
+            m_db.exec(statement);
+            if (m_db.lastError().isValid()) {
+                qCWarning(dcLogEngine) << "Error creating log partition in database. Driver error:" << m_db.lastError().driverText() << "Database error:" << m_db.lastError().databaseText();
+                m_db.close();
+                return false;
+            }
+        }
+        if (!loadPartitions()) {
+            m_db.close();
+            return false;
+        }
+    }
 
+    // The oldest partition, unless the retention has dropped it while migrating already
+    m_migrationPartitionId = m_db.tables().contains("_entries_v4") && m_partitions.count() > 1 ? m_partitions.first().id : -1;
 
+    m_internedUuids.clear();
+    QSqlQuery uuidsQuery = m_db.exec("SELECT uuid FROM uuids;");
+    while (uuidsQuery.next()) {
+        m_internedUuids.insert(uuidsQuery.value(0).toUuid());
     }
 
     qCDebug(dcLogEngine) << "Initialized logging DB successfully. (maximum DB size:" << m_dbMaxSize << ")";
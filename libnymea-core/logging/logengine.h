@@ -33,6 +33,8 @@
 
 #include "logentry.h"
 #include "logfilter.h"
+#include "stateaggregator.h"
+#include "statehistorypoint.h"
 #include "types/event.h"
 #include "types/action.h"
 #include "types/browseritemaction.h"
@@ -46,13 +48,14 @@
 #include <QSqlError>
 #include <QSqlRecord>
 #include <QTimer>
-#include <QFutureWatcher>
 
 namespace nymeaserver {
 
 class DatabaseJob;
+class LogDatabaseWorker;
 class LogEntriesFetchJob;
 class ThingsFetchJob;
+class StateHistoryFetchJob;
 
 class LogEngine: public QObject
 {
@@ -65,10 +68,13 @@ public:
 
     LogEntriesFetchJob *fetchLogEntries(const LogFilter &filter = LogFilter());
     ThingsFetchJob *fetchThings();
+    StateHistoryFetchJob *fetchStateHistory(const ThingId &thingId, const StateTypeId &stateTypeId, Logging::StateHistoryResolution resolution, const QDateTime &from, const QDateTime &to);
 
     bool jobsRunning() const;
 
     void setMaxLogEntries(int maxLogEntries, int trimSize);
+    void setWriteBatching(int maxBatchSize, int flushInterval);
+    void setRetentionPolicy(int maxDays, bool partitionByDay);
     void clearDatabase();
 
     void removeThingLogs(const ThingId &thingId);
@@ -96,71 +102,132 @@ signals:
     void jobsRunningChanged();
 
 private:
+    // Entries are stored in rolling partition tables. Trimming drops whole partitions.
+    struct Partition {
+        int id = 0;
+        qint64 startTime = 0;
+        int entryCount = 0; // Committed entries
+        int size = 0; // Committed and queued entries
+        QString table() const { return QString("entries_%1").arg(id); }
+    };
+
     bool initDB(const QString &username, const QString &password);
+    QStringList partitionSchema(int partitionId) const;
+    bool loadPartitions();
+    bool partitionByDay() const;
+    int partitionSize() const;
+    Partition *findPartition(int partitionId);
+    void createPartition(const QDateTime &startTime);
+    void dropPartition(const Partition &partition);
+    void removedFromPartition(int partitionId, int count);
+    void updateEntryCount();
+    QString selectEntriesQuery(const LogFilter &filter) const;
+    void internUuid(const QUuid &uuid);
     void appendLogEntry(const LogEntry &entry);
     void rotate(const QString &dbName);
+    void startWorkers();
+    void stopWorkers();
+    void discardQueuedJobs();
 
     bool migrateDatabaseVersion3to4();
     void migrateEntries3to4();
     void finalizeMigration3To4();
 
+    bool migrateDatabaseVersion4to5();
+    void migrateEntries4to5();
+    void finalizeMigration4To5();
+
+    bool migrateDatabaseVersion5to6();
+
 private slots:
     void checkDBSize();
     void trim();
+    void flushStateHistory();
 
     void enqueJob(DatabaseJob *job, bool priority = false);
+    void enqueReadJob(DatabaseJob *job);
     void processQueue();
-    void handleJobFinished();
+    void flushBatch();
+    void handleJobsFinished(const QList<DatabaseJob*> &jobs);
 
 private:
+    // Only used for setup and migration in the main thread while the workers are stopped
     QSqlDatabase m_db;
+    QString m_driver;
+    QString m_hostname;
     QString m_username;
     QString m_password;
     int m_dbMaxSize;
     int m_trimSize;
+    int m_maxDays = 0;
+    bool m_partitionByDay = false;
     int m_entryCount = 0;
+    QList<Partition> m_partitions;
+    QList<int> m_pendingDrops;
+    int m_migrationPartitionId = -1;
+    QTimer m_retentionTimer;
+
+    // Numeric state values are aggregated in memory and merged into the stateHistory table periodically
+    StateAggregator m_stateAggregator;
+    QTimer m_stateHistoryTimer;
     bool m_initialized = false;
     bool m_dbMalformed = false;
 
     ThingManager *m_thingManager = nullptr;
 
+    // Thing and type ids known to be in the uuids lookup table
+    QSet<QUuid> m_internedUuids;
+
     // When maxQueueLength is exceeded, jobs will be flagged and discarded if this source logs more events
     int m_maxQueueLength;
-    QHash<QString, QList<DatabaseJob*>> m_flaggedJobs;
+    QHash<QString, QList<QPair<DatabaseJob*, int>>> m_flaggedJobs; // Job and its partition id
 
+    // Consecutive batchable jobs (log entry inserts) are executed as one transaction
+    int m_maxBatchSize = 100;
+    int m_flushInterval = 0;
+    bool m_flushDue = false;
+    QTimer m_flushTimer;
+
+    // Writes are executed in order by the writer thread, reads run in parallel on a read-only connection
+    LogDatabaseWorker *m_writer = nullptr;
+    LogDatabaseWorker *m_reader = nullptr;
     QList<DatabaseJob*> m_jobQueue;
-    DatabaseJob *m_currentJob = nullptr;
-    QFutureWatcher<DatabaseJob*> m_jobWatcher;
+    QList<DatabaseJob*> m_readQueue;
+    int m_runningWriteBatches = 0;
+    int m_runningReadJobs = 0;
 };
 
 class DatabaseJob: public QObject
 {
     Q_OBJECT
 public:
-    DatabaseJob(const QSqlDatabase &db, const QString &queryString, const QVariantList &bindValues = QVariantList()):
-        m_db(db),
+    DatabaseJob(const QString &queryString, const QVariantList &bindValues = QVariantList(), bool batchable = false):
         m_queryString(queryString),
-        m_bindValues(bindValues)
+        m_bindValues(bindValues),
+        m_batchable(batchable)
     {
     }
 
     QString executedQuery() const { return m_executedQuery; }
     QSqlError error() const { return m_error; }
+    int rowsAffected() const { return m_rowsAffected; }
     QList<QSqlRecord> results() const { return m_results; }
 
 signals:
     void finished();
 
 private:
-    QSqlDatabase m_db;
     QString m_queryString;
     QVariantList m_bindValues;
+    bool m_batchable = false;
 
     QString m_executedQuery;
     QSqlError m_error;
+    int m_rowsAffected = -1;
     QList<QSqlRecord> m_results;
 
     friend class LogEngine;
+    friend class LogDatabaseWorker;
 };
 
 class LogEntriesFetchJob: public QObject
@@ -169,10 +236,13 @@ class LogEntriesFetchJob: public QObject
 public:
     LogEntriesFetchJob(QObject *parent): QObject(parent) {}
     QList<LogEntry> results() { return m_results; }
+    // Set if the limit has been reached, continues the result set in a subsequent fetch
+    QString nextCursor() const { return m_nextCursor; }
 signals:
     void finished();
 private:
     QList<LogEntry> m_results;
+    QString m_nextCursor;
     friend class LogEngine;
 };
 
@@ -189,6 +259,19 @@ private:
     friend class LogEngine;
 };
 
+class StateHistoryFetchJob: public QObject
+{
+    Q_OBJECT
+public:
+    StateHistoryFetchJob(QObject *parent): QObject(parent) {}
+    StateHistoryPoints results() { return m_results; }
+signals:
+    void finished();
+private:
+    StateHistoryPoints m_results;
+    friend class LogEngine;
+};
+
 }
 
 #endif
@@ -44,6 +44,8 @@
 #include "logfilter.h"
 #include "loggingcategories.h"
 
+#include <QStringList>
+
 namespace nymeaserver {
 
 /*! Constructs a new \l{LogFilter}.*/
@@ -228,6 +230,65 @@ int LogFilter::offset() const
     return m_offset;
 }
 
+/*! Sets the opaque \a cursor as returned by a previous fetch. The result set will continue right after the
+    entry the cursor points to. Other than the offset, this doesn't require to skip all previous entries.
+    Returns false if the cursor is invalid. */
+bool LogFilter::setCursor(const QString &cursor)
+{
+    QStringList parts = QString::fromUtf8(QByteArray::fromBase64(cursor.toUtf8(), QByteArray::Base64UrlEncoding)).split(':');
+    if (parts.count() != 3) {
+        return false;
+    }
+    bool timestampOk, partitionOk, rowIdOk;
+    qint64 timestamp = parts.at(0).toLongLong(&timestampOk);
+    int partitionId = parts.at(1).toInt(&partitionOk);
+    qint64 rowId = parts.at(2).toLongLong(&rowIdOk);
+    if (!timestampOk || !partitionOk || !rowIdOk) {
+        return false;
+    }
+    setCursor(timestamp, partitionId, rowId);
+    return true;
+}
+
+/*! Sets the cursor to the entry with the given \a rowId in the partition \a partitionId, logged at \a timestamp. */
+void LogFilter::setCursor(qint64 timestamp, int partitionId, qint64 rowId)
+{
+    m_hasCursor = true;
+    m_cursorTimestamp = timestamp;
+    m_cursorPartitionId = partitionId;
+    m_cursorRowId = rowId;
+}
+
+/*! Returns true if a cursor has been set for this \l{LogFilter}. */
+bool LogFilter::hasCursor() const
+{
+    return m_hasCursor;
+}
+
+/*! Returns the timestamp of the entry the cursor points to. \sa{setCursor} */
+qint64 LogFilter::cursorTimestamp() const
+{
+    return m_cursorTimestamp;
+}
+
+/*! Returns the id of the partition holding the entry the cursor points to. \sa{setCursor} */
+int LogFilter::cursorPartitionId() const
+{
+    return m_cursorPartitionId;
+}
+
+/*! Returns the row id of the entry the cursor points to within its partition. \sa{setCursor} */
+qint64 LogFilter::cursorRowId() const
+{
+    return m_cursorRowId;
+}
+
+/*! Returns the opaque cursor string for the entry with the given \a rowId in the partition \a partitionId, logged at \a timestamp. */
+QString LogFilter::createCursor(qint64 timestamp, int partitionId, qint64 rowId)
+{
+    return QString::fromUtf8(QString("%1:%2:%3").arg(timestamp).arg(partitionId).arg(rowId).toUtf8().toBase64(QByteArray::Base64UrlEncoding));
+}
+
 /*! Returns true if this \l{LogFilter} is empty. */
 bool LogFilter::isEmpty() const
 {
@@ -349,38 +410,28 @@ QString LogFilter::createEventTypesString() const
 
 QString LogFilter::createTypeIdsString() const
 {
+    // Type ids are stored as keys into the uuids lookup table
     QString query;
     if (!m_typeIds.isEmpty()) {
-        if (m_typeIds.count() == 1) {
-            query.append(QString("typeId = '%1' ").arg(m_typeIds.first().toString()));
-        } else {
-            query.append("( ");
-            foreach (const QUuid &typeId, m_typeIds) {
-                query.append(QString("typeId = '%1' ").arg(typeId.toString()));
-                if (typeId != m_typeIds.last())
-                    query.append("OR ");
-            }
-            query.append(") ");
+        QStringList uuids;
+        foreach (const QUuid &typeId, m_typeIds) {
+            uuids.append(QString("'%1'").arg(typeId.toString()));
         }
+        query.append(QString("typeId IN (SELECT id FROM uuids WHERE uuid IN (%1)) ").arg(uuids.join(", ")));
     }
     return query;
 }
 
 QString LogFilter::createThingIdString() const
 {
+    // Thing ids are stored as keys into the uuids lookup table
     QString query;
     if (!m_thingIds.isEmpty()) {
-        if (m_thingIds.count() == 1) {
-            query.append(QString("thingId = '%1' ").arg(m_thingIds.first().toString()));
-        } else {
-            query.append("( ");
-            foreach (const ThingId &thingId, m_thingIds) {
-                query.append(QString("thingId = '%1' ").arg(thingId.toString()));
-                if (thingId != m_thingIds.last())
-                    query.append("OR ");
-            }
-            query.append(") ");
+        QStringList uuids;
+        foreach (const ThingId &thingId, m_thingIds) {
+            uuids.append(QString("'%1'").arg(thingId.toString()));
         }
+        query.append(QString("thingId IN (SELECT id FROM uuids WHERE uuid IN (%1)) ").arg(uuids.join(", ")));
     }
     return query;
 }
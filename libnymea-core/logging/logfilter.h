@@ -77,6 +77,15 @@ public:
     void setOffset(int offset);
     int offset() const;
 
+    // Keyset pagination: Continue after the entry the cursor points to
+    bool setCursor(const QString &cursor);
+    void setCursor(qint64 timestamp, int partitionId, qint64 rowId);
+    bool hasCursor() const;
+    qint64 cursorTimestamp() const;
+    int cursorPartitionId() const;
+    qint64 cursorRowId() const;
+    static QString createCursor(qint64 timestamp, int partitionId, qint64 rowId);
+
     bool isEmpty() const;
 
 private:
@@ -89,6 +98,10 @@ private:
     QVariantList m_values;
     int m_limit = -1;
     int m_offset = 0;
+    bool m_hasCursor = false;
+    qint64 m_cursorTimestamp = 0;
+    int m_cursorPartitionId = 0;
+    qint64 m_cursorRowId = 0;
 
     QString createDateString() const;
     QString createTimeFilterString(QPair<QDateTime, QDateTime> timeFilter) const;
@@ -74,6 +74,14 @@ public:
     };
     Q_ENUM(LoggingEventType)
 
+    enum StateHistoryResolution {
+        StateHistoryResolutionMinute,
+        StateHistoryResolutionQuarterHour,
+        StateHistoryResolutionHour,
+        StateHistoryResolutionDay
+    };
+    Q_ENUM(StateHistoryResolution)
+
     Logging(QObject *parent = nullptr);
 };
 
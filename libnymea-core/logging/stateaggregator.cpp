@@ -0,0 +1,183 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+/*!
+    \class nymeaserver::StateAggregator
+    \brief Incrementally aggregates numeric state values into time buckets.
+
+    \ingroup logs
+    \inmodule core
+
+    The StateAggregator keeps the minimum, maximum, sum, count and last value of numeric states
+    for each of the \l{Logging::StateHistoryResolution}{resolutions}. Buckets are aligned to UTC.
+
+    The aggregator only holds the values added since the pending buckets have been taken the last
+    time. The \l{LogEngine} merges those into the buckets stored in the log database, so the full
+    history never needs to be scanned when a state history is fetched.
+
+    \sa LogEngine, StateHistoryPoint
+*/
+
+#include "stateaggregator.h"
+
+namespace nymeaserver {
+
+QList<Logging::StateHistoryResolution> StateAggregator::resolutions()
+{
+    return {
+        Logging::StateHistoryResolutionMinute,
+        Logging::StateHistoryResolutionQuarterHour,
+        Logging::StateHistoryResolutionHour,
+        Logging::StateHistoryResolutionDay
+    };
+}
+
+/*! Returns the length of a bucket for the given \a resolution in milliseconds. */
+qint64 StateAggregator::bucketLength(Logging::StateHistoryResolution resolution)
+{
+    switch (resolution) {
+    case Logging::StateHistoryResolutionMinute:
+        return 60 * 1000;
+    case Logging::StateHistoryResolutionQuarterHour:
+        return 15 * 60 * 1000;
+    case Logging::StateHistoryResolutionHour:
+        return 60 * 60 * 1000;
+    case Logging::StateHistoryResolutionDay:
+        return 24 * 60 * 60 * 1000;
+    }
+    return 60 * 1000;
+}
+
+/*! Returns the start of the bucket containing \a timestamp for the given \a resolution. Both in milliseconds since epoch. */
+qint64 StateAggregator::bucketStart(Logging::StateHistoryResolution resolution, qint64 timestamp)
+{
+    qint64 length = bucketLength(resolution);
+    qint64 start = timestamp - (timestamp % length);
+    // Round down for timestamps before epoch too
+    return start > timestamp ? start - length : start;
+}
+
+/*! Returns for how long buckets of the given \a resolution are kept in milliseconds. 0 means forever. */
+qint64 StateAggregator::retention(Logging::StateHistoryResolution resolution)
+{
+    const qint64 day = 24 * 60 * 60 * 1000;
+    switch (resolution) {
+    case Logging::StateHistoryResolutionMinute:
+        return 2 * day;
+    case Logging::StateHistoryResolutionQuarterHour:
+        return 31 * day;
+    case Logging::StateHistoryResolutionHour:
+        return 366 * day;
+    case Logging::StateHistoryResolutionDay:
+        return 0;
+    }
+    return 0;
+}
+
+bool StateAggregator::isNumeric(const QVariant &value)
+{
+    switch (static_cast<int>(value.type())) {
+    case QMetaType::Int:
+    case QMetaType::UInt:
+    case QMetaType::LongLong:
+    case QMetaType::ULongLong:
+    case QMetaType::Double:
+    case QMetaType::Float:
+        return true;
+    default:
+        return false;
+    }
+}
+
+void StateAggregator::addValue(const ThingId &thingId, const StateTypeId &stateTypeId, qint64 timestamp, double value)
+{
+    QList<Bucket> &buckets = m_pending[qMakePair(thingId, stateTypeId)];
+    foreach (Logging::StateHistoryResolution resolution, resolutions()) {
+        qint64 startTime = bucketStart(resolution, timestamp);
+
+        Bucket *bucket = nullptr;
+        for (int i = 0; i < buckets.count(); i++) {
+            if (buckets.at(i).resolution == resolution && buckets.at(i).startTime == startTime) {
+                bucket = &buckets[i];
+                break;
+            }
+        }
+
+        if (!bucket) {
+            Bucket newBucket;
+            newBucket.thingId = thingId;
+            newBucket.stateTypeId = stateTypeId;
+            newBucket.resolution = resolution;
+            newBucket.startTime = startTime;
+            newBucket.minimum = value;
+            newBucket.maximum = value;
+            buckets.append(newBucket);
+            bucket = &buckets.last();
+        }
+
+        bucket->minimum = qMin(bucket->minimum, value);
+        bucket->maximum = qMax(bucket->maximum, value);
+        bucket->sum += value;
+        bucket->count++;
+        bucket->last = value;
+    }
+}
+
+/*! Returns all buckets with values added since the last call and resets them. */
+QList<StateAggregator::Bucket> StateAggregator::takePending()
+{
+    QList<Bucket> buckets;
+    foreach (const QList<Bucket> &stateBuckets, m_pending) {
+        buckets.append(stateBuckets);
+    }
+    m_pending.clear();
+    return buckets;
+}
+
+bool StateAggregator::hasPending() const
+{
+    return !m_pending.isEmpty();
+}
+
+void StateAggregator::removeThing(const ThingId &thingId)
+{
+    QMutableHashIterator<QPair<ThingId, StateTypeId>, QList<Bucket>> it(m_pending);
+    while (it.hasNext()) {
+        if (it.next().key().first == thingId) {
+            it.remove();
+        }
+    }
+}
+
+void StateAggregator::clear()
+{
+    m_pending.clear();
+}
+
+}
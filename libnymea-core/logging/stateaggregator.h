@@ -0,0 +1,78 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+#ifndef STATEAGGREGATOR_H
+#define STATEAGGREGATOR_H
+
+#include "logging.h"
+#include "typeutils.h"
+
+#include <QHash>
+#include <QPair>
+#include <QVariant>
+
+namespace nymeaserver {
+
+class StateAggregator
+{
+public:
+    // Aggregated values of one state in one interval of a resolution
+    struct Bucket {
+        ThingId thingId;
+        StateTypeId stateTypeId;
+        Logging::StateHistoryResolution resolution = Logging::StateHistoryResolutionMinute;
+        qint64 startTime = 0;
+        double minimum = 0;
+        double maximum = 0;
+        double sum = 0;
+        int count = 0;
+        double last = 0;
+    };
+
+    static QList<Logging::StateHistoryResolution> resolutions();
+    static qint64 bucketLength(Logging::StateHistoryResolution resolution);
+    static qint64 bucketStart(Logging::StateHistoryResolution resolution, qint64 timestamp);
+    static qint64 retention(Logging::StateHistoryResolution resolution);
+    static bool isNumeric(const QVariant &value);
+
+    void addValue(const ThingId &thingId, const StateTypeId &stateTypeId, qint64 timestamp, double value);
+    QList<Bucket> takePending();
+    bool hasPending() const;
+
+    void removeThing(const ThingId &thingId);
+    void clear();
+
+private:
+    // Values added since the pending buckets have been taken the last time, per (thingId, stateTypeId)
+    QHash<QPair<ThingId, StateTypeId>, QList<Bucket>> m_pending;
+};
+
+}
+
+#endif // STATEAGGREGATOR_H
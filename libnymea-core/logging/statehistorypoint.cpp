@@ -0,0 +1,113 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+/*!
+    \class nymeaserver::StateHistoryPoint
+    \brief Represents an aggregated interval of a numeric state history.
+
+    \ingroup logs
+    \inmodule core
+
+    A \l{StateHistoryPoint} holds the minimum, maximum, average and last value of a state
+    within an interval of the resolution it has been fetched with.
+
+    \sa LogEngine, StateAggregator, LoggingHandler
+*/
+
+#include "statehistorypoint.h"
+
+namespace nymeaserver {
+
+StateHistoryPoint::StateHistoryPoint()
+{
+
+}
+
+StateHistoryPoint::StateHistoryPoint(const QDateTime &timestamp, double minimum, double maximum, double average, double last, int count):
+    m_timestamp(timestamp),
+    m_minimum(minimum),
+    m_maximum(maximum),
+    m_average(average),
+    m_last(last),
+    m_count(count)
+{
+
+}
+
+QDateTime StateHistoryPoint::timestamp() const
+{
+    return m_timestamp;
+}
+
+double StateHistoryPoint::minimum() const
+{
+    return m_minimum;
+}
+
+double StateHistoryPoint::maximum() const
+{
+    return m_maximum;
+}
+
+double StateHistoryPoint::average() const
+{
+    return m_average;
+}
+
+double StateHistoryPoint::last() const
+{
+    return m_last;
+}
+
+int StateHistoryPoint::count() const
+{
+    return m_count;
+}
+
+StateHistoryPoints::StateHistoryPoints()
+{
+
+}
+
+StateHistoryPoints::StateHistoryPoints(const QList<StateHistoryPoint> &other): QList<StateHistoryPoint>(other)
+{
+
+}
+
+QVariant StateHistoryPoints::get(int index) const
+{
+    return QVariant::fromValue(at(index));
+}
+
+void StateHistoryPoints::put(const QVariant &variant)
+{
+    append(variant.value<StateHistoryPoint>());
+}
+
+}
@@ -229,6 +229,16 @@ NymeaConfiguration::NymeaConfiguration(QObject *parent) :
     settings.setValue("logDBUser", logDBUser());
     settings.setValue("logDBPassword", logDBPassword());
     settings.setValue("logDBMaxEntries", logDBMaxEntries());
+    settings.setValue("logDBMaxBatchSize", logDBMaxBatchSize());
+    settings.setValue("logDBFlushInterval", logDBFlushInterval());
+    settings.setValue("logDBMaxDays", logDBMaxDays());
+    settings.setValue("logDBPartitionByDay", logDBPartitionByDay());
+    settings.endGroup();
+
+    // Write defaults for rule engine settings
+    settings.beginGroup("RuleEngine");
+    settings.setValue("parallelEvaluation", ruleEngineParallelEvaluation());
+    settings.setValue("maxThreads", ruleEngineMaxThreads());
     settings.endGroup();
 }
 
@@ -584,6 +594,48 @@ int NymeaConfiguration::logDBMaxEntries() const
     return settings.value("logDBMaxEntries", 200000).toInt();
 }
 
+int NymeaConfiguration::logDBMaxBatchSize() const
+{
+    NymeaSettings settings(NymeaSettings::SettingsRoleGlobal);
+    settings.beginGroup("Logs");
+    return settings.value("logDBMaxBatchSize", 100).toInt();
+}
+
+int NymeaConfiguration::logDBFlushInterval() const
+{
+    NymeaSettings settings(NymeaSettings::SettingsRoleGlobal);
+    settings.beginGroup("Logs");
+    return settings.value("logDBFlushInterval", 0).toInt();
+}
+
+int NymeaConfiguration::logDBMaxDays() const
+{
+    NymeaSettings settings(NymeaSettings::SettingsRoleGlobal);
+    settings.beginGroup("Logs");
+    return settings.value("logDBMaxDays", 0).toInt();
+}
+
+bool NymeaConfiguration::logDBPartitionByDay() const
+{
+    NymeaSettings settings(NymeaSettings::SettingsRoleGlobal);
+    settings.beginGroup("Logs");
+    return settings.value("logDBPartitionByDay", false).toBool();
+}
+
+bool NymeaConfiguration::ruleEngineParallelEvaluation() const
+{
+    NymeaSettings settings(NymeaSettings::SettingsRoleGlobal);
+    settings.beginGroup("RuleEngine");
+    return settings.value("parallelEvaluation", false).toBool();
+}
+
+int NymeaConfiguration::ruleEngineMaxThreads() const
+{
+    NymeaSettings settings(NymeaSettings::SettingsRoleGlobal);
+    settings.beginGroup("RuleEngine");
+    return settings.value("maxThreads", 0).toInt();
+}
+
 QString NymeaConfiguration::sslCertificate() const
 {
     NymeaSettings settings(NymeaSettings::SettingsRoleGlobal);
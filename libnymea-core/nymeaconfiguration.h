@@ -208,6 +208,14 @@ public:
     QString logDBUser() const;
     QString logDBPassword() const;
     int logDBMaxEntries() const;
+    int logDBMaxBatchSize() const;
+    int logDBFlushInterval() const;
+    int logDBMaxDays() const;
+    bool logDBPartitionByDay() const;
+
+    // Rule engine
+    bool ruleEngineParallelEvaluation() const;
+    int ruleEngineMaxThreads() const;
 
 private:
     QHash<QString, ServerConfiguration> m_tcpServerConfigs;
@@ -125,9 +125,12 @@ void NymeaCore::init(const QStringList &additionalInterfaces) {
 
     qCDebug(dcCore) << "Creating Rule Engine";
     m_ruleEngine = new RuleEngine(this);
+    m_ruleEngine->setParallelEvaluation(m_configuration->ruleEngineParallelEvaluation(), m_configuration->ruleEngineMaxThreads());
 
     qCDebug(dcCore) << "Creating Log Engine";
     m_logger = new LogEngine(m_configuration->logDBDriver(), m_configuration->logDBName(), m_configuration->logDBHost(), m_configuration->logDBUser(), m_configuration->logDBPassword(), m_configuration->logDBMaxEntries(), this);
+    m_logger->setWriteBatching(m_configuration->logDBMaxBatchSize(), m_configuration->logDBFlushInterval());
+    m_logger->setRetentionPolicy(m_configuration->logDBMaxDays(), m_configuration->logDBPartitionByDay());
     m_logger->setThingManager(m_thingManager);
 
     qCDebug(dcCore()) << "Creating Script Engine";
@@ -231,6 +231,30 @@ void Rule::setStatesActive(const bool &statesActive)
     m_statesActive = statesActive;
 }
 
+bool Rule::evaluateStates()
+{
+    m_statesActive = m_stateEvaluator.evaluate();
+    return m_statesActive;
+}
+
+bool Rule::evaluateStates(const ThingId &thingId, const StateTypeId &stateTypeId)
+{
+    m_statesActive = m_stateEvaluator.evaluate(thingId, stateTypeId);
+    return m_statesActive;
+}
+
+bool Rule::evaluateStates(const ThingStateSnapshot &snapshot)
+{
+    m_statesActive = m_stateEvaluator.evaluate(snapshot);
+    return m_statesActive;
+}
+
+bool Rule::evaluateStates(const ThingStateSnapshot &snapshot, const ThingId &thingId, const StateTypeId &stateTypeId)
+{
+    m_statesActive = m_stateEvaluator.evaluate(snapshot, thingId, stateTypeId);
+    return m_statesActive;
+}
+
 void Rule::setTimeActive(const bool &timeActive)
 {
     m_timeActive = timeActive;
@@ -96,6 +96,10 @@ public:
 private:
     friend class RuleEngine;
     void setStatesActive(const bool &statesActive);
+    bool evaluateStates();
+    bool evaluateStates(const ThingId &thingId, const StateTypeId &stateTypeId);
+    bool evaluateStates(const ThingStateSnapshot &snapshot);
+    bool evaluateStates(const ThingStateSnapshot &snapshot, const ThingId &thingId, const StateTypeId &stateTypeId);
     void setTimeActive(const bool &timeActive);
     void setActive(const bool &active);
 
@@ -110,6 +110,7 @@
 
 
 #include "ruleengine.h"
+#include "thingstatesnapshot.h"
 #include "nymeacore.h"
 #include "loggingcategories.h"
 #include "time/calendaritem.h"
@@ -126,9 +127,16 @@
 #include <QStringList>
 #include <QStandardPaths>
 #include <QCoreApplication>
+#include <QMap>
+#include <QThread>
+#include <QThreadPool>
+#include <QtConcurrent/QtConcurrentRun>
 
 namespace nymeaserver {
 
+// Below this number of state evaluators to update, the overhead of the worker threads outweighs the gain
+static const int parallelEvaluationThreshold = 16;
+
 /*! Constructs the RuleEngine with the given \a parent. Although it wouldn't harm to have multiple RuleEngines, there is one
     instance available from \l{NymeaCore}. This one should be used instead of creating multiple ones.
  */
@@ -142,6 +150,38 @@ RuleEngine::~RuleEngine()
 {
 }
 
+/*! Returns true if the state evaluators of many rules affected by the same event are evaluated on worker threads.
+
+    \sa setParallelEvaluation()
+*/
+bool RuleEngine::parallelEvaluation() const
+{
+    return m_threadPool != nullptr;
+}
+
+/*! Enables or disables the parallel evaluation of state evaluators. When \a enabled, the state evaluators of
+    the rules affected by an event are evaluated on up to \a maxThreads worker threads against a snapshot of
+    the thing states. If \a maxThreads is 0, the number of CPU cores is used. The resulting rules and their
+    actions are still handled on the main thread in the order of ruleIds().
+*/
+void RuleEngine::setParallelEvaluation(bool enabled, int maxThreads)
+{
+    if (!enabled) {
+        if (m_threadPool) {
+            qCDebug(dcRuleEngine()) << "Disabling parallel rule evaluation";
+            delete m_threadPool;
+            m_threadPool = nullptr;
+        }
+        return;
+    }
+
+    if (!m_threadPool) {
+        m_threadPool = new QThreadPool(this);
+    }
+    m_threadPool->setMaxThreadCount(maxThreads > 0 ? maxThreads : QThread::idealThreadCount());
+    qCDebug(dcRuleEngine()) << "Enabling parallel rule evaluation with" << m_threadPool->maxThreadCount() << "threads";
+}
+
 /*! Ask the Engine to evaluate all the rules for the given \a event.
     This will search all the \l{Rule}{Rules} triggered by the given \a event
     and evaluate their states in the system. It will return a
@@ -155,8 +195,8 @@ QList<Rule> RuleEngine::evaluateEvent(const Event &event)
         qCWarning(dcRuleEngine()) << "Invalid event. ThingID does not reference a valid thing";
         return QList<Rule>();
     }
-    ThingClass thingClass = thing->thingClass();
-    EventType eventType = thingClass.eventTypes().findById(event.eventTypeId());
+    const ThingClass &thingClass = thing->thingClass();
+    const EventType &eventType = thingClass.eventType(event.eventTypeId());
 
 
     if (event.params().count() == 0) {
@@ -165,49 +205,62 @@ QList<Rule> RuleEngine::evaluateEvent(const Event &event)
         qCDebug(dcRuleEngineDebug).nospace().noquote() << "Evaluate event: " << thing->name() << " - " << eventType.name() << " (ThingId:" << thing->id().toString() << ", EventTypeId:" << eventType.id().toString() << ")" << endl << "     " << event.params();
     }
 
+    QList<RuleId> candidates = candidateRules(event, thingClass);
+
+    // Collect the rules having a state based on this event and update their states
+    QVector<StateEvaluation> evaluations;
+    foreach (const RuleId &id, candidates) {
+        int index = m_ruleIndexes.value(id);
+        const Rule &rule = m_rules.at(index);
+        bool unsynced = m_unsyncedRules.removeAll(id) > 0;
+        if (!rule.enabled()) {
+            continue;
+        }
+        if (unsynced) {
+            evaluations.append({index, true, false});
+        } else if (containsState(rule.stateEvaluator(), event)) {
+            evaluations.append({index, false, false});
+        }
+    }
+    evaluateStates(evaluations, event);
+
     QList<Rule> rules;
-    foreach (const RuleId &id, ruleIds()) {
-        Rule rule = m_rules.value(id);
+    foreach (const RuleId &id, candidates) {
+        int index = m_ruleIndexes.value(id);
+        const Rule &rule = m_rules.at(index);
         if (!rule.enabled()) {
             qCDebug(dcRuleEngineDebug()).nospace().noquote() << "Skipping rule " << rule.name() << " (" << rule.id().toString() << ") "  << " because it is disabled.";
             continue;
         }
 
-        // If we have a state based on this event
-        if (containsState(rule.stateEvaluator(), event)) {
-            rule.setStatesActive(rule.stateEvaluator().evaluate());
-            m_rules[rule.id()] = rule;
-        }
+        bool statesActive = m_statesActive.testBit(index);
+        bool timeActive = m_timeActive.testBit(index);
 
         // If this rule does not base on an event, evaluate the rule
         if (rule.eventDescriptors().isEmpty() && rule.timeDescriptor().timeEventItems().isEmpty() && !rule.stateEvaluator().isEmpty()) {
-            if (rule.timeActive() && rule.statesActive()) {
-                if (!m_activeRules.contains(rule.id())) {
+            if (timeActive && statesActive) {
+                if (!m_activeRules.testBit(index)) {
                     qCDebug(dcRuleEngine).nospace().noquote() << "Rule " << rule.name() << " (" << rule.id().toString() << ") active.";
-                    rule.setActive(true);
-                    m_rules[rule.id()] = rule;
-                    m_activeRules.append(rule.id());
-                    rules.append(rule);
+                    m_activeRules.setBit(index);
+                    rules.append(ruleAt(index));
                 }
             } else {
-                if (m_activeRules.contains(rule.id())) {
+                if (m_activeRules.testBit(index)) {
                     qCDebug(dcRuleEngine).nospace().noquote() << "Rule " << rule.name() << " (" << rule.id().toString() << ") inactive.";
-                    rule.setActive(false);
-                    m_rules[rule.id()] = rule;
-                    m_activeRules.removeAll(rule.id());
-                    rules.append(rule);
+                    m_activeRules.clearBit(index);
+                    rules.append(ruleAt(index));
                 }
             }
         } else {
             // Event based rule
             if (containsEvent(rule, event, thing->thingClassId())) {
-                qCDebug(dcRuleEngineDebug()).nospace().noquote() << "Rule " << rule.name() << " (" << rule.id().toString() << ") contains event. States active:" << rule.statesActive() << "Time active:" << rule.timeActive();
-                if (rule.statesActive() && rule.timeActive()) {
+                qCDebug(dcRuleEngineDebug()).nospace().noquote() << "Rule " << rule.name() << " (" << rule.id().toString() << ") contains event. States active:" << statesActive << "Time active:" << timeActive;
+                if (statesActive && timeActive) {
                     qCDebug(dcRuleEngine).nospace().noquote() << "Rule " << rule.name() << " (" + rule.id().toString() << ") contains event and all states match.";
-                    rules.append(rule);
+                    rules.append(ruleAt(index));
                 } else {
                     qCDebug(dcRuleEngine).nospace().noquote() << "Rule " << rule.name() << " (" + rule.id().toString() << ") contains event but state are not matching.";
-                    rules.append(rule);
+                    rules.append(ruleAt(index));
                 }
             }
         }
@@ -216,6 +269,55 @@ QList<Rule> RuleEngine::evaluateEvent(const Event &event)
     return rules;
 }
 
+/*! Updates the state evaluators of the rules in the given \a evaluations after the given \a event.
+
+    If parallel evaluation is enabled and there are enough rules to evaluate, the state evaluators are
+    evaluated on the worker threads against a snapshot of the states they depend on. The results are
+    merged back into the runtime state of the rules on the calling thread.
+*/
+void RuleEngine::evaluateStates(QVector<StateEvaluation> &evaluations, const Event &event)
+{
+    ThingId thingId = event.thingId();
+    StateTypeId stateTypeId(event.eventTypeId());
+
+    if (!m_threadPool || evaluations.count() < parallelEvaluationThreshold) {
+        foreach (const StateEvaluation &evaluation, evaluations) {
+            Rule &rule = m_rules[evaluation.index];
+            m_statesActive.setBit(evaluation.index, evaluation.full ? rule.evaluateStates() : rule.evaluateStates(thingId, stateTypeId));
+        }
+        return;
+    }
+
+    // Worker threads must not access the things, so copy all the states needed beforehand
+    ThingStateSnapshot snapshot;
+    snapshot.captureThingState(thingId, stateTypeId);
+    foreach (const StateEvaluation &evaluation, evaluations) {
+        m_rules.at(evaluation.index).stateEvaluator().captureStates(&snapshot);
+    }
+
+    // Every worker evaluates a distinct set of rules, so they don't need any locking
+    Rule *rules = m_rules.data();
+    StateEvaluation *data = evaluations.data();
+    int count = evaluations.count();
+    int chunkCount = qMin(m_threadPool->maxThreadCount(), count);
+    QList<QFuture<void>> futures;
+    for (int chunk = 0; chunk < chunkCount; chunk++) {
+        futures.append(QtConcurrent::run(m_threadPool, [rules, data, count, chunk, chunkCount, &snapshot, thingId, stateTypeId]() {
+            for (int i = chunk; i < count; i += chunkCount) {
+                Rule &rule = rules[data[i].index];
+                data[i].result = data[i].full ? rule.evaluateStates(snapshot) : rule.evaluateStates(snapshot, thingId, stateTypeId);
+            }
+        }));
+    }
+    foreach (QFuture<void> future, futures) {
+        future.waitForFinished();
+    }
+
+    foreach (const StateEvaluation &evaluation, evaluations) {
+        m_statesActive.setBit(evaluation.index, evaluation.result);
+    }
+}
+
 /*! Ask the Engine to evaluate all the rules for the given \a dateTime.
     This will search all the \l{Rule}{Rules} triggered by the given \a dateTime
     and evaluate their \l{CalendarItem}{CalendarItems} and \l{TimeEventItem}{TimeEventItems}.
@@ -227,14 +329,36 @@ QList<Rule> RuleEngine::evaluateTime(const QDateTime &dateTime)
     if (!m_lastEvaluationTime.isValid()) {
         m_lastEvaluationTime = dateTime;
         m_lastEvaluationTime = m_lastEvaluationTime.addSecs(-1);
+        m_lastUtcOffset = dateTime.offsetFromUtc();
+    }
+
+    // The schedule holds absolute points in time. If the clock jumped backwards or the UTC offset changed
+    // (time zone or daylight saving time changes), the local times of the time descriptors moved.
+    if (dateTime < m_lastEvaluationTime || dateTime.offsetFromUtc() != m_lastUtcOffset) {
+        qCDebug(dcRuleEngine()) << "Time jumped backwards or the UTC offset changed. Evaluating all time based rules.";
+        foreach (const RuleId &ruleId, m_ruleIds) {
+            if (!m_rules.at(m_ruleIndexes.value(ruleId)).timeDescriptor().isEmpty()) {
+                scheduleTimeEvaluation(ruleId, QDateTime::fromMSecsSinceEpoch(0));
+            }
+        }
+    }
+
+    // Only evaluate the rules which are due. Their time descriptors can't change before that.
+    QList<QUuid> dueRuleIds;
+    while (!m_timeSchedule.isEmpty() && m_timeSchedule.firstKey() <= dateTime) {
+        QMultiMap<QDateTime, QUuid>::iterator it = m_timeSchedule.begin();
+        dueRuleIds.append(it.value());
+        m_scheduledTimes.remove(it.value());
+        m_timeSchedule.erase(it);
     }
 
     QList<Rule> rules;
 
-    qCDebug(dcRuleEngineDebug()) << "Evaluating time event" << dateTime.toString();
+    qCDebug(dcRuleEngineDebug()) << "Evaluating time event" << dateTime.toString() << "for" << dueRuleIds.count() << "rules";
 
-    foreach (const Rule &r, m_rules.values()) {
-        Rule rule = m_rules.value(r.id());
+    foreach (const QUuid &ruleId, dueRuleIds) {
+        int index = m_ruleIndexes.value(ruleId);
+        const Rule &rule = m_rules.at(index);
         if (!rule.enabled()) {
             qCDebug(dcRuleEngineDebug()) << "Skipping rule" << rule.name() << "because it is disabled";
             continue;
@@ -246,28 +370,25 @@ QList<Rule> RuleEngine::evaluateTime(const QDateTime &dateTime)
             continue;
         }
 
+        scheduleTimeEvaluation(rule.id(), rule.timeDescriptor().nextEvaluation(dateTime));
+
         // Check if this rule is based on calendarItems
         if (!rule.timeDescriptor().calendarItems().isEmpty()) {
-            rule.setTimeActive(rule.timeDescriptor().evaluate(m_lastEvaluationTime, dateTime));
-            m_rules[rule.id()] = rule;
+            m_timeActive.setBit(index, rule.timeDescriptor().evaluate(m_lastEvaluationTime, dateTime));
 
             if (rule.timeDescriptor().timeEventItems().isEmpty() && rule.eventDescriptors().isEmpty()) {
 
-                if (rule.timeActive() && rule.statesActive()) {
-                    if (!m_activeRules.contains(rule.id())) {
+                if (m_timeActive.testBit(index) && m_statesActive.testBit(index)) {
+                    if (!m_activeRules.testBit(index)) {
                         qCDebug(dcRuleEngine) << "Rule" << rule.id().toString() << "active.";
-                        rule.setActive(true);
-                        m_rules[rule.id()] = rule;
-                        m_activeRules.append(rule.id());
-                        rules.append(rule);
+                        m_activeRules.setBit(index);
+                        rules.append(ruleAt(index));
                     }
                 } else {
-                    if (m_activeRules.contains(rule.id())) {
+                    if (m_activeRules.testBit(index)) {
                         qCDebug(dcRuleEngine) << "Rule" << rule.id().toString() << "inactive.";
-                        rule.setActive(false);
-                        m_rules[rule.id()] = rule;
-                        m_activeRules.removeAll(rule.id());
-                        rules.append(rule);
+                        m_activeRules.clearBit(index);
+                        rules.append(ruleAt(index));
                     }
                 }
             }
@@ -277,14 +398,15 @@ QList<Rule> RuleEngine::evaluateTime(const QDateTime &dateTime)
         // If we have timeEvent items
         if (!rule.timeDescriptor().timeEventItems().isEmpty()) {
             bool valid = rule.timeDescriptor().evaluate(m_lastEvaluationTime, dateTime);
-            if (valid && rule.timeActive()) {
+            if (valid && m_timeActive.testBit(index)) {
                 qCDebug(dcRuleEngine) << "Rule" << rule.id() << "time event triggert.";
-                rules.append(rule);
+                rules.append(ruleAt(index));
             }
         }
     }
 
     m_lastEvaluationTime = dateTime;
+    m_lastUtcOffset = dateTime.offsetFromUtc();
 
     if (rules.count() > 0) { // Don't spam the log
         qCDebug(dcRuleEngine()) << "EvaluateTimeEvent evaluated" << rules.count() << "to be executed";
@@ -471,13 +593,14 @@ RuleEngine::RuleError RuleEngine::editRule(const Rule &rule)
     return RuleErrorNoError;
 }
 
-/*! Returns a list of all \l{Rule}{Rules} loaded in this Engine.
-    Be aware that this does not necessarily reflect the order of the rules in the engine.
-    Use ruleIds() if you need the correct order.
-*/
+/*! Returns a list of all \l{Rule}{Rules} loaded in this Engine in the order of ruleIds(). */
 QList<Rule> RuleEngine::rules() const
 {
-    return m_rules.values();
+    QList<Rule> rules;
+    foreach (const RuleId &ruleId, m_ruleIds) {
+        rules.append(ruleAt(m_ruleIndexes.value(ruleId)));
+    }
+    return rules;
 }
 
 /*! Returns a list of all ruleIds loaded in this Engine. */
@@ -493,14 +616,11 @@ QList<RuleId> RuleEngine::ruleIds() const
 */
 RuleEngine::RuleError RuleEngine::removeRule(const RuleId &ruleId, bool fromEdit)
 {
-    int index = m_ruleIds.indexOf(ruleId);
-    if (index < 0) {
+    if (!m_ruleIndexes.contains(ruleId)) {
         return RuleErrorRuleNotFound;
     }
 
-    m_ruleIds.takeAt(index);
-    m_rules.remove(ruleId);
-    m_activeRules.removeAll(ruleId);
+    eraseRule(ruleId);
 
     NymeaSettings settings(NymeaSettings::SettingsRoleRules);
     settings.beginGroup(ruleId.toString());
@@ -522,17 +642,22 @@ RuleEngine::RuleError RuleEngine::removeRule(const RuleId &ruleId, bool fromEdit
 */
 RuleEngine::RuleError RuleEngine::enableRule(const RuleId &ruleId)
 {
-    if (!m_rules.contains(ruleId)) {
+    if (!m_ruleIndexes.contains(ruleId)) {
         qCWarning(dcRuleEngine) << "Rule not found. Can't enable it";
         return RuleErrorRuleNotFound;
     }
 
-    Rule rule = m_rules.value(ruleId);
-    if (rule.enabled())
+    int index = m_ruleIndexes.value(ruleId);
+    if (m_rules.at(index).enabled())
         return RuleErrorNoError;
 
-    rule.setEnabled(true);
-    m_rules[ruleId] = rule;
+    m_rules[index].setEnabled(true);
+    Rule rule = ruleAt(index);
+    // The states and time might have changed while the rule was disabled
+    m_unsyncedRules.append(ruleId);
+    if (!rule.timeDescriptor().isEmpty()) {
+        scheduleTimeEvaluation(ruleId, QDateTime::fromMSecsSinceEpoch(0));
+    }
     saveRule(rule);
     emit ruleConfigurationChanged(rule);
 
@@ -548,17 +673,17 @@ RuleEngine::RuleError RuleEngine::enableRule(const RuleId &ruleId)
 */
 RuleEngine::RuleError RuleEngine::disableRule(const RuleId &ruleId)
 {
-    if (!m_rules.contains(ruleId)) {
+    if (!m_ruleIndexes.contains(ruleId)) {
         qCWarning(dcRuleEngine) << "Rule not found. Can't disable it";
         return RuleErrorRuleNotFound;
     }
 
-    Rule rule = m_rules.value(ruleId);
-    if (!rule.enabled())
+    int index = m_ruleIndexes.value(ruleId);
+    if (!m_rules.at(index).enabled())
         return RuleErrorNoError;
 
-    rule.setEnabled(false);
-    m_rules[ruleId] = rule;
+    m_rules[index].setEnabled(false);
+    Rule rule = ruleAt(index);
     saveRule(rule);
     emit ruleConfigurationChanged(rule);
 
@@ -575,12 +700,12 @@ RuleEngine::RuleError RuleEngine::disableRule(const RuleId &ruleId)
 RuleEngine::RuleError RuleEngine::executeActions(const RuleId &ruleId)
 {
     // check if rule exists
-    if (!m_rules.contains(ruleId)) {
+    if (!m_ruleIndexes.contains(ruleId)) {
         qCWarning(dcRuleEngine) << "Not executing rule actions: Rule not found.";
         return RuleErrorRuleNotFound;
     }
 
-    Rule rule = m_rules.value(ruleId);
+    Rule rule = ruleAt(m_ruleIndexes.value(ruleId));
 
     // check if rule is executable
     if (!rule.executable()) {
@@ -610,12 +735,12 @@ RuleEngine::RuleError RuleEngine::executeActions(const RuleId &ruleId)
 RuleEngine::RuleError RuleEngine::executeExitActions(const RuleId &ruleId)
 {
     // check if rule exits
-    if (!m_rules.contains(ruleId)) {
+    if (!m_ruleIndexes.contains(ruleId)) {
         qCWarning(dcRuleEngine) << "Not executing rule exit actions: rule not found.";
         return RuleErrorRuleNotFound;
     }
 
-    Rule rule = m_rules.value(ruleId);
+    Rule rule = ruleAt(m_ruleIndexes.value(ruleId));
 
     // check if rule is executable
     if (!rule.executable()) {
@@ -636,17 +761,18 @@ RuleEngine::RuleError RuleEngine::executeExitActions(const RuleId &ruleId)
 
 Rule RuleEngine::findRule(const RuleId &ruleId)
 {
-    if (!m_rules.contains(ruleId))
+    if (!m_ruleIndexes.contains(ruleId))
         return Rule();
 
-    return m_rules.value(ruleId);
+    return ruleAt(m_ruleIndexes.value(ruleId));
 }
 
 QList<RuleId> RuleEngine::findRules(const ThingId &thingId) const
 {
     // Find all offending rules
     QList<RuleId> offendingRules;
-    foreach (const Rule &rule, m_rules) {
+    foreach (const RuleId &ruleId, m_ruleIds) {
+        const Rule &rule = m_rules.at(m_ruleIndexes.value(ruleId));
         bool offending = false;
         foreach (const EventDescriptor &eventDescriptor, rule.eventDescriptors()) {
             if (eventDescriptor.thingId() == thingId) {
@@ -705,7 +831,8 @@ QList<RuleId> RuleEngine::findRules(const ThingId &thingId) const
 QList<ThingId> RuleEngine::thingsInRules() const
 {
     QList<ThingId> tmp;
-    foreach (const Rule &rule, m_rules) {
+    foreach (const RuleId &ruleId, m_ruleIds) {
+        const Rule &rule = m_rules.at(m_ruleIndexes.value(ruleId));
         foreach (const EventDescriptor &descriptor, rule.eventDescriptors()) {
             if (!tmp.contains(descriptor.thingId()) && !descriptor.thingId().isNull()) {
                 tmp.append(descriptor.thingId());
@@ -732,10 +859,10 @@ QList<ThingId> RuleEngine::thingsInRules() const
 
 void RuleEngine::removeThingFromRule(const RuleId &id, const ThingId &thingId)
 {
-    if (!m_rules.contains(id))
+    if (!m_ruleIndexes.contains(id))
         return;
 
-    Rule rule = m_rules.value(id);
+    Rule rule = m_rules.at(m_ruleIndexes.value(id));
 
     // remove thing from eventDescriptors
     QList<EventDescriptor> eventDescriptors = rule.eventDescriptors();
@@ -798,7 +925,7 @@ void RuleEngine::removeThingFromRule(const RuleId &id, const ThingId &thingId)
     if (actions.isEmpty() && exitActions.isEmpty()) {
         // The rule doesn't have any actions any more and is useless at this point... let's remove it altogether
         qCDebug(dcRuleEngine()) << "Rule" << rule.name() << "(" + rule.id().toString() + ")" << "does not have any actions any more. Removing it.";
-        m_rules.take(id);
+        eraseRule(id);
         emit ruleRemoved(id);
         return;
     }
@@ -811,11 +938,14 @@ void RuleEngine::removeThingFromRule(const RuleId &id, const ThingId &thingId)
     newRule.setTimeDescriptor(rule.timeDescriptor());
     newRule.setActions(actions);
     newRule.setExitActions(exitActions);
-    m_rules[id] = newRule;
+    updateRuleIndex(rule, false);
+    m_rules[m_ruleIndexes.value(id)] = newRule;
+    updateRuleIndex(newRule, true);
+    m_unsyncedRules.append(id);
 
     // save it
     saveRule(newRule);
-    emit ruleConfigurationChanged(newRule);
+    emit ruleConfigurationChanged(ruleAt(m_ruleIndexes.value(id)));
 }
 
 bool RuleEngine::containsEvent(const Rule &rule, const Event &event, const ThingClassId &thingClassId)
@@ -836,8 +966,8 @@ bool RuleEngine::containsEvent(const Rule &rule, const Event &event, const Thing
                 continue;
             }
 
-            EventType et = dc.eventTypes().findById(event.eventTypeId());
-            StateType st = dc.stateTypes().findById(event.eventTypeId());
+            const EventType &et = dc.eventType(event.eventTypeId());
+            const StateType &st = dc.stateType(StateTypeId(event.eventTypeId()));
             if (et.isValid()) {
                 if (et.name() != eventDescriptor.interfaceEvent()) {
                     // The fired event name does not match with the eventDescriptor's interfaceEvent
@@ -864,8 +994,8 @@ bool RuleEngine::containsEvent(const Rule &rule, const Event &event, const Thing
                     continue;
                 }
                 ThingClass dc = NymeaCore::instance()->thingManager()->findThingClass(thingClassId);
-                EventType et = dc.eventTypes().findById(event.eventTypeId());
-                StateType st = dc.stateTypes().findById(event.eventTypeId());
+                const EventType &et = dc.eventType(event.eventTypeId());
+                const StateType &st = dc.stateType(StateTypeId(event.eventTypeId()));
                 if (et.isValid()) {
                     ParamType pt = et.paramTypes().findByName(paramDescriptor.paramName());
                     paramValue = event.param(pt.id()).value();
@@ -1129,12 +1259,164 @@ QVariant::Type RuleEngine::getEventParamType(const EventTypeId &eventTypeId, con
 
 void RuleEngine::appendRule(const Rule &rule)
 {
-    Rule newRule = rule;
-    newRule.setStatesActive(newRule.stateEvaluator().evaluate());
-    newRule.setTimeActive(newRule.timeDescriptor().evaluate(QDateTime(), QDateTime::currentDateTime()));
-    qCDebug(dcRuleEngine()) << "Adding Rule:" << newRule;
-    m_rules.insert(rule.id(), newRule);
+    int index;
+    if (!m_freeRuleIndexes.isEmpty()) {
+        index = m_freeRuleIndexes.takeLast();
+        m_rules[index] = rule;
+    } else {
+        index = m_rules.count();
+        m_rules.append(rule);
+        m_activeRules.resize(m_rules.count());
+        m_statesActive.resize(m_rules.count());
+        m_timeActive.resize(m_rules.count());
+    }
+    m_ruleIndexes.insert(rule.id(), index);
     m_ruleIds.append(rule.id());
+
+    m_activeRules.clearBit(index);
+    m_statesActive.setBit(index, m_rules[index].evaluateStates());
+    const Rule &newRule = m_rules.at(index);
+    m_timeActive.setBit(index, newRule.timeDescriptor().evaluate(QDateTime(), QDateTime::currentDateTime()));
+    qCDebug(dcRuleEngine()) << "Adding Rule:" << ruleAt(index);
+    indexRule(newRule);
+    // Make sure the active state of state based rules is synced on the next event
+    m_unsyncedRules.append(rule.id());
+    // Time based rules get evaluated on the next time evaluation and scheduled from there on
+    if (!newRule.timeDescriptor().isEmpty()) {
+        scheduleTimeEvaluation(rule.id(), QDateTime::fromMSecsSinceEpoch(0));
+    }
+}
+
+/*! Removes the rule with the given \a ruleId from the rule storage, the indexes and the time schedule.
+    The index of the rule will be reused by the next rule added. */
+void RuleEngine::eraseRule(const RuleId &ruleId)
+{
+    int index = m_ruleIndexes.take(ruleId);
+    m_ruleIds.removeAll(ruleId);
+    unindexRule(m_rules.at(index));
+    scheduleTimeEvaluation(ruleId, QDateTime());
+    m_rules[index] = Rule();
+    m_activeRules.clearBit(index);
+    m_statesActive.clearBit(index);
+    m_timeActive.clearBit(index);
+    m_freeRuleIndexes.append(index);
+}
+
+/*! Returns a copy of the rule definition stored at the given \a index with its runtime state applied. */
+Rule RuleEngine::ruleAt(int index) const
+{
+    Rule rule = m_rules.at(index);
+    rule.setActive(m_activeRules.testBit(index));
+    rule.setStatesActive(m_statesActive.testBit(index));
+    rule.setTimeActive(m_timeActive.testBit(index));
+    return rule;
+}
+
+/*! Schedules the time evaluation of the rule with the given \a ruleId for the given \a dateTime, replacing
+    any previously scheduled evaluation. Passing an invalid \a dateTime removes the rule from the schedule. */
+void RuleEngine::scheduleTimeEvaluation(const RuleId &ruleId, const QDateTime &dateTime)
+{
+    if (m_scheduledTimes.contains(ruleId)) {
+        m_timeSchedule.remove(m_scheduledTimes.take(ruleId), ruleId);
+    }
+    if (dateTime.isValid()) {
+        m_timeSchedule.insert(dateTime, ruleId);
+        m_scheduledTimes.insert(ruleId, dateTime);
+    }
+}
+
+void RuleEngine::indexRule(const Rule &rule)
+{
+    m_ruleSequence.insert(rule.id(), m_ruleSequenceCounter++);
+    updateRuleIndex(rule, true);
+}
+
+void RuleEngine::unindexRule(const Rule &rule)
+{
+    updateRuleIndex(rule, false);
+    m_ruleSequence.remove(rule.id());
+    m_unsyncedRules.removeAll(rule.id());
+}
+
+void RuleEngine::updateRuleIndex(const Rule &rule, bool add)
+{
+    QUuid ruleId = rule.id();
+    auto updateThingIndex = [this, ruleId, add](const QUuid &thingId, const QUuid &typeId) {
+        if (thingId.isNull() || typeId.isNull()) {
+            return;
+        }
+        QPair<QUuid, QUuid> key(thingId, typeId);
+        if (add) {
+            if (!m_thingIndex[key].contains(ruleId)) {
+                m_thingIndex[key].append(ruleId);
+            }
+        } else if (m_thingIndex.contains(key)) {
+            m_thingIndex[key].removeAll(ruleId);
+            if (m_thingIndex.value(key).isEmpty()) {
+                m_thingIndex.remove(key);
+            }
+        }
+    };
+    auto updateInterfaceIndex = [this, ruleId, add](const QString &interface, const QString &name) {
+        QPair<QString, QString> key(interface, name);
+        if (add) {
+            if (!m_interfaceIndex[key].contains(ruleId)) {
+                m_interfaceIndex[key].append(ruleId);
+            }
+        } else if (m_interfaceIndex.contains(key)) {
+            m_interfaceIndex[key].removeAll(ruleId);
+            if (m_interfaceIndex.value(key).isEmpty()) {
+                m_interfaceIndex.remove(key);
+            }
+        }
+    };
+
+    foreach (const EventDescriptor &eventDescriptor, rule.eventDescriptors()) {
+        if (eventDescriptor.type() == EventDescriptor::TypeThing) {
+            updateThingIndex(eventDescriptor.thingId(), eventDescriptor.eventTypeId());
+        } else {
+            updateInterfaceIndex(eventDescriptor.interface(), eventDescriptor.interfaceEvent());
+        }
+    }
+
+    QList<StateEvaluator> stateEvaluators = {rule.stateEvaluator()};
+    while (!stateEvaluators.isEmpty()) {
+        StateEvaluator stateEvaluator = stateEvaluators.takeFirst();
+        StateDescriptor stateDescriptor = stateEvaluator.stateDescriptor();
+        if (stateDescriptor.isValid()) {
+            if (stateDescriptor.type() == StateDescriptor::TypeThing) {
+                updateThingIndex(stateDescriptor.thingId(), stateDescriptor.stateTypeId());
+            } else {
+                updateInterfaceIndex(stateDescriptor.interface(), stateDescriptor.interfaceState());
+            }
+            updateThingIndex(stateDescriptor.valueThingId(), stateDescriptor.valueStateTypeId());
+        }
+        stateEvaluators.append(stateEvaluator.childEvaluators());
+    }
+}
+
+/*! Returns the rules which may be affected by the given \a event in the order of ruleIds(). */
+QList<RuleId> RuleEngine::candidateRules(const Event &event, const ThingClass &thingClass) const
+{
+    QList<QUuid> candidates = m_thingIndex.value(qMakePair<QUuid, QUuid>(event.thingId(), event.eventTypeId()));
+
+    QString eventName = thingClass.eventType(event.eventTypeId()).name();
+    if (eventName.isEmpty()) {
+        eventName = thingClass.stateType(StateTypeId(event.eventTypeId())).name();
+    }
+    if (!eventName.isEmpty()) {
+        foreach (const QString &interface, thingClass.interfaces()) {
+            candidates.append(m_interfaceIndex.value(qMakePair(interface, eventName)));
+        }
+    }
+
+    candidates.append(m_unsyncedRules);
+
+    QMap<quint64, RuleId> sortedCandidates;
+    foreach (const QUuid &ruleId, candidates) {
+        sortedCandidates.insert(m_ruleSequence.value(ruleId), ruleId);
+    }
+    return sortedCandidates.values();
 }
 
 void RuleEngine::saveRule(const Rule &rule)
@@ -1556,7 +1838,6 @@ void RuleEngine::init()
         rule.setExitActions(exitActions);
         rule.setEnabled(enabled);
         rule.setExecutable(executable);
-        rule.setStatesActive(rule.stateEvaluator().evaluate());
         appendRule(rule);
         settings.endGroup();
     }
@@ -39,8 +39,16 @@
 #include <QObject>
 #include <QList>
 #include <QUuid>
+#include <QHash>
+#include <QVector>
+#include <QBitArray>
+#include <QPair>
+#include <QMultiMap>
+#include <QDateTime>
 #include <QSettings>
 
+class QThreadPool;
+
 namespace nymeaserver {
 
 class RuleEngine : public QObject
@@ -82,6 +90,9 @@ public:
     ~RuleEngine();
     void init();
 
+    bool parallelEvaluation() const;
+    void setParallelEvaluation(bool enabled, int maxThreads = 0);
+
     QList<Rule> evaluateEvent(const Event &event);
     QList<Rule> evaluateTime(const QDateTime &dateTime);
 
@@ -111,6 +122,12 @@ signals:
     void ruleConfigurationChanged(const Rule &rule);
 
 private:
+    struct StateEvaluation {
+        int index;
+        bool full;
+        bool result;
+    };
+
     bool containsEvent(const Rule &rule, const Event &event, const ThingClassId &thingClassId);
     bool containsState(const StateEvaluator &stateEvaluator, const Event &stateChangeEvent);
 
@@ -121,16 +138,48 @@ private:
     QVariant::Type getEventParamType(const EventTypeId &eventTypeId, const ParamTypeId &paramTypeId);
 
     void appendRule(const Rule &rule);
+    void eraseRule(const RuleId &ruleId);
+    Rule ruleAt(int index) const;
+    void indexRule(const Rule &rule);
+    void unindexRule(const Rule &rule);
+    void updateRuleIndex(const Rule &rule, bool add);
+    QList<RuleId> candidateRules(const Event &event, const ThingClass &thingClass) const;
+    void evaluateStates(QVector<StateEvaluation> &evaluations, const Event &event);
+    void scheduleTimeEvaluation(const RuleId &ruleId, const QDateTime &dateTime);
     void saveRule(const Rule &rule);
     void saveRuleActions(NymeaSettings *settings, const QList<RuleAction> &ruleActions);
     QList<RuleAction> loadRuleActions(NymeaSettings *settings);
 
 private:
     QList<RuleId> m_ruleIds; // Keeping a list of RuleIds to keep sorting order...
-    QHash<RuleId, Rule> m_rules; // ...but use a Hash for faster finding
-    QList<RuleId> m_activeRules;
+    QHash<QUuid, int> m_ruleIndexes; // ...and a dense index into the rule storage for faster finding
+
+    // Rule definitions, indexed by the dense rule index. Indexes of removed rules are reused.
+    QVector<Rule> m_rules;
+    QVector<int> m_freeRuleIndexes;
+
+    // Runtime state of the rules, indexed like m_rules
+    QBitArray m_activeRules;
+    QBitArray m_statesActive;
+    QBitArray m_timeActive;
+
+    // Inverted index to find the rules which can be affected by an event
+    QHash<QPair<QUuid, QUuid>, QList<QUuid>> m_thingIndex; // (thingId, eventTypeId/stateTypeId) -> ruleIds
+    QHash<QPair<QString, QString>, QList<QUuid>> m_interfaceIndex; // (interface, event/state name) -> ruleIds
+    QHash<QUuid, quint64> m_ruleSequence; // Insertion order of the rules, same as m_ruleIds
+    quint64 m_ruleSequenceCounter = 0;
+    QList<QUuid> m_unsyncedRules; // Rules which need to be evaluated on the next event regardless of the index
+
+    // Time based rules ordered by the next time their time descriptor needs to be evaluated
+    QMultiMap<QDateTime, QUuid> m_timeSchedule;
+    QHash<QUuid, QDateTime> m_scheduledTimes;
 
     QDateTime m_lastEvaluationTime;
+    // Stored separately as the offset of a local QDateTime follows the current time zone
+    int m_lastUtcOffset = 0;
+
+    // Worker threads evaluating the state evaluators of many rules at once, null if disabled
+    QThreadPool *m_threadPool = nullptr;
 };
 
 }
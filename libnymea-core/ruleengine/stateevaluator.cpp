@@ -30,6 +30,7 @@
 
 
 #include "stateevaluator.h"
+#include "thingstatesnapshot.h"
 #include "nymeacore.h"
 #include "integrations/thingmanager.h"
 #include "loggingcategories.h"
@@ -41,6 +42,7 @@ StateEvaluator::StateEvaluator(const StateDescriptor &stateDescriptor):
     m_stateDescriptor(stateDescriptor),
     m_operatorType(Types::StateOperatorAnd)
 {
+    updateDependencies();
 }
 
 StateEvaluator::StateEvaluator(QList<StateEvaluator> childEvaluators, Types::StateOperator stateOperator):
@@ -48,6 +50,7 @@ StateEvaluator::StateEvaluator(QList<StateEvaluator> childEvaluators, Types::Sta
     m_childEvaluators(childEvaluators),
     m_operatorType(stateOperator)
 {
+    updateDependencies();
 }
 
 StateDescriptor StateEvaluator::stateDescriptor() const
@@ -58,6 +61,7 @@ StateDescriptor StateEvaluator::stateDescriptor() const
 void StateEvaluator::setStateDescriptor(const StateDescriptor &stateDescriptor)
 {
     m_stateDescriptor = stateDescriptor;
+    updateDependencies();
 }
 
 StateEvaluators StateEvaluator::childEvaluators() const
@@ -68,11 +72,13 @@ StateEvaluators StateEvaluator::childEvaluators() const
 void StateEvaluator::setChildEvaluators(const StateEvaluators &stateEvaluators)
 {
     m_childEvaluators = stateEvaluators;
+    updateDependencies();
 }
 
 void StateEvaluator::appendEvaluator(const StateEvaluator &stateEvaluator)
 {
     m_childEvaluators.append(stateEvaluator);
+    updateDependencies();
 }
 
 Types::StateOperator StateEvaluator::operatorType() const
@@ -83,46 +89,187 @@ Types::StateOperator StateEvaluator::operatorType() const
 void StateEvaluator::setOperatorType(Types::StateOperator operatorType)
 {
     m_operatorType = operatorType;
+    m_evaluated = false;
 }
 
+/*! Evaluates the whole tree of this StateEvaluator and returns the result. The results of all
+    nodes in the tree are cached for subsequent calls to \l{evaluate(const ThingId &thingId, const StateTypeId &stateTypeId)}. */
 bool StateEvaluator::evaluate() const
+{
+    return evaluateTree(nullptr);
+}
+
+/*! Evaluates the whole tree of this StateEvaluator against the state values in the given \a snapshot instead
+    of the current thing states. The snapshot needs to contain all states captured by \l{captureStates()}.
+    This does not access the ThingManager and can be called from any thread. */
+bool StateEvaluator::evaluate(const ThingStateSnapshot &snapshot) const
+{
+    return evaluateTree(&snapshot);
+}
+
+bool StateEvaluator::evaluateTree(const ThingStateSnapshot *snapshot) const
 {
     qCDebug(dcRuleEngineDebug()) << "StateEvaluator:" << this << "Evaluating: Operator type" << m_operatorType << "Valid descriptor:" << m_stateDescriptor.isValid() << "Childs:" << m_childEvaluators.count();
-    bool descriptorMatching = true;
+    m_descriptorResult = true;
+    if (m_stateDescriptor.isValid()) {
+        m_descriptorResult = snapshot ? evaluateDescriptor(m_stateDescriptor, *snapshot) : evaluateDescriptor(m_stateDescriptor);
+    }
+
+    // Not short circuiting here so all the child results are cached
+    foreach (const StateEvaluator &stateEvaluator, m_childEvaluators) {
+        stateEvaluator.evaluateTree(snapshot);
+    }
+
+    m_result = combineResults(snapshot);
+    m_evaluated = true;
+    qCDebug(dcRuleEngineDebug()) << "StateEvaluator:" << this << "Evaluation result:" << m_result;
+    return m_result;
+}
+
+/*! Updates the evaluation after the state with the given \a stateTypeId of the thing with the given \a thingId
+    has changed and returns the result.
+
+    Only the descriptors depending on the given state are evaluated again, all other nodes of the tree return
+    their cached result. Propagating towards the root stops as soon as the result of a node doesn't change.
+*/
+bool StateEvaluator::evaluate(const ThingId &thingId, const StateTypeId &stateTypeId)
+{
+    QList<QPair<QString, QString>> interfaceStates;
+    if (!m_interfaceStates.isEmpty()) {
+        Thing *thing = NymeaCore::instance()->thingManager()->findConfiguredThing(thingId);
+        if (thing) {
+            const ThingClass &thingClass = thing->thingClass();
+            QString stateName = thingClass.stateType(stateTypeId).name();
+            foreach (const QString &interface, thingClass.interfaces()) {
+                interfaceStates.append(qMakePair(interface, stateName));
+            }
+        }
+    }
+    return reevaluate(qMakePair<QUuid, QUuid>(thingId, stateTypeId), interfaceStates, nullptr);
+}
+
+/*! Updates the evaluation after the state with the given \a stateTypeId of the thing with the given \a thingId
+    has changed, using the state values in the given \a snapshot, and returns the result. The snapshot needs to
+    contain the changed state as well as all states captured by \l{captureStates()}.
+
+    \sa evaluate(const ThingStateSnapshot &snapshot)
+*/
+bool StateEvaluator::evaluate(const ThingStateSnapshot &snapshot, const ThingId &thingId, const StateTypeId &stateTypeId)
+{
+    return reevaluate(qMakePair<QUuid, QUuid>(thingId, stateTypeId), snapshot.stateInterfaces(thingId, stateTypeId), &snapshot);
+}
+
+/*! Copies all the states this StateEvaluator depends on into the given \a snapshot. */
+void StateEvaluator::captureStates(ThingStateSnapshot *snapshot) const
+{
+    foreach (const QPair<QUuid, QUuid> &thingState, m_thingStates) {
+        snapshot->captureThingState(ThingId(thingState.first), StateTypeId(thingState.second));
+    }
+    foreach (const QPair<QString, QString> &interfaceState, m_interfaceStates) {
+        snapshot->captureInterfaceState(interfaceState.first, interfaceState.second);
+    }
+}
+
+bool StateEvaluator::reevaluate(const QPair<QUuid, QUuid> &thingState, const QList<QPair<QString, QString>> &interfaceStates, const ThingStateSnapshot *snapshot)
+{
+    if (!m_evaluated) {
+        return evaluateTree(snapshot);
+    }
+
+    bool changed = false;
     if (m_stateDescriptor.isValid()) {
-        descriptorMatching = evaluateDescriptor(m_stateDescriptor);
+        bool descriptorAffected = false;
+        if (m_stateDescriptor.type() == StateDescriptor::TypeThing) {
+            descriptorAffected = thingState == qMakePair<QUuid, QUuid>(m_stateDescriptor.thingId(), m_stateDescriptor.stateTypeId());
+        } else {
+            descriptorAffected = interfaceStates.contains(qMakePair(m_stateDescriptor.interface(), m_stateDescriptor.interfaceState()));
+        }
+        descriptorAffected |= thingState == qMakePair<QUuid, QUuid>(m_stateDescriptor.valueThingId(), m_stateDescriptor.valueStateTypeId());
+
+        if (descriptorAffected) {
+            bool descriptorResult = snapshot ? evaluateDescriptor(m_stateDescriptor, *snapshot) : evaluateDescriptor(m_stateDescriptor);
+            changed = descriptorResult != m_descriptorResult;
+            m_descriptorResult = descriptorResult;
+        }
+    }
+
+    for (int i = 0; i < m_childEvaluators.count(); i++) {
+        if (!m_childEvaluators.at(i).dependsOn(thingState, interfaceStates)) {
+            continue;
+        }
+        StateEvaluator &childEvaluator = m_childEvaluators[i];
+        bool previousResult = childEvaluator.m_result;
+        bool wasEvaluated = childEvaluator.m_evaluated;
+        if (childEvaluator.reevaluate(thingState, interfaceStates, snapshot) != previousResult || !wasEvaluated) {
+            changed = true;
+        }
+    }
+
+    if (changed) {
+        m_result = combineResults(snapshot);
+    }
+    return m_result;
+}
+
+bool StateEvaluator::dependsOn(const QPair<QUuid, QUuid> &thingState, const QList<QPair<QString, QString>> &interfaceStates) const
+{
+    if (m_thingStates.contains(thingState)) {
+        return true;
+    }
+    for (int i = 0; i < interfaceStates.count(); i++) {
+        if (m_interfaceStates.contains(interfaceStates.at(i))) {
+            return true;
+        }
     }
+    return false;
+}
 
+bool StateEvaluator::combineResults(const ThingStateSnapshot *snapshot) const
+{
     if (m_operatorType == Types::StateOperatorOr) {
-        if (m_stateDescriptor.isValid() && descriptorMatching) {
-            qCDebug(dcRuleEngineDebug()) << "StateEvaluator:" << this << "Descriptor is matching. Operator is OR => Evaluation result: true";
+        if (m_stateDescriptor.isValid() && m_descriptorResult) {
             return true;
         }
         foreach (const StateEvaluator &stateEvaluator, m_childEvaluators) {
-            if (stateEvaluator.evaluate()) {
-                qCDebug(dcRuleEngineDebug()) << "StateEvaluator:" << this << "Child evaluator evaluated to true. Operator is OR => Evaluation result: true";
+            if (stateEvaluator.m_evaluated ? stateEvaluator.m_result : stateEvaluator.evaluateTree(snapshot)) {
                 return true;
             }
         }
-        qCDebug(dcRuleEngineDebug()) << "StateEvaluator:" << this << "No child evaluator evaluated to true => Evaluation result: false";
         return false;
     }
 
-    if (!descriptorMatching) {
-        qCDebug(dcRuleEngineDebug()) << "StateEvaluator:" << this << "StateDescriptor not matching and operator is AND => Evaluation result: false";
+    if (!m_descriptorResult) {
         return false;
     }
-
     foreach (const StateEvaluator &stateEvaluator, m_childEvaluators) {
-        if (!stateEvaluator.evaluate()) {
-            qCDebug(dcRuleEngineDebug()) << "StateEvaluator:" << this << "Child evaluator not matching => Evaluation result: false";
+        if (!(stateEvaluator.m_evaluated ? stateEvaluator.m_result : stateEvaluator.evaluateTree(snapshot))) {
             return false;
         }
     }
-    qCDebug(dcRuleEngineDebug()) << "StateEvaluator:" << this << "StateDescriptor and all child evaluators matching => Evaluation result: true";
     return true;
 }
 
+void StateEvaluator::updateDependencies()
+{
+    m_thingStates.clear();
+    m_interfaceStates.clear();
+    if (m_stateDescriptor.isValid()) {
+        if (m_stateDescriptor.type() == StateDescriptor::TypeThing) {
+            m_thingStates.insert(qMakePair<QUuid, QUuid>(m_stateDescriptor.thingId(), m_stateDescriptor.stateTypeId()));
+        } else {
+            m_interfaceStates.insert(qMakePair(m_stateDescriptor.interface(), m_stateDescriptor.interfaceState()));
+        }
+        if (!m_stateDescriptor.valueThingId().isNull()) {
+            m_thingStates.insert(qMakePair<QUuid, QUuid>(m_stateDescriptor.valueThingId(), m_stateDescriptor.valueStateTypeId()));
+        }
+    }
+    foreach (const StateEvaluator &stateEvaluator, m_childEvaluators) {
+        m_thingStates.unite(stateEvaluator.m_thingStates);
+        m_interfaceStates.unite(stateEvaluator.m_interfaceStates);
+    }
+    m_evaluated = false;
+}
+
 bool StateEvaluator::containsThing(const ThingId &thingId) const
 {
     if (m_stateDescriptor.thingId() == thingId || m_stateDescriptor.valueThingId() == thingId)
@@ -144,6 +291,7 @@ void StateEvaluator::removeThing(const ThingId &thingId)
     for (int i = 0; i < m_childEvaluators.count(); i++) {
         m_childEvaluators[i].removeThing(thingId);
     }
+    updateDependencies();
 }
 
 QList<ThingId> StateEvaluator::containedThings() const
@@ -361,20 +509,7 @@ bool StateEvaluator::evaluateDescriptor(const StateDescriptor &descriptor) const
             if (!res) {
                 return false;
             }
-            switch (descriptor.operatorType()) {
-            case Types::ValueOperatorEquals:
-                return state.value() == convertedValue;
-            case Types::ValueOperatorGreater:
-                return state.value() > convertedValue;
-            case Types::ValueOperatorGreaterOrEqual:
-                return state.value() >= convertedValue;
-            case Types::ValueOperatorLess:
-                return state.value() < convertedValue;
-            case Types::ValueOperatorLessOrEqual:
-                return state.value() <= convertedValue;
-            case Types::ValueOperatorNotEquals:
-                return state.value() != convertedValue;
-            }
+            return compareValues(state.value(), descriptor.operatorType(), convertedValue);
 
         } else if (!descriptor.valueThingId().isNull() && !descriptor.valueStateTypeId().isNull()) {
             Thing *valueThing = NymeaCore::instance()->thingManager()->findConfiguredThing(descriptor.valueThingId());
@@ -389,20 +524,7 @@ bool StateEvaluator::evaluateDescriptor(const StateDescriptor &descriptor) const
             }
 
             qCDebug(dcRuleEngineDebug()) << "Comparing" << state.value() << "to" << valueState.value() << "with operator" << descriptor.operatorType();
-            switch (descriptor.operatorType()) {
-            case Types::ValueOperatorEquals:
-                return state.value() == valueState.value();
-            case Types::ValueOperatorGreater:
-                return state.value() > valueState.value();
-            case Types::ValueOperatorGreaterOrEqual:
-                return state.value() >= valueState.value();
-            case Types::ValueOperatorLess:
-                return state.value() < valueState.value();
-            case Types::ValueOperatorLessOrEqual:
-                return state.value() <= valueState.value();
-            case Types::ValueOperatorNotEquals:
-                return state.value() != valueState.value();
-            }
+            return compareValues(state.value(), descriptor.operatorType(), valueState.value());
         }
 
     } else { // Interface based
@@ -427,6 +549,65 @@ bool StateEvaluator::evaluateDescriptor(const StateDescriptor &descriptor) const
     return false;
 }
 
+bool StateEvaluator::evaluateDescriptor(const StateDescriptor &descriptor, const ThingStateSnapshot &snapshot) const
+{
+    if (descriptor.type() == StateDescriptor::TypeInterface) {
+        foreach (const QPair<QUuid, QUuid> &thingState, snapshot.interfaceStates(descriptor.interface(), descriptor.interfaceState())) {
+            // Generate a thing based state descriptor and run again
+            StateDescriptor temporaryDescriptor(StateTypeId(thingState.second), ThingId(thingState.first), descriptor.stateValue(), descriptor.operatorType());
+            temporaryDescriptor.setValueThingId(descriptor.valueThingId());
+            temporaryDescriptor.setValueStateTypeId(descriptor.valueStateTypeId());
+            if (evaluateDescriptor(temporaryDescriptor, snapshot)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    if (!snapshot.containsState(descriptor.thingId(), descriptor.stateTypeId())) {
+        qCWarning(dcRuleEngine()) << "State" << descriptor.stateTypeId().toString() << "of thing" << descriptor.thingId().toString() << "listed in state descriptor not found in system.";
+        return false;
+    }
+    QVariant value = snapshot.stateValue(descriptor.thingId(), descriptor.stateTypeId());
+
+    if (!descriptor.stateValue().isNull()) {
+        QVariant convertedValue = descriptor.stateValue();
+        if (!convertedValue.convert(value.type())) {
+            return false;
+        }
+        return compareValues(value, descriptor.operatorType(), convertedValue);
+    }
+
+    if (!descriptor.valueThingId().isNull() && !descriptor.valueStateTypeId().isNull()) {
+        if (!snapshot.containsState(descriptor.valueThingId(), descriptor.valueStateTypeId())) {
+            qCWarning(dcRuleEngine()) << "State" << descriptor.valueStateTypeId().toString() << "of thing" << descriptor.valueThingId().toString() << "defined in statedescriptor value not found in system.";
+            return false;
+        }
+        return compareValues(value, descriptor.operatorType(), snapshot.stateValue(descriptor.valueThingId(), descriptor.valueStateTypeId()));
+    }
+
+    return false;
+}
+
+bool StateEvaluator::compareValues(const QVariant &value, Types::ValueOperator operatorType, const QVariant &referenceValue)
+{
+    switch (operatorType) {
+    case Types::ValueOperatorEquals:
+        return value == referenceValue;
+    case Types::ValueOperatorGreater:
+        return value > referenceValue;
+    case Types::ValueOperatorGreaterOrEqual:
+        return value >= referenceValue;
+    case Types::ValueOperatorLess:
+        return value < referenceValue;
+    case Types::ValueOperatorLessOrEqual:
+        return value <= referenceValue;
+    case Types::ValueOperatorNotEquals:
+        return value != referenceValue;
+    }
+    return false;
+}
+
 QDebug operator<<(QDebug dbg, const StateEvaluator &stateEvaluator)
 {
     dbg.nospace() << "StateEvaluator: Operator:" << stateEvaluator.operatorType() << endl << "  " << stateEvaluator.stateDescriptor() << endl;
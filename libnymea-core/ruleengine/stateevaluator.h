@@ -35,11 +35,14 @@
 #include "types/statedescriptor.h"
 
 #include <QDebug>
+#include <QSet>
+#include <QPair>
 
 class NymeaSettings;
 
 namespace nymeaserver {
 class StateEvaluator;
+class ThingStateSnapshot;
 
 class StateEvaluators: public QList<StateEvaluator>
 {
@@ -73,6 +76,10 @@ public:
     void setOperatorType(Types::StateOperator operatorType);
 
     bool evaluate() const;
+    bool evaluate(const ThingId &thingId, const StateTypeId &stateTypeId);
+    bool evaluate(const ThingStateSnapshot &snapshot) const;
+    bool evaluate(const ThingStateSnapshot &snapshot, const ThingId &thingId, const StateTypeId &stateTypeId);
+    void captureStates(ThingStateSnapshot *snapshot) const;
     bool containsThing(const ThingId &thingId) const;
 
     void removeThing(const ThingId &thingId);
@@ -85,13 +92,29 @@ public:
     bool isEmpty() const;
 
 private:
+    bool evaluateTree(const ThingStateSnapshot *snapshot) const;
     bool evaluateDescriptor(const StateDescriptor &descriptor) const;
+    bool evaluateDescriptor(const StateDescriptor &descriptor, const ThingStateSnapshot &snapshot) const;
+    static bool compareValues(const QVariant &value, Types::ValueOperator operatorType, const QVariant &referenceValue);
+    bool reevaluate(const QPair<QUuid, QUuid> &thingState, const QList<QPair<QString, QString>> &interfaceStates, const ThingStateSnapshot *snapshot);
+    bool dependsOn(const QPair<QUuid, QUuid> &thingState, const QList<QPair<QString, QString>> &interfaceStates) const;
+    bool combineResults(const ThingStateSnapshot *snapshot) const;
+    void updateDependencies();
 
 private:
     StateDescriptor m_stateDescriptor;
 
     QList<StateEvaluator> m_childEvaluators;
     Types::StateOperator m_operatorType;
+
+    // The states this evaluator and all its children depend on
+    QSet<QPair<QUuid, QUuid>> m_thingStates;
+    QSet<QPair<QString, QString>> m_interfaceStates;
+
+    // Cached results of the last evaluation
+    mutable bool m_evaluated = false;
+    mutable bool m_descriptorResult = true;
+    mutable bool m_result = false;
 };
 
 
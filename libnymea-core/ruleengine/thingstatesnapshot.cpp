@@ -0,0 +1,125 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2022, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+/*!
+    \class nymeaserver::ThingStateSnapshot
+    \brief Holds a copy of thing state values for evaluating \l{StateEvaluator}{StateEvaluators} outside of the main thread.
+
+    \ingroup rules
+    \inmodule core
+
+    The snapshot is filled on the main thread with the states a set of state evaluators depend on. Afterwards
+    it is only read, so it can be shared between the threads evaluating those state evaluators.
+
+    \sa StateEvaluator
+*/
+
+#include "thingstatesnapshot.h"
+#include "nymeacore.h"
+#include "integrations/thingmanager.h"
+
+namespace nymeaserver {
+
+ThingStateSnapshot::ThingStateSnapshot()
+{
+
+}
+
+/*! Copies the value of the state with the given \a stateTypeId of the thing with the given \a thingId into this snapshot. */
+void ThingStateSnapshot::captureThingState(const ThingId &thingId, const StateTypeId &stateTypeId)
+{
+    QPair<QUuid, QUuid> key(thingId, stateTypeId);
+    if (m_stateInterfaces.contains(key)) {
+        return;
+    }
+
+    Thing *thing = NymeaCore::instance()->thingManager()->findConfiguredThing(thingId);
+    if (!thing) {
+        return;
+    }
+
+    const ThingClass &thingClass = thing->thingClass();
+    QString stateName = thingClass.stateType(stateTypeId).name();
+    QList<QPair<QString, QString>> stateInterfaces;
+    foreach (const QString &interface, thingClass.interfaces()) {
+        stateInterfaces.append(qMakePair(interface, stateName));
+    }
+    m_stateInterfaces.insert(key, stateInterfaces);
+
+    State state = thing->state(stateTypeId);
+    if (!state.stateTypeId().isNull()) {
+        m_states.insert(key, state.value());
+    }
+}
+
+/*! Copies the value of the state with the given \a stateName of all things implementing the given \a interface into this snapshot. */
+void ThingStateSnapshot::captureInterfaceState(const QString &interface, const QString &stateName)
+{
+    QPair<QString, QString> key(interface, stateName);
+    if (m_interfaceStates.contains(key)) {
+        return;
+    }
+
+    QList<QPair<QUuid, QUuid>> thingStates;
+    foreach (Thing *thing, NymeaCore::instance()->thingManager()->configuredThings()) {
+        if (thing->thingClass().interfaces().contains(interface)) {
+            StateTypeId stateTypeId = thing->thingClass().stateTypes().findByName(stateName).id();
+            captureThingState(thing->id(), stateTypeId);
+            thingStates.append(qMakePair<QUuid, QUuid>(thing->id(), stateTypeId));
+        }
+    }
+    m_interfaceStates.insert(key, thingStates);
+}
+
+/*! Returns true if the snapshot contains a value for the state with the given \a stateTypeId of the thing with the given \a thingId. */
+bool ThingStateSnapshot::containsState(const ThingId &thingId, const StateTypeId &stateTypeId) const
+{
+    return m_states.contains(qMakePair<QUuid, QUuid>(thingId, stateTypeId));
+}
+
+/*! Returns the captured value of the state with the given \a stateTypeId of the thing with the given \a thingId. */
+QVariant ThingStateSnapshot::stateValue(const ThingId &thingId, const StateTypeId &stateTypeId) const
+{
+    return m_states.value(qMakePair<QUuid, QUuid>(thingId, stateTypeId));
+}
+
+/*! Returns the (thingId, stateTypeId) pairs of the state with the given \a stateName of all things implementing the given \a interface. */
+QList<QPair<QUuid, QUuid>> ThingStateSnapshot::interfaceStates(const QString &interface, const QString &stateName) const
+{
+    return m_interfaceStates.value(qMakePair(interface, stateName));
+}
+
+/*! Returns the (interface, state name) pairs the state with the given \a stateTypeId of the thing with the given \a thingId is known by. */
+QList<QPair<QString, QString>> ThingStateSnapshot::stateInterfaces(const ThingId &thingId, const StateTypeId &stateTypeId) const
+{
+    return m_stateInterfaces.value(qMakePair<QUuid, QUuid>(thingId, stateTypeId));
+}
+
+}
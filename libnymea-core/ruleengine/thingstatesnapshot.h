@@ -0,0 +1,68 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2022, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef THINGSTATESNAPSHOT_H
+#define THINGSTATESNAPSHOT_H
+
+#include "typeutils.h"
+
+#include <QHash>
+#include <QPair>
+#include <QUuid>
+#include <QVariant>
+
+namespace nymeaserver {
+
+class ThingStateSnapshot
+{
+public:
+    ThingStateSnapshot();
+
+    void captureThingState(const ThingId &thingId, const StateTypeId &stateTypeId);
+    void captureInterfaceState(const QString &interface, const QString &stateName);
+
+    bool containsState(const ThingId &thingId, const StateTypeId &stateTypeId) const;
+    QVariant stateValue(const ThingId &thingId, const StateTypeId &stateTypeId) const;
+
+    QList<QPair<QUuid, QUuid>> interfaceStates(const QString &interface, const QString &stateName) const;
+    QList<QPair<QString, QString>> stateInterfaces(const ThingId &thingId, const StateTypeId &stateTypeId) const;
+
+private:
+    // (thingId, stateTypeId) -> value
+    QHash<QPair<QUuid, QUuid>, QVariant> m_states;
+    // (thingId, stateTypeId) -> (interface, state name) for all interfaces of the thing
+    QHash<QPair<QUuid, QUuid>, QList<QPair<QString, QString>>> m_stateInterfaces;
+    // (interface, state name) -> (thingId, stateTypeId) of all things implementing the interface
+    QHash<QPair<QString, QString>, QList<QPair<QUuid, QUuid>>> m_interfaceStates;
+};
+
+}
+
+#endif // THINGSTATESNAPSHOT_H
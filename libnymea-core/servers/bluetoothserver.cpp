@@ -82,7 +82,8 @@ void BluetoothServer::sendData(const QUuid &clientId, const QByteArray &data)
         return;
 
     qCDebug(dcBluetoothServerTraffic()) << "Send data:" << qUtf8Printable(data);
-    client->write(data + '\n');
+    client->write(data);
+    client->write("\n", 1);
 }
 
 /*! Send the given \a data to the \a clients. */
@@ -92,6 +93,24 @@ void BluetoothServer::sendData(const QList<QUuid> &clients, const QByteArray &da
         sendData(client, data);
 }
 
+/*! Send \a data to the client with the given \a clientId as it is. */
+void BluetoothServer::sendRawData(const QUuid &clientId, const QByteArray &data)
+{
+    QBluetoothSocket *client = m_clientList.value(clientId);
+    if (!client)
+        return;
+
+    qCDebug(dcBluetoothServerTraffic()) << "Send raw data:" << data.size() << "bytes";
+    client->write(data);
+}
+
+/*! Returns the number of bytes not yet written to the client with the given \a clientId. */
+qint64 BluetoothServer::bytesToWrite(const QUuid &clientId) const
+{
+    QBluetoothSocket *client = m_clientList.value(clientId);
+    return client ? client->bytesToWrite() : 0;
+}
+
 void BluetoothServer::terminateClientConnection(const QUuid &clientId)
 {
     QBluetoothSocket *client = m_clientList.value(clientId);
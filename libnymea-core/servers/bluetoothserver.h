@@ -51,8 +51,10 @@ public:
 
     void sendData(const QUuid &clientId, const QByteArray &data) override;
     void sendData(const QList<QUuid> &clients, const QByteArray &data) override;
+    void sendRawData(const QUuid &clientId, const QByteArray &data) override;
 
     void terminateClientConnection(const QUuid &clientId) override;
+    qint64 bytesToWrite(const QUuid &clientId) const override;
 
 private:
     QBluetoothServer *m_server = nullptr;
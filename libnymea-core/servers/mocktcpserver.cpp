@@ -70,6 +70,11 @@ void MockTcpServer::sendData(const QList<QUuid> &clients, const QByteArray &data
     }
 }
 
+void MockTcpServer::sendRawData(const QUuid &clientId, const QByteArray &data)
+{
+    emit outgoingData(clientId, data);
+}
+
 void MockTcpServer::terminateClientConnection(const QUuid &clientId)
 {
     emit connectionTerminated(clientId);
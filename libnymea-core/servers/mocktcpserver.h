@@ -50,6 +50,7 @@ public:
 
     void sendData(const QUuid &clientId, const QByteArray &data) override;
     void sendData(const QList<QUuid> &clients, const QByteArray &data) override;
+    void sendRawData(const QUuid &clientId, const QByteArray &data) override;
     void terminateClientConnection(const QUuid &clientId) override;
 
 /************** Used for testing **************************/
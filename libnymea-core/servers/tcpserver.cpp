@@ -112,6 +112,13 @@ void TcpServer::sendData(const QList<QUuid> &clients, const QByteArray &data)
     }
 }
 
+/*! Returns the number of bytes not yet written to the client with the given \a clientId. */
+qint64 TcpServer::bytesToWrite(const QUuid &clientId) const
+{
+    QTcpSocket *client = m_clientList.value(clientId);
+    return client ? client->bytesToWrite() : 0;
+}
+
 void TcpServer::terminateClientConnection(const QUuid &clientId)
 {
     QTcpSocket *client = m_clientList.value(clientId);
@@ -128,7 +135,21 @@ void TcpServer::sendData(const QUuid &clientId, const QByteArray &data)
     client = m_clientList.value(clientId);
     if (client) {
         qCDebug(dcTcpServerTraffic()) << "Sending to client" << clientId.toString() << data;
-        client->write(data + '\n');
+        // Both end up in the socket's write buffer, no need to copy the data for the separator
+        client->write(data);
+        client->write("\n", 1);
+    } else {
+        qCWarning(dcTcpServer()) << "Client" << clientId.toString() << "unknown to this transport";
+    }
+}
+
+/*! Sending \a data to the client with the given \a clientId as it is.*/
+void TcpServer::sendRawData(const QUuid &clientId, const QByteArray &data)
+{
+    QTcpSocket *client = m_clientList.value(clientId);
+    if (client) {
+        qCDebug(dcTcpServerTraffic()) << "Sending" << data.size() << "raw bytes to client" << clientId.toString();
+        client->write(data);
     } else {
         qCWarning(dcTcpServer()) << "Client" << clientId.toString() << "unknown to this transport";
     }
@@ -86,8 +86,10 @@ public:
 
     void sendData(const QUuid &clientId, const QByteArray &data) override;
     void sendData(const QList<QUuid> &clients, const QByteArray &data) override;
+    void sendRawData(const QUuid &clientId, const QByteArray &data) override;
 
     void terminateClientConnection(const QUuid &clientId) override;
+    qint64 bytesToWrite(const QUuid &clientId) const override;
 
 private:
     QTimer *m_timer = nullptr;
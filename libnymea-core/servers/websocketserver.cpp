@@ -100,7 +100,11 @@ void WebSocketServer::sendData(const QUuid &clientId, const QByteArray &data)
     client = m_clientList.value(clientId);
     if (client) {
         qCDebug(dcWebSocketServerTraffic()) << "Sending data to client" << data;
-        client->sendTextMessage(data + '\n');
+        // Text messages are sent as QString anyway. Append the separator to the converted message
+        // instead of copying the data for it first.
+        QString message = QString::fromUtf8(data);
+        message.append(QLatin1Char('\n'));
+        client->sendTextMessage(message);
     } else {
         qCWarning(dcWebSocketServer()) << "Client" << clientId << "unknown to this transport";
     }
@@ -117,6 +121,30 @@ void WebSocketServer::sendData(const QList<QUuid> &clients, const QByteArray &da
     }
 }
 
+/*! Send the given binary \a data to the client with the given \a clientId as a binary websocket message.
+ *
+ * \sa TransportInterface::sendBinaryData()
+ */
+void WebSocketServer::sendBinaryData(const QUuid &clientId, const QByteArray &data)
+{
+    QWebSocket *client = m_clientList.value(clientId);
+    if (client) {
+        qCDebug(dcWebSocketServerTraffic()) << "Sending binary data to client" << data.toHex();
+        client->sendBinaryMessage(data);
+    } else {
+        qCWarning(dcWebSocketServer()) << "Client" << clientId << "unknown to this transport";
+    }
+}
+
+/*! Send the given \a data as it is to the client with the given \a clientId as a binary websocket message.
+ *
+ * \sa TransportInterface::sendRawData()
+ */
+void WebSocketServer::sendRawData(const QUuid &clientId, const QByteArray &data)
+{
+    sendBinaryData(clientId, data);
+}
+
 void WebSocketServer::terminateClientConnection(const QUuid &clientId)
 {
     QWebSocket *client = m_clientList.value(clientId);
@@ -126,6 +154,17 @@ void WebSocketServer::terminateClientConnection(const QUuid &clientId)
     }
 }
 
+/*! Returns the number of bytes not yet written to the client with the given \a clientId. */
+qint64 WebSocketServer::bytesToWrite(const QUuid &clientId) const
+{
+#if QT_VERSION >= QT_VERSION_CHECK(5,12,0)
+    QWebSocket *client = m_clientList.value(clientId);
+    return client ? client->bytesToWrite() : 0;
+#else
+    return TransportInterface::bytesToWrite(clientId);
+#endif
+}
+
 void WebSocketServer::onClientConnected()
 {
     // got a new client connected
@@ -168,7 +207,8 @@ void WebSocketServer::onBinaryMessageReceived(const QByteArray &data)
 {
     QWebSocket *client = qobject_cast<QWebSocket *>(sender());
     QUuid clientId = m_clientList.key(client);
-    qCDebug(dcWebSocketServerTraffic()) << "Binary message from" << clientId.toString() << ":" << data;
+    qCDebug(dcWebSocketServerTraffic()) << "Binary message from" << clientId.toString() << ":" << data.toHex();
+    emit dataAvailable(clientId, data);
 }
 
 void WebSocketServer::onTextMessageReceived(const QString &message)
@@ -72,6 +72,12 @@
     Pure virtual method for sending \a data to \a clients over the corresponding \l{TransportInterface}.
 */
 
+/*! \fn void nymeaserver::TransportInterface::sendRawData(const QUuid &clientId, const QByteArray &data);
+    Pure virtual method for sending \a data to the client with the id \a clientId exactly as it is, without appending
+    a message separator. This is used for compressed connections, where the separators are part of the compressed
+    stream. Message based transports send \a data as one binary message.
+*/
+
 /*! \fn void nymeaserver::TransportInterface::terminateClientConnection(const QUuid &clientId);
     Pure virtual method for terminating \a clients connection. The JSON RPC server might call this when a
     client violates the protocol. Transports should close the connection to the client.
@@ -113,6 +119,26 @@ ServerConfiguration TransportInterface::configuration() const
     return m_config;
 }
 
+/*! Sends the binary \a data, for example a CBOR encoded message, to the client with the given \a clientId.
+    The default implementation uses sendData(), which is fine for stream based transports. Transports which
+    distinguish between text and binary messages should override this.
+*/
+void TransportInterface::sendBinaryData(const QUuid &clientId, const QByteArray &data)
+{
+    sendData(clientId, data);
+}
+
+/*! Returns the number of bytes queued for the client with the given \a clientId which have not been written to
+    the connection yet. The JSON RPC server uses this to hold back coalescable notifications for clients which
+    don't keep up. The default implementation returns -1 for transports which can't tell, in which case the server
+    limits how much it writes per throttle interval instead.
+*/
+qint64 TransportInterface::bytesToWrite(const QUuid &clientId) const
+{
+    Q_UNUSED(clientId)
+    return -1;
+}
+
 /*! Set the name of this TransportInterface to the given \a serverName. */
 void TransportInterface::setServerName(const QString &serverName)
 {
@@ -49,9 +49,13 @@ public:
 
     virtual void sendData(const QUuid &clientId, const QByteArray &data) = 0;
     virtual void sendData(const QList<QUuid> &clients, const QByteArray &data) = 0;
+    virtual void sendBinaryData(const QUuid &clientId, const QByteArray &data);
+    virtual void sendRawData(const QUuid &clientId, const QByteArray &data) = 0;
 
     virtual void terminateClientConnection(const QUuid &clientId) = 0;
 
+    virtual qint64 bytesToWrite(const QUuid &clientId) const;
+
     void setConfiguration(const ServerConfiguration &config);
     ServerConfiguration configuration() const;
 
@@ -237,6 +237,7 @@ UserManager::UserError UserManager::removeUser(const QString &username)
 
     QString dropTokensQuery = QString("DELETE FROM tokens WHERE lower(username) = \"%1\";").arg(username.toLower());
     m_db.exec(dropTokensQuery);
+    removeCachedTokens(username);
 
     emit userRemoved(username);
     return UserErrorNoError;
@@ -246,7 +247,7 @@ UserManager::UserError UserManager::setUserScopes(const QString &username, Types
 {
     QString scopesString = Types::scopesToStringList(scopes).join(',');
     QSqlQuery setScopesQuery(m_db);
-    setScopesQuery.prepare("UPDATE users SET scopes = '%1' WHERE username = '%2'");
+    setScopesQuery.prepare("UPDATE users SET scopes = ? WHERE username = ?;");
     setScopesQuery.addBindValue(scopesString);
     setScopesQuery.addBindValue(username);
     setScopesQuery.exec();
@@ -254,6 +255,7 @@ UserManager::UserError UserManager::setUserScopes(const QString &username, Types
         qCWarning(dcUserManager()) << "Error updating scopes for user" << username << setScopesQuery.lastError().databaseText() << setScopesQuery.lastError().driverText();
         return UserErrorBackendError;
     }
+    removeCachedTokens(username);
 
     emit userChanged(username);
     return UserErrorNoError;
@@ -455,22 +457,45 @@ UserManager::UserError UserManager::removeToken(const QUuid &tokenId)
         return UserErrorTokenNotFound;
     }
 
+    QHash<QByteArray, CachedToken>::iterator it = m_tokenCache.begin();
+    while (it != m_tokenCache.end()) {
+        if (it->tokenId == tokenId) {
+            it = m_tokenCache.erase(it);
+        } else {
+            ++it;
+        }
+    }
+
     qCDebug(dcUserManager) << "Token" << tokenId << "removed from DB";
     return UserErrorNoError;
 }
 
-/*! Returns true, if the given \a token is valid. */
-bool UserManager::verifyToken(const QByteArray &token)
+/*! Returns true, if the given \a token is valid. If \a scopes is not null, it will be filled with the
+    permission scopes of the user owning the token.
+
+    Verified tokens are cached in memory, so subsequent calls with the same token don't hit the database.
+    The cache is invalidated by \l{removeToken}, \l{removeUser} and \l{setUserScopes}.
+*/
+bool UserManager::verifyToken(const QByteArray &token, Types::PermissionScopes *scopes)
 {
+    QHash<QByteArray, CachedToken>::const_iterator cached = m_tokenCache.constFind(token);
+    if (cached != m_tokenCache.constEnd()) {
+        if (scopes) {
+            *scopes = cached->scopes;
+        }
+        return true;
+    }
+
     if (!validateToken(token)) {
         qCWarning(dcUserManager) << "Token failed character validation" << token;
         return false;
     }
-    QString getTokenQuery = QString("SELECT * FROM tokens WHERE token = \"%1\";")
-            .arg(QString::fromUtf8(token));
-    QSqlQuery result = m_db.exec(getTokenQuery);
-    if (m_db.lastError().type() != QSqlError::NoError) {
-        qCWarning(dcUserManager) << "Query for token failed:" << m_db.lastError().databaseText() << m_db.lastError().driverText() << getTokenQuery;
+    QSqlQuery result(m_db);
+    result.prepare("SELECT id, username FROM tokens WHERE token = ?;");
+    result.addBindValue(QString::fromUtf8(token));
+    result.exec();
+    if (result.lastError().type() != QSqlError::NoError) {
+        qCWarning(dcUserManager) << "Query for token failed:" << result.lastError().databaseText() << result.lastError().driverText() << result.executedQuery();
         return false;
     }
     if (!result.first()) {
@@ -478,11 +503,22 @@ bool UserManager::verifyToken(const QByteArray &token)
         return false;
     }
     //qCDebug(dcUserManager) << "Token authorized for user" << result.value("username").toString();
+
+    CachedToken cachedToken;
+    cachedToken.tokenId = result.value("id").toUuid();
+    cachedToken.username = result.value("username").toString();
+    cachedToken.scopes = userInfo(cachedToken.username).scopes();
+    m_tokenCache.insert(token, cachedToken);
+
+    if (scopes) {
+        *scopes = cachedToken.scopes;
+    }
     return true;
 }
 
 bool UserManager::initDB()
 {
+    m_tokenCache.clear();
     m_db.close();
 
     if (!m_db.open()) {
@@ -670,6 +706,18 @@ void UserManager::dumpDBError(const QString &message)
     qCCritical(dcUserManager) << message << "Driver error:" << m_db.lastError().driverText() << "Database error:" << m_db.lastError().databaseText();
 }
 
+void UserManager::removeCachedTokens(const QString &username)
+{
+    QHash<QByteArray, CachedToken>::iterator it = m_tokenCache.begin();
+    while (it != m_tokenCache.end()) {
+        if (it->username.compare(username, Qt::CaseInsensitive) == 0) {
+            it = m_tokenCache.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
 void UserManager::onPushButtonPressed()
 {
     if (m_pushButtonTransaction.first == -1) {
@@ -36,6 +36,7 @@
 
 #include <QObject>
 #include <QSqlDatabase>
+#include <QHash>
 
 namespace nymeaserver {
 
@@ -81,7 +82,7 @@ public:
     UserError removeToken(const QUuid &tokenId);
 
 
-    bool verifyToken(const QByteArray &token);
+    bool verifyToken(const QByteArray &token, Types::PermissionScopes *scopes = nullptr);
 
 signals:
     void userAdded(const QString &username);
@@ -97,6 +98,7 @@ private:
     bool validateToken(const QByteArray &token) const;
 
     void dumpDBError(const QString &message);
+    void removeCachedTokens(const QString &username);
 
 private slots:
     void onPushButtonPressed();
@@ -107,6 +109,13 @@ private:
     int m_pushButtonTransactionIdCounter = 0;
     QPair<int, QString> m_pushButtonTransaction;
 
+    struct CachedToken {
+        QUuid tokenId;
+        QString username;
+        Types::PermissionScopes scopes;
+    };
+    QHash<QByteArray, CachedToken> m_tokenCache;
+
 };
 }
 Q_DECLARE_METATYPE(nymeaserver::UserManager::UserError)
@@ -182,7 +182,7 @@ PluginId Thing::pluginId() const
 }
 
 /*! Returns the \l{ThingClass} of this thing. */
-ThingClass Thing::thingClass() const
+const ThingClass &Thing::thingClass() const
 {
     return m_thingClass;
 }
@@ -315,10 +315,17 @@ void Thing::setSettingValue(const QString &paramName, const QVariant &value)
     setSettingValue(paramTypeId, value);
 }
 
-/*! Returns the states of this thing. It must match the \l{StateType} description in the associated \l{ThingClass}. */
+/*! Returns the states of this thing. It must match the \l{StateType} description in the associated \l{ThingClass}.
+    The states are ordered by their slot, that is, in the same order as the \l{StateType}{StateTypes} of the \l{ThingClass}. */
 States Thing::states() const
 {
-    return m_states;
+    States states;
+    foreach (const State &state, m_states) {
+        if (!state.stateTypeId().isNull()) {
+            states.append(state);
+        }
+    }
+    return states;
 }
 
 /*! Returns true, a \l{Param} with the given \a paramTypeId exists for this thing. */
@@ -327,21 +334,26 @@ bool Thing::hasParam(const ParamTypeId &paramTypeId) const
     return m_params.hasParam(paramTypeId);
 }
 
-/*! Set the \l{State}{States} of this \l{Thing} to the given \a states.*/
+/*! Set the \l{State}{States} of this \l{Thing} to the given \a states.
+    Each state is stored in the slot the \l{ThingClass} assigns to its \l{StateType}. States not known to the
+    \l{ThingClass} are dropped. Slots without a given state stay unset, \l{hasState()} returns false for them. */
 void Thing::setStates(const States &states)
 {
-    m_states = states;
+    m_states.fill(State(), m_thingClass.stateTypes().count());
+    foreach (const State &state, states) {
+        int slot = m_thingClass.stateSlot(state.stateTypeId());
+        if (slot < 0) {
+            qCWarning(dcThing()) << "No such state type" << state.stateTypeId().toString() << "in" << m_name << "(" + m_thingClass.name() + ")";
+            continue;
+        }
+        m_states[slot] = state;
+    }
 }
 
 /*! Returns true, a \l{State} with the state given by \a stateTypeId exists for this thing. */
 bool Thing::hasState(const StateTypeId &stateTypeId) const
 {
-    foreach (const State &state, m_states) {
-        if (state.stateTypeId() == stateTypeId) {
-            return true;
-        }
-    }
-    return false;
+    return stateSlot(stateTypeId) >= 0;
 }
 
 /*! Finds the \l{State} matching the given \a stateTypeId in this thing and returns the current value. */
@@ -354,12 +366,11 @@ bool Thing::hasState(const QString &stateName) const
 /*! Finds the \l{State} matching the given \a stateTypeId in this thing and returns the current value. */
 QVariant Thing::stateValue(const StateTypeId &stateTypeId) const
 {
-    foreach (const State &state, m_states) {
-        if (state.stateTypeId() == stateTypeId) {
-            return state.value();
-        }
+    int slot = stateSlot(stateTypeId);
+    if (slot < 0) {
+        return QVariant();
     }
-    return QVariant();
+    return m_states.at(slot).value();
 }
 
 /*! Finds the \l{State} matching the given \a stateName in this thing and returns the current value. */
@@ -371,52 +382,51 @@ QVariant Thing::stateValue(const QString &stateName) const
 /*! Sets the value for the \l{State} matching the given \a stateTypeId in this thing to value. */
 void Thing::setStateValue(const StateTypeId &stateTypeId, const QVariant &value)
 {
-    StateType stateType = m_thingClass.stateTypes().findById(stateTypeId);
+    const StateType &stateType = m_thingClass.stateType(stateTypeId);
     if (!stateType.isValid()) {
         qCWarning(dcThing()) << "No such state type" << stateTypeId.toString() << "in" << m_name << "(" + thingClass().name() + ")";
         return;
     }
-    for (int i = 0; i < m_states.count(); ++i) {
-        if (m_states.at(i).stateTypeId() == stateTypeId) {
-            QVariant newValue = value;
-            if (!newValue.convert(stateType.type())) {
-                qCWarning(dcThing()).nospace() << m_name << ": Invalid value " << value << " for state " << stateType.name() << ". Type mismatch. Expected type: " << QVariant::typeToName(stateType.type()) << " (Discarding change)";
-                return;
-            }
-            State state = m_states.at(i);
-            if (state.minValue().isValid() && value < state.minValue()) {
-                qCWarning(dcThing()).nospace() << m_name << ": Invalid value " << value << " for state " << stateType.name() << ". Out of range: " << state.minValue() << " - " << state.maxValue() << " (Correcting to closest value within range)";
-                newValue = state.minValue();
-            }
-            if (state.maxValue().isValid() && value > state.maxValue()) {
-                qCWarning(dcThing()).nospace() << m_name << ": Invalid value " << value << " for state " << stateType.name() << ". Out of range: " << state.minValue() << " - " << state.maxValue() << " (Correcting to closest value within range)";
-                newValue = state.maxValue();
-            }
-            if (!stateType.possibleValues().isEmpty() && !stateType.possibleValues().contains(value)) {
-                qCWarning(dcThing()).nospace() << m_name << ": Invalid value " << value << " for state " << stateType.name() << ". Not an accepted value. Possible values: " << stateType.possibleValues() << " (Discarding change)";
-                return;
-            }
-
-            StateValueFilter *filter = m_stateValueFilters.value(stateTypeId);
-            if (filter) {
-                filter->addValue(newValue);
-                newValue = filter->filteredValue();
-            }
+    int slot = stateSlot(stateTypeId);
+    if (slot < 0) {
+        Q_ASSERT_X(false, m_name.toUtf8(), QString("Failed setting state %1 to %2").arg(stateType.name()).arg(value.toString()).toUtf8());
+        qCWarning(dcThing).nospace() << m_name << ": Failed setting state " << stateType.name() << "to" << value;
+        return;
+    }
+    QVariant newValue = value;
+    if (!newValue.convert(stateType.type())) {
+        qCWarning(dcThing()).nospace() << m_name << ": Invalid value " << value << " for state " << stateType.name() << ". Type mismatch. Expected type: " << QVariant::typeToName(stateType.type()) << " (Discarding change)";
+        return;
+    }
+    const State &state = m_states.at(slot);
+    if (state.minValue().isValid() && value < state.minValue()) {
+        qCWarning(dcThing()).nospace() << m_name << ": Invalid value " << value << " for state " << stateType.name() << ". Out of range: " << state.minValue() << " - " << state.maxValue() << " (Correcting to closest value within range)";
+        newValue = state.minValue();
+    }
+    if (state.maxValue().isValid() && value > state.maxValue()) {
+        qCWarning(dcThing()).nospace() << m_name << ": Invalid value " << value << " for state " << stateType.name() << ". Out of range: " << state.minValue() << " - " << state.maxValue() << " (Correcting to closest value within range)";
+        newValue = state.maxValue();
+    }
+    if (!stateType.possibleValues().isEmpty() && !stateType.possibleValues().contains(value)) {
+        qCWarning(dcThing()).nospace() << m_name << ": Invalid value " << value << " for state " << stateType.name() << ". Not an accepted value. Possible values: " << stateType.possibleValues() << " (Discarding change)";
+        return;
+    }
 
-            QVariant oldValue = m_states.at(i).value();
-            if (oldValue == newValue) {
-                qCDebug(dcThing()).nospace() << m_name << ": Discarding state change for " << stateType.name() << " as the value did not actually change. Old value:" << oldValue << "New value:" << newValue;
-                return;
-            }
+    StateValueFilter *filter = m_stateValueFilters.value(stateTypeId);
+    if (filter) {
+        filter->addValue(newValue);
+        newValue = filter->filteredValue();
+    }
 
-            qCDebug(dcThing()).nospace() << m_name << ": State " << stateType.name() << " changed from " << oldValue << " to " << newValue;
-            m_states[i].setValue(newValue);
-            emit stateValueChanged(stateTypeId, newValue, m_states.at(i).minValue(), m_states.at(i).maxValue());
-            return;
-        }
+    QVariant oldValue = m_states.at(slot).value();
+    if (oldValue == newValue) {
+        qCDebug(dcThing()).nospace() << m_name << ": Discarding state change for " << stateType.name() << " as the value did not actually change. Old value:" << oldValue << "New value:" << newValue;
+        return;
     }
-    Q_ASSERT_X(false, m_name.toUtf8(), QString("Failed setting state %1 to %2").arg(stateType.name()).arg(value.toString()).toUtf8());
-    qCWarning(dcThing).nospace() << m_name << ": Failed setting state " << stateType.name() << "to" << value;
+
+    qCDebug(dcThing()).nospace() << m_name << ": State " << stateType.name() << " changed from " << oldValue << " to " << newValue;
+    m_states[slot].setValue(newValue);
+    emit stateValueChanged(stateTypeId, newValue, m_states.at(slot).minValue(), m_states.at(slot).maxValue());
 }
 
 /*! Sets the value for the \l{State} matching the given \a stateName in this thing to value. */
@@ -429,37 +439,36 @@ void Thing::setStateValue(const QString &stateName, const QVariant &value)
 /*! Sets the minimum value for the \l{State} matching the given \a stateTypeId in this thing to value. */
 void Thing::setStateMinValue(const StateTypeId &stateTypeId, const QVariant &minValue)
 {
-    StateType stateType = m_thingClass.stateTypes().findById(stateTypeId);
+    const StateType &stateType = m_thingClass.stateType(stateTypeId);
     if (!stateType.isValid()) {
         qCWarning(dcThing()) << "No such state type" << stateTypeId.toString() << "in" << m_name << "(" + thingClass().name() + ")";
         return;
     }
-    for (int i = 0; i < m_states.count(); ++i) {
-        if (m_states.at(i).stateTypeId() == stateTypeId) {
-            QVariant newMin = minValue.isValid() ? minValue : stateType.minValue();
-
-            if (newMin == m_states.at(i).minValue()) {
-                return;
-            }
+    int slot = stateSlot(stateTypeId);
+    if (slot < 0) {
+        Q_ASSERT_X(false, m_name.toUtf8(), QString("Failed setting minimum state value %1 to %2").arg(stateType.name()).arg(minValue.toString()).toUtf8());
+        qCWarning(dcThing).nospace() << m_name << ": Failed setting minimum state value " << stateType.name() << " to " << minValue;
+        return;
+    }
+    QVariant newMin = minValue.isValid() ? minValue : stateType.minValue();
 
-            m_states[i].setMinValue(newMin);
+    if (newMin == m_states.at(slot).minValue()) {
+        return;
+    }
 
-            // Sanity check for max >= min
-            if (m_states.at(i).maxValue() < newMin) {
-                qCWarning(dcThing()) << "Adjusting state maximum value for" << stateType.name() << "from" << m_states.at(i).maxValue() << "to new minimum value of" << newMin;
-                m_states[i].setMaxValue(newMin);
-            }
-            if (m_states.at(i).value() < newMin) {
-                qCInfo(dcThing()) << "Adjusting state value for" << stateType.name() << "from" << m_states.at(i).value() << "to new minimum value of" << newMin;
-                m_states[i].setValue(newMin);
-            }
+    m_states[slot].setMinValue(newMin);
 
-            emit stateValueChanged(stateTypeId, m_states.at(i).value(), m_states.at(i).minValue(), m_states.at(i).maxValue());
-            return;
-        }
+    // Sanity check for max >= min
+    if (m_states.at(slot).maxValue() < newMin) {
+        qCWarning(dcThing()) << "Adjusting state maximum value for" << stateType.name() << "from" << m_states.at(slot).maxValue() << "to new minimum value of" << newMin;
+        m_states[slot].setMaxValue(newMin);
+    }
+    if (m_states.at(slot).value() < newMin) {
+        qCInfo(dcThing()) << "Adjusting state value for" << stateType.name() << "from" << m_states.at(slot).value() << "to new minimum value of" << newMin;
+        m_states[slot].setValue(newMin);
     }
-    Q_ASSERT_X(false, m_name.toUtf8(), QString("Failed setting minimum state value %1 to %2").arg(stateType.name()).arg(minValue.toString()).toUtf8());
-    qCWarning(dcThing).nospace() << m_name << ": Failed setting minimum state value " << stateType.name() << " to " << minValue;
+
+    emit stateValueChanged(stateTypeId, m_states.at(slot).value(), m_states.at(slot).minValue(), m_states.at(slot).maxValue());
 }
 
 /*! Sets the minimum value for the \l{State} matching the given \a stateName in this thing to value. */
@@ -472,40 +481,39 @@ void Thing::setStateMinValue(const QString &stateName, const QVariant &minValue)
 /*! Sets the maximum value for the \l{State} matching the given \a stateTypeId in this thing to value. */
 void Thing::setStateMaxValue(const StateTypeId &stateTypeId, const QVariant &maxValue)
 {
-    StateType stateType = m_thingClass.stateTypes().findById(stateTypeId);
+    const StateType &stateType = m_thingClass.stateType(stateTypeId);
     if (!stateType.isValid()) {
         qCWarning(dcThing()) << "No such state type" << stateTypeId.toString() << "in" << m_name << "(" + thingClass().name() + ")";
         return;
     }
-    for (int i = 0; i < m_states.count(); ++i) {
-        if (m_states.at(i).stateTypeId() == stateTypeId) {
-            QVariant newMax = maxValue.isValid() ? maxValue : stateType.maxValue();
-
-            if (newMax == m_states.at(i).maxValue()) {
-                return;
-            }
+    int slot = stateSlot(stateTypeId);
+    if (slot < 0) {
+        Q_ASSERT_X(false, m_name.toUtf8(), QString("Failed setting maximum state value %1 to %2").arg(stateType.name()).arg(maxValue.toString()).toUtf8());
+        qCWarning(dcThing).nospace() << m_name << ": Failed setting maximum state value " << stateType.name() << " t o" << maxValue;
+        return;
+    }
+    QVariant newMax = maxValue.isValid() ? maxValue : stateType.maxValue();
 
-            m_states[i].setMaxValue(newMax);
+    if (newMax == m_states.at(slot).maxValue()) {
+        return;
+    }
 
-            if (newMax.isValid()) {
-                // Sanity check for min <= max
-                if (m_states.at(i).minValue() > newMax) {
-                    qCWarning(dcThing()) << "Adjusting minimum state value for" << stateType.name() << "from" << m_states.at(i).minValue() << "to new maximum value of" << newMax;
-                    m_states[i].setMinValue(newMax);
-                }
+    m_states[slot].setMaxValue(newMax);
 
-                if (m_states.at(i).value() > newMax) {
-                    qCInfo(dcThing()) << "Adjusting state value for" << stateType.name() << "from" << m_states.at(i).value() << "to new maximum value of" << newMax;
-                    m_states[i].setValue(maxValue);
-                }
-            }
+    if (newMax.isValid()) {
+        // Sanity check for min <= max
+        if (m_states.at(slot).minValue() > newMax) {
+            qCWarning(dcThing()) << "Adjusting minimum state value for" << stateType.name() << "from" << m_states.at(slot).minValue() << "to new maximum value of" << newMax;
+            m_states[slot].setMinValue(newMax);
+        }
 
-            emit stateValueChanged(stateTypeId, m_states.at(i).value(), m_states.at(i).minValue(), m_states.at(i).maxValue());
-            return;
+        if (m_states.at(slot).value() > newMax) {
+            qCInfo(dcThing()) << "Adjusting state value for" << stateType.name() << "from" << m_states.at(slot).value() << "to new maximum value of" << newMax;
+            m_states[slot].setValue(maxValue);
         }
     }
-    Q_ASSERT_X(false, m_name.toUtf8(), QString("Failed setting maximum state value %1 to %2").arg(stateType.name()).arg(maxValue.toString()).toUtf8());
-    qCWarning(dcThing).nospace() << m_name << ": Failed setting maximum state value " << stateType.name() << " t o" << maxValue;
+
+    emit stateValueChanged(stateTypeId, m_states.at(slot).value(), m_states.at(slot).minValue(), m_states.at(slot).maxValue());
 }
 
 /*! Sets the maximum value for the \l{State} matching the given \a stateName in this thing to value. */
@@ -517,47 +525,45 @@ void Thing::setStateMaxValue(const QString &stateName, const QVariant &maxValue)
 
 void Thing::setStateMinMaxValues(const StateTypeId &stateTypeId, const QVariant &minValue, const QVariant &maxValue)
 {
-    StateType stateType = m_thingClass.stateTypes().findById(stateTypeId);
+    const StateType &stateType = m_thingClass.stateType(stateTypeId);
     if (!stateType.isValid()) {
         qCWarning(dcThing()) << "No such state type" << stateTypeId.toString() << "in" << m_name << "(" + thingClass().name() + ")";
         return;
     }
-    for (int i = 0; i < m_states.count(); ++i) {
-        if (m_states.at(i).stateTypeId() == stateTypeId) {
-            QVariant newMin = minValue.isValid() ? minValue : stateType.minValue();
-            QVariant newMax = maxValue.isValid() ? maxValue : stateType.maxValue();
+    int slot = stateSlot(stateTypeId);
+    if (slot < 0) {
+        Q_ASSERT_X(false, m_name.toUtf8(), QString("Failed setting maximum state value %1 to %2").arg(stateType.name()).arg(maxValue.toString()).toUtf8());
+        qCWarning(dcThing).nospace() << m_name << ": Failed setting maximum state value " << stateType.name() << " t o" << maxValue;
+        return;
+    }
+    QVariant newMin = minValue.isValid() ? minValue : stateType.minValue();
+    QVariant newMax = maxValue.isValid() ? maxValue : stateType.maxValue();
 
-            if (newMin == m_states.at(i).minValue() && newMax == m_states.at(i).maxValue()) {
-                return;
-            }
+    if (newMin == m_states.at(slot).minValue() && newMax == m_states.at(slot).maxValue()) {
+        return;
+    }
 
-            m_states[i].setMinValue(newMin);
-            m_states[i].setMaxValue(newMax);
-
-            if (newMax.isValid() || newMax.isValid()) {
-                // Sanity check for min <= max
-                if (newMin > newMax) {
-                    qCWarning(dcThing()) << "Adjusting maximum state value for" << stateType.name() << "from" << m_states.at(i).maxValue() << "to new minimum value of" << newMax;
-                    m_states[i].setMaxValue(newMin);
-                }
-
-                if (m_states.at(i).value() < m_states.at(i).minValue()) {
-                    qCInfo(dcThing()) << "Adjusting state value for" << stateType.name() << "from" << m_states.at(i).value() << "to new minimum value of" << m_states.at(i).minValue();
-                    m_states[i].setValue(m_states.at(i).minValue());
-                }
-                if (m_states.at(i).value() > m_states.at(i).maxValue()) {
-                    qCInfo(dcThing()) << "Adjusting state value for" << stateType.name() << "from" << m_states.at(i).value() << "to new maximum value of" << m_states.at(i).maxValue();
-                    m_states[i].setValue(m_states.at(i).maxValue());
-                }
-            }
+    m_states[slot].setMinValue(newMin);
+    m_states[slot].setMaxValue(newMax);
+
+    if (newMax.isValid() || newMax.isValid()) {
+        // Sanity check for min <= max
+        if (newMin > newMax) {
+            qCWarning(dcThing()) << "Adjusting maximum state value for" << stateType.name() << "from" << m_states.at(slot).maxValue() << "to new minimum value of" << newMax;
+            m_states[slot].setMaxValue(newMin);
+        }
 
-            emit stateValueChanged(stateTypeId, m_states.at(i).value(), m_states.at(i).minValue(), m_states.at(i).maxValue());
-            return;
+        if (m_states.at(slot).value() < m_states.at(slot).minValue()) {
+            qCInfo(dcThing()) << "Adjusting state value for" << stateType.name() << "from" << m_states.at(slot).value() << "to new minimum value of" << m_states.at(slot).minValue();
+            m_states[slot].setValue(m_states.at(slot).minValue());
+        }
+        if (m_states.at(slot).value() > m_states.at(slot).maxValue()) {
+            qCInfo(dcThing()) << "Adjusting state value for" << stateType.name() << "from" << m_states.at(slot).value() << "to new maximum value of" << m_states.at(slot).maxValue();
+            m_states[slot].setValue(m_states.at(slot).maxValue());
         }
     }
-    Q_ASSERT_X(false, m_name.toUtf8(), QString("Failed setting maximum state value %1 to %2").arg(stateType.name()).arg(maxValue.toString()).toUtf8());
-    qCWarning(dcThing).nospace() << m_name << ": Failed setting maximum state value " << stateType.name() << " t o" << maxValue;
 
+    emit stateValueChanged(stateTypeId, m_states.at(slot).value(), m_states.at(slot).minValue(), m_states.at(slot).maxValue());
 }
 
 void Thing::setStateMinMaxValues(const QString &stateName, const QVariant &minValue, const QVariant &maxValue)
@@ -569,12 +575,11 @@ void Thing::setStateMinMaxValues(const QString &stateName, const QVariant &minVa
 /*! Returns the \l{State} with the given \a stateTypeId of this thing. */
 State Thing::state(const StateTypeId &stateTypeId) const
 {
-    for (int i = 0; i < m_states.count(); ++i) {
-        if (m_states.at(i).stateTypeId() == stateTypeId) {
-            return m_states.at(i);
-        }
+    int slot = stateSlot(stateTypeId);
+    if (slot < 0) {
+        return State(StateTypeId(), ThingId());
     }
-    return State(StateTypeId(), ThingId());
+    return m_states.at(slot);
 }
 
 /*! Returns the \l{State} with the given name of this thing. */
@@ -670,19 +675,29 @@ void Thing::setLoggedEventTypeIds(const QList<EventTypeId> loggedEventTypeIds)
     m_loggedEventTypeIds = loggedEventTypeIds;
 }
 
+int Thing::stateSlot(const StateTypeId &stateTypeId) const
+{
+    // Slots of states which have not been set hold an empty State
+    int slot = m_thingClass.stateSlot(stateTypeId);
+    if (slot < 0 || slot >= m_states.count() || m_states.at(slot).stateTypeId() != stateTypeId) {
+        return -1;
+    }
+    return slot;
+}
+
 void Thing::setStateValueFilter(const StateTypeId &stateTypeId, Types::StateValueFilter filter)
 {
-    for (int i = 0; i < m_states.count(); i++) {
-        if (m_states.at(i).stateTypeId() == stateTypeId) {
-            m_states[i].setFilter(filter);
-            StateValueFilter *stateValueFilter = m_stateValueFilters.take(stateTypeId);
-            if (stateValueFilter) {
-                delete stateValueFilter;
-            }
-            if (filter == Types::StateValueFilterAdaptive) {
-                m_stateValueFilters.insert(stateTypeId, new StateValueFilterAdaptive());
-            }
-        }
+    int slot = stateSlot(stateTypeId);
+    if (slot < 0) {
+        return;
+    }
+    m_states[slot].setFilter(filter);
+    StateValueFilter *stateValueFilter = m_stateValueFilters.take(stateTypeId);
+    if (stateValueFilter) {
+        delete stateValueFilter;
+    }
+    if (filter == Types::StateValueFilterAdaptive) {
+        m_stateValueFilters.insert(stateTypeId, new StateValueFilterAdaptive());
     }
 }
 
@@ -43,6 +43,7 @@
 #include <QObject>
 #include <QUuid>
 #include <QVariant>
+#include <QVector>
 
 class IntegrationPlugin;
 class StateValueFilter;
@@ -110,7 +111,7 @@ public:
     ThingClassId thingClassId() const;
     PluginId pluginId() const;
 
-    ThingClass thingClass() const;
+    const ThingClass &thingClass() const;
 
     Q_INVOKABLE QString name() const;
     Q_INVOKABLE void setName(const QString &name);
@@ -189,6 +190,8 @@ private:
     void setStateValueFilter(const StateTypeId &stateTypeId, Types::StateValueFilter filter);
 
 private:
+    int stateSlot(const StateTypeId &stateTypeId) const;
+
     ThingClass m_thingClass;
     PluginId m_pluginId;
     ThingId m_id;
@@ -196,7 +199,7 @@ private:
     QString m_name;
     ParamList m_params;
     ParamList m_settings;
-    States m_states;
+    QVector<State> m_states;
     bool m_autoCreated = false;
 
     ThingSetupStatus m_setupStatus = ThingSetupStatusNone;
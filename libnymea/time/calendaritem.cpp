@@ -140,6 +140,94 @@ bool CalendarItem::evaluate(const QDateTime &dateTime) const
     return dateTime >= m_dateTime && dateTime < m_dateTime.addSecs(duration() * 60);
 }
 
+/*! Returns the earliest point in time after the given \a dateTime at which the result of \l{evaluate()}
+    may change. The returned time is never later than the actual change, but it may be earlier, in which case
+    evaluating at that time will just return the same result again. Returns an invalid QDateTime if the result
+    won't change any more.
+*/
+QDateTime CalendarItem::nextTransition(const QDateTime &dateTime) const
+{
+    if (!m_startTime.isValid() && m_repeatingOption.mode() != RepeatingOption::RepeatingModeYearly) {
+        // One time calendar item
+        if (dateTime < m_dateTime) {
+            return m_dateTime;
+        }
+        QDateTime endDateTime = m_dateTime.addSecs(duration() * 60);
+        if (dateTime < endDateTime) {
+            return endDateTime;
+        }
+        return QDateTime();
+    }
+
+    bool hourly = m_startTime.isValid() && m_repeatingOption.mode() == RepeatingOption::RepeatingModeHourly;
+    QTime startTime = m_startTime.isValid() ? m_startTime : m_dateTime.time();
+
+    // Items repeating for at least their whole period are always active, see evaluate()
+    if (m_startTime.isValid()) {
+        switch (m_repeatingOption.mode()) {
+        case RepeatingOption::RepeatingModeHourly:
+            if (duration() >= 60)
+                return QDateTime();
+            break;
+        case RepeatingOption::RepeatingModeNone:
+        case RepeatingOption::RepeatingModeDaily:
+            if (duration() >= 1440)
+                return QDateTime();
+            break;
+        case RepeatingOption::RepeatingModeWeekly:
+            if (duration() >= 10080)
+                return QDateTime();
+            break;
+        default:
+            break;
+        }
+    }
+
+    // All the intervals start at startTime every hour or every day (weekly, monthly and yearly
+    // items start on a subset of those days). Take the next start and the next end of such an interval.
+    auto nextStart = [hourly, startTime](const QDateTime &after) {
+        QDateTime start = after;
+        if (hourly) {
+            start.setTime(QTime(after.time().hour(), startTime.minute(), startTime.second()));
+            if (start <= after)
+                start = start.addSecs(3600);
+        } else {
+            start.setTime(startTime);
+            if (start <= after)
+                start = start.addDays(1);
+        }
+        return start;
+    };
+
+    QDateTime transition = nextStart(dateTime);
+    QDateTime nextEnd = nextStart(dateTime.addSecs(-static_cast<qint64>(duration()) * 60)).addSecs(duration() * 60);
+    if (nextEnd < transition)
+        transition = nextEnd;
+
+    // evaluateHourly() only checks the interval starting in the current hour, so intervals
+    // reaching into the next hour end at the top of the hour
+    if (hourly && startTime.minute() * 60 + startTime.second() + duration() * 60 > 3600) {
+        QDateTime nextHour = dateTime;
+        nextHour.setTime(QTime(dateTime.time().hour(), 0));
+        nextHour = nextHour.addSecs(3600);
+        if (nextHour < transition)
+            transition = nextHour;
+    }
+
+    // Week and month day filters of hourly items change at midnight
+    if (hourly) {
+        QDateTime midnight = QDateTime(dateTime.date().addDays(1), QTime(0, 0), dateTime.timeSpec());
+        if (midnight < transition)
+            transition = midnight;
+    }
+
+    // Non existing local times (e.g. DST changes), just check again in a minute
+    if (!transition.isValid())
+        return dateTime.addSecs(60);
+
+    return transition;
+}
+
 bool CalendarItem::evaluateHourly(const QDateTime &dateTime) const
 {
     // If the duration is longer than a hour, this calendar item is always true
@@ -115,6 +115,27 @@ bool TimeDescriptor::evaluate(const QDateTime &lastEvaluationTime, const QDateTi
     return false;
 }
 
+/*! Returns the earliest point in time after the given \a dateTime at which \l{evaluate()} may return a
+    different result. Returns an invalid QDateTime if this \l{TimeDescriptor} will never change any more.
+*/
+QDateTime TimeDescriptor::nextEvaluation(const QDateTime &dateTime) const
+{
+    QDateTime next;
+    foreach (const CalendarItem &calendarItem, m_calendarItems) {
+        QDateTime transition = calendarItem.nextTransition(dateTime);
+        if (transition.isValid() && (!next.isValid() || transition < next)) {
+            next = transition;
+        }
+    }
+    foreach (const TimeEventItem &timeEventItem, m_timeEventItems) {
+        QDateTime occurrence = timeEventItem.nextOccurrence(dateTime);
+        if (occurrence.isValid() && (!next.isValid() || occurrence < next)) {
+            next = occurrence;
+        }
+    }
+    return next;
+}
+
 /*! Print a TimeDescriptor including the full lists of CalendarItems and TimeEventItems to QDebug. */
 QDebug operator<<(QDebug dbg, const TimeDescriptor &timeDescriptor)
 {
@@ -142,6 +142,52 @@ bool TimeEventItem::evaluate(const QDateTime &lastEvaluationTime, const QDateTim
     return lastEvaluationTime < m_dateTime && m_dateTime <= dateTime;
 }
 
+/*! Returns the earliest point in time after the given \a dateTime at which this \l{TimeEventItem} may trigger.
+    The returned time is never later than the actual event, but it may be earlier for items which only trigger on
+    some days. Returns an invalid QDateTime if this item won't trigger any more.
+*/
+QDateTime TimeEventItem::nextOccurrence(const QDateTime &dateTime) const
+{
+    if (m_time.isValid()) {
+        QDateTime next = dateTime;
+        switch (m_repeatingOption.mode()) {
+        case RepeatingOption::RepeatingModeHourly:
+            next.setTime(QTime(dateTime.time().hour(), m_time.minute(), m_time.second()));
+            if (next <= dateTime)
+                next = next.addSecs(3600);
+            break;
+        case RepeatingOption::RepeatingModeYearly:
+            // Never triggers, see evaluate()
+            return QDateTime();
+        default:
+            next.setTime(m_time);
+            if (next <= dateTime)
+                next = next.addDays(1);
+            break;
+        }
+        // Non existing local times (e.g. DST changes), just check again in a minute
+        if (!next.isValid())
+            return dateTime.addSecs(60);
+        return next;
+    }
+
+    if (m_repeatingOption.mode() == RepeatingOption::RepeatingModeYearly) {
+        for (int year = dateTime.date().year(); year <= dateTime.date().year() + 4; year++) {
+            QDateTime next = m_dateTime;
+            next.setDate(QDate(year, m_dateTime.date().month(), m_dateTime.date().day()));
+            if (next.isValid() && next > dateTime) {
+                return next;
+            }
+        }
+        return QDateTime();
+    }
+
+    if (m_dateTime > dateTime)
+        return m_dateTime;
+
+    return QDateTime();
+}
+
 /*! Print a TimeEvent to QDebug. */
 QDebug operator<<(QDebug dbg, const TimeEventItem &timeEventItem)
 {
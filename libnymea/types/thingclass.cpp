@@ -141,13 +141,19 @@ StateTypes ThingClass::stateTypes() const
 
 /*! Returns the \l{StateType} with the given \a stateTypeId of this \l{DeviceClass}.
  * If there is no matching \l{StateType}, an invalid \l{StateType} will be returned.*/
-StateType ThingClass::getStateType(const StateTypeId &stateTypeId)
+StateType ThingClass::getStateType(const StateTypeId &stateTypeId) const
 {
-    foreach (const StateType &stateType, m_stateTypes) {
-        if (stateType.id() == stateTypeId)
-            return stateType;
-    }
-    return StateType(StateTypeId());
+    return stateType(stateTypeId);
+}
+
+/*! Returns a reference to the \l{StateType} with the given \a stateTypeId of this \l{DeviceClass} without copying it.
+    If there is no matching \l{StateType}, a reference to an invalid \l{StateType} will be returned. The reference is
+    valid as long as this \l{DeviceClass} isn't modified or destroyed. */
+const StateType &ThingClass::stateType(const StateTypeId &stateTypeId) const
+{
+    static const StateType invalidStateType = StateType(StateTypeId());
+    int index = m_stateTypeIndexes.value(stateTypeId, -1);
+    return index >= 0 ? m_stateTypes.at(index) : invalidStateType;
 }
 
 /*! Set the \a stateTypes of this DeviceClass. \{Device}{Devices} created
@@ -155,17 +161,18 @@ StateType ThingClass::getStateType(const StateTypeId &stateTypeId)
 void ThingClass::setStateTypes(const StateTypes &stateTypes)
 {
     m_stateTypes = stateTypes;
+    m_stateTypeIndexes.clear();
+    for (int i = 0; i < m_stateTypes.count(); i++) {
+        if (!m_stateTypeIndexes.contains(m_stateTypes.at(i).id())) {
+            m_stateTypeIndexes.insert(m_stateTypes.at(i).id(), i);
+        }
+    }
 }
 
 /*! Returns true if this DeviceClass has a \l{StateType} with the given \a stateTypeId. */
 bool ThingClass::hasStateType(const StateTypeId &stateTypeId) const
 {
-    foreach (const StateType &stateType, m_stateTypes) {
-        if (stateType.id() == stateTypeId) {
-            return true;
-        }
-    }
-    return false;
+    return m_stateTypeIndexes.contains(stateTypeId);
 }
 
 bool ThingClass::hasStateType(const QString &stateTypeName) const
@@ -178,6 +185,14 @@ bool ThingClass::hasStateType(const QString &stateTypeName) const
     return false;
 }
 
+/*! Returns the slot of the \l{StateType} with the given \a stateTypeId, or -1 if this DeviceClass has no such \l{StateType}.
+    Slots are dense and stable for the lifetime of this DeviceClass: \l{Thing}{Things} of this class store their states
+    in a vector indexed by slot, in the same order as \l{stateTypes()}. */
+int ThingClass::stateSlot(const StateTypeId &stateTypeId) const
+{
+    return m_stateTypeIndexes.value(stateTypeId, -1);
+}
+
 /*! Returns the eventTypes of this DeviceClass. \{Device}{Devices} created
     from this \l{DeviceClass} must have their events matching to this template. */
 EventTypes ThingClass::eventTypes() const
@@ -190,17 +205,27 @@ EventTypes ThingClass::eventTypes() const
 void ThingClass::setEventTypes(const EventTypes &eventTypes)
 {
     m_eventTypes = eventTypes;
+    m_eventTypeIndexes.clear();
+    for (int i = 0; i < m_eventTypes.count(); i++) {
+        if (!m_eventTypeIndexes.contains(m_eventTypes.at(i).id())) {
+            m_eventTypeIndexes.insert(m_eventTypes.at(i).id(), i);
+        }
+    }
+}
+
+/*! Returns a reference to the \l{EventType} with the given \a eventTypeId of this \l{DeviceClass} without copying it.
+    If there is no matching \l{EventType}, a reference to an invalid \l{EventType} will be returned. */
+const EventType &ThingClass::eventType(const EventTypeId &eventTypeId) const
+{
+    static const EventType invalidEventType = EventType(EventTypeId());
+    int index = m_eventTypeIndexes.value(eventTypeId, -1);
+    return index >= 0 ? m_eventTypes.at(index) : invalidEventType;
 }
 
 /*! Returns true if this DeviceClass has a \l{EventType} with the given \a eventTypeId. */
 bool ThingClass::hasEventType(const EventTypeId &eventTypeId) const
 {
-    foreach (const EventType &eventType, m_eventTypes) {
-        if (eventType.id() == eventTypeId) {
-            return true;
-        }
-    }
-    return false;
+    return m_eventTypeIndexes.contains(eventTypeId);
 }
 
 bool ThingClass::hasEventType(const QString &eventTypeName) const
@@ -225,17 +250,27 @@ ActionTypes ThingClass::actionTypes() const
 void ThingClass::setActionTypes(const ActionTypes &actionTypes)
 {
     m_actionTypes = actionTypes;
+    m_actionTypeIndexes.clear();
+    for (int i = 0; i < m_actionTypes.count(); i++) {
+        if (!m_actionTypeIndexes.contains(m_actionTypes.at(i).id())) {
+            m_actionTypeIndexes.insert(m_actionTypes.at(i).id(), i);
+        }
+    }
+}
+
+/*! Returns a reference to the \l{ActionType} with the given \a actionTypeId of this \l{DeviceClass} without copying it.
+    If there is no matching \l{ActionType}, a reference to an invalid \l{ActionType} will be returned. */
+const ActionType &ThingClass::actionType(const ActionTypeId &actionTypeId) const
+{
+    static const ActionType invalidActionType = ActionType(ActionTypeId());
+    int index = m_actionTypeIndexes.value(actionTypeId, -1);
+    return index >= 0 ? m_actionTypes.at(index) : invalidActionType;
 }
 
 /*! Returns true if this DeviceClass has a \l{ActionType} with the given \a actionTypeId. */
 bool ThingClass::hasActionType(const ActionTypeId &actionTypeId) const
 {
-    foreach (const ActionType &actionType, m_actionTypes) {
-        if (actionType.id() == actionTypeId) {
-            return true;
-        }
-    }
-    return false;
+    return m_actionTypeIndexes.contains(actionTypeId);
 }
 
 bool ThingClass::hasActionType(const QString &actionTypeName) const
@@ -285,6 +320,21 @@ ParamTypes ThingClass::paramTypes() const
 void ThingClass::setParamTypes(const ParamTypes &params)
 {
     m_paramTypes = params;
+    m_paramTypeIndexes.clear();
+    for (int i = 0; i < m_paramTypes.count(); i++) {
+        if (!m_paramTypeIndexes.contains(m_paramTypes.at(i).id())) {
+            m_paramTypeIndexes.insert(m_paramTypes.at(i).id(), i);
+        }
+    }
+}
+
+/*! Returns a reference to the \l{ParamType} with the given \a paramTypeId of this \l{DeviceClass} without copying it.
+    If there is no matching \l{ParamType}, a reference to an invalid \l{ParamType} will be returned. */
+const ParamType &ThingClass::paramType(const ParamTypeId &paramTypeId) const
+{
+    static const ParamType invalidParamType;
+    int index = m_paramTypeIndexes.value(paramTypeId, -1);
+    return index >= 0 ? m_paramTypes.at(index) : invalidParamType;
 }
 
 /*! Returns the settings description of this DeviceClass. \{Device}{Devices} created
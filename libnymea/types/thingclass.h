@@ -41,6 +41,7 @@
 
 #include <QList>
 #include <QUuid>
+#include <QHash>
 
 class LIBNYMEA_EXPORT ThingClass
 {
@@ -104,17 +105,21 @@ public:
     void setDisplayName(const QString &displayName);
 
     StateTypes stateTypes() const;
-    StateType getStateType(const StateTypeId &stateTypeId);
+    const StateType &stateType(const StateTypeId &stateTypeId) const;
+    StateType getStateType(const StateTypeId &stateTypeId) const;
     void setStateTypes(const StateTypes &stateTypes);
     bool hasStateType(const StateTypeId &stateTypeId) const;
     bool hasStateType(const QString &stateTypeName) const;
+    int stateSlot(const StateTypeId &stateTypeId) const;
 
     EventTypes eventTypes() const;
+    const EventType &eventType(const EventTypeId &eventTypeId) const;
     void setEventTypes(const EventTypes &eventTypes);
     bool hasEventType(const EventTypeId &eventTypeId) const;
     bool hasEventType(const QString &eventTypeName) const;
 
     ActionTypes actionTypes() const;
+    const ActionType &actionType(const ActionTypeId &actionTypeId) const;
     void setActionTypes(const ActionTypes &actionTypes);
     bool hasActionType(const ActionTypeId &actionTypeId) const;
     bool hasActionType(const QString &actionTypeName) const;
@@ -127,6 +132,7 @@ public:
     bool hasBrowserItemActionType(const ActionTypeId &actionTypeId);
 
     ParamTypes paramTypes() const;
+    const ParamType &paramType(const ParamTypeId &paramTypeId) const;
     void setParamTypes(const ParamTypes &paramTypes);
 
     ParamTypes settingsTypes() const;
@@ -171,6 +177,12 @@ private:
     DiscoveryType m_discoveryType = DiscoveryTypePrecise;
     QStringList m_interfaces;
     QStringList m_providedInterfaces;
+
+    // Id -> index lookup tables for the type lists above
+    QHash<QUuid, int> m_stateTypeIndexes;
+    QHash<QUuid, int> m_eventTypeIndexes;
+    QHash<QUuid, int> m_actionTypeIndexes;
+    QHash<QUuid, int> m_paramTypeIndexes;
 };
 
 Q_DECLARE_OPERATORS_FOR_FLAGS(ThingClass::CreateMethods)
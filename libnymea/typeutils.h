@@ -43,7 +43,7 @@ public: \
     type##Id(): QUuid() {} \
     static type##Id create##type##Id() { return type##Id(QUuid::createUuid()); } \
     bool operator==(const type##Id &other) const { \
-        return toString() == other.toString(); \
+        return QUuid::operator==(other); \
     } \
 }; \
 Q_DECLARE_METATYPE(type##Id);
@@ -197,7 +197,7 @@ QString HttpDaemon::generateWebPage()
         body.append("<form action=\"/setstate\" method=\"get\">");
         StateType stateType = thingClass.stateTypes().at(i);
         body.append("<td>" + stateType.name() + "</td>");
-        body.append(QString("<td><input type='input'' name='%1' value='%2'></td>").arg(stateType.id().toString()).arg(m_thing->states().at(i).value().toString()));
+        body.append(QString("<td><input type='input'' name='%1' value='%2'></td>").arg(stateType.id().toString()).arg(m_thing->stateValue(stateType.id()).toString()));
         body.append("<td><input type=submit value='Set State'/></td>");
         body.append("</form>");
         body.append("</tr>");
@@ -14,6 +14,8 @@ SUBDIRS = \
         rules \
         scripts \
         tags \
+        thingclass \
+        thingstatecache \
         timemanager \
         userloading \
         usermanager \
@@ -86,6 +86,11 @@ private slots:
 
     void stateCache();
 
+    void legacyStateCacheMigration_data();
+    void legacyStateCacheMigration();
+
+    void stateSlots();
+
     void discoverThings_data();
     void discoverThings();
 
@@ -156,6 +161,8 @@ private slots:
     void removeAutoThing();
 
     void discoverThingsParenting();
+
+    void benchmarkFindConfiguredThings();
 };
 
 void TestIntegrations::initTestCase()
@@ -720,6 +727,125 @@ void TestIntegrations::stateCache()
     spy.wait();
 }
 
+void TestIntegrations::stateSlots()
+{
+    Thing *thing = NymeaCore::instance()->thingManager()->findConfiguredThing(m_mockThingId);
+    QVERIFY(thing);
+    const ThingClass &thingClass = thing->thingClass();
+
+    // States are kept in slot order, that is, the order of the thing class' state types
+    States originalStates = thing->states();
+    QCOMPARE(originalStates.count(), thingClass.stateTypes().count());
+    for (int i = 0; i < originalStates.count(); i++) {
+        QCOMPARE(originalStates.at(i).stateTypeId(), thingClass.stateTypes().at(i).id());
+        QCOMPARE(thingClass.stateSlot(originalStates.at(i).stateTypeId()), i);
+        QVERIFY(thing->hasState(originalStates.at(i).stateTypeId()));
+        QCOMPARE(thing->state(originalStates.at(i).stateTypeId()).value(), originalStates.at(i).value());
+    }
+
+    // Only the given states are set, in slot order regardless of the order they're passed in
+    State intState = thing->state(mockIntStateTypeId);
+    State boolState = thing->state(mockBoolStateTypeId);
+    States states;
+    states.append(boolState);
+    states.append(intState);
+    states.append(State(StateTypeId::createStateTypeId(), thing->id()));
+    thing->setStates(states);
+
+    QVERIFY(thing->hasState(mockIntStateTypeId));
+    QVERIFY(thing->hasState(mockBoolStateTypeId));
+    QVERIFY(!thing->hasState(mockDoubleStateTypeId));
+    QVERIFY(thing->state(mockDoubleStateTypeId).stateTypeId().isNull());
+    QVERIFY(!thing->stateValue(mockDoubleStateTypeId).isValid());
+    QCOMPARE(thing->stateValue(mockIntStateTypeId), intState.value());
+    QCOMPARE(thing->states().count(), 2);
+    bool intFirst = thingClass.stateSlot(mockIntStateTypeId) < thingClass.stateSlot(mockBoolStateTypeId);
+    QCOMPARE(thing->states().first().stateTypeId(), intFirst ? StateTypeId(mockIntStateTypeId) : StateTypeId(mockBoolStateTypeId));
+
+    thing->setStates(originalStates);
+    QCOMPARE(thing->states().count(), originalStates.count());
+    QVERIFY(thing->hasState(mockDoubleStateTypeId));
+}
+
+void TestIntegrations::legacyStateCacheMigration_data()
+{
+    QTest::addColumn<bool>("perThingFile");
+    QTest::addColumn<bool>("corruptCache");
+
+    QTest::newRow("per thing cache file") << true << false;
+    QTest::newRow("thingstates.conf") << false << false;
+    QTest::newRow("per thing cache file, corrupt state cache") << true << true;
+}
+
+void TestIntegrations::legacyStateCacheMigration()
+{
+    QFETCH(bool, perThingFile);
+    QFETCH(bool, corruptCache);
+
+    Thing* thing = NymeaCore::instance()->thingManager()->findConfiguredThings(mockThingClassId).first();
+    ThingId thingId = thing->id();
+    int port = thing->paramValue(mockThingHttpportParamTypeId).toInt();
+    int defaultValue = thing->thingClass().getStateType(mockIntStateTypeId).defaultValue().toInt();
+    int legacyValue = defaultValue + 7;
+
+    stopServer();
+
+    // Things without an entry in the state cache are restored from the legacy cache
+    QString cacheFileName = NymeaSettings::cachePath() + "/thingstates.cache";
+    if (corruptCache) {
+        QFile cacheFile(cacheFileName);
+        QVERIFY(cacheFile.open(QFile::WriteOnly | QFile::Truncate));
+        cacheFile.write("corrupt");
+        cacheFile.close();
+    } else {
+        QFile::remove(cacheFileName);
+    }
+
+    QString legacyFileName;
+    if (perThingFile) {
+        legacyFileName = NymeaSettings::cachePath() + "/thingstates/" + thingId.toString().remove(QRegExp("[{}]")) + ".cache";
+    } else {
+        legacyFileName = NymeaSettings::settingsPath() + "/thingstates.conf";
+    }
+    QSettings *legacySettings = new QSettings(legacyFileName, QSettings::IniFormat);
+    if (!perThingFile) {
+        legacySettings->beginGroup(thingId.toString());
+    }
+    legacySettings->beginGroup(mockIntStateTypeId.toString());
+    legacySettings->setValue("value", legacyValue);
+    legacySettings->endGroup();
+    delete legacySettings;
+
+    startServer();
+
+    QVariantMap params;
+    params.insert("thingId", thingId);
+    params.insert("stateTypeId", mockIntStateTypeId);
+    QVariant response = injectAndWait("Integrations.GetStateValue", params);
+    QCOMPARE(response.toMap().value("params").toMap().value("value").toInt(), legacyValue);
+
+    // Migrated per thing files are cleaned up
+    if (perThingFile) {
+        QTRY_VERIFY(!QFile::exists(legacyFileName));
+    }
+
+    // The migrated value is restored from the state cache without the legacy cache
+    stopServer();
+    QFile::remove(legacyFileName);
+    startServer();
+
+    response = injectAndWait("Integrations.GetStateValue", params);
+    QCOMPARE(response.toMap().value("params").toMap().value("value").toInt(), legacyValue);
+
+    // Reset back to the default value
+    QNetworkAccessManager nam;
+    QSignalSpy spy(&nam, SIGNAL(finished(QNetworkReply*)));
+    QNetworkRequest request(QUrl(QString("http://localhost:%1/setstate?%2=%3").arg(port).arg(mockIntStateTypeId.toString()).arg(defaultValue)));
+    QNetworkReply *reply = nam.get(request);
+    connect(reply, &QNetworkReply::finished, reply, &QNetworkReply::deleteLater);
+    spy.wait();
+}
+
 void TestIntegrations::discoverThings_data()
 {
     QTest::addColumn<ThingClassId>("thingClassId");
@@ -2397,6 +2523,72 @@ void TestIntegrations::testTranslations()
 
 }
 
+void TestIntegrations::benchmarkFindConfiguredThings()
+{
+    if (qgetenv("WITH_BENCHMARK").isEmpty()) {
+        QSKIP("Skipping benchmark tests: export WITH_BENCHMARK=1 to enable it.");
+    }
+
+    // 100 lights with 19 temperature sensors each
+    QList<ThingId> parentIds;
+    QList<ThingId> thingIds;
+    NymeaSettings settings(NymeaSettings::SettingsRoleThings);
+    settings.beginGroup("ThingConfig");
+    for (int i = 0; i < 2000; i++) {
+        ThingId thingId = ThingId::createThingId();
+        settings.beginGroup(thingId.toString());
+        settings.setValue("pluginid", mockPluginId.toString());
+        if (i % 20 == 0) {
+            settings.setValue("thingName", QString("Benchmark light %1").arg(i));
+            settings.setValue("thingClassId", virtualIoLightMockThingClassId.toString());
+            parentIds.append(thingId);
+        } else {
+            settings.setValue("thingName", QString("Benchmark sensor %1").arg(i));
+            settings.setValue("thingClassId", virtualIoTemperatureSensorMockThingClassId.toString());
+            settings.setValue("parentid", parentIds.last().toString());
+        }
+        settings.endGroup();
+        thingIds.append(thingId);
+    }
+    settings.endGroup();
+    settings.sync();
+
+    restartServer();
+
+    ThingManager *thingManager = NymeaCore::instance()->thingManager();
+    QCOMPARE(thingManager->findConfiguredThings(virtualIoLightMockThingClassId).count(), 100);
+    QCOMPARE(thingManager->findConfiguredThings(virtualIoTemperatureSensorMockThingClassId).count(), 1900);
+    QCOMPARE(thingManager->findConfiguredThings("temperaturesensor").count(), 1900);
+    QCOMPARE(thingManager->findChilds(parentIds.first()).count(), 19);
+    int lightCount = thingManager->findConfiguredThings("light").count();
+    QVERIFY(lightCount >= 100);
+
+    int found = 0;
+    QBENCHMARK {
+        found = 0;
+        foreach (const ThingId &thingId, thingIds) {
+            if (thingManager->findConfiguredThing(thingId)) {
+                found++;
+            }
+        }
+        foreach (const ThingId &parentId, parentIds) {
+            found += thingManager->findChilds(parentId).count();
+            found += thingManager->findConfiguredThings(virtualIoLightMockThingClassId).count();
+            found += thingManager->findConfiguredThings("light").count();
+        }
+    }
+    QCOMPARE(found, 2000 + 100 * (19 + 100 + lightCount));
+
+    settings.beginGroup("ThingConfig");
+    foreach (const ThingId &thingId, thingIds) {
+        settings.remove(thingId.toString());
+    }
+    settings.endGroup();
+    settings.sync();
+
+    restartServer();
+}
+
 #include "testintegrations.moc"
 QTEST_MAIN(TestIntegrations)
 
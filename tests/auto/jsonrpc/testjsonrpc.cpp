@@ -35,6 +35,13 @@
 #include "servers/mocktcpserver.h"
 #include "usermanager/usermanager.h"
 #include "nymeadbusservice.h"
+#include "jsonrpc/jsonvalidator.h"
+#include "jsonrpc/messagecompressor.h"
+#include "jsonrpc/messageframer.h"
+
+#if QT_VERSION >= QT_VERSION_CHECK(5,12,0)
+#include <QCborValue>
+#endif
 
 using namespace nymeaserver;
 
@@ -78,6 +85,22 @@ private slots:
 
     void pluginConfigChangeEmitsNotification();
 
+    void notificationSerializedOncePerLocale();
+
+    void notificationFilters();
+
+    void notificationThrottle();
+    void notificationThrottleKeepsOrder();
+
+    void messageEncodingCbor();
+
+    void messageCompression();
+
+    void pipelinedCalls();
+    void lengthPrefixedFraming();
+    void lengthPrefixedFramingAfterHello_data();
+    void lengthPrefixedFramingAfterHello();
+
     /*
     Cases for push button auth:
 
@@ -118,6 +141,9 @@ private slots:
 
     void testGarbageData();
 
+    void benchmarkValidateParams_data();
+    void benchmarkValidateParams();
+
 private:
     QStringList extractRefs(const QVariant &variant);
 
@@ -967,6 +993,437 @@ void TestJSONRPC::pluginConfigChangeEmitsNotification()
     QCOMPARE(notificationData.first().toMap().value("notification").toString() == "Integrations.PluginConfigurationChanged", true);
 }
 
+void TestJSONRPC::notificationSerializedOncePerLocale()
+{
+    QVariantMap params;
+    params.insert("enabled", true);
+    QVariant response = injectAndWait("JSONRPC.SetNotificationStatus", params);
+    QCOMPARE(response.toMap().value("params").toMap().value("enabled").toBool(), true);
+
+    // Connect a second client with the same locale and a third one using another locale
+    QUuid bobId = QUuid::createUuid();
+    QUuid carolId = QUuid::createUuid();
+    m_mockTcpServer->clientConnected(bobId);
+    m_mockTcpServer->clientConnected(carolId);
+    injectAndWait("JSONRPC.Hello", QVariantMap(), bobId);
+    params.clear();
+    params.insert("locale", "de_DE");
+    injectAndWait("JSONRPC.Hello", params, carolId);
+    params.clear();
+    params.insert("enabled", true);
+    injectAndWait("JSONRPC.SetNotificationStatus", params, bobId);
+    injectAndWait("JSONRPC.SetNotificationStatus", params, carolId);
+
+    QSignalSpy clientSpy(m_mockTcpServer, SIGNAL(outgoingData(QUuid,QByteArray)));
+
+    params.clear();
+    params.insert("pluginId", mockPluginId);
+    QVariantList pluginParams;
+    QVariantMap param1;
+    param1.insert("paramTypeId",  mockPluginConfigParamIntParamTypeId);
+    param1.insert("value", 43);
+    pluginParams.append(param1);
+    params.insert("configuration", pluginParams);
+    response = injectAndWait("Integrations.SetPluginConfiguration", params);
+
+    QHash<QUuid, QByteArray> payloads;
+    for (int i = 0; i < clientSpy.count(); i++) {
+        QByteArray data = clientSpy.at(i).last().toByteArray();
+        if (data.contains("Integrations.PluginConfigurationChanged")) {
+            payloads.insert(clientSpy.at(i).first().toUuid(), data);
+        }
+    }
+    QCOMPARE(payloads.count(), 3);
+    QVERIFY2(payloads.value(m_clientId) == payloads.value(bobId), "Clients using the same locale should receive the same payload");
+    QCOMPARE(QJsonDocument::fromJson(payloads.value(carolId)).toVariant().toMap().value("id"),
+             QJsonDocument::fromJson(payloads.value(m_clientId)).toVariant().toMap().value("id"));
+
+    emit m_mockTcpServer->clientDisconnected(bobId);
+    emit m_mockTcpServer->clientDisconnected(carolId);
+}
+
+void TestJSONRPC::notificationFilters()
+{
+    QVariantMap filter;
+    filter.insert("notifications", QStringList() << "Integrations.StateChanged");
+    filter.insert("thingIds", QVariantList() << m_mockThingId);
+    filter.insert("stateTypeIds", QVariantList() << mockIntStateTypeId);
+
+    QVariantMap params;
+    params.insert("namespaces", QStringList() << "Integrations");
+    // Convert to Json and back to get the uuids without braces
+    params.insert("filters", QVariantList() << QJsonDocument::fromVariant(filter).toVariant());
+    QVariant response = injectAndWait("JSONRPC.SetNotificationStatus", params);
+    QCOMPARE(response.toMap().value("status").toString(), QString("success"));
+    QCOMPARE(response.toMap().value("params").toMap().value("namespaces").toStringList(), QStringList() << "Integrations");
+
+    QNetworkAccessManager nam;
+    QSignalSpy clientSpy(m_mockTcpServer, SIGNAL(outgoingData(QUuid,QByteArray)));
+
+    // A state which doesn't match the filter
+    QNetworkRequest request(QUrl(QString("http://localhost:%1/setstate?%2=%3").arg(m_mockThing1Port).arg(mockBoolStateTypeId.toString()).arg("true")));
+    QNetworkReply *reply = nam.get(request);
+    connect(reply, SIGNAL(finished()), reply, SLOT(deleteLater()));
+    QSignalSpy replySpy(reply, SIGNAL(finished()));
+    replySpy.wait();
+
+    // And one which does
+    request.setUrl(QUrl(QString("http://localhost:%1/setstate?%2=%3").arg(m_mockThing1Port).arg(mockIntStateTypeId.toString()).arg(77)));
+    reply = nam.get(request);
+    connect(reply, SIGNAL(finished()), reply, SLOT(deleteLater()));
+    if (clientSpy.count() == 0) clientSpy.wait();
+    clientSpy.wait(200);
+
+    QVariantList stateChangedVariants = checkNotifications(clientSpy, "Integrations.StateChanged");
+    QCOMPARE(stateChangedVariants.count(), 1);
+    QCOMPARE(stateChangedVariants.first().toMap().value("params").toMap().value("stateTypeId").toUuid(), QUuid(mockIntStateTypeId));
+    QCOMPARE(stateChangedVariants.first().toMap().value("params").toMap().value("value").toInt(), 77);
+
+    QCOMPARE(disableNotifications(), true);
+}
+
+void TestJSONRPC::notificationThrottle()
+{
+    QVariantMap params;
+    params.insert("namespaces", QStringList() << "Integrations");
+    params.insert("throttle", 500);
+    QVariant response = injectAndWait("JSONRPC.SetNotificationStatus", params);
+    QCOMPARE(response.toMap().value("status").toString(), QString("success"));
+
+    QNetworkAccessManager nam;
+    QSignalSpy clientSpy(m_mockTcpServer, SIGNAL(outgoingData(QUuid,QByteArray)));
+
+    // Change the same state a few times within the throttle interval
+    QList<int> values = {31, 32, 33};
+    foreach (int value, values) {
+        QNetworkRequest request(QUrl(QString("http://localhost:%1/setstate?%2=%3").arg(m_mockThing1Port).arg(mockIntStateTypeId.toString()).arg(value)));
+        QNetworkReply *reply = nam.get(request);
+        connect(reply, SIGNAL(finished()), reply, SLOT(deleteLater()));
+        QSignalSpy replySpy(reply, SIGNAL(finished()));
+        replySpy.wait();
+    }
+    QCOMPARE(checkNotifications(clientSpy, "Integrations.StateChanged").count(), 0);
+
+    // Only the latest value is sent once the interval passed
+    clientSpy.wait(1000);
+    QVariantList stateChangedVariants = checkNotifications(clientSpy, "Integrations.StateChanged");
+    QCOMPARE(stateChangedVariants.count(), 1);
+    QCOMPARE(stateChangedVariants.first().toMap().value("params").toMap().value("stateTypeId").toUuid(), QUuid(mockIntStateTypeId));
+    QCOMPARE(stateChangedVariants.first().toMap().value("params").toMap().value("value").toInt(), 33);
+
+    QCOMPARE(disableNotifications(), true);
+}
+
+void TestJSONRPC::notificationThrottleKeepsOrder()
+{
+    QVariantMap params;
+    params.insert("thingId", m_mockThingId);
+    QVariant response = injectAndWait("Integrations.GetThings", params);
+    QString thingName = response.toMap().value("params").toMap().value("things").toList().first().toMap().value("name").toString();
+
+    params.clear();
+    params.insert("namespaces", QStringList() << "Integrations");
+    params.insert("throttle", 5000);
+    response = injectAndWait("JSONRPC.SetNotificationStatus", params);
+    QCOMPARE(response.toMap().value("status").toString(), QString("success"));
+
+    QNetworkAccessManager nam;
+    QSignalSpy clientSpy(m_mockTcpServer, SIGNAL(outgoingData(QUuid,QByteArray)));
+
+    QNetworkRequest request(QUrl(QString("http://localhost:%1/setstate?%2=%3").arg(m_mockThing1Port).arg(mockIntStateTypeId.toString()).arg(41)));
+    QNetworkReply *reply = nam.get(request);
+    connect(reply, SIGNAL(finished()), reply, SLOT(deleteLater()));
+    QSignalSpy replySpy(reply, SIGNAL(finished()));
+    replySpy.wait();
+    QCOMPARE(checkNotifications(clientSpy, "Integrations.StateChanged").count(), 0);
+
+    // A notification which isn't throttled must not overtake the held back state change
+    params.clear();
+    params.insert("thingId", m_mockThingId);
+    params.insert("name", "Throttled thing");
+    response = injectAndWait("Integrations.EditThing", params);
+    verifyError(response, "thingError", "ThingErrorNoError");
+
+    QStringList notifications;
+    for (int i = 0; i < clientSpy.count(); i++) {
+        QVariantMap message = QJsonDocument::fromJson(clientSpy.at(i).last().toByteArray()).toVariant().toMap();
+        if (message.contains("notification")) {
+            notifications.append(message.value("notification").toString());
+        }
+    }
+    QCOMPARE(notifications.count("Integrations.StateChanged"), 1);
+    QCOMPARE(notifications.count("Integrations.ThingChanged"), 1);
+    QVERIFY(notifications.indexOf("Integrations.StateChanged") < notifications.indexOf("Integrations.ThingChanged"));
+
+    QCOMPARE(disableNotifications(), true);
+
+    params.clear();
+    params.insert("thingId", m_mockThingId);
+    params.insert("name", thingName);
+    response = injectAndWait("Integrations.EditThing", params);
+    verifyError(response, "thingError", "ThingErrorNoError");
+}
+
+void TestJSONRPC::messageEncodingCbor()
+{
+#if QT_VERSION >= QT_VERSION_CHECK(5,12,0)
+    QUuid newClientId = QUuid::createUuid();
+    m_mockTcpServer->clientConnected(newClientId);
+    qApp->processEvents();
+
+    // The Hello reply itself is still JSON
+    QVariantMap params;
+    params.insert("encoding", "MessageEncodingCbor");
+    QVariantMap response = injectAndWait("JSONRPC.Hello", params, newClientId).toMap();
+    QCOMPARE(response.value("status").toString(), QString("success"));
+    QCOMPARE(response.value("params").toMap().value("encoding").toString(), QString("MessageEncodingCbor"));
+
+    QSignalSpy spy(m_mockTcpServer, SIGNAL(outgoingData(QUuid,QByteArray)));
+
+    // Send a call split in two chunks to verify incomplete CBOR data is buffered
+    QVariantMap call;
+    call.insert("id", 4242);
+    call.insert("method", "JSONRPC.Version");
+    call.insert("token", m_apiToken);
+    QByteArray data = QCborValue::fromVariant(call).toCbor();
+    m_mockTcpServer->injectData(newClientId, data.left(5));
+    m_mockTcpServer->injectData(newClientId, data.mid(5));
+
+    if (spy.count() == 0) {
+        spy.wait();
+    }
+    QCOMPARE(spy.count(), 1);
+    QCOMPARE(spy.first().at(0).toUuid(), newClientId);
+
+    QCborParserError error;
+    QCborValue reply = QCborValue::fromCbor(spy.first().at(1).toByteArray(), &error);
+    QCOMPARE(error.error, QCborError::NoError);
+    QVariantMap replyMap = reply.toMap().toVariantMap();
+    QCOMPARE(replyMap.value("id").toInt(), 4242);
+    QCOMPARE(replyMap.value("status").toString(), QString("success"));
+    QCOMPARE(replyMap.value("params").toMap().value("version").toString(), QString(NYMEA_VERSION_STRING));
+
+    emit m_mockTcpServer->clientDisconnected(newClientId);
+#else
+    QSKIP("CBOR encoding requires Qt 5.12");
+#endif
+}
+
+void TestJSONRPC::messageCompression()
+{
+    QUuid newClientId = QUuid::createUuid();
+    emit m_mockTcpServer->clientConnected(newClientId);
+    qApp->processEvents();
+
+    // The Hello reply itself is not compressed yet
+    QVariantMap params;
+    params.insert("compression", "MessageCompressionDeflate");
+    QVariantMap response = injectAndWait("JSONRPC.Hello", params, newClientId).toMap();
+    QCOMPARE(response.value("status").toString(), QString("success"));
+    QCOMPARE(response.value("params").toMap().value("compression").toString(), QString("MessageCompressionDeflate"));
+
+    QVariantMap introspect = injectAndWait("JSONRPC.Introspect").toMap().value("params").toMap();
+
+    // Act as the client. Introspect is sent twice to get the precompressed reply from the cache too,
+    // followed by a regular call which may refer back to the precompressed data.
+    MessageCompressor client;
+    QVERIFY(client.isValid());
+    QSignalSpy spy(m_mockTcpServer, SIGNAL(outgoingData(QUuid,QByteArray)));
+    QStringList methods = {"JSONRPC.Introspect", "JSONRPC.Introspect", "JSONRPC.Version"};
+    for (int i = 0; i < methods.count(); i++) {
+        QVariantMap call;
+        call.insert("id", 100 + i);
+        call.insert("method", methods.at(i));
+        call.insert("token", m_apiToken);
+        m_mockTcpServer->injectData(newClientId, client.compress(QJsonDocument::fromVariant(call).toJson(QJsonDocument::Compact) + '\n'));
+    }
+
+    QByteArray decompressed;
+    for (int i = 0; i < spy.count(); i++) {
+        if (spy.at(i).at(0).toUuid() == newClientId) {
+            QVERIFY(client.decompress(spy.at(i).at(1).toByteArray(), &decompressed, 16 * 1024 * 1024));
+        }
+    }
+    QVERIFY(decompressed.endsWith('\n'));
+
+    QList<QVariantMap> replies;
+    foreach (const QByteArray &line, decompressed.split('\n')) {
+        if (line.isEmpty()) {
+            continue;
+        }
+        QJsonParseError error;
+        QJsonDocument jsonDoc = QJsonDocument::fromJson(line, &error);
+        QCOMPARE(error.error, QJsonParseError::NoError);
+        if (jsonDoc.toVariant().toMap().contains("id")) {
+            replies.append(jsonDoc.toVariant().toMap());
+        }
+    }
+    QCOMPARE(replies.count(), 3);
+    for (int i = 0; i < 2; i++) {
+        QCOMPARE(replies.at(i).value("id").toInt(), 100 + i);
+        QCOMPARE(replies.at(i).value("status").toString(), QString("success"));
+        QVERIFY2(replies.at(i).value("params").toMap() == introspect, "Compressed Introspect reply differs from the uncompressed one");
+    }
+    QCOMPARE(replies.at(2).value("id").toInt(), 102);
+    QCOMPARE(replies.at(2).value("params").toMap().value("version").toString(), QString(NYMEA_VERSION_STRING));
+
+    emit m_mockTcpServer->clientDisconnected(newClientId);
+}
+
+void TestJSONRPC::pipelinedCalls()
+{
+    QSignalSpy spy(m_mockTcpServer, SIGNAL(outgoingData(QUuid,QByteArray)));
+
+    // Three calls in one chunk, without any separator, where one of them contains brackets in a string
+    QByteArray data;
+    for (int i = 0; i < 3; i++) {
+        QVariantMap call;
+        call.insert("id", 200 + i);
+        call.insert("method", "JSONRPC.Version");
+        call.insert("token", m_apiToken);
+        call.insert("comment", "}\n{\"id\": 1} [");
+        data.append(QJsonDocument::fromVariant(call).toJson(QJsonDocument::Compact));
+    }
+    // And a fourth one, split right after a closing bracket within a string
+    QVariantMap call;
+    call.insert("id", 203);
+    call.insert("method", "JSONRPC.Version");
+    call.insert("token", m_apiToken);
+    call.insert("comment", "}");
+    QByteArray lastCall = QJsonDocument::fromVariant(call).toJson(QJsonDocument::Compact) + '\n';
+    int splitIndex = lastCall.indexOf("\"}\"") + 2;
+    data.append(lastCall.left(splitIndex));
+
+    m_mockTcpServer->injectData(m_clientId, data);
+    QCOMPARE(spy.count(), 3);
+    m_mockTcpServer->injectData(m_clientId, lastCall.mid(splitIndex));
+    QCOMPARE(spy.count(), 4);
+
+    for (int i = 0; i < spy.count(); i++) {
+        QJsonParseError error;
+        QVariantMap response = QJsonDocument::fromJson(spy.at(i).at(1).toByteArray(), &error).toVariant().toMap();
+        QCOMPARE(error.error, QJsonParseError::NoError);
+        QCOMPARE(response.value("id").toInt(), 200 + i);
+        QCOMPARE(response.value("status").toString(), QString("success"));
+    }
+}
+
+void TestJSONRPC::lengthPrefixedFraming()
+{
+    QUuid newClientId = QUuid::createUuid();
+    emit m_mockTcpServer->clientConnected(newClientId);
+    qApp->processEvents();
+
+    // The Hello reply itself is not length prefixed yet
+    QVariantMap params;
+    params.insert("framing", "MessageFramingLengthPrefixed");
+    QVariantMap response = injectAndWait("JSONRPC.Hello", params, newClientId).toMap();
+    QCOMPARE(response.value("status").toString(), QString("success"));
+    QCOMPARE(response.value("params").toMap().value("framing").toString(), QString("MessageFramingLengthPrefixed"));
+
+    QSignalSpy spy(m_mockTcpServer, SIGNAL(outgoingData(QUuid,QByteArray)));
+
+    QByteArray data;
+    for (int i = 0; i < 3; i++) {
+        QVariantMap call;
+        call.insert("id", 300 + i);
+        call.insert("method", "JSONRPC.Version");
+        call.insert("token", m_apiToken);
+        QByteArray payload = QJsonDocument::fromVariant(call).toJson(QJsonDocument::Compact);
+        data.append(MessageFramer::lengthPrefix(payload.size()));
+        data.append(payload);
+    }
+
+    // Two frames at once, then the third one split within its length prefix
+    int splitIndex = data.size() - data.size() / 3 + 2;
+    m_mockTcpServer->injectData(newClientId, data.left(splitIndex));
+    QCOMPARE(spy.count(), 2);
+    m_mockTcpServer->injectData(newClientId, data.mid(splitIndex));
+    QCOMPARE(spy.count(), 3);
+
+    for (int i = 0; i < spy.count(); i++) {
+        QCOMPARE(spy.at(i).at(0).toUuid(), newClientId);
+        QByteArray frame = spy.at(i).at(1).toByteArray();
+        QVERIFY(frame.size() > 4);
+        QCOMPARE(frame.left(4), MessageFramer::lengthPrefix(frame.size() - 4));
+        QJsonParseError error;
+        QVariantMap reply = QJsonDocument::fromJson(frame.mid(4), &error).toVariant().toMap();
+        QCOMPARE(error.error, QJsonParseError::NoError);
+        QCOMPARE(reply.value("id").toInt(), 300 + i);
+        QCOMPARE(reply.value("status").toString(), QString("success"));
+    }
+
+    // A frame larger than the limit drops the connection
+    QSignalSpy terminatedSpy(m_mockTcpServer, SIGNAL(connectionTerminated(QUuid)));
+    m_mockTcpServer->injectData(newClientId, MessageFramer::lengthPrefix(2 * 1024 * 1024));
+    QCOMPARE(terminatedSpy.count(), 1);
+    QCOMPARE(terminatedSpy.first().at(0).toUuid(), newClientId);
+
+    emit m_mockTcpServer->clientDisconnected(newClientId);
+}
+
+void TestJSONRPC::lengthPrefixedFramingAfterHello_data()
+{
+    QTest::addColumn<bool>("samePacket");
+
+    QTest::newRow("frame in the same packet as Hello") << true;
+    QTest::newRow("frame in the next packet") << false;
+}
+
+void TestJSONRPC::lengthPrefixedFramingAfterHello()
+{
+    QFETCH(bool, samePacket);
+
+    QUuid newClientId = QUuid::createUuid();
+    emit m_mockTcpServer->clientConnected(newClientId);
+    qApp->processEvents();
+
+    QSignalSpy spy(m_mockTcpServer, SIGNAL(outgoingData(QUuid,QByteArray)));
+
+    // A regular newline terminated Hello, followed by a length prefixed call
+    QVariantMap params;
+    params.insert("framing", "MessageFramingLengthPrefixed");
+    QVariantMap hello;
+    hello.insert("id", 400);
+    hello.insert("method", "JSONRPC.Hello");
+    hello.insert("params", params);
+    QByteArray helloData = QJsonDocument::fromVariant(hello).toJson(QJsonDocument::Compact) + '\n';
+
+    QVariantMap call;
+    call.insert("id", 401);
+    call.insert("method", "JSONRPC.Version");
+    call.insert("token", m_apiToken);
+    QByteArray payload = QJsonDocument::fromVariant(call).toJson(QJsonDocument::Compact);
+    QByteArray frame = MessageFramer::lengthPrefix(payload.size()) + payload;
+
+    QSignalSpy terminatedSpy(m_mockTcpServer, SIGNAL(connectionTerminated(QUuid)));
+    if (samePacket) {
+        m_mockTcpServer->injectData(newClientId, helloData + frame);
+    } else {
+        m_mockTcpServer->injectData(newClientId, helloData);
+        m_mockTcpServer->injectData(newClientId, frame);
+    }
+    QCOMPARE(terminatedSpy.count(), 0);
+    QCOMPARE(spy.count(), 2);
+
+    // The Hello reply is newline delimited JSON
+    QJsonParseError error;
+    QVariantMap helloReply = QJsonDocument::fromJson(spy.at(0).at(1).toByteArray(), &error).toVariant().toMap();
+    QCOMPARE(error.error, QJsonParseError::NoError);
+    QCOMPARE(helloReply.value("id").toInt(), 400);
+    QCOMPARE(helloReply.value("params").toMap().value("framing").toString(), QString("MessageFramingLengthPrefixed"));
+
+    // The reply to the call is length prefixed
+    QByteArray replyFrame = spy.at(1).at(1).toByteArray();
+    QCOMPARE(replyFrame.left(4), MessageFramer::lengthPrefix(replyFrame.size() - 4));
+    QVariantMap reply = QJsonDocument::fromJson(replyFrame.mid(4), &error).toVariant().toMap();
+    QCOMPARE(error.error, QJsonParseError::NoError);
+    QCOMPARE(reply.value("id").toInt(), 401);
+    QCOMPARE(reply.value("status").toString(), QString("success"));
+
+    emit m_mockTcpServer->clientDisconnected(newClientId);
+}
+
 void TestJSONRPC::testPushButtonAuth()
 {
     PushButtonAgent pushButtonAgent;
@@ -1315,6 +1772,76 @@ void TestJSONRPC::testGarbageData()
     QCOMPARE(spy.count(), 1);
 }
 
+void TestJSONRPC::benchmarkValidateParams_data()
+{
+    QTest::addColumn<QString>("method");
+    QTest::addColumn<QVariantMap>("params");
+
+    QVariantMap param1;
+    param1.insert("paramTypeId", mockWithParamsActionParam1ParamTypeId);
+    param1.insert("value", 5);
+    QVariantMap param2;
+    param2.insert("paramTypeId", mockWithParamsActionParam2ParamTypeId);
+    param2.insert("value", true);
+
+    QVariantMap executeActionParams;
+    executeActionParams.insert("thingId", m_mockThingId);
+    executeActionParams.insert("actionTypeId", mockWithParamsActionTypeId);
+    executeActionParams.insert("params", QVariantList() << param1 << param2);
+
+    QVariantMap eventDescriptor;
+    eventDescriptor.insert("thingId", m_mockThingId);
+    eventDescriptor.insert("eventTypeId", mockEvent1EventTypeId);
+
+    QVariantMap stateDescriptor;
+    stateDescriptor.insert("thingId", m_mockThingId);
+    stateDescriptor.insert("stateTypeId", mockIntStateTypeId);
+    stateDescriptor.insert("operator", "ValueOperatorGreater");
+    stateDescriptor.insert("value", 5);
+    QVariantMap childEvaluator;
+    childEvaluator.insert("stateDescriptor", stateDescriptor);
+    QVariantMap stateEvaluator;
+    stateEvaluator.insert("operator", "StateOperatorAnd");
+    stateEvaluator.insert("childEvaluators", QVariantList() << childEvaluator << childEvaluator);
+
+    QVariantMap ruleActionParam1;
+    ruleActionParam1.insert("paramTypeId", mockWithParamsActionParam1ParamTypeId);
+    ruleActionParam1.insert("value", 5);
+    QVariantMap ruleActionParam2;
+    ruleActionParam2.insert("paramTypeId", mockWithParamsActionParam2ParamTypeId);
+    ruleActionParam2.insert("value", true);
+    QVariantMap action;
+    action.insert("thingId", m_mockThingId);
+    action.insert("actionTypeId", mockWithParamsActionTypeId);
+    action.insert("ruleActionParams", QVariantList() << ruleActionParam1 << ruleActionParam2);
+
+    QVariantMap addRuleParams;
+    addRuleParams.insert("name", "Benchmark rule");
+    addRuleParams.insert("eventDescriptors", QVariantList() << eventDescriptor);
+    addRuleParams.insert("stateEvaluator", stateEvaluator);
+    addRuleParams.insert("actions", QVariantList() << action);
+    addRuleParams.insert("exitActions", QVariantList() << action);
+
+    QTest::newRow("Integrations.ExecuteAction") << "Integrations.ExecuteAction" << executeActionParams;
+    QTest::newRow("Rules.AddRule") << "Rules.AddRule" << addRuleParams;
+}
+
+void TestJSONRPC::benchmarkValidateParams()
+{
+    QFETCH(QString, method);
+    QFETCH(QVariantMap, params);
+
+    QVariantMap api = injectAndWait("JSONRPC.Introspect").toMap().value("params").toMap();
+    JsonValidator validator;
+    validator.setApi(api);
+
+    QVERIFY2(validator.validateParams(params, method).success(), qUtf8Printable(validator.result().errorString() + " in " + validator.result().where()));
+
+    QBENCHMARK {
+        validator.validateParams(params, method);
+    }
+}
+
 #include "testjsonrpc.moc"
 
 QTEST_MAIN(TestJSONRPC)
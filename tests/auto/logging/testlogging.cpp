@@ -84,6 +84,15 @@ private slots:
 
     void testLimits();
 
+    void testCursor();
+
+    void testStreaming();
+
+    void stateHistory();
+
+    void benchmarkStateLogging_data();
+    void benchmarkStateLogging();
+
     // this has to be the last test
     void removeThing();
 };
@@ -743,6 +752,182 @@ void TestLogging::testLimits()
     QCOMPARE(response.value("params").toMap().value("logEntries").toList().count(), 10);
 }
 
+void TestLogging::testCursor()
+{
+    // Using the 50 entries from testLimits()
+    QVariantMap params;
+    QVariantMap response = injectAndWait("Logging.GetLogEntries", params).toMap();
+    QVariantList allEntries = response.value("params").toMap().value("logEntries").toList();
+    QCOMPARE(allEntries.count(), 50);
+    QVERIFY2(!response.value("params").toMap().contains("nextCursor"), "Got a cursor for an unlimited fetch");
+
+    // Page through in pages of 20 entries, should return 20, 20 and 10 entries
+    QVariantList pagedEntries;
+    QString cursor;
+    QList<int> pageSizes;
+    do {
+        params.clear();
+        params.insert("limit", 20);
+        if (!cursor.isEmpty()) {
+            params.insert("cursor", cursor);
+        }
+        response = injectAndWait("Logging.GetLogEntries", params).toMap();
+        verifyLoggingError(response);
+        QVariantList entries = response.value("params").toMap().value("logEntries").toList();
+        pageSizes.append(entries.count());
+        pagedEntries.append(entries);
+        cursor = response.value("params").toMap().value("nextCursor").toString();
+    } while (!cursor.isEmpty() && pageSizes.count() < 5);
+
+    QCOMPARE(pageSizes, QList<int>() << 20 << 20 << 10);
+    QCOMPARE(pagedEntries, allEntries);
+
+    // Invalid cursor
+    params.clear();
+    params.insert("limit", 20);
+    params.insert("cursor", "invalid");
+    response = injectAndWait("Logging.GetLogEntries", params).toMap();
+    verifyLoggingError(response, Logging::LoggingErrorInvalidFilterParameter);
+}
+
+void TestLogging::testStreaming()
+{
+    // Using the 50 entries from testLimits()
+    QSignalSpy notificationSpy(m_mockTcpServer, SIGNAL(outgoingData(QUuid,QByteArray)));
+
+    QVariantMap params;
+    params.insert("stream", true);
+    QVariantMap response = injectAndWait("Logging.GetLogEntries", params).toMap();
+    verifyLoggingError(response);
+    QUuid streamId = response.value("params").toMap().value("streamId").toUuid();
+    QVERIFY2(!streamId.isNull(), "Did not get a stream id");
+
+    QVariantList entries;
+    bool finished = false;
+    while (!finished) {
+        foreach (const QVariant &notification, checkNotifications(notificationSpy, "Logging.LogEntriesStreamed")) {
+            QVariantMap notificationParams = notification.toMap().value("params").toMap();
+            QCOMPARE(notificationParams.value("streamId").toUuid(), streamId);
+            entries.append(notificationParams.value("logEntries").toList());
+            finished = notificationParams.value("final").toBool();
+        }
+        notificationSpy.clear();
+        if (!finished && !notificationSpy.wait()) {
+            break;
+        }
+    }
+    QVERIFY2(finished, "Did not receive the final chunk");
+    QCOMPARE(entries.count(), 50);
+}
+
+void TestLogging::stateHistory()
+{
+    clearLoggingDatabase();
+    waitForDBSync();
+
+    Thing *thing = NymeaCore::instance()->thingManager()->findConfiguredThing(m_mockThingId);
+    QVERIFY2(thing, "Mock thing not found");
+
+    qint64 startTime = QDateTime::currentMSecsSinceEpoch();
+    thing->setStateValue(mockIntStateTypeId, 10);
+    thing->setStateValue(mockIntStateTypeId, 30);
+    thing->setStateValue(mockIntStateTypeId, 20);
+    waitForDBSync();
+
+    // The values might end up in two minute buckets, but not more
+    QVariantMap params;
+    params.insert("thingId", m_mockThingId);
+    params.insert("stateTypeId", mockIntStateTypeId);
+    params.insert("resolution", enumValueName(Logging::StateHistoryResolutionMinute));
+    params.insert("from", startTime);
+    QVariant response = injectAndWait("Logging.GetStateHistory", params);
+    verifyLoggingError(response);
+
+    QVariantList points = response.toMap().value("params").toMap().value("stateHistoryPoints").toList();
+    QVERIFY2(points.count() >= 1 && points.count() <= 2, "Unexpected number of state history points");
+    int count = 0;
+    double minimum = points.first().toMap().value("minimum").toDouble();
+    double maximum = points.first().toMap().value("maximum").toDouble();
+    foreach (const QVariant &point, points) {
+        QVERIFY(point.toMap().value("timestamp").toLongLong() <= QDateTime::currentMSecsSinceEpoch());
+        count += point.toMap().value("count").toInt();
+        minimum = qMin(minimum, point.toMap().value("minimum").toDouble());
+        maximum = qMax(maximum, point.toMap().value("maximum").toDouble());
+    }
+    QCOMPARE(count, 3);
+    QCOMPARE(minimum, 10.0);
+    QCOMPARE(maximum, 30.0);
+    QCOMPARE(points.last().toMap().value("last").toDouble(), 20.0);
+
+    // Values are merged into the stored buckets
+    thing->setStateValue(mockIntStateTypeId, 40);
+    waitForDBSync();
+
+    params.insert("resolution", enumValueName(Logging::StateHistoryResolutionDay));
+    response = injectAndWait("Logging.GetStateHistory", params);
+    verifyLoggingError(response);
+    points = response.toMap().value("params").toMap().value("stateHistoryPoints").toList();
+    count = 0;
+    foreach (const QVariant &point, points) {
+        count += point.toMap().value("count").toInt();
+    }
+    QCOMPARE(count, 4);
+    QCOMPARE(points.last().toMap().value("last").toDouble(), 40.0);
+
+    // An empty time range is invalid
+    params.insert("to", startTime - 1000);
+    response = injectAndWait("Logging.GetStateHistory", params);
+    verifyLoggingError(response, Logging::LoggingErrorInvalidFilterParameter);
+}
+
+void TestLogging::benchmarkStateLogging_data()
+{
+    QTest::addColumn<int>("maxBatchSize");
+
+    QTest::newRow("single inserts") << 1;
+    QTest::newRow("batched inserts") << 100;
+}
+
+void TestLogging::benchmarkStateLogging()
+{
+    if (qgetenv("WITH_BENCHMARK").isEmpty()) {
+        QSKIP("Skipping benchmark tests: export WITH_BENCHMARK=1 to enable it.");
+    }
+
+    QFETCH(int, maxBatchSize);
+
+    LogEngine *logEngine = NymeaCore::instance()->logEngine();
+    logEngine->setMaxLogEntries(20000, 100);
+    logEngine->setWriteBatching(maxBatchSize, 0);
+    clearLoggingDatabase();
+    waitForDBSync();
+
+    Thing *thing = NymeaCore::instance()->thingManager()->findConfiguredThing(m_mockThingId);
+    QVERIFY2(thing, "Mock thing not found");
+
+    QSignalSpy entriesSpy(logEngine, &LogEngine::logEntryAdded);
+
+    // Feed state changes in chunks below the flooding limit of the log engine so no entry gets discarded
+    int entryCount = 10000;
+    int chunkSize = 500;
+    QElapsedTimer timer;
+    timer.start();
+    for (int i = 0; i < entryCount; i++) {
+        thing->setStateValue(mockIntStateTypeId, i);
+        if (i % chunkSize == chunkSize - 1) {
+            waitForDBSync();
+        }
+    }
+    waitForDBSync();
+    qint64 elapsed = qMax<qint64>(1, timer.elapsed());
+
+    QCOMPARE(entriesSpy.count(), entryCount);
+    qCDebug(dcTests()) << "Logged" << entryCount << "state changes with max batch size" << maxBatchSize << "in" << elapsed << "ms:" << (entryCount * 1000 / elapsed) << "entries/second";
+
+    logEngine->setWriteBatching(100, 0);
+    logEngine->setMaxLogEntries(1000, 10);
+}
+
 void TestLogging::removeThing()
 {
     // enable notifications
@@ -29,6 +29,8 @@
 * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
 
 #include <QtTest>
+#include <QSqlDatabase>
+#include <QSqlQuery>
 
 #include "logging/logengine.h"
 
@@ -44,7 +46,20 @@ private slots:
     void benchmarkDB_data();
     void benchmarkDB();
 
+    void benchmarkFetch_data();
+    void benchmarkFetch();
+
+    void partitionRollover();
+    void queueOverflowDropsFlooding();
+    void timeBasedRetention();
+    void migrateSchema5to6();
+
 private:
+    void createEngine(const QString &dbName, int maxDBSize = 50000);
+    void waitForJobs();
+    QList<LogEntry> fetchEntries(const LogFilter &filter = LogFilter());
+    QStringList partitionTables(const QString &dbName);
+
     LogEngine *engine;
 };
 
@@ -130,5 +145,254 @@ void TestLoggingDirect::benchmarkDB()
     qDebug() << "Ended benchmark with" << entries.count() << "entries in the db";
 }
 
+void TestLoggingDirect::benchmarkFetch_data()
+{
+    QTest::addColumn<int>("entries");
+
+    QTest::newRow("10000 entries") << 10000;
+    QTest::newRow("100000 entries") << 100000;
+    QTest::newRow("1000000 entries") << 1000000;
+}
+
+void TestLoggingDirect::benchmarkFetch()
+{
+    if (qgetenv("WITH_BENCHMARK").isEmpty()) {
+        QSKIP("Skipping benchmark tests: export WITH_BENCHMARK=1 to enable it.");
+    }
+
+    QFETCH(int, entries);
+
+    // 10 things with 10 types each
+    QList<ThingId> thingIds;
+    QList<ActionTypeId> typeIds;
+    for (int i = 0; i < 10; i++) {
+        thingIds.append(ThingId(QUuid::createUuid()));
+        typeIds.append(ActionTypeId(QUuid::createUuid()));
+    }
+
+    engine->setMaxLogEntries(-1, 0);
+    engine->clearDatabase();
+    while (engine->jobsRunning()) {
+        qApp->processEvents();
+    }
+
+    qDebug() << "Prefilling DB with" << entries << "entries";
+    for (int i = 0; i < entries; i++) {
+        BrowserItemAction action(thingIds.at(i % 10), QString::number(i), typeIds.at((i / 10) % 10));
+        engine->logBrowserItemAction(action);
+        // Stay below the flooding limit of the log engine
+        if (i % 500 == 499) {
+            while (engine->jobsRunning()) {
+                qApp->processEvents();
+            }
+        }
+    }
+    while (engine->jobsRunning()) {
+        qApp->processEvents();
+    }
+
+    LogFilter filter;
+    filter.addThingId(thingIds.at(3));
+    filter.addTypeId(typeIds.at(7));
+    filter.setLimit(100);
+
+    QList<LogEntry> results;
+    QBENCHMARK {
+        LogEntriesFetchJob *job = engine->fetchLogEntries(filter);
+        QSignalSpy fetchSpy(job, &LogEntriesFetchJob::finished);
+        fetchSpy.wait();
+        results = job->results();
+    }
+    QCOMPARE(results.count(), qMin(100, entries / 100));
+
+    engine->setMaxLogEntries(50000, 500);
+    while (engine->jobsRunning()) {
+        qApp->processEvents();
+    }
+}
+
+void TestLoggingDirect::partitionRollover()
+{
+    QString dbName = "/tmp/nymea-test/nymea-partitions.sqlite";
+    // A maximum of 100 entries results in partitions of 10 entries
+    createEngine(dbName, 100);
+
+    for (int i = 0; i < 35; i++) {
+        engine->logSystemEvent(QDateTime::currentDateTime(), i % 2);
+    }
+    waitForJobs();
+
+    QCOMPARE(fetchEntries().count(), 35);
+    QCOMPARE(partitionTables(dbName), QStringList({"entries_1", "entries_2", "entries_3", "entries_4"}));
+
+    // Exceeding the maximum drops the oldest partitions as a whole
+    for (int i = 0; i < 100; i++) {
+        engine->logSystemEvent(QDateTime::currentDateTime(), i % 2);
+    }
+    waitForJobs();
+
+    int count = fetchEntries().count();
+    QVERIFY2(count > 90 && count <= 100, QString("Expected 91 to 100 entries but have %1").arg(count).toLocal8Bit());
+    QStringList tables = partitionTables(dbName);
+    QVERIFY(!tables.contains("entries_1"));
+    QVERIFY(tables.contains("entries_14"));
+}
+
+void TestLoggingDirect::queueOverflowDropsFlooding()
+{
+    QString dbName = "/tmp/nymea-test/nymea-flooding.sqlite";
+    createEngine(dbName);
+
+    ThingId floodingThingId = ThingId::createThingId();
+    ThingId otherThingId = ThingId::createThingId();
+    ActionTypeId actionTypeId = ActionTypeId(QUuid::createUuid());
+
+    // Without processing events, nothing finishes and the queue exceeds its limit of 1000 jobs
+    int floodCount = 3000;
+    for (int i = 0; i < floodCount; i++) {
+        engine->logBrowserItemAction(BrowserItemAction(floodingThingId, QString::number(i), actionTypeId));
+        if (i == floodCount / 2) {
+            engine->logBrowserItemAction(BrowserItemAction(otherThingId, "other", actionTypeId));
+        }
+    }
+    waitForJobs();
+
+    LogFilter floodingFilter;
+    floodingFilter.addThingId(floodingThingId);
+    QList<LogEntry> entries = fetchEntries(floodingFilter);
+    QVERIFY2(entries.count() < floodCount, QString("Expected entries to be dropped but have %1").arg(entries.count()).toLocal8Bit());
+    QVERIFY(entries.count() >= 1000);
+    // The most recent entries of a flooding source are kept
+    QCOMPARE(entries.first().value().toString(), QString::number(floodCount - 1));
+
+    // Other sources are not affected by the flooding
+    LogFilter otherFilter;
+    otherFilter.addThingId(otherThingId);
+    entries = fetchEntries(otherFilter);
+    QCOMPARE(entries.count(), 1);
+    QCOMPARE(entries.first().value().toString(), QString("other"));
+}
+
+void TestLoggingDirect::timeBasedRetention()
+{
+    QString dbName = "/tmp/nymea-test/nymea-retention.sqlite";
+    createEngine(dbName);
+
+    // Retention by days alone (without partitionByDay) needs to start a new partition per day too
+    engine->setRetentionPolicy(5, false);
+
+    QDateTime now = QDateTime::currentDateTime();
+    engine->logSystemEvent(now.addDays(-10), true);
+    engine->logSystemEvent(now.addDays(-8), true);
+    engine->logSystemEvent(now.addDays(-1), true);
+    engine->logSystemEvent(now, true);
+    waitForJobs();
+
+    // A partition expires once the next one has been started before the retention window.
+    // Entries from 8 days ago are kept as their partition lasted until yesterday.
+    QList<LogEntry> entries = fetchEntries();
+    QCOMPARE(entries.count(), 3);
+    foreach (const LogEntry &entry, entries) {
+        QVERIFY(entry.timestamp() > now.addDays(-9));
+    }
+    QVERIFY(!partitionTables(dbName).contains("entries_1"));
+
+    engine->setRetentionPolicy(0, false);
+}
+
+void TestLoggingDirect::migrateSchema5to6()
+{
+    QString dbName = "/tmp/nymea-test/nymea-v5.sqlite";
+    delete engine;
+    engine = nullptr;
+    QFile::remove(dbName);
+
+    // A schema 5 database keeps all entries in a single "entries" table
+    {
+        QSqlDatabase db = QSqlDatabase::addDatabase("QSQLITE", "v5");
+        db.setDatabaseName(dbName);
+        QVERIFY(db.open());
+        QSqlQuery query(db);
+        QVERIFY(query.exec("CREATE TABLE metadata (`key` VARCHAR(10), data VARCHAR(40));"));
+        QVERIFY(query.exec("INSERT INTO metadata (`key`, data) VALUES('version', '5');"));
+        QVERIFY(query.exec("CREATE TABLE uuids (id INTEGER PRIMARY KEY, uuid VARCHAR(38) UNIQUE);"));
+        QVERIFY(query.exec("CREATE TABLE entries (timestamp BIGINT, loggingLevel INT, sourceType INT, typeId INTEGER, thingId INTEGER, "
+                           "value VARCHAR(100), loggingEventType INT, active BOOL, errorCode INT);"));
+        qint64 timestamp = QDateTime::currentDateTime().addSecs(-60).toMSecsSinceEpoch();
+        for (int i = 0; i < 3; i++) {
+            QVERIFY(query.exec(QString("INSERT INTO entries (timestamp, loggingLevel, sourceType, loggingEventType, active, errorCode) VALUES (%1, %2, %3, %4, 1, 0);")
+                               .arg(timestamp + i).arg(Logging::LoggingLevelInfo).arg(Logging::LoggingSourceSystem).arg(Logging::LoggingEventTypeActiveChange)));
+        }
+        db.close();
+    }
+    QSqlDatabase::removeDatabase("v5");
+
+    engine = new LogEngine("QSQLITE", dbName);
+    waitForJobs();
+
+    // The old entries table becomes the first partition
+    QCOMPARE(partitionTables(dbName), QStringList({"entries_1"}));
+    QCOMPARE(fetchEntries().count(), 3);
+
+    engine->logSystemEvent(QDateTime::currentDateTime(), true);
+    waitForJobs();
+    QCOMPARE(fetchEntries().count(), 4);
+
+    {
+        QSqlDatabase db = QSqlDatabase::addDatabase("QSQLITE", "v6");
+        db.setDatabaseName(dbName);
+        QVERIFY(db.open());
+        QSqlQuery query = db.exec("SELECT data FROM metadata WHERE `key` = 'version';");
+        QVERIFY(query.next());
+        QCOMPARE(query.value(0).toInt(), 6);
+        db.close();
+    }
+    QSqlDatabase::removeDatabase("v6");
+}
+
+void TestLoggingDirect::createEngine(const QString &dbName, int maxDBSize)
+{
+    delete engine;
+    engine = nullptr;
+    QFile::remove(dbName);
+    engine = new LogEngine("QSQLITE", dbName, "127.0.0.1", QString(), QString(), maxDBSize);
+    waitForJobs();
+}
+
+void TestLoggingDirect::waitForJobs()
+{
+    while (engine->jobsRunning()) {
+        qApp->processEvents();
+    }
+}
+
+QList<LogEntry> TestLoggingDirect::fetchEntries(const LogFilter &filter)
+{
+    LogEntriesFetchJob *job = engine->fetchLogEntries(filter);
+    QSignalSpy fetchSpy(job, &LogEntriesFetchJob::finished);
+    fetchSpy.wait();
+    return job->results();
+}
+
+QStringList TestLoggingDirect::partitionTables(const QString &dbName)
+{
+    QStringList tables;
+    {
+        QSqlDatabase db = QSqlDatabase::addDatabase("QSQLITE", "partitions");
+        db.setDatabaseName(dbName);
+        if (db.open()) {
+            foreach (const QString &table, db.tables()) {
+                if (table.startsWith("entries_")) {
+                    tables.append(table);
+                }
+            }
+            db.close();
+        }
+    }
+    QSqlDatabase::removeDatabase("partitions");
+    tables.sort();
+    return tables;
+}
+
 #include "testloggingdirect.moc"
 QTEST_MAIN(TestLoggingDirect)
@@ -33,6 +33,7 @@
 #include "servers/mocktcpserver.h"
 #include "nymeacore.h"
 #include "jsonrpc/jsonhandler.h"
+#include "ruleengine/ruleengine.h"
 
 using namespace nymeaserver;
 
@@ -46,6 +47,8 @@ private:
 
     ThingId addDisplayPinMock();
 
+    void verifyIncrementalEvaluation(StateEvaluator &evaluator, const ThingId &thingId, const StateTypeId &stateTypeId, const QVariant &value);
+
     QVariantMap createEventDescriptor(const ThingId &thingId, const EventTypeId &eventTypeId);
     QVariantMap createActionWithParams(const ThingId &thingId);
     QVariantMap createStateEvaluatorFromSingleDescriptor(const QVariantMap &stateDescriptor);
@@ -102,6 +105,10 @@ private slots:
     void testStateEvaluator3_data();
     void testStateEvaluator3();
 
+    void testIncrementalStateEvaluation_data();
+    void testIncrementalStateEvaluation();
+    void testIncrementalStateEvaluationThingRemoved();
+
     void testChildEvaluator_data();
     void testChildEvaluator();
 
@@ -138,6 +145,10 @@ private slots:
 
     void testHousekeeping_data();
     void testHousekeeping();
+
+    void testParallelStateEvaluation();
+
+    void benchmarkEvaluateEvent();
 };
 
 void TestRules::cleanupMockHistory() {
@@ -159,6 +170,20 @@ void TestRules::cleanupRules() {
     }
 }
 
+// Changes the given state and verifies that updating the cached evaluation gives the same result as evaluating the whole tree
+void TestRules::verifyIncrementalEvaluation(StateEvaluator &evaluator, const ThingId &thingId, const StateTypeId &stateTypeId, const QVariant &value)
+{
+    Thing *thing = NymeaCore::instance()->thingManager()->findConfiguredThing(thingId);
+    QVERIFY2(thing, "Thing not found");
+    thing->setStateValue(stateTypeId, value);
+
+    bool incrementalResult = evaluator.evaluate(thingId, stateTypeId);
+    StateEvaluator fullEvaluator = evaluator;
+    bool fullResult = fullEvaluator.evaluate();
+    QVERIFY2(incrementalResult == fullResult, QString("Incremental evaluation gave %1 after setting %2 to %3")
+             .arg(incrementalResult).arg(stateTypeId.toString()).arg(value.toString()).toUtf8());
+}
+
 ThingId TestRules::addDisplayPinMock()
 {
     // Discover things
@@ -1879,6 +1904,114 @@ void TestRules::testStateEvaluator3()
     QVERIFY2(mainEvaluator.evaluate() == shouldMatch, shouldMatch ? "State should match" : "State shouldn't match");
 }
 
+void TestRules::testIncrementalStateEvaluation_data()
+{
+    QTest::addColumn<StateEvaluator>("evaluator");
+
+    StateEvaluator intEquals(StateDescriptor(mockIntStateTypeId, m_mockThingId, 10, Types::ValueOperatorEquals));
+    StateEvaluator intGreater(StateDescriptor(mockIntStateTypeId, m_mockThingId, 20, Types::ValueOperatorGreater));
+    StateEvaluator boolTrue(StateDescriptor(mockBoolStateTypeId, m_mockThingId, true, Types::ValueOperatorEquals));
+    StateEvaluator doubleLess(StateDescriptor(mockDoubleStateTypeId, m_mockThingId, 3.5, Types::ValueOperatorLess));
+    StateEvaluator batteryCritical(StateDescriptor("battery", "batteryCritical", true, Types::ValueOperatorEquals));
+    StateEvaluator batteryLow(StateDescriptor("battery", "batteryLevel", 30, Types::ValueOperatorLess));
+
+    StateDescriptor intAboveBatteryDescriptor(mockIntStateTypeId, m_mockThingId, QVariant(), Types::ValueOperatorGreater);
+    intAboveBatteryDescriptor.setValueThingId(m_mockThingId);
+    intAboveBatteryDescriptor.setValueStateTypeId(mockBatteryLevelStateTypeId);
+    StateEvaluator intAboveBattery(intAboveBatteryDescriptor);
+
+    StateEvaluator descriptorWithChildren(StateDescriptor(mockBoolStateTypeId, m_mockThingId, true, Types::ValueOperatorEquals));
+    descriptorWithChildren.setOperatorType(Types::StateOperatorOr);
+    descriptorWithChildren.setChildEvaluators(QList<StateEvaluator>() << intEquals << StateEvaluator(QList<StateEvaluator>() << doubleLess << batteryLow));
+
+    QTest::newRow("nested and/or") << StateEvaluator(QList<StateEvaluator>() << intEquals << StateEvaluator(QList<StateEvaluator>() << boolTrue << StateEvaluator(QList<StateEvaluator>() << doubleLess << intGreater), Types::StateOperatorOr));
+    QTest::newRow("nested or/and") << StateEvaluator(QList<StateEvaluator>() << StateEvaluator(QList<StateEvaluator>() << intGreater << boolTrue) << StateEvaluator(QList<StateEvaluator>() << doubleLess << intEquals), Types::StateOperatorOr);
+    QTest::newRow("descriptor with children") << descriptorWithChildren;
+    QTest::newRow("interface descriptors") << StateEvaluator(QList<StateEvaluator>() << batteryCritical << StateEvaluator(QList<StateEvaluator>() << batteryLow << boolTrue), Types::StateOperatorOr);
+    QTest::newRow("value thing descriptor") << StateEvaluator(QList<StateEvaluator>() << intAboveBattery << StateEvaluator(QList<StateEvaluator>() << boolTrue << batteryCritical, Types::StateOperatorOr));
+}
+
+void TestRules::testIncrementalStateEvaluation()
+{
+    QFETCH(StateEvaluator, evaluator);
+
+    Thing *thing = NymeaCore::instance()->thingManager()->findConfiguredThing(m_mockThingId);
+    QVERIFY2(thing, "Mock thing not found");
+    QList<StateTypeId> stateTypeIds = {mockIntStateTypeId, mockBoolStateTypeId, mockDoubleStateTypeId, mockBatteryLevelStateTypeId, mockBatteryCriticalStateTypeId};
+    QVariantList initialValues;
+    foreach (const StateTypeId &stateTypeId, stateTypeIds) {
+        initialValues.append(thing->stateValue(stateTypeId));
+    }
+
+    // Walk through state changes flipping every node of the trees a few times
+    QList<QPair<StateTypeId, QVariant>> changes = {
+        {mockIntStateTypeId, 10},
+        {mockBoolStateTypeId, true},
+        {mockDoubleStateTypeId, 2.0},
+        {mockIntStateTypeId, 25},
+        {mockBatteryLevelStateTypeId, 10},
+        {mockBatteryCriticalStateTypeId, true},
+        {mockIntStateTypeId, 5},
+        {mockBoolStateTypeId, false},
+        {mockBatteryLevelStateTypeId, 80},
+        {mockBatteryCriticalStateTypeId, false},
+        {mockDoubleStateTypeId, 4.0},
+        {mockIntStateTypeId, 90},
+        {mockBoolStateTypeId, true},
+        {mockIntStateTypeId, 10},
+        {mockDoubleStateTypeId, 1.0}
+    };
+
+    evaluator.evaluate();
+    for (int i = 0; i < changes.count(); i++) {
+        verifyIncrementalEvaluation(evaluator, m_mockThingId, changes.at(i).first, changes.at(i).second);
+    }
+
+    for (int i = 0; i < stateTypeIds.count(); i++) {
+        thing->setStateValue(stateTypeIds.at(i), initialValues.at(i));
+    }
+}
+
+void TestRules::testIncrementalStateEvaluationThingRemoved()
+{
+    ThingId displayPinThingId = addDisplayPinMock();
+    QVERIFY2(!displayPinThingId.isNull(), "Could not add display pin mock");
+
+    Thing *thing = NymeaCore::instance()->thingManager()->findConfiguredThing(m_mockThingId);
+    Thing *displayPinThing = NymeaCore::instance()->thingManager()->findConfiguredThing(displayPinThingId);
+    QVERIFY2(thing && displayPinThing, "Mock things not found");
+    QVariant initialIntValue = thing->stateValue(mockIntStateTypeId);
+    QVariant initialBoolValue = thing->stateValue(mockBoolStateTypeId);
+
+    StateDescriptor percentageAboveIntDescriptor(displayPinMockPercentageStateTypeId, displayPinThingId, QVariant(), Types::ValueOperatorGreater);
+    percentageAboveIntDescriptor.setValueThingId(m_mockThingId);
+    percentageAboveIntDescriptor.setValueStateTypeId(mockIntStateTypeId);
+    StateEvaluator boolTrue(StateDescriptor(mockBoolStateTypeId, m_mockThingId, true, Types::ValueOperatorEquals));
+    StateEvaluator evaluator(QList<StateEvaluator>() << StateEvaluator(percentageAboveIntDescriptor) << boolTrue, Types::StateOperatorOr);
+
+    thing->setStateValue(mockBoolStateTypeId, false);
+    thing->setStateValue(mockIntStateTypeId, 10);
+    displayPinThing->setStateValue(displayPinMockPercentageStateTypeId, 50);
+    QVERIFY(evaluator.evaluate());
+    verifyIncrementalEvaluation(evaluator, m_mockThingId, mockIntStateTypeId, 60);
+    verifyIncrementalEvaluation(evaluator, displayPinThingId, displayPinMockPercentageStateTypeId, 70);
+
+    QVariantMap params;
+    params.insert("thingId", displayPinThingId);
+    QVariant response = injectAndWait("Integrations.RemoveThing", params);
+    verifyThingError(response);
+
+    evaluator.removeThing(displayPinThingId);
+    QVERIFY(!evaluator.containsThing(displayPinThingId));
+
+    verifyIncrementalEvaluation(evaluator, m_mockThingId, mockIntStateTypeId, 5);
+    verifyIncrementalEvaluation(evaluator, m_mockThingId, mockBoolStateTypeId, true);
+    verifyIncrementalEvaluation(evaluator, m_mockThingId, mockBoolStateTypeId, false);
+
+    thing->setStateValue(mockIntStateTypeId, initialIntValue);
+    thing->setStateValue(mockBoolStateTypeId, initialBoolValue);
+}
+
 void TestRules::testChildEvaluator_data()
 {
     cleanup();
@@ -3344,5 +3477,98 @@ void TestRules::testHousekeeping()
     }
 }
 
+void TestRules::testParallelStateEvaluation()
+{
+    RuleEngine *ruleEngine = NymeaCore::instance()->ruleEngine();
+    ruleEngine->setParallelEvaluation(true, 4);
+
+    // Enough state based rules to be evaluated on the worker threads
+    QList<RuleId> ruleIds;
+    for (int i = 0; i < 40; i++) {
+        Rule rule;
+        rule.setId(RuleId::createRuleId());
+        rule.setName(QString("Parallel rule %1").arg(i));
+        rule.setStateEvaluator(StateEvaluator(StateDescriptor(mockIntStateTypeId, m_mockThingId, i, Types::ValueOperatorGreaterOrEqual)));
+        rule.setActions({RuleAction(mockWithoutParamsActionTypeId, m_mockThingId)});
+        QCOMPARE(ruleEngine->addRule(rule), RuleEngine::RuleErrorNoError);
+        ruleIds.append(rule.id());
+    }
+
+    QNetworkAccessManager nam;
+    QSignalSpy spy(&nam, SIGNAL(finished(QNetworkReply*)));
+
+    // First a full evaluation of the new rules, then an incremental one in parallel and one in serial mode
+    QList<QPair<int, bool>> steps = {qMakePair(37, true), qMakePair(3, true), qMakePair(25, false)};
+    for (int step = 0; step < steps.count(); step++) {
+        ruleEngine->setParallelEvaluation(steps.at(step).second, 4);
+        int value = steps.at(step).first;
+        spy.clear();
+        QNetworkReply *reply = nam.get(QNetworkRequest(QUrl(QString("http://localhost:%1/setstate?%2=%3").arg(m_mockThing1Port).arg(mockIntStateTypeId.toString()).arg(value))));
+        spy.wait();
+        QCOMPARE(spy.count(), 1);
+        reply->deleteLater();
+
+        for (int i = 0; i < ruleIds.count(); i++) {
+            Rule rule = ruleEngine->findRule(ruleIds.at(i));
+            QVERIFY2(rule.statesActive() == (value >= i), QString("Rule %1 states active: %2 for value %3").arg(i).arg(rule.statesActive()).arg(value).toUtf8());
+            QVERIFY2(rule.active() == (value >= i), QString("Rule %1 active: %2 for value %3").arg(i).arg(rule.active()).arg(value).toUtf8());
+        }
+    }
+
+    ruleEngine->setParallelEvaluation(false);
+    foreach (const RuleId &ruleId, ruleIds) {
+        ruleEngine->removeRule(ruleId);
+    }
+    cleanupMockHistory();
+}
+
+void TestRules::benchmarkEvaluateEvent()
+{
+    if (qgetenv("WITH_BENCHMARK").isEmpty()) {
+        QSKIP("Skipping benchmark tests: export WITH_BENCHMARK=1 to enable it.");
+    }
+
+    RuleEngine *ruleEngine = NymeaCore::instance()->ruleEngine();
+
+    // 1000 rules, half of them event based, half of them state based, none depending on the events below
+    QList<RuleId> ruleIds;
+    for (int i = 0; i < 1000; i++) {
+        Rule rule;
+        rule.setId(RuleId::createRuleId());
+        rule.setName(QString("Benchmark rule %1").arg(i));
+        if (i % 2 == 0) {
+            rule.setEventDescriptors({EventDescriptor(mockEvent2EventTypeId, m_mockThingId)});
+        } else {
+            rule.setStateEvaluator(StateEvaluator(StateDescriptor(mockDoubleStateTypeId, m_mockThingId, i, Types::ValueOperatorGreater)));
+        }
+        rule.setActions({RuleAction(mockWithoutParamsActionTypeId, m_mockThingId)});
+        QCOMPARE(ruleEngine->addRule(rule), RuleEngine::RuleErrorNoError);
+        ruleIds.append(rule.id());
+    }
+
+    // One rule which is affected by the events
+    Rule rule;
+    rule.setId(RuleId::createRuleId());
+    rule.setName("Benchmark target rule");
+    rule.setEventDescriptors({EventDescriptor(mockEvent1EventTypeId, m_mockThingId)});
+    rule.setActions({RuleAction(mockWithoutParamsActionTypeId, m_mockThingId)});
+    QCOMPARE(ruleEngine->addRule(rule), RuleEngine::RuleErrorNoError);
+    ruleIds.append(rule.id());
+
+    Event event(mockEvent1EventTypeId, m_mockThingId);
+    QList<Rule> affectedRules;
+    QBENCHMARK {
+        for (int i = 0; i < 1000; i++) {
+            affectedRules = ruleEngine->evaluateEvent(event);
+        }
+    }
+    QCOMPARE(affectedRules.count(), 1);
+    QCOMPARE(affectedRules.first().id(), rule.id());
+
+    foreach (const RuleId &ruleId, ruleIds) {
+        ruleEngine->removeRule(ruleId);
+    }
+}
+
 #include "testrules.moc"
 QTEST_MAIN(TestRules)
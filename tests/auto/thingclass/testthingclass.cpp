@@ -0,0 +1,188 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2022, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include <QtTest>
+
+#include "types/thingclass.h"
+
+class TestThingClass: public QObject
+{
+    Q_OBJECT
+public:
+    TestThingClass(QObject* parent = nullptr);
+
+private slots:
+    void stateTypeLookup();
+    void stateSlots();
+    void duplicateStateTypeIds();
+    void eventTypeLookup();
+    void actionTypeLookup();
+    void paramTypeLookup();
+
+private:
+    StateTypes createStateTypes(int count);
+};
+
+TestThingClass::TestThingClass(QObject *parent): QObject(parent)
+{
+}
+
+void TestThingClass::stateTypeLookup()
+{
+    StateTypes stateTypes = createStateTypes(5);
+    ThingClass thingClass;
+    thingClass.setStateTypes(stateTypes);
+
+    foreach (const StateType &stateType, stateTypes) {
+        QVERIFY(thingClass.hasStateType(stateType.id()));
+        QCOMPARE(thingClass.stateType(stateType.id()).id(), stateType.id());
+        QCOMPARE(thingClass.stateType(stateType.id()).name(), stateType.name());
+        QCOMPARE(thingClass.getStateType(stateType.id()).name(), stateType.name());
+    }
+
+    StateTypeId unknownId = StateTypeId::createStateTypeId();
+    QVERIFY(!thingClass.hasStateType(unknownId));
+    QVERIFY(!thingClass.stateType(unknownId).isValid());
+    QVERIFY(!thingClass.getStateType(unknownId).isValid());
+
+    // Replacing the state types rebuilds the index
+    StateTypes otherStateTypes = createStateTypes(2);
+    thingClass.setStateTypes(otherStateTypes);
+    QVERIFY(!thingClass.hasStateType(stateTypes.first().id()));
+    QVERIFY(!thingClass.stateType(stateTypes.first().id()).isValid());
+    QCOMPARE(thingClass.stateType(otherStateTypes.last().id()).name(), otherStateTypes.last().name());
+}
+
+void TestThingClass::stateSlots()
+{
+    StateTypes stateTypes = createStateTypes(5);
+    ThingClass thingClass;
+    thingClass.setStateTypes(stateTypes);
+
+    // Slots are the positions in stateTypes()
+    for (int i = 0; i < stateTypes.count(); i++) {
+        QCOMPARE(thingClass.stateSlot(stateTypes.at(i).id()), i);
+        QCOMPARE(thingClass.stateTypes().at(thingClass.stateSlot(stateTypes.at(i).id())).id(), stateTypes.at(i).id());
+    }
+    QCOMPARE(thingClass.stateSlot(StateTypeId::createStateTypeId()), -1);
+    QCOMPARE(thingClass.stateSlot(StateTypeId()), -1);
+
+    // Copies keep the same slots
+    ThingClass copy = thingClass;
+    for (int i = 0; i < stateTypes.count(); i++) {
+        QCOMPARE(copy.stateSlot(stateTypes.at(i).id()), i);
+    }
+}
+
+void TestThingClass::duplicateStateTypeIds()
+{
+    StateTypes stateTypes = createStateTypes(3);
+    StateType duplicate(stateTypes.at(1).id());
+    duplicate.setName("duplicate");
+    stateTypes.append(duplicate);
+
+    ThingClass thingClass;
+    thingClass.setStateTypes(stateTypes);
+
+    // As with a linear search, the first entry wins
+    QCOMPARE(thingClass.stateType(duplicate.id()).name(), stateTypes.at(1).name());
+    QCOMPARE(thingClass.stateSlot(duplicate.id()), 1);
+}
+
+void TestThingClass::eventTypeLookup()
+{
+    EventTypes eventTypes;
+    for (int i = 0; i < 5; i++) {
+        EventType eventType(EventTypeId::createEventTypeId());
+        eventType.setName(QString("event%1").arg(i));
+        eventTypes.append(eventType);
+    }
+    ThingClass thingClass;
+    thingClass.setEventTypes(eventTypes);
+
+    foreach (const EventType &eventType, eventTypes) {
+        QVERIFY(thingClass.hasEventType(eventType.id()));
+        QCOMPARE(thingClass.eventType(eventType.id()).name(), eventType.name());
+    }
+    EventTypeId unknownId = EventTypeId::createEventTypeId();
+    QVERIFY(!thingClass.hasEventType(unknownId));
+    QVERIFY(!thingClass.eventType(unknownId).isValid());
+}
+
+void TestThingClass::actionTypeLookup()
+{
+    ActionTypes actionTypes;
+    for (int i = 0; i < 5; i++) {
+        ActionType actionType(ActionTypeId::createActionTypeId());
+        actionType.setName(QString("action%1").arg(i));
+        actionTypes.append(actionType);
+    }
+    ThingClass thingClass;
+    thingClass.setActionTypes(actionTypes);
+
+    foreach (const ActionType &actionType, actionTypes) {
+        QVERIFY(thingClass.hasActionType(actionType.id()));
+        QCOMPARE(thingClass.actionType(actionType.id()).name(), actionType.name());
+    }
+    ActionTypeId unknownId = ActionTypeId::createActionTypeId();
+    QVERIFY(!thingClass.hasActionType(unknownId));
+    QVERIFY(thingClass.actionType(unknownId).id().isNull());
+}
+
+void TestThingClass::paramTypeLookup()
+{
+    ParamTypes paramTypes;
+    for (int i = 0; i < 5; i++) {
+        paramTypes.append(ParamType(ParamTypeId::createParamTypeId(), QString("param%1").arg(i), QVariant::Int, i));
+    }
+    ThingClass thingClass;
+    thingClass.setParamTypes(paramTypes);
+
+    foreach (const ParamType &paramType, paramTypes) {
+        QCOMPARE(thingClass.paramType(paramType.id()).name(), paramType.name());
+        QCOMPARE(thingClass.paramType(paramType.id()).defaultValue(), paramType.defaultValue());
+    }
+    QVERIFY(!thingClass.paramType(ParamTypeId::createParamTypeId()).isValid());
+}
+
+StateTypes TestThingClass::createStateTypes(int count)
+{
+    StateTypes stateTypes;
+    for (int i = 0; i < count; i++) {
+        StateType stateType(StateTypeId::createStateTypeId());
+        stateType.setName(QString("state%1").arg(i));
+        stateType.setType(QVariant::Int);
+        stateTypes.append(stateType);
+    }
+    return stateTypes;
+}
+
+#include "testthingclass.moc"
+QTEST_MAIN(TestThingClass)
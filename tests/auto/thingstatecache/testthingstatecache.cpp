@@ -0,0 +1,197 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2022, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include <QtTest>
+
+#include "integrations/thingstatecache.h"
+
+using namespace nymeaserver;
+
+class TestThingStateCache: public QObject
+{
+    Q_OBJECT
+public:
+    TestThingStateCache(QObject* parent = nullptr);
+
+protected slots:
+    void initTestCase();
+    void init();
+
+private slots:
+    void storeAndLoad();
+    void flushOnlyWhenDirty();
+    void removeThing();
+    void unusableCacheFile_data();
+    void unusableCacheFile();
+
+private:
+    void writeCacheFile(const QByteArray &data);
+
+    QString m_fileName = "/tmp/nymea-test/thingstates.cache";
+};
+
+TestThingStateCache::TestThingStateCache(QObject *parent): QObject(parent)
+{
+}
+
+void TestThingStateCache::initTestCase()
+{
+    // Important for settings
+    QCoreApplication::instance()->setOrganizationName("nymea-test");
+}
+
+void TestThingStateCache::init()
+{
+    QFile::remove(m_fileName);
+}
+
+void TestThingStateCache::storeAndLoad()
+{
+    ThingId thingId = ThingId::createThingId();
+    StateTypeId stateTypeId = StateTypeId::createStateTypeId();
+
+    ThingStateCache *cache = new ThingStateCache(m_fileName, 60000, this);
+    QVERIFY(!cache->contains(thingId));
+    cache->storeState(thingId, stateTypeId, 42, 0, 100);
+    QVERIFY(cache->contains(thingId));
+
+    // Nothing is written before the flush interval passed
+    QVERIFY(!QFile::exists(m_fileName));
+
+    // Destroying the cache writes pending changes
+    delete cache;
+    QVERIFY(QFile::exists(m_fileName));
+
+    cache = new ThingStateCache(m_fileName, 60000, this);
+    QCOMPARE(cache->thingIds(), QList<ThingId>() << thingId);
+    ThingStateCache::CachedState state = cache->states(thingId).value(stateTypeId);
+    QCOMPARE(state.value, QVariant(42));
+    QCOMPARE(state.minValue, QVariant(0));
+    QCOMPARE(state.maxValue, QVariant(100));
+    delete cache;
+}
+
+void TestThingStateCache::flushOnlyWhenDirty()
+{
+    ThingId thingId = ThingId::createThingId();
+    StateTypeId stateTypeId = StateTypeId::createStateTypeId();
+
+    ThingStateCache cache(m_fileName, 10, this);
+    cache.storeState(thingId, stateTypeId, 1, QVariant(), QVariant());
+
+    // The flush timer writes the file
+    QTRY_VERIFY(QFile::exists(m_fileName));
+    QVERIFY(QFile::remove(m_fileName));
+
+    // Storing the same value again does not mark the cache dirty
+    cache.storeState(thingId, stateTypeId, 1, QVariant(), QVariant());
+    QVERIFY(cache.flush());
+    QVERIFY(!QFile::exists(m_fileName));
+
+    cache.storeState(thingId, stateTypeId, 2, QVariant(), QVariant());
+    QVERIFY(cache.flush());
+    QVERIFY(QFile::exists(m_fileName));
+}
+
+void TestThingStateCache::removeThing()
+{
+    ThingId thingId = ThingId::createThingId();
+    ThingId otherThingId = ThingId::createThingId();
+    StateTypeId stateTypeId = StateTypeId::createStateTypeId();
+
+    ThingStateCache *cache = new ThingStateCache(m_fileName, 60000, this);
+    cache->storeState(thingId, stateTypeId, 1, QVariant(), QVariant());
+    cache->storeState(otherThingId, stateTypeId, 2, QVariant(), QVariant());
+    QVERIFY(cache->flush());
+    cache->removeThing(thingId);
+    delete cache;
+
+    cache = new ThingStateCache(m_fileName, 60000, this);
+    QVERIFY(!cache->contains(thingId));
+    QCOMPARE(cache->states(otherThingId).value(stateTypeId).value, QVariant(2));
+    delete cache;
+}
+
+void TestThingStateCache::unusableCacheFile_data()
+{
+    QTest::addColumn<QByteArray>("data");
+
+    // A valid cache file with one thing and one state to start from
+    ThingStateCache *cache = new ThingStateCache(m_fileName, 60000, this);
+    cache->storeState(ThingId::createThingId(), StateTypeId::createStateTypeId(), "value", QVariant(), QVariant());
+    delete cache;
+    QFile file(m_fileName);
+    QVERIFY(file.open(QFile::ReadOnly));
+    QByteArray valid = file.readAll();
+    file.close();
+
+    QByteArray badMagic = valid;
+    badMagic[0] = 'x';
+    QByteArray badVersion = valid;
+    badVersion[7] = 2;
+
+    QTest::newRow("empty") << QByteArray();
+    QTest::newRow("bad magic") << badMagic;
+    QTest::newRow("bad version") << badVersion;
+    QTest::newRow("truncated header") << valid.left(6);
+    QTest::newRow("truncated states") << valid.left(valid.length() - 4);
+}
+
+void TestThingStateCache::unusableCacheFile()
+{
+    QFETCH(QByteArray, data);
+
+    writeCacheFile(data);
+
+    // An unusable cache is ignored as a whole, so things fall back to the legacy cache or the defaults
+    ThingStateCache *cache = new ThingStateCache(m_fileName, 60000, this);
+    QVERIFY(cache->thingIds().isEmpty());
+
+    // It is replaced with the next flush
+    ThingId thingId = ThingId::createThingId();
+    StateTypeId stateTypeId = StateTypeId::createStateTypeId();
+    cache->storeState(thingId, stateTypeId, 5, QVariant(), QVariant());
+    delete cache;
+
+    cache = new ThingStateCache(m_fileName, 60000, this);
+    QCOMPARE(cache->states(thingId).value(stateTypeId).value, QVariant(5));
+    delete cache;
+}
+
+void TestThingStateCache::writeCacheFile(const QByteArray &data)
+{
+    QFile file(m_fileName);
+    QVERIFY(file.open(QFile::WriteOnly | QFile::Truncate));
+    QCOMPARE(file.write(data), static_cast<qint64>(data.length()));
+    file.close();
+}
+
+#include "testthingstatecache.moc"
+QTEST_MAIN(TestThingStateCache)
@@ -114,6 +114,11 @@ private slots:
 
     void testEnableDisableTimeRule();
 
+    void testNextTransition_data();
+    void testNextTransition();
+
+    void testUtcOffsetChange();
+
 private:
     void initTimeManager();
 
@@ -2023,6 +2028,115 @@ void TestTimeManager::testEnableDisableTimeRule()
     verifyRuleError(response);
 }
 
+void TestTimeManager::testNextTransition_data()
+{
+    QTest::addColumn<TimeDescriptor>("timeDescriptor");
+
+    auto calendarItem = [](const QTime &startTime, uint duration, const RepeatingOption &repeatingOption) {
+        CalendarItem item;
+        item.setStartTime(startTime);
+        item.setDuration(duration);
+        item.setRepeatingOption(repeatingOption);
+        TimeDescriptor timeDescriptor;
+        timeDescriptor.setCalendarItems({item});
+        return timeDescriptor;
+    };
+    auto timeEventItem = [](const QTime &time, const RepeatingOption &repeatingOption) {
+        TimeEventItem item;
+        item.setTime(time);
+        item.setRepeatingOption(repeatingOption);
+        TimeDescriptor timeDescriptor;
+        timeDescriptor.setTimeEventItems({item});
+        return timeDescriptor;
+    };
+
+    CalendarItem dateTimeItem;
+    dateTimeItem.setDateTime(QDateTime(QDate(2020, 3, 3), QTime(10, 15)));
+    dateTimeItem.setDuration(90);
+    TimeDescriptor dateTimeDescriptor;
+    dateTimeDescriptor.setCalendarItems({dateTimeItem});
+
+    CalendarItem yearlyItem;
+    yearlyItem.setDateTime(QDateTime(QDate(2019, 3, 4), QTime(23, 30)));
+    yearlyItem.setDuration(120);
+    yearlyItem.setRepeatingOption(RepeatingOption(RepeatingOption::RepeatingModeYearly));
+    TimeDescriptor yearlyDescriptor;
+    yearlyDescriptor.setCalendarItems({yearlyItem});
+
+    QTest::newRow("calendar datetime") << dateTimeDescriptor;
+    QTest::newRow("calendar yearly") << yearlyDescriptor;
+    QTest::newRow("calendar hourly") << calendarItem(QTime(0, 50), 20, RepeatingOption(RepeatingOption::RepeatingModeHourly, {1, 3, 5}));
+    QTest::newRow("calendar daily") << calendarItem(QTime(22, 10), 180, RepeatingOption(RepeatingOption::RepeatingModeDaily));
+    QTest::newRow("calendar weekly") << calendarItem(QTime(20, 0), 2000, RepeatingOption(RepeatingOption::RepeatingModeWeekly, {2, 7}));
+    QTest::newRow("calendar monthly") << calendarItem(QTime(8, 5), 75, RepeatingOption(RepeatingOption::RepeatingModeMonthly, QList<int>(), {1, 4, 31}));
+    QTest::newRow("time event hourly") << timeEventItem(QTime(0, 7), RepeatingOption(RepeatingOption::RepeatingModeHourly));
+    QTest::newRow("time event daily") << timeEventItem(QTime(13, 37), RepeatingOption(RepeatingOption::RepeatingModeDaily));
+    QTest::newRow("time event weekly") << timeEventItem(QTime(6, 0), RepeatingOption(RepeatingOption::RepeatingModeWeekly, {4}));
+}
+
+void TestTimeManager::testNextTransition()
+{
+    QFETCH(TimeDescriptor, timeDescriptor);
+
+    // Walk minute by minute through a few weeks and make sure the descriptor never changes before its next evaluation
+    QDateTime dateTime(QDate(2020, 2, 26), QTime(0, 0));
+    QDateTime nextEvaluation = timeDescriptor.nextEvaluation(dateTime);
+    bool lastResult = timeDescriptor.evaluate(dateTime.addSecs(-60), dateTime);
+    for (int i = 0; i < 60 * 24 * 7 * 3; i++) {
+        QDateTime previous = dateTime;
+        dateTime = dateTime.addSecs(60);
+        bool result = timeDescriptor.evaluate(previous, dateTime);
+        if (result != lastResult || (result && !timeDescriptor.timeEventItems().isEmpty())) {
+            QVERIFY2(nextEvaluation.isValid() && nextEvaluation <= dateTime,
+                     QString("Descriptor changed at %1 but next evaluation was scheduled for %2").arg(dateTime.toString()).arg(nextEvaluation.toString()).toUtf8());
+        }
+        if (nextEvaluation.isValid() && nextEvaluation <= dateTime) {
+            nextEvaluation = timeDescriptor.nextEvaluation(dateTime);
+            QVERIFY(!nextEvaluation.isValid() || nextEvaluation > dateTime);
+        }
+        lastResult = result;
+    }
+}
+
+void TestTimeManager::testUtcOffsetChange()
+{
+    initTimeManager();
+
+    QVariantMap action;
+    action.insert("actionTypeId", mockWithoutParamsActionTypeId);
+    action.insert("thingId", m_mockThingId);
+    action.insert("ruleActionParams", QVariantList());
+
+    QVariantMap ruleMap;
+    ruleMap.insert("name", "Time based event rule across a time zone change");
+    ruleMap.insert("actions", QVariantList() << action);
+    ruleMap.insert("timeDescriptor", createTimeDescriptorTimeEvent(createTimeEventItem("10:45")));
+
+    QVariant response = injectAndWait("Rules.AddRule", ruleMap);
+    verifyRuleError(response);
+    RuleId ruleId = RuleId(response.toMap().value("params").toMap().value("ruleId").toString());
+
+    QDate date = NymeaCore::instance()->timeManager()->currentDateTime().date().addDays(1);
+
+    // The rule is scheduled for 10:45 UTC
+    NymeaCore::instance()->timeManager()->setTime(QDateTime(date, QTime(9, 30), Qt::OffsetFromUTC, 0));
+    verifyRuleNotExecuted();
+
+    // The time zone changes to UTC+1 one minute later. 10:45 local time is now 09:45 UTC.
+    NymeaCore::instance()->timeManager()->setTime(QDateTime(date, QTime(10, 31), Qt::OffsetFromUTC, 3600));
+    verifyRuleNotExecuted();
+
+    NymeaCore::instance()->timeManager()->setTime(QDateTime(date, QTime(10, 45), Qt::OffsetFromUTC, 3600));
+    verifyRuleExecuted(mockWithoutParamsActionTypeId);
+
+    cleanupMockHistory();
+
+    QVariantMap removeParams;
+    removeParams.insert("ruleId", ruleId);
+    response = injectAndWait("Rules.RemoveRule", removeParams);
+    verifyRuleError(response);
+}
+
 void TestTimeManager::initTimeManager()
 {
     cleanupMockHistory();
@@ -108,6 +108,8 @@ private slots:
 
     void getUserInfo();
 
+    void scopesChangeAppliesToCachedToken();
+
 private:
     // m_apiToken is in testBase
     QUuid m_tokenId;
@@ -531,5 +533,29 @@ void TestUsermanager::unauthenticatedCallAfterTokenRemove()
     injectAndWait("JSONRPC.Hello");
 }
 
+void TestUsermanager::scopesChangeAppliesToCachedToken()
+{
+    authenticate();
+
+    QVariantMap params;
+    params.insert("pluginId", mockPluginId);
+
+    // Warm up the token cache with a call requiring a permission scope
+    QVariant response = injectAndWait("Integrations.GetPluginConfiguration", params);
+    QCOMPARE(response.toMap().value("status").toString(), QString("success"));
+
+    UserManager *userManager = NymeaCore::instance()->userManager();
+    QCOMPARE(userManager->setUserScopes("valid@user.test", Types::PermissionScopeControlThings), UserManager::UserErrorNoError);
+
+    response = injectAndWait("Integrations.GetPluginConfiguration", params);
+    QCOMPARE(response.toMap().value("status").toString(), QString("error"));
+    QCOMPARE(response.toMap().value("error").toString(), QString("Permission denied."));
+
+    QCOMPARE(userManager->setUserScopes("valid@user.test", Types::PermissionScopeAdmin), UserManager::UserErrorNoError);
+
+    response = injectAndWait("Integrations.GetPluginConfiguration", params);
+    QCOMPARE(response.toMap().value("status").toString(), QString("success"));
+}
+
 #include "testusermanager.moc"
 QTEST_MAIN(TestUsermanager)
@@ -66,6 +66,7 @@ void NymeaTestBase::initTestCase(const QString &loggingRules)
     pluginSettings.clear();
     QDir dir(NymeaSettings::cachePath() + "/thingstates/");
     dir.removeRecursively();
+    QFile::remove(NymeaSettings::cachePath() + "/thingstates.cache");
 
     // Reset to default settings
     NymeaSettings nymeadSettings(NymeaSettings::SettingsRoleGlobal);
@@ -418,8 +419,18 @@ void NymeaTestBase::waitForDBSync()
 void NymeaTestBase::restartServer()
 {
     // Destroy and recreate the core instance...
+    stopServer();
+    startServer();
+}
+
+void NymeaTestBase::stopServer()
+{
     qCDebug(dcTests()) << "Tearing down server instance";
     NymeaCore::instance()->destroy();
+}
+
+void NymeaTestBase::startServer()
+{
     qCDebug(dcTests()) << "Restarting server instance";
     NymeaCore::instance()->init();
     QSignalSpy coreSpy(NymeaCore::instance(), SIGNAL(initialized()));
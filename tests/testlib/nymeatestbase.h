@@ -123,6 +123,9 @@ protected:
 
     void waitForDBSync();
     void restartServer();
+    // For tests which need to modify files while the server is down
+    void stopServer();
+    void startServer();
     void clearLoggingDatabase();
 
 private: